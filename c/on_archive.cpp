@@ -1,5 +1,12 @@
 #include "StdAfx.h"
 
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 RH_C_FUNCTION CRhCmnStringHolder* StringHolder_New()
 {
   return new CRhCmnStringHolder();
@@ -174,6 +181,309 @@ RH_C_FUNCTION bool ON_BinaryArchive_WriteCompressedBuffer( ON_BinaryArchive* pAr
   return rc;
 }
 
+// Blocked compressed buffers. The payload is split into blocks that are
+// deflated independently, so blocks compress and inflate on worker threads
+// and a sub-range only inflates the blocks it overlaps.
+//
+// Layout: an ordinary single-stream compressed buffer holding a 28 byte
+// header, followed by an anonymous chunk (version 1.0) holding one
+// ON_CompressedBuffer per block. The header is the 16 bytes of
+// ChunkedCompressedBufferId followed by the uncompressed size, the block size
+// and the block count as little endian 32 bit integers. A reader only treats
+// the chunk as blocks when the header matches, so a single-stream buffer and
+// whatever the caller wrote after it are never misread. Readers that only
+// know the single-stream format read the header as a 28 byte buffer and
+// leave the block chunk unread.
+static const ON_UUID ChunkedCompressedBufferId = { 0x5a8e2f41, 0x93d7, 0x4c1b, { 0xa6, 0x0e, 0x71, 0xd2, 0x3b, 0x95, 0xc4, 0x8f } };
+static const int ChunkedCompressedBufferHeaderSize = 28;
+
+static void SetUInt32LE( unsigned char* p, unsigned int value )
+{
+  p[0] = (unsigned char)(value & 0xFF);
+  p[1] = (unsigned char)((value >> 8) & 0xFF);
+  p[2] = (unsigned char)((value >> 16) & 0xFF);
+  p[3] = (unsigned char)((value >> 24) & 0xFF);
+}
+
+static unsigned int GetUInt32LE( const unsigned char* p )
+{
+  return (unsigned int)p[0] | ((unsigned int)p[1] << 8) | ((unsigned int)p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+// The uuid bytes in the order ON_BinaryArchive::WriteUuid stores them
+static void GetChunkedCompressedBufferMagic( unsigned char magic[16] )
+{
+  const ON_UUID& id = ChunkedCompressedBufferId;
+  SetUInt32LE(magic, (unsigned int)id.Data1);
+  magic[4] = (unsigned char)(id.Data2 & 0xFF);
+  magic[5] = (unsigned char)(id.Data2 >> 8);
+  magic[6] = (unsigned char)(id.Data3 & 0xFF);
+  magic[7] = (unsigned char)(id.Data3 >> 8);
+  memcpy(magic + 8, id.Data4, 8);
+}
+
+struct CompressBlocksContext
+{
+  const char* m_buffer;
+  unsigned int m_size;
+  unsigned int m_block_size;
+  ON_ClassArray<ON_CompressedBuffer>* m_blocks;
+  char* m_block_rc; // one result per block, each written by one thread only
+};
+
+static void CompressBlockAt(int index, void* context)
+{
+  CompressBlocksContext* ctx = (CompressBlocksContext*)context;
+  const unsigned int offset = (unsigned int)index * ctx->m_block_size;
+  unsigned int count = ctx->m_size - offset;
+  if( count > ctx->m_block_size )
+    count = ctx->m_block_size;
+  ctx->m_block_rc[index] = (*ctx->m_blocks)[index].Compress(count, ctx->m_buffer + offset, 1) ? 1 : 0;
+}
+
+// True if every entry of block_rc is set
+static bool AllBlocksSucceeded( const ON_SimpleArray<char>& block_rc )
+{
+  for( int i = 0; i < block_rc.Count(); i++ )
+  {
+    if( 0 == block_rc[i] )
+      return false;
+  }
+  return true;
+}
+
+// blockSize == 0 uses 256KB blocks. maxThreads <= 0 uses every core.
+// Nothing is written if a block fails to compress.
+RH_C_FUNCTION bool ON_BinaryArchive_WriteCompressedBuffer2( ON_BinaryArchive* pArchive, unsigned int size, /*ARRAY*/const char* pBuffer, unsigned int blockSize, int maxThreads )
+{
+  bool rc = false;
+  if( pArchive && size > 0 && pBuffer )
+  {
+    if( 0 == blockSize )
+      blockSize = 256*1024;
+    const int block_count = (int)((size + blockSize - 1) / blockSize);
+    ON_ClassArray<ON_CompressedBuffer> blocks(block_count);
+    blocks.SetCount(block_count);
+    CompressBlocksContext ctx;
+    ctx.m_buffer = pBuffer;
+    ctx.m_size = size;
+    ctx.m_block_size = blockSize;
+    ctx.m_blocks = &blocks;
+    ON_SimpleArray<char> block_rc(block_count);
+    block_rc.SetCount(block_count);
+    block_rc.Zero();
+    ctx.m_block_rc = block_rc.Array();
+    RhCmnParallelFor(block_count, CompressBlockAt, &ctx, maxThreads);
+    if( !AllBlocksSucceeded(block_rc) )
+      return false;
+
+    unsigned char header[ChunkedCompressedBufferHeaderSize];
+    GetChunkedCompressedBufferMagic(header);
+    SetUInt32LE(header + 16, size);
+    SetUInt32LE(header + 20, blockSize);
+    SetUInt32LE(header + 24, (unsigned int)block_count);
+    rc = pArchive->WriteCompressedBuffer(ChunkedCompressedBufferHeaderSize, header);
+    if( rc )
+      rc = pArchive->BeginWrite3dmChunk(TCODE_ANONYMOUS_CHUNK, 1, 0);
+    if( rc )
+    {
+      for( int i = 0; rc && i < block_count; i++ )
+        rc = blocks[i].Write(*pArchive);
+      if( !pArchive->EndWrite3dmChunk() )
+        rc = false;
+    }
+  }
+  return rc;
+}
+
+class CRhCmnCompressedBufferReader
+{
+public:
+  CRhCmnCompressedBufferReader() : m_size(0), m_block_size(0) {}
+
+  // Reads either format. Blocks stay deflated until Read asks for them. A
+  // single-stream buffer is inflated here since it cannot be split.
+  bool Open(ON_BinaryArchive& archive);
+
+  bool Read(unsigned int offset, unsigned int count, char* pBuffer, int maxThreads) const;
+
+  unsigned int m_size;
+  unsigned int m_block_size;
+  ON_ClassArray<ON_CompressedBuffer> m_blocks;
+  ON_SimpleArray<char> m_single_stream;
+};
+
+bool CRhCmnCompressedBufferReader::Open(ON_BinaryArchive& archive)
+{
+  size_t sizeof_buffer = 0;
+  if( !archive.ReadCompressedBufferSize(&sizeof_buffer) )
+    return false;
+  m_size = (unsigned int)sizeof_buffer;
+  m_block_size = m_size;
+  if( 0 == sizeof_buffer )
+    return true;
+  m_single_stream.SetCapacity(m_size);
+  m_single_stream.SetCount(m_size);
+  int bFailedCRC = 0;
+  if( !archive.ReadCompressedBuffer(sizeof_buffer, m_single_stream.Array(), &bFailedCRC) || bFailedCRC )
+    return false;
+
+  // Anything but a blocked header is the data itself
+  unsigned char magic[16];
+  GetChunkedCompressedBufferMagic(magic);
+  const unsigned char* header = (const unsigned char*)m_single_stream.Array();
+  if( ChunkedCompressedBufferHeaderSize != (int)sizeof_buffer || 0 != memcmp(header, magic, 16) )
+    return true;
+
+  const unsigned int size = GetUInt32LE(header + 16);
+  const unsigned int block_size = GetUInt32LE(header + 20);
+  const int block_count = (int)GetUInt32LE(header + 24);
+  m_single_stream.Destroy();
+  // The blocks have to cover size exactly: every block but the last one
+  // holds block_size bytes.
+  if( block_count < 0 || 0 == block_size )
+    return false;
+  const ON__UINT64 covered = (ON__UINT64)block_count * block_size;
+  if( covered < size || (block_count > 0 && covered - block_size >= size) )
+    return false;
+
+  int major_version = 0;
+  int minor_version = 0;
+  if( !archive.BeginRead3dmChunk(TCODE_ANONYMOUS_CHUNK, &major_version, &minor_version) )
+    return false;
+  bool rc = 1 == major_version;
+  if( rc )
+  {
+    m_size = size;
+    m_block_size = block_size;
+    m_blocks.Reserve(block_count);
+    m_blocks.SetCount(block_count);
+    for( int i = 0; rc && i < block_count; i++ )
+    {
+      rc = m_blocks[i].Read(archive);
+      const unsigned int expected = (i + 1 < block_count) ? block_size : size - (unsigned int)i * block_size;
+      if( rc && m_blocks[i].m_sizeof_uncompressed != expected )
+        rc = false;
+    }
+  }
+  if( !archive.EndRead3dmChunk() )
+    rc = false;
+  return rc;
+}
+
+struct InflateBlocksContext
+{
+  const CRhCmnCompressedBufferReader* m_reader;
+  int m_first_block;
+  unsigned int m_offset;
+  unsigned int m_count;
+  char* m_buffer;
+  char* m_block_rc; // one result per block, each written by one thread only
+};
+
+static void InflateBlockAt(int index, void* context)
+{
+  InflateBlocksContext* ctx = (InflateBlocksContext*)context;
+  const int block_index = ctx->m_first_block + index;
+  const ON_CompressedBuffer& block = ctx->m_reader->m_blocks[block_index];
+  const unsigned int block_start = (unsigned int)block_index * ctx->m_reader->m_block_size;
+  const unsigned int block_end = block_start + (unsigned int)block.m_sizeof_uncompressed;
+  const unsigned int start = block_start > ctx->m_offset ? block_start : ctx->m_offset;
+  const unsigned int end = block_end < ctx->m_offset + ctx->m_count ? block_end : ctx->m_offset + ctx->m_count;
+  ctx->m_block_rc[index] = 0;
+  if( end <= start )
+    return; // Open checked the block sizes, so this is never hit
+
+  int bFailedCRC = 0;
+  bool rc;
+  if( start == block_start && end == block_end )
+    rc = block.Uncompress(ctx->m_buffer + (start - ctx->m_offset), &bFailedCRC);
+  else
+  {
+    // partial block at either end of the range
+    ON_SimpleArray<char> temp((int)block.m_sizeof_uncompressed);
+    rc = block.Uncompress(temp.Array(), &bFailedCRC);
+    if( rc )
+      memcpy(ctx->m_buffer + (start - ctx->m_offset), temp.Array() + (start - block_start), end - start);
+  }
+  ctx->m_block_rc[index] = (rc && !bFailedCRC) ? 1 : 0;
+}
+
+bool CRhCmnCompressedBufferReader::Read(unsigned int offset, unsigned int count, char* pBuffer, int maxThreads) const
+{
+  if( NULL == pBuffer || offset > m_size || count > m_size - offset )
+    return false;
+  if( 0 == count )
+    return true;
+  if( m_blocks.Count() < 1 )
+  {
+    if( (unsigned int)m_single_stream.Count() < offset + count )
+      return false;
+    memcpy(pBuffer, m_single_stream.Array() + offset, count);
+    return true;
+  }
+  if( 0 == m_block_size )
+    return false;
+
+  InflateBlocksContext ctx;
+  ctx.m_reader = this;
+  ctx.m_first_block = (int)(offset / m_block_size);
+  ctx.m_offset = offset;
+  ctx.m_count = count;
+  ctx.m_buffer = pBuffer;
+  const int last_block = (int)((offset + count - 1) / m_block_size);
+  if( last_block >= m_blocks.Count() )
+    return false;
+  const int block_count = last_block - ctx.m_first_block + 1;
+  ON_SimpleArray<char> block_rc(block_count);
+  block_rc.SetCount(block_count);
+  block_rc.Zero();
+  ctx.m_block_rc = block_rc.Array();
+  RhCmnParallelFor(block_count, InflateBlockAt, &ctx, maxThreads);
+  return AllBlocksSucceeded(block_rc);
+}
+
+// Reads a compressed buffer written by either ON_BinaryArchive_WriteCompressedBuffer
+// or ON_BinaryArchive_WriteCompressedBuffer2
+RH_C_FUNCTION CRhCmnCompressedBufferReader* ON_BinaryArchive_OpenCompressedBuffer( ON_BinaryArchive* pArchive )
+{
+  CRhCmnCompressedBufferReader* rc = NULL;
+  if( pArchive )
+  {
+    rc = new CRhCmnCompressedBufferReader();
+    if( !rc->Open(*pArchive) )
+    {
+      delete rc;
+      rc = NULL;
+    }
+  }
+  return rc;
+}
+
+RH_C_FUNCTION unsigned int ON_CompressedBufferReader_Size( const CRhCmnCompressedBufferReader* pConstReader )
+{
+  unsigned int rc = 0;
+  if( pConstReader )
+    rc = pConstReader->m_size;
+  return rc;
+}
+
+// Copies count bytes starting at offset. Only the blocks that overlap the
+// range are inflated.
+RH_C_FUNCTION bool ON_CompressedBufferReader_Read( const CRhCmnCompressedBufferReader* pConstReader, unsigned int offset, unsigned int count, /*ARRAY*/char* pBuffer, int maxThreads )
+{
+  bool rc = false;
+  if( pConstReader && pBuffer )
+    rc = pConstReader->Read(offset, count, pBuffer, maxThreads);
+  return rc;
+}
+
+RH_C_FUNCTION void ON_CompressedBufferReader_Delete( CRhCmnCompressedBufferReader* pReader )
+{
+  if( pReader )
+    delete pReader;
+}
+
 RH_C_FUNCTION bool ON_BinaryArchive_ReadShort(ON_BinaryArchive* pArchive, short* readShort)
 {
   bool rc = false;
@@ -477,6 +787,7 @@ RH_C_FUNCTION bool ON_BinaryArchive_WriteGeometry(ON_BinaryArchive* pArchive, co
     // 13 March 2013 (S. Baer) RH-16957
     // The geometry reader was using ReadObject, so we need to use the
     // WriteObject function instead of the ON_Geometry::Write function
+    RhCmnMaterializeLazyUserData(pConstGeometry, pArchive->Archive3dmVersion());
     rc = pArchive->WriteObject(pConstGeometry);
     //rc = pConstGeometry->Write(*pArchive) ? true:false;
   }
@@ -594,6 +905,162 @@ RH_C_FUNCTION bool ON_BinaryArchive_EndWriteDictionaryEntry(ON_BinaryArchive* pA
   return rc;
 }
 
+// Name, type and position of every entry in a dictionary, recorded by a
+// single pass that skips the entry payloads. The positions are offsets of
+// the entry chunks in the archive, so an entry can be opened again with
+// BeginReadDictionaryEntry after seeking there.
+class CRhCmnDictionaryIndex
+{
+public:
+  struct Entry
+  {
+    ON_wString m_name;
+    int m_type;
+    size_t m_offset;
+  };
+
+  bool Scan( ON_BinaryArchive& archive );
+  int Find( const wchar_t* name ) const;
+  int BeginReadEntry( ON_BinaryArchive& archive, int index, int* de_type ) const;
+
+  ON_ClassArray<Entry> m_entries; // in archive order
+  ON_SimpleArray<int> m_sorted;   // m_entries indices sorted by name
+};
+
+static int CompareDictionaryEntryName( const CRhCmnDictionaryIndex::Entry* a, const CRhCmnDictionaryIndex::Entry* b )
+{
+  return a->m_name.Compare(b->m_name);
+}
+
+bool CRhCmnDictionaryIndex::Scan( ON_BinaryArchive& archive )
+{
+  m_entries.Empty();
+  m_sorted.Empty();
+  for(;;)
+  {
+    const size_t offset = archive.CurrentPosition();
+    int de_type = 0;
+    ON_wString name;
+    const int rc = archive.BeginReadDictionaryEntry(&de_type, name);
+    if( 2 == rc )
+      break;
+    if( 1 != rc )
+      return false;
+    Entry& entry = m_entries.AppendNew();
+    entry.m_name = name;
+    entry.m_type = de_type;
+    entry.m_offset = offset;
+    // skips the payload without decoding it
+    if( !archive.EndReadDictionaryEntry() )
+      return false;
+  }
+  m_sorted.SetCapacity(m_entries.Count());
+  m_sorted.SetCount(m_entries.Count());
+  m_entries.Sort(ON::quick_sort, m_sorted.Array(), CompareDictionaryEntryName);
+  return true;
+}
+
+int CRhCmnDictionaryIndex::Find( const wchar_t* name ) const
+{
+  if( 0 == name )
+    return -1;
+  int i0 = 0;
+  int i1 = m_sorted.Count();
+  while( i0 < i1 )
+  {
+    const int i = (i0 + i1) / 2;
+    const int c = m_entries[m_sorted[i]].m_name.Compare(name);
+    if( 0 == c )
+      return m_sorted[i];
+    if( c < 0 )
+      i0 = i + 1;
+    else
+      i1 = i;
+  }
+  return -1;
+}
+
+int CRhCmnDictionaryIndex::BeginReadEntry( ON_BinaryArchive& archive, int index, int* de_type ) const
+{
+  if( index < 0 || index >= m_entries.Count() )
+    return 0;
+  if( !archive.SeekFromStart(m_entries[index].m_offset) )
+    return 0;
+  ON_wString name;
+  return archive.BeginReadDictionaryEntry(de_type, name);
+}
+
+// Call after ON_BinaryArchive_BeginReadDictionary. Records every entry of
+// the dictionary without reading the payloads and leaves the archive after
+// the last entry. Entries can then be opened in any order with
+// ON_DictionaryIndex_BeginReadEntry and closed with
+// ON_BinaryArchive_EndReadDictionaryEntry. Entries that are never opened
+// cost nothing more. Finish with ON_BinaryArchive_EndReadDictionary as usual.
+// The archive must support seeking.
+RH_C_FUNCTION CRhCmnDictionaryIndex* ON_BinaryArchive_ScanDictionary(ON_BinaryArchive* pArchive)
+{
+  CRhCmnDictionaryIndex* rc = NULL;
+  if( pArchive && pArchive->ReadMode() )
+  {
+    rc = new CRhCmnDictionaryIndex();
+    if( !rc->Scan(*pArchive) )
+    {
+      delete rc;
+      rc = NULL;
+    }
+  }
+  return rc;
+}
+
+RH_C_FUNCTION int ON_DictionaryIndex_Count(const CRhCmnDictionaryIndex* pConstIndex)
+{
+  if( pConstIndex )
+    return pConstIndex->m_entries.Count();
+  return 0;
+}
+
+RH_C_FUNCTION bool ON_DictionaryIndex_GetEntry(const CRhCmnDictionaryIndex* pConstIndex, int index, int* de_type, CRhCmnStringHolder* pStringHolder)
+{
+  bool rc = false;
+  if( pConstIndex && index>=0 && index<pConstIndex->m_entries.Count() )
+  {
+    const CRhCmnDictionaryIndex::Entry& entry = pConstIndex->m_entries[index];
+    if( de_type )
+      *de_type = entry.m_type;
+    if( pStringHolder )
+      pStringHolder->Set(entry.m_name);
+    rc = true;
+  }
+  return rc;
+}
+
+// Returns the index of the entry called name, or -1
+RH_C_FUNCTION int ON_DictionaryIndex_Find(const CRhCmnDictionaryIndex* pConstIndex, const RHMONO_STRING* name)
+{
+  int rc = -1;
+  if( pConstIndex && name )
+  {
+    INPUTSTRINGCOERCE(_name, name);
+    rc = pConstIndex->Find(_name);
+  }
+  return rc;
+}
+
+// Same return codes as ON_BinaryArchive_BeginReadDictionaryEntry
+RH_C_FUNCTION int ON_DictionaryIndex_BeginReadEntry(const CRhCmnDictionaryIndex* pConstIndex, ON_BinaryArchive* pArchive, int index, int* de_type)
+{
+  int rc = 0;
+  if( pConstIndex && pArchive && de_type )
+    rc = pConstIndex->BeginReadEntry(*pArchive, index, de_type);
+  return rc;
+}
+
+RH_C_FUNCTION void ON_DictionaryIndex_Delete(CRhCmnDictionaryIndex* pIndex)
+{
+  if( pIndex )
+    delete pIndex;
+}
+
 RH_C_FUNCTION ON_Object* ON_ReadBufferArchive(int archive_3dm_version, int archive_on_version, int length, /*ARRAY*/const unsigned char* buffer)
 {
   // Eliminate potential bogus file versions written
@@ -617,6 +1084,8 @@ RH_C_FUNCTION ON_Write3dmBufferArchive* ON_WriteBufferArchive_NewWriter(const ON
     ON_UserDataHolder holder;
     if( !writeuserdata )
       holder.MoveUserDataFrom(*pConstObject);
+    else
+      RhCmnMaterializeLazyUserData(pConstObject, rhinoversion);
     *length = 0;
     size_t sz = pConstObject->SizeOf() + 512; // 256 was too small on x86 builds to account for extra data written
     rc = new ON_Write3dmBufferArchive(sz, 0, rhinoversion, ON::Version());
@@ -651,77 +1120,346 @@ RH_C_FUNCTION unsigned char* ON_WriteBufferArchive_Buffer(const ON_Write3dmBuffe
   return rc;
 }
 
+// Binary archive that writes into a caller supplied growable byte array.
+// The array keeps its capacity between archives so a writer that is used
+// over and over stops allocating once it has seen its largest object.
+class CRhCmnWriteBufferArchive : public ON_BinaryArchive
+{
+public:
+  CRhCmnWriteBufferArchive(ON_SimpleArray<unsigned char>& buffer, int archive_3dm_version, int archive_opennurbs_version)
+  : ON_BinaryArchive(ON::write3dm)
+  , m_buffer(buffer)
+  , m_position(0)
+  {
+    m_buffer.SetCount(0);
+    if( archive_3dm_version < 0 )
+      archive_3dm_version = 0;
+    if( archive_opennurbs_version < 0 )
+      archive_opennurbs_version = 0;
+    SetArchive3dmVersion(archive_3dm_version);
+    ON_SetBinaryArchiveOpenNURBSVersion(*this, archive_opennurbs_version);
+  }
 
+  size_t SizeOfArchive() const { return (size_t)m_buffer.Count(); }
 
-/////////////////////////////////
-// move to on_extensions.cpp
+  size_t CurrentPosition() const { return m_position; }
 
-RH_C_FUNCTION ONX_Model* ONX_Model_New()
-{
-  return new ONX_Model();
-}
+  bool SeekFromCurrentPosition(int offset)
+  {
+    if( offset < 0 && (size_t)(-offset) > m_position )
+      return false;
+    return SeekFromStart(m_position + offset);
+  }
 
-RH_C_FUNCTION void ONX_Model_ReadNotes(const RHMONO_STRING* path, CRhCmnStringHolder* pString)
-{
-  if( path && pString )
+  bool SeekFromStart(size_t offset)
   {
-    INPUTSTRINGCOERCE(_path, path);
+    if( offset > (size_t)m_buffer.Count() )
+      return false;
+    m_position = offset;
+    return true;
+  }
 
-    FILE* fp = ON::OpenFile( _path, L"rb" );
-    if( fp )
+  bool AtEnd() const { return m_position >= (size_t)m_buffer.Count(); }
+
+protected:
+  size_t Read(size_t, void*) { return 0; }
+
+  size_t Write(size_t count, const void* p)
+  {
+    if( count < 1 || NULL == p )
+      return 0;
+    size_t end = m_position + count;
+    if( end > 0x7FFFFFFF )
+      return 0;
+    if( (int)end > m_buffer.Capacity() )
     {
-      ON_BinaryFile file( ON::read3dm, fp);
-      int version = 0;
-      ON_String comments;
-      BOOL rc = file.Read3dmStartSection( &version, comments );
-      if(rc)
-      {
-        ON_3dmProperties prop;
-        file.Read3dmProperties(prop);
-        if( prop.m_Notes.IsValid() )
-        {
-          pString->Set( prop.m_Notes.m_notes );
-        }
-      }
-      ON::CloseFile(fp);
+      // grow geometrically so a long run of small writes stays linear
+      int capacity = m_buffer.Capacity() < 4096 ? 4096 : m_buffer.Capacity();
+      while( capacity < (int)end && capacity < 0x40000000 )
+        capacity *= 2;
+      if( capacity < (int)end )
+        capacity = (int)end;
+      m_buffer.SetCapacity(capacity);
     }
+    if( (int)end > m_buffer.Count() )
+      m_buffer.SetCount((int)end);
+    memcpy(m_buffer.Array() + m_position, p, count);
+    m_position = end;
+    return count;
   }
-}
 
-RH_C_FUNCTION int ONX_Model_ReadArchiveVersion(const RHMONO_STRING* path)
+  bool Flush() { return true; }
+
+private:
+  ON_SimpleArray<unsigned char>& m_buffer;
+  size_t m_position;
+};
+
+// Reusable object serializer. Each call overwrites the bytes produced by the
+// previous call, so callers copy the result out before writing again. Use one
+// writer per thread.
+class CRhCmnBufferWriter
 {
-  if( path )
+public:
+  CRhCmnBufferWriter(int rhinoversion, bool writeuserdata)
+  : m_rhinoversion(rhinoversion)
+  , m_bWriteUserData(writeuserdata)
   {
-    INPUTSTRINGCOERCE(_path, path);
-    
-    FILE* fp = ON::OpenFile( _path, L"rb" );
-    if( fp )
+  }
+
+  // Serializes count objects back to back. offsets[i] is the start of object i
+  // in the buffer and offsets[count] is the total length.
+  bool WriteObjects(int count, const ON_Object* const* objects, unsigned int* offsets)
+  {
+    m_offsets.SetCount(0);
+    CRhCmnWriteBufferArchive archive(m_buffer, m_rhinoversion, ON::Version());
+    if( count < 1 || NULL == objects )
+      return false;
+    m_offsets.Reserve(count+1);
+    for( int i=0; i<count; i++ )
     {
-      ON_BinaryFile file( ON::read3dm, fp);
-      int version = 0;
-      ON_String comment_block;
-      ON_BOOL32 rc = file.Read3dmStartSection( &version, comment_block );
-      if(rc)
-      {
-        ON::CloseFile(fp);
-        return version;
-      }
-      ON::CloseFile(fp);
+      const ON_Object* pConstObject = objects[i];
+      if( NULL == pConstObject )
+        return false;
+      m_offsets.Append((unsigned int)archive.SizeOfArchive());
+      ON_UserDataHolder holder;
+      if( !m_bWriteUserData )
+        holder.MoveUserDataFrom(*pConstObject);
+      else
+        RhCmnMaterializeLazyUserData(pConstObject, m_rhinoversion);
+      bool rc = archive.WriteObject(pConstObject);
+      if( !m_bWriteUserData )
+        holder.MoveUserDataTo(*pConstObject, false);
+      if( !rc )
+        return false;
     }
+    m_offsets.Append((unsigned int)archive.SizeOfArchive());
+    if( offsets )
+      memcpy(offsets, m_offsets.Array(), m_offsets.Count()*sizeof(unsigned int));
+    return true;
   }
-  
-  return 0;
+
+  const unsigned char* Buffer() const { return m_buffer.Array(); }
+  unsigned int Length() const { return (unsigned int)m_buffer.Count(); }
+
+private:
+  int m_rhinoversion;
+  bool m_bWriteUserData;
+  ON_SimpleArray<unsigned char> m_buffer;
+  ON_SimpleArray<unsigned int> m_offsets;
+};
+
+RH_C_FUNCTION CRhCmnBufferWriter* ON_BufferWriter_New(int rhinoversion, bool writeuserdata)
+{
+  return new CRhCmnBufferWriter(rhinoversion, writeuserdata);
 }
 
-RH_C_FUNCTION ON_3dmRevisionHistory* ONX_Model_ReadRevisionHistory(const RHMONO_STRING* path, CRhCmnStringHolder* pStringCreated, CRhCmnStringHolder* pStringLastEdited, int* revision)
+RH_C_FUNCTION void ON_BufferWriter_Delete(CRhCmnBufferWriter* pWriter)
 {
-  ON_3dmRevisionHistory* rc = NULL;
-  if( path && pStringCreated && pStringLastEdited && revision )
-  {
-    INPUTSTRINGCOERCE(_path, path);
+  if( pWriter )
+    delete pWriter;
+}
 
-    FILE* fp = ON::OpenFile( _path, L"rb" );
-    if( fp )
+// Returned buffer is owned by the writer and valid until the next write
+RH_C_FUNCTION const unsigned char* ON_BufferWriter_WriteObject(CRhCmnBufferWriter* pWriter, const ON_Object* pConstObject, unsigned int* length)
+{
+  const unsigned char* rc = NULL;
+  if( length )
+    *length = 0;
+  if( pWriter && pConstObject && length )
+  {
+    const ON_Object* objects[1] = { pConstObject };
+    if( pWriter->WriteObjects(1, objects, NULL) )
+    {
+      rc = pWriter->Buffer();
+      *length = pWriter->Length();
+    }
+  }
+  return rc;
+}
+
+// offsets must hold one more entry than pConstObjects
+RH_C_FUNCTION const unsigned char* ON_BufferWriter_WriteObjects(CRhCmnBufferWriter* pWriter, const ON_SimpleArray<ON_Object*>* pConstObjects, /*ARRAY*/unsigned int* offsets, unsigned int* length)
+{
+  const unsigned char* rc = NULL;
+  if( length )
+    *length = 0;
+  if( pWriter && pConstObjects && pConstObjects->Count()>0 && offsets && length )
+  {
+    if( pWriter->WriteObjects(pConstObjects->Count(), pConstObjects->Array(), offsets) )
+    {
+      rc = pWriter->Buffer();
+      *length = pWriter->Length();
+    }
+  }
+  return rc;
+}
+
+// Reads a buffer produced by ON_BufferWriter_WriteObjects. pObjects is set
+// to count entries; slots that fail to read are NULL. Returns the number of
+// objects read.
+RH_C_FUNCTION int ON_ReadBufferArchive2(int archive_3dm_version, int archive_on_version, unsigned int length, /*ARRAY*/const unsigned char* buffer, int count, /*ARRAY*/const unsigned int* offsets, ON_SimpleArray<ON_Object*>* pObjects)
+{
+  int rc = 0;
+  if( length>0 && buffer && count>0 && offsets && pObjects )
+  {
+    pObjects->SetCount(0);
+    pObjects->Reserve(count);
+    for( int i=0; i<count; i++ )
+    {
+      ON_Object* pObject = NULL;
+      unsigned int start = offsets[i];
+      unsigned int end = offsets[i+1];
+      if( end > start && end <= length )
+        pObject = ON_ReadBufferArchive(archive_3dm_version, archive_on_version, (int)(end-start), buffer+start);
+      pObjects->Append(pObject);
+      if( pObject )
+        rc++;
+    }
+  }
+  return rc;
+}
+
+struct ReadBufferArchivesContext
+{
+  unsigned int m_length;
+  const unsigned char* m_buffer;
+  const unsigned int* m_offsets;
+  const int* m_archive_3dm_versions;
+  const int* m_archive_on_versions;
+  ON_Object** m_objects;
+  int* m_status;
+};
+
+static void ReadBufferArchiveAt(int index, void* context)
+{
+  ReadBufferArchivesContext* ctx = (ReadBufferArchivesContext*)context;
+  const int archive_3dm_version = ctx->m_archive_3dm_versions[index];
+  const unsigned int start = ctx->m_offsets[index];
+  const unsigned int end = ctx->m_offsets[index+1];
+  ON_Object* pObject = NULL;
+  int status = 0;
+  if( archive_3dm_version > 5 && archive_3dm_version < 50 )
+    status = -1;
+  else if( end > ctx->m_length || end < start )
+    status = -2;
+  else if( end > start )
+  {
+    pObject = ON_ReadBufferArchive(archive_3dm_version, ctx->m_archive_on_versions[index], (int)(end-start), ctx->m_buffer+start);
+    status = pObject ? 1 : -2;
+  }
+  ctx->m_objects[index] = pObject;
+  if( ctx->m_status )
+    ctx->m_status[index] = status;
+}
+
+// Decodes count independent archives on worker threads. Archive i is
+// buffer[offsets[i]] through buffer[offsets[i+1]-1], so offsets holds
+// count+1 entries, and was written with archive_3dm_versions[i] and
+// archive_on_versions[i]. pObjects is set to count entries (NULL on failure)
+// and status, when not NULL, receives
+//  1 = read, 0 = empty archive, -1 = bogus archive version, -2 = decode failed.
+// Returns the number of objects read. Once managed user data classes are
+// registered the archives are decoded on the calling thread.
+RH_C_FUNCTION int ON_ReadBufferArchives(int count, unsigned int length, /*ARRAY*/const unsigned char* buffer, /*ARRAY*/const unsigned int* offsets, /*ARRAY*/const int* archive_3dm_versions, /*ARRAY*/const int* archive_on_versions, ON_SimpleArray<ON_Object*>* pObjects, /*ARRAY*/int* status, int maxThreads)
+{
+  int rc = 0;
+  if( count>0 && buffer && offsets && archive_3dm_versions && archive_on_versions && pObjects )
+  {
+    pObjects->Reserve(count);
+    pObjects->SetCount(count);
+    ReadBufferArchivesContext ctx;
+    ctx.m_length = length;
+    ctx.m_buffer = buffer;
+    ctx.m_offsets = offsets;
+    ctx.m_archive_3dm_versions = archive_3dm_versions;
+    ctx.m_archive_on_versions = archive_on_versions;
+    ctx.m_objects = pObjects->Array();
+    ctx.m_status = status;
+    // Managed user data can not be created on worker threads
+    if( RhCmnManagedUserDataRegistered() )
+      maxThreads = 1;
+    RhCmnParallelFor(count, ReadBufferArchiveAt, &ctx, maxThreads);
+    for( int i=0; i<count; i++ )
+    {
+      if( (*pObjects)[i] )
+        rc++;
+    }
+  }
+  return rc;
+}
+
+
+
+/////////////////////////////////
+// move to on_extensions.cpp
+
+RH_C_FUNCTION ONX_Model* ONX_Model_New()
+{
+  return new ONX_Model();
+}
+
+RH_C_FUNCTION void ONX_Model_ReadNotes(const RHMONO_STRING* path, CRhCmnStringHolder* pString)
+{
+  if( path && pString )
+  {
+    INPUTSTRINGCOERCE(_path, path);
+
+    FILE* fp = ON::OpenFile( _path, L"rb" );
+    if( fp )
+    {
+      ON_BinaryFile file( ON::read3dm, fp);
+      int version = 0;
+      ON_String comments;
+      BOOL rc = file.Read3dmStartSection( &version, comments );
+      if(rc)
+      {
+        ON_3dmProperties prop;
+        file.Read3dmProperties(prop);
+        if( prop.m_Notes.IsValid() )
+        {
+          pString->Set( prop.m_Notes.m_notes );
+        }
+      }
+      ON::CloseFile(fp);
+    }
+  }
+}
+
+RH_C_FUNCTION int ONX_Model_ReadArchiveVersion(const RHMONO_STRING* path)
+{
+  if( path )
+  {
+    INPUTSTRINGCOERCE(_path, path);
+    
+    FILE* fp = ON::OpenFile( _path, L"rb" );
+    if( fp )
+    {
+      ON_BinaryFile file( ON::read3dm, fp);
+      int version = 0;
+      ON_String comment_block;
+      ON_BOOL32 rc = file.Read3dmStartSection( &version, comment_block );
+      if(rc)
+      {
+        ON::CloseFile(fp);
+        return version;
+      }
+      ON::CloseFile(fp);
+    }
+  }
+  
+  return 0;
+}
+
+RH_C_FUNCTION ON_3dmRevisionHistory* ONX_Model_ReadRevisionHistory(const RHMONO_STRING* path, CRhCmnStringHolder* pStringCreated, CRhCmnStringHolder* pStringLastEdited, int* revision)
+{
+  ON_3dmRevisionHistory* rc = NULL;
+  if( path && pStringCreated && pStringLastEdited && revision )
+  {
+    INPUTSTRINGCOERCE(_path, path);
+
+    FILE* fp = ON::OpenFile( _path, L"rb" );
+    if( fp )
     {
       ON_BinaryFile file( ON::read3dm, fp);
       int version = 0;
@@ -803,6 +1541,190 @@ RH_C_FUNCTION void ONX_Model_ReadApplicationDetails(const RHMONO_STRING* path, C
   }
 }
 
+// Everything the ONX_Model_Read... file queries above need, gathered from
+// a single open and a single parse of the start and properties sections.
+class CRhCmnFileHeader
+{
+public:
+  CRhCmnFileHeader() : m_3dm_version(0) {}
+  bool Read( const wchar_t* filename );
+
+  int m_3dm_version;
+  ON_String m_start_section_comments;
+  ON_3dmProperties m_properties;
+};
+
+bool CRhCmnFileHeader::Read( const wchar_t* filename )
+{
+  bool rc = false;
+  FILE* fp = ON::OpenFile( filename, L"rb" );
+  if( fp )
+  {
+    ON_BinaryFile file( ON::read3dm, fp );
+    if( file.Read3dmStartSection( &m_3dm_version, m_start_section_comments ) )
+    {
+      // A file with a readable start section is still useful even when
+      // the properties are damaged; the version and comments are valid.
+      file.Read3dmProperties(m_properties);
+      rc = true;
+    }
+    ON::CloseFile(fp);
+  }
+  return rc;
+}
+
+RH_C_FUNCTION CRhCmnFileHeader* ONX_Model_ReadFileHeader(const RHMONO_STRING* path)
+{
+  CRhCmnFileHeader* rc = NULL;
+  if( path )
+  {
+    INPUTSTRINGCOERCE(_path, path);
+    rc = new CRhCmnFileHeader();
+    if( !rc->Read(_path) )
+    {
+      delete rc;
+      rc = NULL;
+    }
+  }
+  return rc;
+}
+
+RH_C_FUNCTION void ONX_Model_FileHeader_Delete(CRhCmnFileHeader* pHeader)
+{
+  if( pHeader )
+    delete pHeader;
+}
+
+RH_C_FUNCTION int ONX_Model_FileHeader_ArchiveVersion(const CRhCmnFileHeader* pConstHeader)
+{
+  if( pConstHeader )
+    return pConstHeader->m_3dm_version;
+  return 0;
+}
+
+RH_C_FUNCTION void ONX_Model_FileHeader_GetStartSectionComments(const CRhCmnFileHeader* pConstHeader, CRhCmnStringHolder* pString)
+{
+  if( pConstHeader && pString )
+    pString->Set(ON_wString(pConstHeader->m_start_section_comments));
+}
+
+RH_C_FUNCTION bool ONX_Model_FileHeader_GetNotes(const CRhCmnFileHeader* pConstHeader, CRhCmnStringHolder* pString, bool* visible, bool* html, int* left, int* top, int* right, int* bottom)
+{
+  bool rc = false;
+  if( pConstHeader && visible && html && left && top && right && bottom )
+  {
+    const ON_3dmNotes& notes = pConstHeader->m_properties.m_Notes;
+    rc = notes.IsValid() ? true : false;
+    if( pString && rc )
+      pString->Set(notes.m_notes);
+    *visible = notes.m_bVisible?true:false;
+    *html = notes.m_bHTML?true:false;
+    *left = notes.m_window_left;
+    *top = notes.m_window_top;
+    *right = notes.m_window_right;
+    *bottom = notes.m_window_bottom;
+  }
+  return rc;
+}
+
+// Returned pointer is owned by the header. Do not call ON_3dmRevisionHistory_Delete on it.
+RH_C_FUNCTION const ON_3dmRevisionHistory* ONX_Model_FileHeader_RevisionHistory(const CRhCmnFileHeader* pConstHeader, CRhCmnStringHolder* pStringCreated, CRhCmnStringHolder* pStringLastEdited, int* revision)
+{
+  const ON_3dmRevisionHistory* rc = NULL;
+  if( pConstHeader )
+  {
+    rc = &(pConstHeader->m_properties.m_RevisionHistory);
+    if( pStringCreated )
+      pStringCreated->Set(rc->m_sCreatedBy);
+    if( pStringLastEdited )
+      pStringLastEdited->Set(rc->m_sLastEditedBy);
+    if( revision )
+      *revision = rc->m_revision_count;
+  }
+  return rc;
+}
+
+RH_C_FUNCTION void ONX_Model_FileHeader_GetApplicationDetails(const CRhCmnFileHeader* pConstHeader, CRhCmnStringHolder* pApplicationName, CRhCmnStringHolder* pApplicationUrl, CRhCmnStringHolder* pApplicationDetails)
+{
+  if( pConstHeader )
+  {
+    const ON_3dmApplication& app = pConstHeader->m_properties.m_Application;
+    if( pApplicationName )
+      pApplicationName->Set(app.m_application_name);
+    if( pApplicationUrl )
+      pApplicationUrl->Set(app.m_application_URL);
+    if( pApplicationDetails )
+      pApplicationDetails->Set(app.m_application_details);
+  }
+}
+
+struct ReadFileHeadersContext
+{
+  const ON_ClassArray<ON_wString>* m_paths;
+  ON_SimpleArray<CRhCmnFileHeader*>* m_headers;
+};
+
+static void ReadFileHeaderAt(int index, void* context)
+{
+  ReadFileHeadersContext* ctx = (ReadFileHeadersContext*)context;
+  CRhCmnFileHeader* pHeader = new CRhCmnFileHeader();
+  if( !pHeader->Read((*ctx->m_paths)[index].Array()) )
+  {
+    delete pHeader;
+    pHeader = NULL;
+  }
+  (*ctx->m_headers)[index] = pHeader;
+}
+
+// Reads the headers of every file in pPaths on worker threads. The result
+// has one entry per path, in the same order, with NULL entries for files
+// that could not be read. Free with ONX_Model_FileHeaderArray_Delete.
+RH_C_FUNCTION ON_SimpleArray<CRhCmnFileHeader*>* ONX_Model_ReadFileHeaders(const ON_ClassArray<ON_wString>* pPaths, int maxThreads)
+{
+  ON_SimpleArray<CRhCmnFileHeader*>* rc = NULL;
+  if( pPaths )
+  {
+    const int count = pPaths->Count();
+    rc = new ON_SimpleArray<CRhCmnFileHeader*>(count);
+    rc->SetCount(count);
+    rc->Zero();
+    ReadFileHeadersContext ctx;
+    ctx.m_paths = pPaths;
+    ctx.m_headers = rc;
+    RhCmnParallelFor(count, ReadFileHeaderAt, &ctx, maxThreads);
+  }
+  return rc;
+}
+
+RH_C_FUNCTION int ONX_Model_FileHeaderArray_Count(const ON_SimpleArray<CRhCmnFileHeader*>* pConstHeaders)
+{
+  if( pConstHeaders )
+    return pConstHeaders->Count();
+  return 0;
+}
+
+RH_C_FUNCTION const CRhCmnFileHeader* ONX_Model_FileHeaderArray_Get(const ON_SimpleArray<CRhCmnFileHeader*>* pConstHeaders, int index)
+{
+  const CRhCmnFileHeader* rc = NULL;
+  if( pConstHeaders && index>=0 && index<pConstHeaders->Count() )
+    rc = (*pConstHeaders)[index];
+  return rc;
+}
+
+RH_C_FUNCTION void ONX_Model_FileHeaderArray_Delete(ON_SimpleArray<CRhCmnFileHeader*>* pHeaders)
+{
+  if( pHeaders )
+  {
+    for( int i=0; i<pHeaders->Count(); i++ )
+    {
+      CRhCmnFileHeader* pHeader = (*pHeaders)[i];
+      if( pHeader )
+        delete pHeader;
+    }
+    delete pHeaders;
+  }
+}
+
 RH_C_FUNCTION ONX_Model* ONX_Model_ReadFile(const RHMONO_STRING* path, CRhCmnStringHolder* pStringHolder)
 {
   ONX_Model* rc = NULL;
@@ -865,2380 +1787,6100 @@ enum ObjectTypeFilter : unsigned int
   otAny           = 0xFFFFFFFF
 };
 
-RH_C_FUNCTION bool ONX_Model_WriteFile(ONX_Model* pModel, const RHMONO_STRING* path, int version, CRhCmnStringHolder* pStringHolder)
+// Open addressing map from uuid to table index. Built from scratch when it
+// goes stale; appends at the end of the table are added in place so adding
+// objects one at a time does not force a rebuild per object.
+class CRhCmnUuidIndexMap
 {
-  bool rc = false;
-  if( pModel )
+public:
+  CRhCmnUuidIndexMap() : m_bValid(false), m_count(0) {}
+
+  void Invalidate() { m_bValid = false; }
+  bool IsValid(int table_count) const { return m_bValid && m_count == table_count; }
+
+  void Reset(int table_count)
   {
-    INPUTSTRINGCOERCE(_path, path);
-    ON_wString s;
-    ON_TextLog log(s);
-    ON_TextLog* pLog = pStringHolder ? &log : NULL;
-    rc = pModel->Write(_path, version, NULL, pLog);
-    if( pStringHolder )
-      pStringHolder->Set(s);
+    int capacity = 16;
+    while( capacity < 2*table_count )
+      capacity *= 2;
+    ON_UuidIndex empty;
+    empty.m_id = ON_nil_uuid;
+    empty.m_i = -1;
+    m_slots.SetCapacity(capacity);
+    m_slots.SetCount(capacity);
+    for( int i = 0; i < capacity; i++ )
+      m_slots[i] = empty;
+    m_count = 0;
+    m_bValid = true;
   }
-  return rc;
-}
 
-RH_C_FUNCTION bool ONX_Model_WriteFile2(ONX_Model* pModel, const RHMONO_STRING* path, int version, bool writeRenderMeshes, bool writeAnalysisMeshes, bool writeUserData)
-{
-  bool rc = false;
-  INPUTSTRINGCOERCE(_path, path);
-  if( pModel && _path )
+  // Call for index == 0,1,2,... in table order. Duplicate ids keep the
+  // first index, which is what a front to back scan would find.
+  void Append(const ON_UUID& id, int index)
   {
-    FILE* fp = ON::OpenFile(_path, L"wb");
-    if( 0==fp )
-      return false;
-    ON_BinaryFile binary_file(ON::write3dm, fp);
-    binary_file.EnableSave3dmRenderMeshes(writeRenderMeshes?1:0);
-    binary_file.EnableSave3dmAnalysisMeshes(writeAnalysisMeshes?1:0);
-    binary_file.EnableSaveUserData(writeUserData?1:0);
-    rc = pModel->Write(binary_file, version, 0, 0);
-    ON::CloseFile(fp);
+    if( !m_bValid || index != m_count )
+    {
+      m_bValid = false;
+      return;
+    }
+    m_count++;
+    if( 2*m_count > m_slots.Count() )
+    {
+      // grow; the caller rebuilds on the next lookup
+      m_bValid = false;
+      return;
+    }
+    const unsigned int mask = (unsigned int)m_slots.Count() - 1;
+    for( unsigned int slot = Hash(id) & mask; ; slot = (slot + 1) & mask )
+    {
+      ON_UuidIndex& s = m_slots[(int)slot];
+      if( s.m_i < 0 )
+      {
+        s.m_id = id;
+        s.m_i = index;
+        return;
+      }
+      if( s.m_id == id )
+        return;
+    }
   }
-  return rc;
-}
 
-RH_C_FUNCTION void ONX_Model_Delete(ONX_Model* pModel)
-{
-  if( pModel )
-    delete pModel;
-}
-
-RH_C_FUNCTION bool ONX_Model_IsValid(const ONX_Model* pConstModel, CRhCmnStringHolder* pString)
-{
-  bool rc = false;
-  if( pConstModel && pString )
+  int Find(const ON_UUID& id) const
   {
-    ON_wString s;
-    ON_TextLog log(s);
-    rc = pConstModel->IsValid(&log);
-    pString->Set(s);
+    if( m_slots.Count() < 1 )
+      return -1;
+    const unsigned int mask = (unsigned int)m_slots.Count() - 1;
+    for( unsigned int slot = Hash(id) & mask; ; slot = (slot + 1) & mask )
+    {
+      const ON_UuidIndex& s = m_slots[(int)slot];
+      if( s.m_i < 0 )
+        return -1;
+      if( s.m_id == id )
+        return s.m_i;
+    }
   }
-  return rc;
-}
 
-RH_C_FUNCTION bool ONX_Model_IsValid2(const ONX_Model* pConstModel, ON_TextLog* pTextLog)
+private:
+  static unsigned int Hash(const ON_UUID& id)
+  {
+    unsigned int h = id.Data1 ^ ((unsigned int)id.Data2 << 16 | id.Data3);
+    for( int i = 0; i < 8; i++ )
+      h = h*31 + id.Data4[i];
+    return h * 0x9E3779B1u;
+  }
+
+  bool m_bValid;
+  int m_count;
+  ON_SimpleArray<ON_UuidIndex> m_slots; // m_i < 0 marks an empty slot
+};
+
+// Tables with a uuid index, also the table argument of ONX_Model_ResolveIds
+enum ModelIdTable : int
+{
+  mitObjectTable = 0,
+  mitLayerTable,
+  mitLinetypeTable,
+  mitDimstyleTable,
+  mitHatchpatternTable,
+  mitMaterialTable,
+  mitInstanceDefinitionTable,
+  mitTableCount
+};
+
+static const unsigned int ModelIdTableFilter[mitTableCount] =
 {
-  bool rc = false;
-  if( pConstModel && pTextLog )
-    rc = pConstModel->IsValid(pTextLog);
-  return rc;
-}
+  ttfObjectTable,
+  ttfLayerTable,
+  ttfLinetypeTable,
+  ttfDimstyleTable,
+  ttfHatchpatternTable,
+  ttfMaterialTable,
+  ttfInstanceDefinitionTable
+};
 
-RH_C_FUNCTION void ONX_Model_Polish(ONX_Model* pModel)
+static int ModelIdTableCount(const ONX_Model& model, int table)
 {
-  if( pModel )
-    pModel->Polish();
+  switch( table )
+  {
+  case mitObjectTable: return model.m_object_table.Count();
+  case mitLayerTable: return model.m_layer_table.Count();
+  case mitLinetypeTable: return model.m_linetype_table.Count();
+  case mitDimstyleTable: return model.m_dimstyle_table.Count();
+  case mitHatchpatternTable: return model.m_hatch_pattern_table.Count();
+  case mitMaterialTable: return model.m_material_table.Count();
+  case mitInstanceDefinitionTable: return model.m_idef_table.Count();
+  }
+  return 0;
 }
 
-RH_C_FUNCTION int ONX_Model_Audit(ONX_Model* pModel, bool attemptRepair, int* repairCount, CRhCmnStringHolder* pString, ON_SimpleArray<int>* warnings)
+static ON_UUID ModelIdTableId(const ONX_Model& model, int table, int index)
 {
-  int rc = -1;
-  if( pModel && repairCount )
+  switch( table )
   {
-    ON_wString s;
-    ON_TextLog log(s);
-    rc = pModel->Audit(attemptRepair, repairCount, &log, warnings);
-    if( pString )
-      pString->Set(s);
+  case mitObjectTable: return model.m_object_table[index].m_attributes.m_uuid;
+  case mitLayerTable: return model.m_layer_table[index].m_layer_id;
+  case mitLinetypeTable: return model.m_linetype_table[index].m_linetype_id;
+  case mitDimstyleTable: return model.m_dimstyle_table[index].m_dimstyle_id;
+  case mitHatchpatternTable: return model.m_hatch_pattern_table[index].m_hatchpattern_id;
+  case mitMaterialTable: return model.m_material_table[index].m_material_id;
+  case mitInstanceDefinitionTable: return model.m_idef_table[index].m_uuid;
   }
-  return rc;
+  return ON_nil_uuid;
 }
 
-RH_C_FUNCTION void ONX_Model_GetStartSectionComments(const ONX_Model* pConstModel, CRhCmnStringHolder* pString)
+// Object indices grouped by layer, material or group
+enum ObjectKeyType : int
 {
-  if( pConstModel && pString )
-    pString->Set(pConstModel->m_sStartSectionComments);
-}
+  oktLayer = 0,
+  oktMaterial = 1,
+  oktGroup = 2,
+  oktCount = 3
+};
 
-RH_C_FUNCTION void ONX_Model_SetStartSectionComments(ONX_Model* pModel, const RHMONO_STRING* comments)
+/*
+Description:
+  Inverted index from a layer, material or group index to the sorted list
+  of indices of the objects that use it. Objects appended at the end of the
+  table keep every list sorted, and a removal patches the lists instead of
+  starting over. Anything else (table renumbering, attributes edited in
+  place) invalidates the index and the next query rebuilds it in one pass.
+*/
+class CRhCmnObjectKeyIndex
 {
-  if( pModel )
+public:
+  CRhCmnObjectKeyIndex() : m_bValid(false), m_object_count(0), m_key_count(0) {}
+
+  void Invalidate() { m_bValid = false; }
+  bool IsValid(int object_count) const { return m_bValid && m_object_count == object_count; }
+
+  void Build(const ONX_Model& model, int key_type)
   {
-    INPUTSTRINGCOERCE(_comments, comments);
-    ON_String ssc(_comments);
-    pModel->m_sStartSectionComments = ssc;
+    switch( key_type )
+    {
+    case oktLayer: m_key_count = model.m_layer_table.Count(); break;
+    case oktMaterial: m_key_count = model.m_material_table.Count(); break;
+    case oktGroup: m_key_count = model.m_group_table.Count(); break;
+    default: m_key_count = 0; break;
+    }
+    m_lists.Empty();
+    m_lists.Reserve(m_key_count);
+    for( int i = 0; i < m_key_count; i++ )
+      m_lists.AppendNew();
+    // Keys past the end of the table (dangling references) are ignored like
+    // negative keys, so they can not leave a freshly built index invalid.
+    m_object_count = model.m_object_table.Count();
+    m_bValid = true;
+    for( int i = 0; i < m_object_count; i++ )
+      AddKeys(model.m_object_table[i].m_attributes, key_type, i, false);
   }
-}
 
-RH_C_FUNCTION void ONX_Model_GetNotes(const ONX_Model* pConstModel, CRhCmnStringHolder* pString, bool* visible, bool* html, int* left, int* top, int* right, int* bottom)
-{
-  if( pConstModel && visible && html && left && top && right && bottom )
+  void Appended(const ON_3dmObjectAttributes& attributes, int key_type, int object_index)
   {
-    const ON_3dmNotes& notes = pConstModel->m_properties.m_Notes;
-    if( pString )
-      pString->Set(notes.m_notes);
-    *visible = notes.m_bVisible?true:false;
-    *html = notes.m_bHTML?true:false;
-    *left = notes.m_window_left;
-    *top = notes.m_window_top;
-    *right = notes.m_window_right;
-    *bottom = notes.m_window_bottom;
+    if( !m_bValid || object_index != m_object_count )
+    {
+      m_bValid = false;
+      return;
+    }
+    m_object_count++;
+    // A key past the end here refers to a table entry added since the build
+    if( !AddKeys(attributes, key_type, object_index, true) )
+      m_bValid = false;
   }
-}
 
-RH_C_FUNCTION void ONX_Model_SetNotesString(ONX_Model* pModel, const RHMONO_STRING* notes)
-{
-  if( pModel )
+  void Removed(int object_index)
   {
-    INPUTSTRINGCOERCE(_notes, notes);
-    pModel->m_properties.m_Notes.m_notes = _notes;
+    if( !m_bValid || object_index < 0 || object_index >= m_object_count )
+    {
+      m_bValid = false;
+      return;
+    }
+    for( int k = 0; k < m_lists.Count(); k++ )
+    {
+      ON_SimpleArray<int>& list = m_lists[k];
+      int j = 0;
+      for( int i = 0; i < list.Count(); i++ )
+      {
+        const int index = list[i];
+        if( index != object_index )
+          list[j++] = index > object_index ? index - 1 : index;
+      }
+      list.SetCount(j);
+    }
+    m_object_count--;
   }
-}
 
-RH_C_FUNCTION void ONX_Model_SetNotes(ONX_Model* pModel, bool visible, bool html, int left, int top, int right, int bottom)
-{
-  if( pModel )
+  const ON_SimpleArray<int>* Objects(int key) const
   {
-    pModel->m_properties.m_Notes.m_bHTML = html?1:0;
-    pModel->m_properties.m_Notes.m_bVisible = visible?1:0;
-    pModel->m_properties.m_Notes.m_window_left = left;
-    pModel->m_properties.m_Notes.m_window_top = top;
-    pModel->m_properties.m_Notes.m_window_right = right;
-    pModel->m_properties.m_Notes.m_window_bottom = bottom;
+    if( key < 0 || key >= m_lists.Count() )
+      return NULL;
+    return &m_lists[key];
   }
-}
-
-enum ONXModelTable : int
-{
-  onxDumpAll = 0,
-  onxDumpSummary = 1,
-  onxBitmapTable = 2,
-  onxTextureMappingTable = 3,
-  onxMaterialTable = 4,
-  onxLinetypeTable = 5,
-  onxLayerTable = 6,
-  onxLightTable = 7,
-  onxGroupTable = 8,
-  onxFontTable = 9,
-  onxDimStyleTable = 10,
-  onxHatchPatternTable = 11,
-  onxIDefTable = 12,
-  onxObjectTable = 13,
-  onxHistoryRecordTable = 14,
-  onxUserDataTable = 15,
-  onxViewTable = 16,
-  onxNamedViewTable = 17,
-};
 
-RH_C_FUNCTION int ONX_Model_TableCount(const ONX_Model* pConstModel, enum ONXModelTable which)
-{
+  int KeyCount() const { return m_lists.Count(); }
 
-  int rc = 0;
-  if( pConstModel )
+private:
+  // Returns false when bStrict is set and a key is past the end of the table
+  bool AddKeys(const ON_3dmObjectAttributes& attributes, int key_type, int object_index, bool bStrict)
   {
-    switch(which)
+    bool rc = true;
+    switch( key_type )
     {
-    case onxBitmapTable:
-      rc = pConstModel->m_bitmap_table.Count();
-      break;
-    case onxTextureMappingTable:
-      rc = pConstModel->m_mapping_table.Count();
-      break;
-    case onxMaterialTable:
-      rc = pConstModel->m_material_table.Count();
-      break;
-    case onxLinetypeTable:
-      rc = pConstModel->m_linetype_table.Count();
-      break;
-    case onxLayerTable:
-      rc = pConstModel->m_layer_table.Count();
-      break;
-    case onxLightTable:
-      rc = pConstModel->m_light_table.Count();
+    case oktLayer:
+      rc = Add(attributes.m_layer_index, object_index, bStrict);
       break;
-    case onxGroupTable:
-      rc = pConstModel->m_group_table.Count();
-      break;
-    case onxFontTable:
-      rc = pConstModel->m_font_table.Count();
-      break;
-    case onxDimStyleTable:
-      rc = pConstModel->m_dimstyle_table.Count();
-      break;
-    case onxHatchPatternTable:
-      rc = pConstModel->m_hatch_pattern_table.Count();
-      break;
-    case onxIDefTable:
-      rc = pConstModel->m_idef_table.Count();
-      break;
-    case onxObjectTable:
-      rc = pConstModel->m_object_table.Count();
-      break;
-    case onxHistoryRecordTable:
-      rc = pConstModel->m_history_record_table.Count();
-      break;
-    case onxUserDataTable:
-      rc = pConstModel->m_userdata_table.Count();
-      break;
-    case onxViewTable:
-      rc = pConstModel->m_settings.m_views.Count();
-      break;
-    case onxNamedViewTable:
-      rc = pConstModel->m_settings.m_named_views.Count();
+    case oktMaterial:
+      rc = Add(attributes.m_material_index, object_index, bStrict);
       break;
-    default:
+    case oktGroup:
+      {
+        const int* groups = attributes.GroupList();
+        for( int i = 0; rc && groups && i < attributes.GroupCount(); i++ )
+          rc = Add(groups[i], object_index, bStrict);
+      }
       break;
     }
+    return rc;
   }
-  return rc;
-}
 
-RH_C_FUNCTION void ONX_Model_Dump(const ONX_Model* pConstModel, enum ONXModelTable which, CRhCmnStringHolder* pStringHolder)
+  bool Add(int key, int object_index, bool bStrict)
+  {
+    if( key < 0 )
+      return true;
+    if( key >= m_key_count )
+      return !bStrict;
+    ON_SimpleArray<int>& list = m_lists[key];
+    if( list.Count() < 1 || *list.Last() != object_index )
+      list.Append(object_index);
+    return true;
+  }
+
+  bool m_bValid;
+  int m_object_count;
+  int m_key_count;
+  ON_ClassArray< ON_SimpleArray<int> > m_lists;
+};
+
+/*
+Description:
+  Bounding boxes of the objects in the object table. Entries exist for the
+  first m_boxes.Count() objects; objects appended since are measured on the
+  next query. Deleting an object drops its entry, anything else resets the
+  cache.
+*/
+class CRhCmnObjectBoxCache
 {
-  if( pConstModel && pStringHolder )
+public:
+  CRhCmnObjectBoxCache() : m_bUnionValid(false) {}
+
+  void Invalidate()
   {
-    ON_wString s;
-    ON_TextLog log(s);
-    switch(which)
+    m_boxes.SetCount(0);
+    m_bUnionValid = false;
+  }
+
+  void Removed(int object_index)
+  {
+    if( object_index >= 0 && object_index < m_boxes.Count() )
     {
-    case onxDumpAll:
-      pConstModel->Dump(log);
-      break;
-    case onxDumpSummary:
-      pConstModel->DumpSummary(log);
-      break;
-    case onxBitmapTable:
-      pConstModel->DumpBitmapTable(log);
-      break;
-    case onxTextureMappingTable:
-      pConstModel->DumpTextureMappingTable(log);
-      break;
-    case onxMaterialTable:
-      pConstModel->DumpMaterialTable(log);
-      break;
-    case onxLinetypeTable:
-      pConstModel->DumpLinetypeTable(log);
-      break;
-    case onxLayerTable:
-      pConstModel->DumpLayerTable(log);
-      break;
-    case onxLightTable:
-      pConstModel->DumpLightTable(log);
-      break;
-    case onxGroupTable:
-      pConstModel->DumpGroupTable(log);
-      break;
-    case onxFontTable:
-      pConstModel->DumpFontTable(log);
-      break;
-    case onxDimStyleTable:
-      pConstModel->DumpDimStyleTable(log);
-      break;
-    case onxHatchPatternTable:
-      pConstModel->DumpHatchPatternTable(log);
-      break;
-    case onxIDefTable:
-      pConstModel->DumpIDefTable(log);
-      break;
-    case onxObjectTable:
-      pConstModel->DumpObjectTable(log);
-      break;
-    case onxHistoryRecordTable:
-      pConstModel->DumpHistoryRecordTable(log);
-      break;
-    case onxUserDataTable:
-      pConstModel->DumpUserDataTable(log);
-      break;
-    default:
-      break;
+      m_boxes.Remove(object_index);
+      m_bUnionValid = false;
     }
-    pStringHolder->Set(s);
   }
-}
 
-RH_C_FUNCTION void ONX_Model_Dump2(const ONX_Model* pConstModel, ON_TextLog* pTextLog)
+  ON_SimpleArray<ON_BoundingBox> m_boxes; // unset for objects that are not geometry
+  ON_BoundingBox m_union;                 // union of m_boxes when m_bUnionValid
+  bool m_bUnionValid;
+};
+
+// Bookkeeping the C API keeps for an ONX_Model between calls. ONX_Model has
+// no room for it, so states live in a registry keyed by model pointer and
+// are dropped by ONX_Model_Delete. Every ONX_Model the C API hands out must
+// be freed through ONX_Model_Delete; a model freed any other way leaves its
+// state behind for the next model allocated at the same address. The
+// registry is locked. The lookup indices have their own lock because
+// queries on a const model may come from several threads; everything else
+// is only touched by calls that modify the model, which are not thread safe
+// anyway.
+class CRhCmnModelState
 {
-  if( pConstModel && pTextLog )
-    pConstModel->Dump(*pTextLog);
-}
+public:
+  CRhCmnModelState() : m_bJournal(false), m_dirty_tables(0) {}
+
+  // incremental save journal (see ONX_Model_Journal_Save)
+  bool m_bJournal;
+  ON_SimpleArray<ON_UUID> m_dirty_objects;   // added or marked dirty since the last journal save
+  ON_SimpleArray<ON_UUID> m_deleted_objects; // deleted since the last journal save
+  unsigned int m_dirty_tables;               // ReadFileTableTypeFilter bits
+
+  // built on first lookup (see ModelIdTableIndex and ModelObjectKeyIndex)
+  CRhCmnCriticalSection m_index_lock;
+  CRhCmnUuidIndexMap m_id_maps[mitTableCount];
+  CRhCmnObjectKeyIndex m_key_indices[oktCount];
+  CRhCmnObjectBoxCache m_boxes;
+};
 
-RH_C_FUNCTION const ON_Geometry* ONX_Model_ModelObjectGeometry(const ONX_Model* pConstModel, int index)
+// Model states hashed by model pointer. Buckets are chained so entries can
+// be removed; the bucket count doubles when there are twice as many states.
+class CRhCmnModelStateRegistry
 {
-  const ON_Geometry* rc = NULL;
-  if( pConstModel && index>=0 && index<pConstModel->m_object_table.Count() )
+public:
+  CRhCmnModelStateRegistry() : m_count(0) {}
+
+  CRhCmnModelState* Find(const ONX_Model* model) const
   {
-    rc = ON_Geometry::Cast(pConstModel->m_object_table[index].m_object);
+    if( m_buckets.Count() < 1 )
+      return NULL;
+    const ON_SimpleArray<Entry>& bucket = m_buckets[Bucket(model, m_buckets.Count())];
+    for( int i = 0; i < bucket.Count(); i++ )
+    {
+      if( bucket[i].m_model == model )
+        return bucket[i].m_state;
+    }
+    return NULL;
   }
-  return rc;
-}
 
-RH_C_FUNCTION const ON_3dmObjectAttributes* ONX_Model_ModelObjectAttributes(const ONX_Model* pConstModel, int index)
-{
-  const ON_3dmObjectAttributes* rc = NULL;
-  if( pConstModel && index>=0 && index<pConstModel->m_object_table.Count() )
+  void Add(const ONX_Model* model, CRhCmnModelState* state)
   {
-    rc = &(pConstModel->m_object_table[index].m_attributes);
+    if( 2*m_buckets.Count() <= m_count )
+      Rehash(m_buckets.Count() < 16 ? 16 : 2*m_buckets.Count());
+    Entry e;
+    e.m_model = model;
+    e.m_state = state;
+    m_buckets[Bucket(model, m_buckets.Count())].Append(e);
+    m_count++;
   }
-  return rc;
-}
 
-RH_C_FUNCTION bool ONX_Model_ObjectTable_LayerIndexTest(const ONX_Model* pConstModel, int objectIndex, int layerIndex)
-{
-  bool rc = false;
-  if( pConstModel && objectIndex>=0 && objectIndex<pConstModel->m_object_table.Count() )
+  // Returns the removed state, which the caller deletes
+  CRhCmnModelState* Remove(const ONX_Model* model)
   {
-    const ONX_Model_Object& obj = pConstModel->m_object_table[objectIndex];
-    rc = obj.m_attributes.m_layer_index == layerIndex;
+    if( m_buckets.Count() < 1 )
+      return NULL;
+    ON_SimpleArray<Entry>& bucket = m_buckets[Bucket(model, m_buckets.Count())];
+    for( int i = 0; i < bucket.Count(); i++ )
+    {
+      if( bucket[i].m_model == model )
+      {
+        CRhCmnModelState* state = bucket[i].m_state;
+        bucket.Remove(i);
+        m_count--;
+        return state;
+      }
+    }
+    return NULL;
   }
-  return rc;
-}
 
-RH_C_FUNCTION ON_UUID ONX_Model_ObjectTable_AddPoint(ONX_Model* pModel, ON_3DPOINT_STRUCT point, const ON_3dmObjectAttributes* pConstAttributes)
-{
-  if( pModel )
+private:
+  struct Entry
   {
-    ONX_Model_Object mo;
-    if( pConstAttributes )
-      mo.m_attributes = *pConstAttributes;
-    mo.m_object = new ON_Point(point.val[0], point.val[1], point.val[2]);
-    ::ON_CreateUuid(mo.m_attributes.m_uuid);
-    pModel->m_object_table.Append(mo);
-    return mo.m_attributes.m_uuid;
+    const ONX_Model* m_model;
+    CRhCmnModelState* m_state;
+  };
+
+  // bucket_count is a power of two
+  static int Bucket(const ONX_Model* model, int bucket_count)
+  {
+    ON__UINT64 x = (ON__UINT64)(size_t)model;
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    return (int)(x & (ON__UINT64)(bucket_count - 1));
   }
-  return ::ON_nil_uuid;
-}
 
-RH_C_FUNCTION ON_UUID ONX_Model_ObjectTable_AddPointCloud(ONX_Model* pModel, int count, /*ARRAY*/const ON_3dPoint* points, const ON_3dmObjectAttributes* pConstAttributes)
+  void Rehash(int bucket_count)
+  {
+    ON_ClassArray< ON_SimpleArray<Entry> > buckets(bucket_count);
+    buckets.SetCount(bucket_count);
+    for( int i = 0; i < m_buckets.Count(); i++ )
+    {
+      for( int j = 0; j < m_buckets[i].Count(); j++ )
+        buckets[Bucket(m_buckets[i][j].m_model, bucket_count)].Append(m_buckets[i][j]);
+    }
+    m_buckets = buckets;
+  }
+
+  ON_ClassArray< ON_SimpleArray<Entry> > m_buckets;
+  int m_count;
+};
+
+static CRhCmnCriticalSection g_model_state_lock;
+static CRhCmnModelStateRegistry g_model_states;
+
+static CRhCmnModelState* GetModelState(const ONX_Model* pConstModel, bool bCreate)
 {
-  if( pModel && count>0 && points )
+  if( NULL == pConstModel )
+    return NULL;
+  g_model_state_lock.Enter();
+  CRhCmnModelState* rc = g_model_states.Find(pConstModel);
+  if( NULL == rc && bCreate )
   {
-    ONX_Model_Object mo;
-    if( pConstAttributes )
-      mo.m_attributes = *pConstAttributes;
-    ON_PointCloud* pCloud = new ON_PointCloud();
-    pCloud->m_P.Append(count, points);
-    mo.m_object = pCloud;
-    ::ON_CreateUuid(mo.m_attributes.m_uuid);
-    pModel->m_object_table.Append(mo);
-    return mo.m_attributes.m_uuid;
+    rc = new CRhCmnModelState();
+    g_model_states.Add(pConstModel, rc);
   }
-  return ::ON_nil_uuid;
+  g_model_state_lock.Leave();
+  return rc;
 }
 
-RH_C_FUNCTION ON_UUID ONX_Model_ObjectTable_AddPointCloud2(ONX_Model* pModel, const ON_PointCloud* pConstPointCloud, const ON_3dmObjectAttributes* pConstAttributes)
+static void DeleteModelState(const ONX_Model* pConstModel)
 {
-  if( pModel && pConstPointCloud )
+  g_model_state_lock.Enter();
+  CRhCmnModelState* state = g_model_states.Remove(pConstModel);
+  g_model_state_lock.Leave();
+  if( state )
+    delete state;
+}
+
+static void InvalidateModelIndices(CRhCmnModelState* state, unsigned int tables)
+{
+  state->m_index_lock.Enter();
+  for( int i = 0; i < mitTableCount; i++ )
   {
-    ONX_Model_Object mo;
-    if( pConstAttributes )
-      mo.m_attributes = *pConstAttributes;
-    mo.m_object = new ON_PointCloud(*pConstPointCloud);
-    ::ON_CreateUuid(mo.m_attributes.m_uuid);
-    pModel->m_object_table.Append(mo);
-    return mo.m_attributes.m_uuid;
+    if( tables & ModelIdTableFilter[i] )
+      state->m_id_maps[i].Invalidate();
   }
-  return ::ON_nil_uuid;
+  // layer, material and group numbers are baked into the key indices
+  if( tables & (ttfObjectTable|ttfLayerTable) )
+    state->m_key_indices[oktLayer].Invalidate();
+  if( tables & (ttfObjectTable|ttfMaterialTable) )
+    state->m_key_indices[oktMaterial].Invalidate();
+  if( tables & (ttfObjectTable|ttfGroupTable) )
+    state->m_key_indices[oktGroup].Invalidate();
+  if( tables & ttfObjectTable )
+    state->m_boxes.Invalidate();
+  state->m_index_lock.Leave();
 }
 
-RH_C_FUNCTION ON_UUID ONX_Model_ObjectTable_AddClippingPlane(ONX_Model* pModel, const ON_PLANE_STRUCT* plane, double du, double dv, int count, /*ARRAY*/const ON_UUID* clippedViewportIds, const ON_3dmObjectAttributes* pConstAttributes)
+static bool SortedUuidsContain( const ON_SimpleArray<ON_UUID>& sorted, const ON_UUID& id )
 {
-  if( pModel && plane && du>0.0 && dv>0.0 && count>0 && clippedViewportIds )
+  int i0 = 0;
+  int i1 = sorted.Count();
+  while( i0 < i1 )
   {
-    ON_Plane temp = FromPlaneStruct(*plane);
-    if( temp.IsValid() )
+    const int i = (i0 + i1) / 2;
+    const int c = ON_UuidCompare(&sorted[i], &id);
+    if( 0 == c )
+      return true;
+    if( c < 0 )
+      i0 = i + 1;
+    else
+      i1 = i;
+  }
+  return false;
+}
+
+static void RebuildModelIdMap(CRhCmnUuidIndexMap& map, const ONX_Model& model, int table, int count)
+{
+  map.Reset(count);
+  for( int i = 0; i < count; i++ )
+    map.Append(ModelIdTableId(model, table, i), i);
+}
+
+/*
+Description:
+  Looks up id_count ids in one of the model's tables. indices receives the
+  index of each id or -1. Returns the number found. The map is validated
+  against the table count and every hit is checked against the table. Ids
+  can also change in place (ON_Layer_SetGuid on a layer owned by the model)
+  without changing the count. A hit that no longer matches rebuilds the map
+  right away. Misses cost one pass over the table that compares ids and
+  allocates nothing; only if it finds a missed id is the map rebuilt. Ids
+  that are not in the table never cause a rebuild.
+*/
+static int ModelIdTableIndices(const ONX_Model* pConstModel, int table, int id_count, const ON_UUID* ids, int* indices)
+{
+  for( int i = 0; i < id_count; i++ )
+    indices[i] = -1;
+  CRhCmnModelState* state = GetModelState(pConstModel, true);
+  if( NULL == state || table < 0 || table >= mitTableCount )
+    return 0;
+  CRhCmnUuidIndexMap& map = state->m_id_maps[table];
+  state->m_index_lock.Enter();
+  const int count = ModelIdTableCount(*pConstModel, table);
+  if( !map.IsValid(count) )
+    RebuildModelIdMap(map, *pConstModel, table, count);
+
+  int rc = 0;
+  bool bStale = false;
+  ON_SimpleArray<int> misses;
+  for( int i = 0; i < id_count; i++ )
+  {
+    const int index = map.Find(ids[i]);
+    if( index >= 0 && index < count && ModelIdTableId(*pConstModel, table, index) == ids[i] )
     {
-      ON_Interval domain0( 0.0, du );
-      ON_Interval domain1( 0.0, dv );
+      indices[i] = index;
+      rc++;
+    }
+    else
+    {
+      if( index >= 0 )
+        bStale = true;
+      misses.Append(i);
+    }
+  }
 
-      ON_PlaneSurface srf( temp );
-      srf.SetExtents( 0, domain0, true );
-      srf.SetExtents( 1, domain1, true );
-      srf.SetDomain( 0, domain0.Min(), domain0.Max() );
-      srf.SetDomain( 1, domain1.Min(), domain1.Max() );
-      if( srf.IsValid() )
-      {
-        ON_ClippingPlaneSurface* cps = new ON_ClippingPlaneSurface(srf);
-        for( int i=0; i<count; i++ )
-          cps->m_clipping_plane.m_viewport_ids.AddUuid(clippedViewportIds[i]);
+  if( !bStale && misses.Count() > 0 )
+  {
+    ON_SimpleArray<ON_UUID> missed_ids(misses.Count());
+    for( int i = 0; i < misses.Count(); i++ )
+      missed_ids.Append(ids[misses[i]]);
+    missed_ids.QuickSort(ON_UuidCompare);
+    for( int i = 0; i < count && !bStale; i++ )
+      bStale = SortedUuidsContain(missed_ids, ModelIdTableId(*pConstModel, table, i));
+  }
 
-        ONX_Model_Object mo;
-        if( pConstAttributes )
-          mo.m_attributes = *pConstAttributes;
-        mo.m_object = cps;
-        ::ON_CreateUuid(mo.m_attributes.m_uuid);
-        pModel->m_object_table.Append(mo);
-        return mo.m_attributes.m_uuid;
+  if( bStale )
+  {
+    RebuildModelIdMap(map, *pConstModel, table, count);
+    for( int i = 0; i < misses.Count(); i++ )
+    {
+      const int j = misses[i];
+      const int index = map.Find(ids[j]);
+      if( index >= 0 && index < count && ModelIdTableId(*pConstModel, table, index) == ids[j] )
+      {
+        indices[j] = index;
+        rc++;
       }
     }
   }
-  return ::ON_nil_uuid;
+  state->m_index_lock.Leave();
+  return rc;
 }
 
-RH_C_FUNCTION ON_UUID ONX_Model_ObjectTable_AddLinearDimension( ONX_Model* pModel, const ON_LinearDimension2* pConstDimension, const ON_3dmObjectAttributes* pConstAttributes )
+// Index of the element with the given id in one of the model's tables, or -1
+static int ModelIdTableIndex(const ONX_Model* pConstModel, int table, const ON_UUID& id)
 {
-  if( pModel && pConstDimension )
-  {
-    ONX_Model_Object mo;
-    if( pConstAttributes )
-      mo.m_attributes = *pConstAttributes;
-    mo.m_object = new ON_LinearDimension2(*pConstDimension);
-    ::ON_CreateUuid(mo.m_attributes.m_uuid);
-    pModel->m_object_table.Append(mo);
-    return mo.m_attributes.m_uuid;
-  }
-  return ::ON_nil_uuid;
+  int index = -1;
+  ModelIdTableIndices(pConstModel, table, 1, &id, &index);
+  return index;
 }
 
-RH_C_FUNCTION ON_UUID ONX_Model_ObjectTable_AddLine( ONX_Model* pModel, ON_3DPOINT_STRUCT pt0, ON_3DPOINT_STRUCT pt1, const ON_3dmObjectAttributes* pConstAttributes )
+/*
+Description:
+  Copies the sorted indices of the objects on a layer, material or group
+  into objects (when not NULL) and returns how many there are. Builds the
+  inverted index on first use.
+*/
+static int ModelObjectKeyIndex(const ONX_Model* pConstModel, int key_type, int key, ON_SimpleArray<int>* objects)
 {
-  if( pModel )
+  CRhCmnModelState* state = GetModelState(pConstModel, true);
+  if( NULL == state || key_type < 0 || key_type >= oktCount )
+    return 0;
+  CRhCmnObjectKeyIndex& index = state->m_key_indices[key_type];
+  state->m_index_lock.Enter();
+  if( !index.IsValid(pConstModel->m_object_table.Count()) )
+    index.Build(*pConstModel, key_type);
+  const ON_SimpleArray<int>* list = index.Objects(key);
+  const int rc = list ? list->Count() : 0;
+  if( objects )
   {
-    ONX_Model_Object mo;
-    if( pConstAttributes )
-      mo.m_attributes = *pConstAttributes;
-    ON_3dPoint _pt0(pt0.val);
-    ON_3dPoint _pt1(pt1.val);
-    mo.m_object = new ON_LineCurve(_pt0, _pt1);
-    ::ON_CreateUuid(mo.m_attributes.m_uuid);
-    pModel->m_object_table.Append(mo);
-    return mo.m_attributes.m_uuid;
+    if( list )
+      *objects = *list;
+    else
+      objects->SetCount(0);
   }
-  return ::ON_nil_uuid;
+  state->m_index_lock.Leave();
+  return rc;
 }
 
-RH_C_FUNCTION ON_UUID ONX_Model_ObjectTable_AddPolyline( ONX_Model* pModel, int count, /*ARRAY*/const ON_3dPoint* points, const ON_3dmObjectAttributes* pConstAttributes )
+struct ObjectBoxesContext
 {
-  if( pModel && count>0 && points )
+  const ONX_Model* m_model;
+  ON_BoundingBox* m_boxes;
+  int m_first;
+  int m_count;
+  int m_block_size;
+  ON_BoundingBox* m_partials; // one union per block
+};
+
+static void MeasureObjectBlockAt(int block, void* context)
+{
+  ObjectBoxesContext* ctx = (ObjectBoxesContext*)context;
+  const int i0 = ctx->m_first + block*ctx->m_block_size;
+  int i1 = i0 + ctx->m_block_size;
+  if( i1 > ctx->m_count )
+    i1 = ctx->m_count;
+  ON_BoundingBox partial;
+  for( int i = i0; i < i1; i++ )
+  {
+    ON_BoundingBox bbox;
+    const ON_Geometry* pGeometry = ON_Geometry::Cast(ctx->m_model->m_object_table[i].m_object);
+    if( pGeometry )
+      bbox = pGeometry->BoundingBox();
+    ctx->m_boxes[i] = bbox;
+    partial.Union(bbox);
+  }
+  ctx->m_partials[block] = partial;
+}
+
+/*
+Description:
+  Brings the bounding box cache up to date and returns the state holding
+  it, with m_index_lock entered. The caller must Leave. Objects not yet in
+  the cache are measured in blocks on worker threads; each block also
+  returns the union of its boxes so the model box is a reduction over
+  blocks rather than objects.
+*/
+static CRhCmnModelState* LockObjectBoxCache(const ONX_Model* pConstModel, int maxThreads)
+{
+  CRhCmnModelState* state = GetModelState(pConstModel, true);
+  if( NULL == state )
+    return NULL;
+  state->m_index_lock.Enter();
+  CRhCmnObjectBoxCache& cache = state->m_boxes;
+  const int count = pConstModel->m_object_table.Count();
+  if( cache.m_boxes.Count() > count )
+    cache.Invalidate();
+  const int first = cache.m_boxes.Count();
+  if( first < count )
+  {
+    cache.m_boxes.SetCapacity(count);
+    cache.m_boxes.SetCount(count);
+    const int block_size = 1024;
+    const int block_count = (count - first + block_size - 1) / block_size;
+    ON_SimpleArray<ON_BoundingBox> partials(block_count);
+    partials.SetCount(block_count);
+    ObjectBoxesContext ctx;
+    ctx.m_model = pConstModel;
+    ctx.m_boxes = cache.m_boxes.Array();
+    ctx.m_first = first;
+    ctx.m_count = count;
+    ctx.m_block_size = block_size;
+    ctx.m_partials = partials.Array();
+    RhCmnParallelFor(block_count, MeasureObjectBlockAt, &ctx, maxThreads);
+
+    if( !cache.m_bUnionValid )
+    {
+      cache.m_union = ON_BoundingBox();
+      for( int i = 0; i < first; i++ )
+        cache.m_union.Union(cache.m_boxes[i]);
+    }
+    for( int i = 0; i < block_count; i++ )
+      cache.m_union.Union(partials[i]);
+    cache.m_bUnionValid = true;
+  }
+  else if( !cache.m_bUnionValid )
   {
-    ONX_Model_Object mo;
-    if( pConstAttributes )
-      mo.m_attributes = *pConstAttributes;
-    ON_PolylineCurve* pC = new ON_PolylineCurve();
-    pC->m_pline.Append(count, points);
-    mo.m_object = pC;
-    ::ON_CreateUuid(mo.m_attributes.m_uuid);
-    pModel->m_object_table.Append(mo);
-    return mo.m_attributes.m_uuid;
+    cache.m_union = ON_BoundingBox();
+    for( int i = 0; i < count; i++ )
+      cache.m_union.Union(cache.m_boxes[i]);
+    cache.m_bUnionValid = true;
   }
-  return ::ON_nil_uuid;
+  return state;
 }
 
-RH_C_FUNCTION ON_UUID ONX_Model_ObjectTable_AddArc(ONX_Model* pModel, ON_Arc* pArc, const ON_3dmObjectAttributes* pConstAttributes )
+static void ModelObjectAdded(const ONX_Model* pConstModel, const ON_UUID& id)
 {
-  if( pModel && pArc )
+  CRhCmnModelState* state = GetModelState(pConstModel, false);
+  if( state && state->m_bJournal )
+    state->m_dirty_objects.Append(id);
+}
+
+// Call after m_object_table.Remove(index)
+static void ModelObjectDeleted(const ONX_Model* pConstModel, const ON_UUID& id, int index)
+{
+  CRhCmnModelState* state = GetModelState(pConstModel, false);
+  if( state )
   {
-    pArc->plane.UpdateEquation();
-    ONX_Model_Object mo;
-    if( pConstAttributes )
-      mo.m_attributes = *pConstAttributes;
-    ON_ArcCurve* pC = new ON_ArcCurve(*pArc);
-    mo.m_object = pC;
-    ::ON_CreateUuid(mo.m_attributes.m_uuid);
-    pModel->m_object_table.Append(mo);
-    return mo.m_attributes.m_uuid;
+    if( state->m_bJournal )
+      state->m_deleted_objects.Append(id);
+    state->m_index_lock.Enter();
+    state->m_id_maps[mitObjectTable].Invalidate();
+    for( int i = 0; i < oktCount; i++ )
+      state->m_key_indices[i].Removed(index);
+    state->m_boxes.Removed(index);
+    state->m_index_lock.Leave();
   }
-  return ::ON_nil_uuid;
 }
 
-RH_C_FUNCTION ON_UUID ONX_Model_ObjectTable_AddCircle(ONX_Model* pModel, const ON_CIRCLE_STRUCT* pCircle, const ON_3dmObjectAttributes* pConstAttributes )
+static void ModelTableChanged(const ONX_Model* pConstModel, unsigned int table)
 {
-  if( pModel && pCircle )
+  CRhCmnModelState* state = GetModelState(pConstModel, false);
+  if( state )
   {
-    ON_Circle circle = FromCircleStruct(*pCircle);
-    ONX_Model_Object mo;
-    if( pConstAttributes )
-      mo.m_attributes = *pConstAttributes;
-    ON_ArcCurve* pC = new ON_ArcCurve(circle);
-    mo.m_object = pC;
-    ::ON_CreateUuid(mo.m_attributes.m_uuid);
-    pModel->m_object_table.Append(mo);
-    return mo.m_attributes.m_uuid;
+    if( state->m_bJournal )
+      state->m_dirty_tables |= table;
+    InvalidateModelIndices(state, table);
   }
-  return ::ON_nil_uuid;
 }
 
-RH_C_FUNCTION ON_UUID ONX_Model_ObjectTable_AddEllipse(ONX_Model* pModel, ON_Ellipse* pEllipse, const ON_3dmObjectAttributes* pConstAttributes)
+static void ModelObjectTableCleared(const ONX_Model* pConstModel)
 {
-  if( pModel && pEllipse )
+  CRhCmnModelState* state = GetModelState(pConstModel, false);
+  if( state )
   {
-    pEllipse->plane.UpdateEquation();
-    ON_NurbsCurve* nc = new ON_NurbsCurve();
-    if(2 == pEllipse->GetNurbForm(*nc) )
+    if( state->m_bJournal )
     {
-      ONX_Model_Object mo;
-      if( pConstAttributes )
-        mo.m_attributes = *pConstAttributes;
-      mo.m_object = nc;
-      ::ON_CreateUuid(mo.m_attributes.m_uuid);
-      pModel->m_object_table.Append(mo);
-      return mo.m_attributes.m_uuid;
+      for( int i=0; i<pConstModel->m_object_table.Count(); i++ )
+        state->m_deleted_objects.Append(pConstModel->m_object_table[i].m_attributes.m_uuid);
     }
-    // didn't work. delete the NurbsCurve
-    delete nc;
+    InvalidateModelIndices(state, ttfObjectTable);
   }
-  return ::ON_nil_uuid;
 }
 
-RH_C_FUNCTION ON_UUID ONX_Model_ObjectTable_AddSphere(ONX_Model* pModel, ON_Sphere* sphere, const ON_3dmObjectAttributes* pConstAttributes)
+// Call after appending to m_object_table. state may be NULL.
+static void ModelObjectAppended(CRhCmnModelState* state, const ONX_Model* pConstModel)
 {
-  if( pModel && sphere )
+  if( state )
   {
-    // make sure the plane equation is in-sync for this sphere
-    sphere->plane.UpdateEquation();
-    ON_RevSurface* pRevSurface = sphere->RevSurfaceForm(false);
-    if( pRevSurface )
-    {
-      ONX_Model_Object mo;
-      if( pConstAttributes )
-        mo.m_attributes = *pConstAttributes;
-      mo.m_object = pRevSurface;
-      ::ON_CreateUuid(mo.m_attributes.m_uuid);
-      pModel->m_object_table.Append(mo);
-      return mo.m_attributes.m_uuid;
-    }
+    const int index = pConstModel->m_object_table.Count()-1;
+    const ONX_Model_Object& mo = pConstModel->m_object_table[index];
+    if( state->m_bJournal )
+      state->m_dirty_objects.Append(mo.m_attributes.m_uuid);
+    state->m_index_lock.Enter();
+    state->m_id_maps[mitObjectTable].Append(mo.m_attributes.m_uuid, index);
+    for( int i = 0; i < oktCount; i++ )
+      state->m_key_indices[i].Appended(mo.m_attributes, i, index);
+    state->m_index_lock.Leave();
   }
-  return ::ON_nil_uuid;
 }
 
-RH_C_FUNCTION ON_UUID ONX_Model_ObjectTable_AddCurve(ONX_Model* pModel, const ON_Curve* pConstCurve, const ON_3dmObjectAttributes* pConstAttributes)
+static void AppendModelObject(ONX_Model* pModel, const ONX_Model_Object& mo)
 {
-  if( pModel && pConstCurve )
+  pModel->m_object_table.Append(mo);
+  ModelObjectAppended(GetModelState(pModel, false), pModel);
+}
+
+// Table entries of model that can carry user data
+static void GetModelUserDataOwners(const ONX_Model& model, ON_SimpleArray<const ON_Object*>& owners)
+{
+  int i;
+  for( i=0; i<model.m_mapping_table.Count(); i++ )
+    owners.Append(&model.m_mapping_table[i]);
+  for( i=0; i<model.m_material_table.Count(); i++ )
+    owners.Append(&model.m_material_table[i]);
+  for( i=0; i<model.m_linetype_table.Count(); i++ )
+    owners.Append(&model.m_linetype_table[i]);
+  for( i=0; i<model.m_layer_table.Count(); i++ )
+    owners.Append(&model.m_layer_table[i]);
+  for( i=0; i<model.m_group_table.Count(); i++ )
+    owners.Append(&model.m_group_table[i]);
+  for( i=0; i<model.m_font_table.Count(); i++ )
+    owners.Append(&model.m_font_table[i]);
+  for( i=0; i<model.m_dimstyle_table.Count(); i++ )
+    owners.Append(&model.m_dimstyle_table[i]);
+  for( i=0; i<model.m_light_table.Count(); i++ )
   {
-    ON_Curve* pCurve = pConstCurve->DuplicateCurve();
-    if( pCurve )
-    {
-      ONX_Model_Object mo;
-      if( pConstAttributes )
-        mo.m_attributes = *pConstAttributes;
-      mo.m_object = pCurve;
-      ::ON_CreateUuid(mo.m_attributes.m_uuid);
-      pModel->m_object_table.Append(mo);
-      return mo.m_attributes.m_uuid;
-    }
+    owners.Append(&model.m_light_table[i].m_light);
+    owners.Append(&model.m_light_table[i].m_attributes);
+  }
+  for( i=0; i<model.m_hatch_pattern_table.Count(); i++ )
+    owners.Append(&model.m_hatch_pattern_table[i]);
+  for( i=0; i<model.m_idef_table.Count(); i++ )
+    owners.Append(&model.m_idef_table[i]);
+  for( i=0; i<model.m_object_table.Count(); i++ )
+  {
+    if( model.m_object_table[i].m_object )
+      owners.Append(model.m_object_table[i].m_object);
+    owners.Append(&model.m_object_table[i].m_attributes);
   }
-  return ::ON_nil_uuid;
 }
 
-RH_C_FUNCTION ON_UUID ONX_Model_ObjectTable_AddTextDot(ONX_Model* pModel, const ON_TextDot* pConstDot, const ON_3dmObjectAttributes* pConstAttributes)
+// See RhCmnFinishLazyUserDataRead
+static void FinishLazyUserDataRead(const ONX_Model& model)
 {
-  if( pModel && pConstDot )
+  ON_SimpleArray<const ON_Object*> owners;
+  GetModelUserDataOwners(model, owners);
+  for( int i=0; i<owners.Count(); i++ )
+    RhCmnFinishLazyUserDataRead(owners[i]);
+}
+
+// See RhCmnMaterializeLazyUserData. version is the version passed to
+// ONX_Model::Write, 0 for the current one.
+static void MaterializeLazyUserData(const ONX_Model& model, int version)
+{
+  if( !RhCmnManagedUserDataRegistered() )
+    return;
+  if( 0 == version )
+    version = ON_BinaryArchive::CurrentArchiveVersion();
+  ON_SimpleArray<const ON_Object*> owners;
+  GetModelUserDataOwners(model, owners);
+  for( int i=0; i<owners.Count(); i++ )
+    RhCmnMaterializeLazyUserData(owners[i], version);
+}
+
+RH_C_FUNCTION bool ONX_Model_WriteFile(ONX_Model* pModel, const RHMONO_STRING* path, int version, CRhCmnStringHolder* pStringHolder)
+{
+  bool rc = false;
+  if( pModel )
   {
-    ON_TextDot* pDot = pConstDot->Duplicate();
-    if( pDot )
-    {
-      ONX_Model_Object mo;
-      if( pConstAttributes )
-        mo.m_attributes = *pConstAttributes;
-      mo.m_object = pDot;
-      ::ON_CreateUuid(mo.m_attributes.m_uuid);
-      pModel->m_object_table.Append(mo);
-      return mo.m_attributes.m_uuid;
-    }
+    INPUTSTRINGCOERCE(_path, path);
+    ON_wString s;
+    ON_TextLog log(s);
+    ON_TextLog* pLog = pStringHolder ? &log : NULL;
+    MaterializeLazyUserData(*pModel, version);
+    rc = pModel->Write(_path, version, NULL, pLog);
+    if( pStringHolder )
+      pStringHolder->Set(s);
   }
-  return ::ON_nil_uuid;
+  return rc;
 }
 
-RH_C_FUNCTION ON_UUID ONX_Model_ObjectTable_AddText(ONX_Model* pModel, const RHMONO_STRING* _text, const ON_PLANE_STRUCT* plane, double height, const RHMONO_STRING* _fontName, int fontStyle, int justification, const ON_3dmObjectAttributes* pConstAttributes)
+RH_C_FUNCTION bool ONX_Model_WriteFile2(ONX_Model* pModel, const RHMONO_STRING* path, int version, bool writeRenderMeshes, bool writeAnalysisMeshes, bool writeUserData)
 {
-  INPUTSTRINGCOERCE(text, _text);
-  INPUTSTRINGCOERCE(fontName, _fontName);
-  if( pModel && plane && text && text[0]!=0 )
+  bool rc = false;
+  INPUTSTRINGCOERCE(_path, path);
+  if( pModel && _path )
   {
-    ON_Plane temp = FromPlaneStruct(*plane);
-    if( temp.IsValid() )
-    {
-      if( height <= 0.0 )
-        height = 1.0;
-      bool bBold = (0!=(fontStyle&1));
-      bool bItalic = (0!=(fontStyle&2));
-
-      ON_wString font_str( fontName );
-      font_str.TrimLeftAndRight();
-      if( font_str.IsEmpty() )
-        font_str = L"Arial";
+    FILE* fp = ON::OpenFile(_path, L"wb");
+    if( 0==fp )
+      return false;
+    ON_BinaryFile binary_file(ON::write3dm, fp);
+    binary_file.EnableSave3dmRenderMeshes(writeRenderMeshes?1:0);
+    binary_file.EnableSave3dmAnalysisMeshes(writeAnalysisMeshes?1:0);
+    binary_file.EnableSaveUserData(writeUserData?1:0);
+    if( writeUserData )
+      MaterializeLazyUserData(*pModel, version);
+    rc = pModel->Write(binary_file, version, 0, 0);
+    ON::CloseFile(fp);
+  }
+  return rc;
+}
 
-      int font_index = -1;
-      for( int i=0; i<pModel->m_font_table.Count(); i++ )
-      {
-        const ON_Font& fnt = pModel->m_font_table[i];
-        if( fnt.IsItalic()==bItalic && fnt.IsBold()==bBold && font_str.Compare(fnt.m_facename)==0 )
-        {
-          font_index = i;
-          break;
-        }
-      }
-      if( -1==font_index )
-      {
-        // create a new font and add it to the font table
-        ON_Font fnt;
-        fnt.SetBold(bBold);
-        fnt.SetIsItalic(bItalic);
-        fnt.SetFontFaceName(font_str);
-        ON_wString fontname(font_str);
-        if(bBold)
-          fontname += L" Bold";
-        if(bItalic)
-          fontname += L" Italic";
-        fnt.SetFontName(fontname);
-        fnt.SetFontIndex( pModel->m_font_table.Count() );
-        pModel->m_font_table.Append(fnt);
-        font_index = fnt.FontIndex();
-      }
-      
-
-      ON_TextEntity2* text_entity = new ON_TextEntity2();
-      text_entity->SetHeight( height );
-      text_entity->SetTextValue( text );
-      text_entity->SetTextFormula( 0 );
-      text_entity->SetPlane( temp );
-      text_entity->SetFontIndex( font_index );
-      if( justification>0 )
-        text_entity->SetJustification((unsigned int)justification);
-
-      ONX_Model_Object mo;
-      if( pConstAttributes )
-        mo.m_attributes = *pConstAttributes;
-      mo.m_object = text_entity;
-      ::ON_CreateUuid(mo.m_attributes.m_uuid);
-      pModel->m_object_table.Append(mo);
-      return mo.m_attributes.m_uuid;
-    }
-  }
-  return ::ON_nil_uuid;
-}
-
-RH_C_FUNCTION ON_UUID ONX_Model_ObjectTable_AddSurface(ONX_Model* pModel, const ON_Surface* pConstSurface, const ON_3dmObjectAttributes* pConstAttributes)
+// ON_BinaryFile with the archive versions set up front. The pipelined writer
+// copies the sections it does not re-create straight from a memory image, so
+// Write3dmStartSection is never called on the file archive itself.
+class CRhCmnSpliceFile : public ON_BinaryFile
 {
-  if( pModel && pConstSurface )
+public:
+  CRhCmnSpliceFile(FILE* fp, int archive_3dm_version, int archive_opennurbs_version)
+  : ON_BinaryFile(ON::write3dm, fp)
   {
-    ON_Surface* pSurface = pConstSurface->Duplicate();
-    if( pSurface )
-    {
-      ONX_Model_Object mo;
-      if( pConstAttributes )
-        mo.m_attributes = *pConstAttributes;
-      mo.m_object = pSurface;
-      ::ON_CreateUuid(mo.m_attributes.m_uuid);
-      pModel->m_object_table.Append(mo);
-      return mo.m_attributes.m_uuid;
-    }
+    SetArchive3dmVersion(archive_3dm_version);
+    ON_SetBinaryArchiveOpenNURBSVersion(*this, archive_opennurbs_version);
   }
-  return ::ON_nil_uuid;
-}
+};
 
-RH_C_FUNCTION ON_UUID ONX_Model_ObjectTable_AddExtrusion(ONX_Model* pModel, const ON_Extrusion* pConstExtrusion, const ON_3dmObjectAttributes* pConstAttributes)
+struct PipelinedObjectRecord
 {
-  if( pModel && pConstExtrusion )
-  {
-    ON_Surface* pExtrusion = pConstExtrusion->Duplicate();
-    if( pExtrusion )
-    {
-      ONX_Model_Object mo;
-      if( pConstAttributes )
-        mo.m_attributes = *pConstAttributes;
-      mo.m_object = pExtrusion;
-      ::ON_CreateUuid(mo.m_attributes.m_uuid);
-      pModel->m_object_table.Append(mo);
-      return mo.m_attributes.m_uuid;
-    }
-  }
-  return ::ON_nil_uuid;
-}
+  PipelinedObjectRecord() : m_start(0), m_end(0), m_rc(false) {}
+  ON_SimpleArray<unsigned char> m_buffer;
+  size_t m_start; // TCODE_OBJECT_RECORD chunk is m_buffer[m_start,m_end)
+  size_t m_end;
+  bool m_rc;
+};
 
-RH_C_FUNCTION ON_UUID ONX_Model_ObjectTable_AddMesh(ONX_Model* pModel, const ON_Mesh* pConstMesh, const ON_3dmObjectAttributes* pConstAttributes)
+struct PipelinedWriteContext
 {
-  if( pModel && pConstMesh )
-  {
-    ON_Mesh* pMesh = pConstMesh->Duplicate();
-    if( pMesh )
+  const ON_ClassArray<ONX_Model_Object>* m_objects;
+  int m_first; // index of the first object in this window
+  int m_3dm_version;
+  int m_opennurbs_version;
+  bool m_bWriteRenderMeshes;
+  bool m_bWriteAnalysisMeshes;
+  bool m_bWriteUserData;
+  ON_ClassArray<PipelinedObjectRecord>* m_records;
+};
+
+static void SerializeObjectRecordAt(int index, void* context)
+{
+  PipelinedWriteContext* ctx = (PipelinedWriteContext*)context;
+  const ONX_Model_Object& mo = (*ctx->m_objects)[ctx->m_first + index];
+  PipelinedObjectRecord& record = (*ctx->m_records)[index];
+  record.m_rc = true;
+  record.m_start = record.m_end = 0;
+  if( 0 == mo.m_object )
+    return;
+
+  // Write3dmObject inside an object table so the archive is in the same
+  // state ONX_Model::Write puts it in. Chunk lengths and CRCs are relative
+  // to the record, so its bytes do not depend on where the record lands.
+  CRhCmnWriteBufferArchive archive(record.m_buffer, ctx->m_3dm_version, ctx->m_opennurbs_version);
+  archive.EnableSave3dmRenderMeshes(ctx->m_bWriteRenderMeshes?1:0);
+  archive.EnableSave3dmAnalysisMeshes(ctx->m_bWriteAnalysisMeshes?1:0);
+  archive.EnableSaveUserData(ctx->m_bWriteUserData?1:0);
+  record.m_rc = archive.BeginWrite3dmObjectTable();
+  if( record.m_rc )
+  {
+    record.m_start = archive.CurrentPosition();
+    record.m_rc = archive.Write3dmObject(*mo.m_object, &mo.m_attributes);
+    record.m_end = archive.CurrentPosition();
+  }
+}
+
+// Finds a top level chunk in a 3dm image. Returns the offset of the chunk
+// and sets chunk_end, or returns 0 when the chunk is not there.
+static size_t Find3dmTopLevelChunk(const unsigned char* image, size_t sizeof_image, int archive_3dm_version, unsigned int typecode, size_t* chunk_end)
+{
+  const size_t sizeof_chunk_length = (archive_3dm_version >= 50) ? 8 : 4;
+  size_t pos = 32; // "3D Geometry File Format " and the version
+  while( pos + 4 + sizeof_chunk_length <= sizeof_image )
+  {
+    ON__UINT32 tcode = 0;
+    ON__UINT64 length = 0;
+    memcpy(&tcode, image + pos, 4);
+    if( 8 == sizeof_chunk_length )
+      memcpy(&length, image + pos + 4, 8);
+    else
     {
-      ONX_Model_Object mo;
-      if( pConstAttributes )
-        mo.m_attributes = *pConstAttributes;
-      mo.m_object = pMesh;
-      ::ON_CreateUuid(mo.m_attributes.m_uuid);
-      pModel->m_object_table.Append(mo);
-      return mo.m_attributes.m_uuid;
+      ON__UINT32 length32 = 0;
+      memcpy(&length32, image + pos + 4, 4);
+      length = length32;
     }
-  }
-  return ::ON_nil_uuid;
-}
-
-RH_C_FUNCTION ON_UUID ONX_Model_ObjectTable_AddBrep(ONX_Model* pModel, const ON_Brep* pConstBrep, const ON_3dmObjectAttributes* pConstAttributes)
-{
-  if( pModel && pConstBrep )
-  {
-    ON_Brep* pBrep = pConstBrep->Duplicate();
-    if( pBrep )
+    size_t next = pos + 4 + sizeof_chunk_length;
+    if( 0 == (tcode & TCODE_SHORT) )
+      next += (size_t)length;
+    if( tcode == typecode )
     {
-      ONX_Model_Object mo;
-      if( pConstAttributes )
-        mo.m_attributes = *pConstAttributes;
-      mo.m_object = pBrep;
-      ::ON_CreateUuid(mo.m_attributes.m_uuid);
-      pModel->m_object_table.Append(mo);
-      return mo.m_attributes.m_uuid;
+      if( chunk_end )
+        *chunk_end = next;
+      return pos;
     }
+    if( TCODE_ENDOFFILE == tcode || next > sizeof_image )
+      break;
+    pos = next;
   }
-  return ::ON_nil_uuid;
+  return 0;
 }
 
-RH_C_FUNCTION ON_UUID ONX_Model_ObjectTable_AddLeader(ONX_Model* pModel, const RHMONO_STRING* _text, const ON_PLANE_STRUCT* plane, int count, /*ARRAY*/const ON_2dPoint* points2d, const ON_3dmObjectAttributes* pConstAttributes)
-{
-  INPUTSTRINGCOERCE(text, _text);
-  if( pModel && plane && count>1 && points2d )
-  {
-    ON_Leader2* leader = new ON_Leader2();
+/*
+Description:
+  Writes the same bytes as ONX_Model_WriteFile2 but serializes the object
+  records, including the zlib compression of meshes, on worker threads.
+  Everything except the object table is written once into memory by
+  ONX_Model::Write with the object table emptied. The file is then assembled
+  from that image with the object records emitted in table order, and the
+  object table and end mark are rebuilt through ON_BinaryArchive so chunk
+  lengths, CRCs and the recorded file size are computed by openNURBS.
+  Objects are serialized in windows so at most a few hundred records are
+  held in memory at once.
+*/
+static bool WriteModelPipelined(ONX_Model& model, FILE* fp, int version, bool writeRenderMeshes, bool writeAnalysisMeshes, bool writeUserData, int maxThreads)
+{
+  ON_SimpleArray<unsigned char> image;
+  CRhCmnWriteBufferArchive skeleton(image, 0, 0);
+  skeleton.EnableSave3dmRenderMeshes(writeRenderMeshes?1:0);
+  skeleton.EnableSave3dmAnalysisMeshes(writeAnalysisMeshes?1:0);
+  skeleton.EnableSaveUserData(writeUserData?1:0);
+  if( writeUserData )
+    MaterializeLazyUserData(model, version);
+
+  const int object_count = model.m_object_table.Count();
+  const int object_capacity = model.m_object_table.Capacity();
+  ONX_Model_Object* objects = model.m_object_table.KeepArray();
+  bool rc = model.Write(skeleton, version, 0, 0);
+  model.m_object_table.SetArray(objects, object_count, object_capacity);
+  if( !rc )
+    return false;
 
-    ON_Plane temp = FromPlaneStruct(*plane);
-    leader->SetPlane(temp);
-    for( int i=0; i<count; i++ )
-      leader->m_points.Append(points2d[i]);
+  const int archive_3dm_version = skeleton.Archive3dmVersion();
+  const int archive_opennurbs_version = skeleton.ArchiveOpenNURBSVersion();
+  size_t table_end = 0;
+  size_t eof_end = 0;
+  const size_t table_start = Find3dmTopLevelChunk(image.Array(), image.Count(), archive_3dm_version, TCODE_OBJECT_TABLE, &table_end);
+  const size_t eof_start = Find3dmTopLevelChunk(image.Array(), image.Count(), archive_3dm_version, TCODE_ENDOFFILE, &eof_end);
+  if( 0 == table_start || eof_start < table_end )
+    return false;
 
-    leader->SetTextValue(text);
+  CRhCmnSpliceFile file(fp, archive_3dm_version, archive_opennurbs_version);
+  file.EnableSave3dmRenderMeshes(writeRenderMeshes?1:0);
+  file.EnableSave3dmAnalysisMeshes(writeAnalysisMeshes?1:0);
+  file.EnableSaveUserData(writeUserData?1:0);
 
-    ONX_Model_Object mo;
-    if( pConstAttributes )
-      mo.m_attributes = *pConstAttributes;
-    mo.m_object = leader;
-    ::ON_CreateUuid(mo.m_attributes.m_uuid);
-    pModel->m_object_table.Append(mo);
-    return mo.m_attributes.m_uuid;
-  }
-  return ::ON_nil_uuid;
-}
+  rc = file.WriteByte(table_start, image.Array());
+  if( rc )
+    rc = file.BeginWrite3dmObjectTable();
+  if( !rc )
+    return false;
 
-RH_C_FUNCTION ON_UUID ONX_Model_ObjectTable_AddHatch(ONX_Model* pModel, const ON_Hatch* pConstHatch, const ON_3dmObjectAttributes* pConstAttributes)
-{
-  if( pModel && pConstHatch )
-  {
-    ON_Hatch* pHatch = pConstHatch->Duplicate();
-    if( pHatch )
+  // Managed user data is written by .NET callbacks that are not thread safe
+  if( writeUserData && RhCmnManagedUserDataRegistered() )
+    maxThreads = 1;
+  const int thread_count = maxThreads > 0 ? maxThreads : RhCmnProcessorCount();
+  const int window = thread_count * 32;
+  ON_ClassArray<PipelinedObjectRecord> records(window);
+  records.SetCount(window);
+
+  PipelinedWriteContext ctx;
+  ctx.m_objects = &model.m_object_table;
+  ctx.m_3dm_version = archive_3dm_version;
+  ctx.m_opennurbs_version = archive_opennurbs_version;
+  ctx.m_bWriteRenderMeshes = writeRenderMeshes;
+  ctx.m_bWriteAnalysisMeshes = writeAnalysisMeshes;
+  ctx.m_bWriteUserData = writeUserData;
+  ctx.m_records = &records;
+
+  for( int first = 0; rc && first < object_count; first += window )
+  {
+    const int count = (object_count - first < window) ? object_count - first : window;
+    ctx.m_first = first;
+    RhCmnParallelFor(count, SerializeObjectRecordAt, &ctx, maxThreads);
+    for( int i = 0; rc && i < count; i++ )
     {
-      ONX_Model_Object mo;
-      if( pConstAttributes )
-        mo.m_attributes = *pConstAttributes;
-      mo.m_object = pHatch;
-      ::ON_CreateUuid(mo.m_attributes.m_uuid);
-      pModel->m_object_table.Append(mo);
-      return mo.m_attributes.m_uuid;
+      const PipelinedObjectRecord& record = records[i];
+      // ONX_Model::Write stops at the first object that fails to write
+      rc = record.m_rc;
+      if( rc && record.m_end > record.m_start )
+        rc = file.WriteByte(record.m_end - record.m_start, record.m_buffer.Array() + record.m_start);
     }
   }
-  return ::ON_nil_uuid;
-}
-
-RH_C_FUNCTION ON_UUID ONX_Model_ObjectTable_AddPolyLine(ONX_Model* pModel, int count, /*ARRAY*/const ON_3dPoint* points, const ON_3dmObjectAttributes* pConstAttributes)
-{
-  if( pModel && points && count>1)
-  {
-    CHack3dPointArray pl(count, (ON_3dPoint*)points);
 
-    ON_PolylineCurve* pCurve = new ON_PolylineCurve(pl);
-    ONX_Model_Object mo;
-    if( pConstAttributes )
-      mo.m_attributes = *pConstAttributes;
-    mo.m_object = pCurve;
-    ::ON_CreateUuid(mo.m_attributes.m_uuid);
-    pModel->m_object_table.Append(mo);
-    return mo.m_attributes.m_uuid;
-  }
-  return ::ON_nil_uuid;
+  if( !file.EndWrite3dmObjectTable() )
+    rc = false;
+  if( rc )
+    rc = file.WriteByte(eof_start - table_end, image.Array() + table_end);
+  if( rc )
+    rc = file.Write3dmEndMark();
+  return rc;
 }
 
-RH_C_FUNCTION bool ONX_Model_ObjectTable_Delete(ONX_Model* pModel, ON_UUID object_id)
+// Same output as ONX_Model_WriteFile2. When maxThreads is not 1 the object
+// table is serialized on worker threads; maxThreads <= 0 uses every core.
+// User data of registered managed classes forces a single thread.
+RH_C_FUNCTION bool ONX_Model_WriteFile3(ONX_Model* pModel, const RHMONO_STRING* path, int version, bool writeRenderMeshes, bool writeAnalysisMeshes, bool writeUserData, int maxThreads)
 {
   bool rc = false;
-  if( pModel )
+  INPUTSTRINGCOERCE(_path, path);
+  if( pModel && _path )
   {
-    for( int i=0; i<pModel->m_object_table.Count(); i++ )
-    {
-      if( pModel->m_object_table[i].m_attributes.m_uuid==object_id )
-      {
-        pModel->m_object_table.Remove(i);
-        rc = true;
-        break;
-      }
-    }
+    // version 1 files write objects without object records
+    if( 1 == maxThreads || 1 == version || pModel->m_object_table.Count() < 2 )
+      return ONX_Model_WriteFile2(pModel, path, version, writeRenderMeshes, writeAnalysisMeshes, writeUserData);
+    FILE* fp = ON::OpenFile(_path, L"wb");
+    if( 0==fp )
+      return false;
+    rc = WriteModelPipelined(*pModel, fp, version, writeRenderMeshes, writeAnalysisMeshes, writeUserData, maxThreads);
+    ON::CloseFile(fp);
   }
   return rc;
 }
 
-RH_C_FUNCTION void ONX_Model_BoundingBox(const ONX_Model* pConstModel, ON_BoundingBox* pBBox)
+// Models returned by the C API must be freed here and not with delete, so
+// the bookkeeping in the model state registry goes with them
+RH_C_FUNCTION void ONX_Model_Delete(ONX_Model* pModel)
 {
-  if( pConstModel && pBBox )
+  if( pModel )
   {
-    *pBBox = pConstModel->BoundingBox();
+    DeleteModelState(pModel);
+    delete pModel;
   }
 }
 
-RH_C_FUNCTION ON_Linetype* ONX_Model_GetLinetypePointer(ONX_Model* pModel, ON_UUID id)
+RH_C_FUNCTION bool ONX_Model_IsValid(const ONX_Model* pConstModel, CRhCmnStringHolder* pString)
 {
-  ON_Linetype* rc = NULL;
-  if( pModel )
+  bool rc = false;
+  if( pConstModel && pString )
   {
-    int count = pModel->m_linetype_table.Count();
-    for( int i=0; i<count; i++ )
-    {
-      if( pModel->m_linetype_table[i].m_linetype_id == id )
-      {
-        rc = &(pModel->m_linetype_table[i]);
-        break;
-      }
-    }
+    ON_wString s;
+    ON_TextLog log(s);
+    rc = pConstModel->IsValid(&log);
+    pString->Set(s);
   }
   return rc;
 }
 
-RH_C_FUNCTION ON_Bitmap* ONX_Model_GetBitmapPointer(ONX_Model* pModel, int index)
+RH_C_FUNCTION bool ONX_Model_IsValid2(const ONX_Model* pConstModel, ON_TextLog* pTextLog)
 {
-  ON_Bitmap* rc = NULL;
-  if( pModel && index >= 0 && index < pModel->m_bitmap_table.Count())
-    rc = pModel->m_bitmap_table[index];
+  bool rc = false;
+  if( pConstModel && pTextLog )
+    rc = pConstModel->IsValid(pTextLog);
   return rc;
 }
 
-RH_C_FUNCTION ON_Layer* ONX_Model_GetLayerPointer(ONX_Model* pModel, ON_UUID id)
+// Polish and repairing audits can change object ids, layers and materials
+// in place, which the lookup indices do not see
+static void ModelObjectsRepaired(const ONX_Model* pConstModel)
+{
+  CRhCmnModelState* state = GetModelState(pConstModel, false);
+  if( state )
+    InvalidateModelIndices(state, ttfObjectTable);
+}
+
+RH_C_FUNCTION void ONX_Model_Polish(ONX_Model* pModel)
 {
-  ON_Layer* rc = NULL;
   if( pModel )
   {
-    int count = pModel->m_layer_table.Count();
-    for( int i=0; i<count; i++ )
-    {
-      if( pModel->m_layer_table[i].m_layer_id == id )
-      {
-        rc = &(pModel->m_layer_table[i]);
-        break;
-      }
-    }
+    pModel->Polish();
+    ModelObjectsRepaired(pModel);
   }
-  return rc;
 }
 
-RH_C_FUNCTION ON_DimStyle* ONX_Model_GetDimStylePointer(ONX_Model* pModel, ON_UUID id)
+RH_C_FUNCTION int ONX_Model_Audit(ONX_Model* pModel, bool attemptRepair, int* repairCount, CRhCmnStringHolder* pString, ON_SimpleArray<int>* warnings)
 {
-  ON_DimStyle* rc = NULL;
-  if( pModel )
+  int rc = -1;
+  if( pModel && repairCount )
   {
-    int count = pModel->m_dimstyle_table.Count();
-    for( int i=0; i<count; i++ )
-    {
-      if( pModel->m_dimstyle_table[i].m_dimstyle_id == id )
-      {
-        rc = &(pModel->m_dimstyle_table[i]);
-        break;
-      }
-    }
+    ON_wString s;
+    ON_TextLog log(s);
+    rc = pModel->Audit(attemptRepair, repairCount, &log, warnings);
+    if( attemptRepair && *repairCount > 0 )
+      ModelObjectsRepaired(pModel);
+    if( pString )
+      pString->Set(s);
   }
   return rc;
 }
 
-RH_C_FUNCTION ON_HatchPattern* ONX_Model_GetHatchPatternPointer(ONX_Model* pModel, ON_UUID id)
+RH_C_FUNCTION int ONX_Model_Audit2(ONX_Model* pModel, bool attemptRepair, int* repairCount, ON_TextLog* pTextLog, ON_SimpleArray<int>* warnings)
 {
-  ON_HatchPattern* rc = NULL;
-  if( pModel )
+  int rc = -1;
+  if( pModel && repairCount )
   {
-    int count = pModel->m_hatch_pattern_table.Count();
-    for( int i=0; i<count; i++ )
-    {
-      if( pModel->m_hatch_pattern_table[i].m_hatchpattern_id == id )
-      {
-        rc = &(pModel->m_hatch_pattern_table[i]);
-        break;
-      }
-    }
+    rc = pModel->Audit(attemptRepair, repairCount, pTextLog, warnings);
+    if( attemptRepair && *repairCount > 0 )
+      ModelObjectsRepaired(pModel);
   }
   return rc;
 }
 
-RH_C_FUNCTION ON_Material* ONX_Model_GetMaterialPointer(ONX_Model* pModel, ON_UUID id)
+// Outcome of checking one object (see ONX_Model_AuditObjects)
+struct CRhCmnObjectAuditResult
 {
-  ON_Material* rc = NULL;
-  if( pModel )
-  {
-    int count = pModel->m_material_table.Count();
-    for( int i=0; i<count; i++ )
-    {
-      if( pModel->m_material_table[i].m_material_id == id )
-      {
-        rc = &(pModel->m_material_table[i]);
-        break;
-      }
-    }
-  }
-  return rc;
-}
+  CRhCmnObjectAuditResult() : m_object_index(-1), m_status(0), m_repair_count(0) {}
+  int m_object_index;
+  int m_status;       // 1 = valid, 2 = valid after repair, 0 = invalid
+  int m_repair_count;
+  ON_wString m_message;
+};
 
-RH_C_FUNCTION void ONX_Model_LinetypeTable_Insert(ONX_Model* pModel, const ON_Linetype* pConstLinetype, int index)
+struct AuditObjectsContext
 {
-  if( pModel && pConstLinetype && index>=0)
-  {
-    pModel->m_linetype_table.Insert(index, *pConstLinetype);
-    // update indices
-    for( int i=index; i<pModel->m_linetype_table.Count(); i++ )
-      pModel->m_linetype_table[i].m_linetype_index = i;
-  }
-}
+  const ONX_Model* m_model;
+  ONX_Model* m_repair_model; // NULL when not repairing
+  bool m_bMessages;
+  ON_ClassArray<CRhCmnObjectAuditResult>* m_results;
+};
 
-RH_C_FUNCTION void ONX_Model_LayerTable_Insert(ONX_Model* pModel, const ON_Layer* pConstLayer, int index)
+static void AuditObjectAt(int index, void* context)
 {
-  if( pModel && pConstLayer && index>=0)
-  {
-    pModel->m_layer_table.Insert(index, *pConstLayer);
-    // update layer indices
-    for( int i=index; i<pModel->m_layer_table.Count(); i++ )
-      pModel->m_layer_table[i].m_layer_index = i;
-  }
-}
+  AuditObjectsContext* ctx = (AuditObjectsContext*)context;
+  const ONX_Model& model = *ctx->m_model;
+  const ONX_Model_Object& mo = model.m_object_table[index];
+  CRhCmnObjectAuditResult& result = (*ctx->m_results)[index];
+  result.m_object_index = index;
 
-RH_C_FUNCTION void ONX_Model_DimStyleTable_Insert(ONX_Model* pModel, const ON_DimStyle* pConstDimStyle, int index)
-{
-  if( pModel && pConstDimStyle && index>=0)
+  ON_TextLog log(result.m_message);
+  ON_TextLog* pLog = ctx->m_bMessages ? &log : NULL;
+  bool bValid = true;
+
+  if( NULL == mo.m_object )
   {
-    pModel->m_dimstyle_table.Insert(index, *pConstDimStyle);
-    // update indices
-    for( int i=index; i<pModel->m_dimstyle_table.Count(); i++ )
-      pModel->m_dimstyle_table[i].m_dimstyle_index = i;
+    if( pLog )
+      pLog->Print("Object has no geometry.\n");
+    bValid = false;
   }
-}
+  else if( !mo.m_object->IsValid(pLog) )
+    bValid = false;
 
-RH_C_FUNCTION void ONX_Model_HatchPatternTable_Insert(ONX_Model* pModel, const ON_HatchPattern* pConstHatchPattern, int index)
-{
-  if( pModel && pConstHatchPattern && index>=0)
+  if( !mo.m_attributes.IsValid(pLog) )
+    bValid = false;
+
+  // Only this thread touches this object's attributes
+  ON_3dmObjectAttributes* pRepair = ctx->m_repair_model ? &ctx->m_repair_model->m_object_table[index].m_attributes : NULL;
+  const int layer_count = model.m_layer_table.Count();
+  if( mo.m_attributes.m_layer_index < 0 || mo.m_attributes.m_layer_index >= layer_count )
   {
-    pModel->m_hatch_pattern_table.Insert(index, *pConstHatchPattern);
-    // update indices
-    for( int i=index; i<pModel->m_hatch_pattern_table.Count(); i++ )
-      pModel->m_hatch_pattern_table[i].m_hatchpattern_index = i;
+    if( pLog )
+      pLog->Print("Layer index %d is not in the layer table.\n", mo.m_attributes.m_layer_index);
+    if( pRepair && layer_count > 0 )
+    {
+      pRepair->m_layer_index = 0;
+      result.m_repair_count++;
+    }
+    else
+      bValid = false;
   }
-}
-
-RH_C_FUNCTION void ONX_Model_InstanceDefinitionTable_Insert(ONX_Model* pModel, const ON_InstanceDefinition* pConstInstanceDefinition, int index)
-{
-  if( pModel && pConstInstanceDefinition && index>=0 )
+  if( mo.m_attributes.m_material_index >= model.m_material_table.Count() )
   {
-    pModel->m_idef_table.Insert(index, *pConstInstanceDefinition);
+    if( pLog )
+      pLog->Print("Material index %d is not in the material table.\n", mo.m_attributes.m_material_index);
+    if( pRepair )
+    {
+      pRepair->m_material_index = -1;
+      result.m_repair_count++;
+    }
+    else
+      bValid = false;
   }
-}
-
-RH_C_FUNCTION void ONX_Model_MaterialTable_Insert(ONX_Model* pModel, const ON_Material* pConstMaterial, int index)
-{
-  if( pModel && pConstMaterial && index>=0)
+  if( ON_UuidIsNil(mo.m_attributes.m_uuid) )
   {
-    pModel->m_material_table.Insert(index, *pConstMaterial);
-    // update indices
-    for( int i=index; i<pModel->m_material_table.Count(); i++ )
-      pModel->m_material_table[i].m_material_index = i;
+    if( pLog )
+      pLog->Print("Object id is nil.\n");
+    if( pRepair )
+    {
+      ON_CreateUuid(pRepair->m_uuid);
+      result.m_repair_count++;
+    }
+    else
+      bValid = false;
   }
-}
 
-RH_C_FUNCTION void ONX_Model_LinetypeTable_RemoveAt(ONX_Model* pModel, int index)
-{
-  if( pModel && index>=0)
-  {
-    pModel->m_linetype_table.Remove(index);
-    // update indices
-    for( int i=index; i<pModel->m_linetype_table.Count(); i++ )
-      pModel->m_linetype_table[i].m_linetype_index = i;
+  if( !bValid )
+    result.m_status = 0;
+  else
+    result.m_status = result.m_repair_count > 0 ? 2 : 1;
+}
+
+/*
+Description:
+  Checks every object on worker threads: geometry and attributes IsValid,
+  layer and material indices in range and a non-nil id. Duplicate ids are
+  found in a pass over the results afterwards. pRepairModel is pConstModel
+  when repairs are wanted and NULL otherwise.
+*/
+static ON_ClassArray<CRhCmnObjectAuditResult>* AuditModelObjects(const ONX_Model* pConstModel, ONX_Model* pRepairModel, bool collectMessages, int maxThreads)
+{
+  const int count = pConstModel->m_object_table.Count();
+  ON_ClassArray<CRhCmnObjectAuditResult>* rc = new ON_ClassArray<CRhCmnObjectAuditResult>(count);
+  rc->SetCount(count);
+  AuditObjectsContext ctx;
+  ctx.m_model = pConstModel;
+  ctx.m_repair_model = pRepairModel;
+  ctx.m_bMessages = collectMessages;
+  ctx.m_results = rc;
+  RhCmnParallelFor(count, AuditObjectAt, &ctx, maxThreads);
+
+  bool bRepaired = false;
+  CRhCmnUuidIndexMap ids;
+  ids.Reset(count);
+  for( int i = 0; i < count; i++ )
+  {
+    CRhCmnObjectAuditResult& result = (*rc)[i];
+    if( result.m_repair_count > 0 )
+      bRepaired = true;
+    const ON_UUID& id = pConstModel->m_object_table[i].m_attributes.m_uuid;
+    ids.Append(id, i);
+    const int first = ids.Find(id);
+    if( first == i || ON_UuidIsNil(id) )
+      continue;
+    if( collectMessages )
+    {
+      ON_TextLog log(result.m_message);
+      log.Print("Object id is also used by object %d.\n", first);
+    }
+    if( pRepairModel )
+    {
+      ON_CreateUuid(pRepairModel->m_object_table[i].m_attributes.m_uuid);
+      result.m_repair_count++;
+      if( result.m_status > 0 )
+        result.m_status = 2;
+      bRepaired = true;
+    }
+    else
+      result.m_status = 0;
   }
+
+  if( bRepaired )
+    ModelObjectsRepaired(pConstModel);
+  return rc;
 }
 
-RH_C_FUNCTION void ONX_Model_LayerTable_RemoveAt(ONX_Model* pModel, int index)
+// Checks every object of the model on worker threads without changing it.
+// Free the result with ONX_Model_AuditResults_Delete.
+RH_C_FUNCTION ON_ClassArray<CRhCmnObjectAuditResult>* ONX_Model_ValidateObjects(const ONX_Model* pConstModel, bool collectMessages, int maxThreads)
 {
-  if( pModel && index>=0)
-  {
-    pModel->m_layer_table.Remove(index);
-    // update indices
-    for( int i=index; i<pModel->m_layer_table.Count(); i++ )
-      pModel->m_layer_table[i].m_layer_index = i;
-  }
+  ON_ClassArray<CRhCmnObjectAuditResult>* rc = NULL;
+  if( pConstModel )
+    rc = AuditModelObjects(pConstModel, NULL, collectMessages, maxThreads);
+  return rc;
 }
 
-RH_C_FUNCTION void ONX_Model_DimStyleTable_RemoveAt(ONX_Model* pModel, int index)
+// Same as ONX_Model_ValidateObjects but, when attemptRepair is true, fixes
+// bad layer and material indices and nil or duplicate object ids.
+RH_C_FUNCTION ON_ClassArray<CRhCmnObjectAuditResult>* ONX_Model_AuditObjects(ONX_Model* pModel, bool attemptRepair, bool collectMessages, int maxThreads)
 {
-  if( pModel && index>=0)
-  {
-    pModel->m_dimstyle_table.Remove(index);
-    // update indices
-    for( int i=index; i<pModel->m_dimstyle_table.Count(); i++ )
-      pModel->m_dimstyle_table[i].m_dimstyle_index = i;
-  }
+  ON_ClassArray<CRhCmnObjectAuditResult>* rc = NULL;
+  if( pModel )
+    rc = AuditModelObjects(pModel, attemptRepair ? pModel : NULL, collectMessages, maxThreads);
+  return rc;
 }
 
-RH_C_FUNCTION void ONX_Model_HatchPatternTable_RemoveAt(ONX_Model* pModel, int index)
+RH_C_FUNCTION int ONX_Model_AuditResults_Count(const ON_ClassArray<CRhCmnObjectAuditResult>* pConstResults)
 {
-  if( pModel && index>=0)
-  {
-    pModel->m_hatch_pattern_table.Remove(index);
-    // update indices
-    for( int i=index; i<pModel->m_hatch_pattern_table.Count(); i++ )
-      pModel->m_hatch_pattern_table[i].m_hatchpattern_index = i;
-  }
+  int rc = 0;
+  if( pConstResults )
+    rc = pConstResults->Count();
+  return rc;
 }
 
-RH_C_FUNCTION void ONX_Model_InstanceDefinitionTable_RemoveAt(ONX_Model* pModel, int index)
+// Copies the status and repair count of every result. Either array may be
+// NULL. Returns the number of invalid objects.
+RH_C_FUNCTION int ONX_Model_AuditResults_GetStatus(const ON_ClassArray<CRhCmnObjectAuditResult>* pConstResults, int count, /*ARRAY*/int* status, /*ARRAY*/int* repairCounts)
 {
-  if( pModel && index>=0)
+  int rc = 0;
+  if( pConstResults )
   {
-    pModel->m_idef_table.Remove(index);
+    if( count > pConstResults->Count() )
+      count = pConstResults->Count();
+    for( int i=0; i<count; i++ )
+    {
+      const CRhCmnObjectAuditResult& result = (*pConstResults)[i];
+      if( status )
+        status[i] = result.m_status;
+      if( repairCounts )
+        repairCounts[i] = result.m_repair_count;
+      if( 0 == result.m_status )
+        rc++;
+    }
   }
+  return rc;
 }
 
-RH_C_FUNCTION void ONX_Model_MaterialTable_RemoveAt(ONX_Model* pModel, int index)
+RH_C_FUNCTION int ONX_Model_AuditResults_Get(const ON_ClassArray<CRhCmnObjectAuditResult>* pConstResults, int index, int* objectIndex, int* repairCount, CRhCmnStringHolder* pMessage)
 {
-  if( pModel && index>=0)
+  int rc = 0;
+  if( pConstResults && index>=0 && index<pConstResults->Count() )
   {
-    pModel->m_material_table.Remove(index);
-    // update indices
-    for( int i=index; i<pModel->m_material_table.Count(); i++ )
-      pModel->m_material_table[i].m_material_index = i;
+    const CRhCmnObjectAuditResult& result = (*pConstResults)[index];
+    rc = result.m_status;
+    if( objectIndex )
+      *objectIndex = result.m_object_index;
+    if( repairCount )
+      *repairCount = result.m_repair_count;
+    if( pMessage )
+      pMessage->Set(result.m_message);
   }
+  return rc;
 }
 
-RH_C_FUNCTION ON_UUID ONX_Model_LinetypeTable_Id(const ONX_Model* pConstModel, int index)
+// Assembles the messages of the objects that were invalid or repaired into
+// one report, in table order
+RH_C_FUNCTION void ONX_Model_AuditResults_Text(const ON_ClassArray<CRhCmnObjectAuditResult>* pConstResults, CRhCmnStringHolder* pString)
 {
-  if( pConstModel && index>=0 && index<pConstModel->m_linetype_table.Count())
+  if( pConstResults && pString )
   {
-    return pConstModel->m_linetype_table[index].m_linetype_id;
+    ON_wString s;
+    for( int i=0; i<pConstResults->Count(); i++ )
+    {
+      const CRhCmnObjectAuditResult& result = (*pConstResults)[i];
+      if( 1 == result.m_status || result.m_message.IsEmpty() )
+        continue;
+      ON_wString header;
+      header.Format(L"Object %d:\n", result.m_object_index);
+      s += header;
+      s += result.m_message;
+    }
+    pString->Set(s);
   }
-  return ::ON_nil_uuid;
 }
 
-RH_C_FUNCTION ON_UUID ONX_Model_LayerTable_Id(const ONX_Model* pConstModel, int index)
+RH_C_FUNCTION void ONX_Model_AuditResults_Delete(ON_ClassArray<CRhCmnObjectAuditResult>* pResults)
 {
-  if( pConstModel && index>=0 && index<pConstModel->m_layer_table.Count())
-  {
-    return pConstModel->m_layer_table[index].m_layer_id;
-  }
-  return ::ON_nil_uuid;
+  if( pResults )
+    delete pResults;
 }
 
-RH_C_FUNCTION ON_UUID ONX_Model_DimStyleTable_Id(const ONX_Model* pConstModel, int index)
+RH_C_FUNCTION void ONX_Model_GetStartSectionComments(const ONX_Model* pConstModel, CRhCmnStringHolder* pString)
 {
-  if( pConstModel && index>=0 && index<pConstModel->m_dimstyle_table.Count())
-  {
-    return pConstModel->m_dimstyle_table[index].m_dimstyle_id;
-  }
-  return ::ON_nil_uuid;
+  if( pConstModel && pString )
+    pString->Set(pConstModel->m_sStartSectionComments);
 }
 
-RH_C_FUNCTION ON_UUID ONX_Model_HatchPatternTable_Id(const ONX_Model* pConstModel, int index)
+RH_C_FUNCTION void ONX_Model_SetStartSectionComments(ONX_Model* pModel, const RHMONO_STRING* comments)
 {
-  if( pConstModel && index>=0 && index<pConstModel->m_hatch_pattern_table.Count())
+  if( pModel )
   {
-    return pConstModel->m_hatch_pattern_table[index].m_hatchpattern_id;
+    INPUTSTRINGCOERCE(_comments, comments);
+    ON_String ssc(_comments);
+    pModel->m_sStartSectionComments = ssc;
+    ModelTableChanged(pModel, ttfPropertiesTable);
   }
-  return ::ON_nil_uuid;
 }
 
-RH_C_FUNCTION ON_UUID ONX_Model_InstanceDefinitionTable_Id(const ONX_Model* pConstModel, int index)
+RH_C_FUNCTION void ONX_Model_GetNotes(const ONX_Model* pConstModel, CRhCmnStringHolder* pString, bool* visible, bool* html, int* left, int* top, int* right, int* bottom)
 {
-  if( pConstModel && index>=0 && index<pConstModel->m_idef_table.Count())
+  if( pConstModel && visible && html && left && top && right && bottom )
   {
-    return pConstModel->m_idef_table[index].m_uuid;
+    const ON_3dmNotes& notes = pConstModel->m_properties.m_Notes;
+    if( pString )
+      pString->Set(notes.m_notes);
+    *visible = notes.m_bVisible?true:false;
+    *html = notes.m_bHTML?true:false;
+    *left = notes.m_window_left;
+    *top = notes.m_window_top;
+    *right = notes.m_window_right;
+    *bottom = notes.m_window_bottom;
   }
-  return ::ON_nil_uuid;
 }
 
-RH_C_FUNCTION int ONX_Model_InstanceDefinitionTable_Index(const ONX_Model* pConstModel, ON_UUID id)
+RH_C_FUNCTION void ONX_Model_SetNotesString(ONX_Model* pModel, const RHMONO_STRING* notes)
 {
-  if( pConstModel )
+  if( pModel )
   {
-    for( int i=0; i<pConstModel->m_idef_table.Count(); i++ )
-    {
-      if( id == pConstModel->m_idef_table[i].m_uuid )
-        return i;
-    }
+    INPUTSTRINGCOERCE(_notes, notes);
+    pModel->m_properties.m_Notes.m_notes = _notes;
+    ModelTableChanged(pModel, ttfPropertiesTable);
   }
-  return -1;
 }
 
-RH_C_FUNCTION const ON_InstanceDefinition* ONX_Model_GetInstanceDefinitionPointer(const ONX_Model* pConstModel, ON_UUID id)
+RH_C_FUNCTION void ONX_Model_SetNotes(ONX_Model* pModel, bool visible, bool html, int left, int top, int right, int bottom)
 {
-  if( pConstModel )
+  if( pModel )
   {
-    for( int i=0; i<pConstModel->m_idef_table.Count(); i++ )
-    {
-      const ON_InstanceDefinition* pIdef = pConstModel->m_idef_table.At(i);
-      if( pIdef && pIdef->m_uuid==id )
-        return pIdef;
-    }
+    pModel->m_properties.m_Notes.m_bHTML = html?1:0;
+    pModel->m_properties.m_Notes.m_bVisible = visible?1:0;
+    pModel->m_properties.m_Notes.m_window_left = left;
+    pModel->m_properties.m_Notes.m_window_top = top;
+    pModel->m_properties.m_Notes.m_window_right = right;
+    pModel->m_properties.m_Notes.m_window_bottom = bottom;
+    ModelTableChanged(pModel, ttfPropertiesTable);
   }
-  return NULL;
 }
 
-RH_C_FUNCTION ON_UUID ONX_Model_MaterialTable_Id(const ONX_Model* pConstModel, int index)
+enum ONXModelTable : int
 {
-  if( pConstModel && index>=0 && index<pConstModel->m_material_table.Count())
-  {
-    return pConstModel->m_material_table[index].m_material_id;
-  }
-  return ::ON_nil_uuid;
-}
+  onxDumpAll = 0,
+  onxDumpSummary = 1,
+  onxBitmapTable = 2,
+  onxTextureMappingTable = 3,
+  onxMaterialTable = 4,
+  onxLinetypeTable = 5,
+  onxLayerTable = 6,
+  onxLightTable = 7,
+  onxGroupTable = 8,
+  onxFontTable = 9,
+  onxDimStyleTable = 10,
+  onxHatchPatternTable = 11,
+  onxIDefTable = 12,
+  onxObjectTable = 13,
+  onxHistoryRecordTable = 14,
+  onxUserDataTable = 15,
+  onxViewTable = 16,
+  onxNamedViewTable = 17,
+};
 
-RH_C_FUNCTION void ONX_Model_TableClear(ONX_Model* pModel, enum ONXModelTable which_table)
+RH_C_FUNCTION int ONX_Model_TableCount(const ONX_Model* pConstModel, enum ONXModelTable which)
 {
-  if( pModel )
+
+  int rc = 0;
+  if( pConstModel )
   {
-    pModel->m_layer_table.Empty();
-    switch(which_table)
+    switch(which)
     {
     case onxBitmapTable:
-      {
-        for( int i=0; i<pModel->m_bitmap_table.Count(); i++ )
-        {
-          ON_Bitmap* pBitmap = pModel->m_bitmap_table[i];
-          if( pBitmap )
-            delete pBitmap;
-          pModel->m_bitmap_table[i] = NULL;
-        }
-        pModel->m_bitmap_table.Empty();
-      }
+      rc = pConstModel->m_bitmap_table.Count();
       break;
     case onxTextureMappingTable:
-      pModel->m_mapping_table.Empty();
+      rc = pConstModel->m_mapping_table.Count();
       break;
     case onxMaterialTable:
-      pModel->m_material_table.Empty();
+      rc = pConstModel->m_material_table.Count();
       break;
     case onxLinetypeTable:
-      pModel->m_linetype_table.Empty();
+      rc = pConstModel->m_linetype_table.Count();
       break;
     case onxLayerTable:
-      pModel->m_layer_table.Empty();
+      rc = pConstModel->m_layer_table.Count();
       break;
     case onxLightTable:
-      pModel->m_light_table.Empty();
+      rc = pConstModel->m_light_table.Count();
       break;
     case onxGroupTable:
-      pModel->m_group_table.Empty();
+      rc = pConstModel->m_group_table.Count();
       break;
     case onxFontTable:
-      pModel->m_font_table.Empty();
+      rc = pConstModel->m_font_table.Count();
       break;
     case onxDimStyleTable:
-      pModel->m_dimstyle_table.Empty();
+      rc = pConstModel->m_dimstyle_table.Count();
       break;
     case onxHatchPatternTable:
-      pModel->m_hatch_pattern_table.Empty();
+      rc = pConstModel->m_hatch_pattern_table.Count();
       break;
     case onxIDefTable:
-      pModel->m_idef_table.Empty();
+      rc = pConstModel->m_idef_table.Count();
       break;
     case onxObjectTable:
-      pModel->m_object_table.Empty();
+      rc = pConstModel->m_object_table.Count();
       break;
     case onxHistoryRecordTable:
-      {
-        for( int i=0; i<pModel->m_history_record_table.Count(); i++ )
-        {
-          ON_HistoryRecord* pRecord = pModel->m_history_record_table[i];
-          if( pRecord )
-            delete pRecord;
-          pModel->m_history_record_table[i] = NULL;
-        }
-        pModel->m_history_record_table.Empty();
-      }
+      rc = pConstModel->m_history_record_table.Count();
       break;
     case onxUserDataTable:
-      pModel->m_userdata_table.Empty();
-      break;
-    }
-  }
-}
-
-
-RH_C_FUNCTION void ONX_Model_GetString( const ONX_Model* pConstModel, int which, CRhCmnStringHolder* pString )
-{
-  const int idxApplicationName = 0;
-  const int idxApplicationUrl = 1;
-  const int idxApplicationDetails = 2;
-  const int idxCreatedBy = 3;
-  const int idxLastCreatedBy = 4;
-
-  if( pConstModel && pString )
-  {
-    switch(which)
-    {
-    case idxApplicationName:
-      pString->Set( pConstModel->m_properties.m_Application.m_application_name );
-      break;
-    case idxApplicationUrl:
-      pString->Set( pConstModel->m_properties.m_Application.m_application_URL );
+      rc = pConstModel->m_userdata_table.Count();
       break;
-    case idxApplicationDetails:
-      pString->Set( pConstModel->m_properties.m_Application.m_application_details );
+    case onxViewTable:
+      rc = pConstModel->m_settings.m_views.Count();
       break;
-    case idxCreatedBy:
-      pString->Set( pConstModel->m_properties.m_RevisionHistory.m_sCreatedBy );
+    case onxNamedViewTable:
+      rc = pConstModel->m_settings.m_named_views.Count();
       break;
-    case idxLastCreatedBy:
-      pString->Set( pConstModel->m_properties.m_RevisionHistory.m_sLastEditedBy );
+    default:
       break;
     }
   }
+  return rc;
 }
 
-RH_C_FUNCTION void ONX_Model_SetString( ONX_Model* pModel, int which, const RHMONO_STRING* str )
-{
-  const int idxApplicationName = 0;
-  const int idxApplicationUrl = 1;
-  const int idxApplicationDetails = 2;
-  const int idxCreatedBy = 3;
-  const int idxLastCreatedBy = 4;
-  INPUTSTRINGCOERCE(_str, str);
-
-  if( pModel )
-  {
-    switch(which)
-    {
-    case idxApplicationName:
-      pModel->m_properties.m_Application.m_application_name = _str;
-      break;
-    case idxApplicationUrl:
-      pModel->m_properties.m_Application.m_application_URL = _str;
-      break;
-    case idxApplicationDetails:
-      pModel->m_properties.m_Application.m_application_details = _str;
-      break;
-    case idxCreatedBy:
-      pModel->m_properties.m_RevisionHistory.m_sCreatedBy = _str;
-      break;
-    case idxLastCreatedBy:
-      pModel->m_properties.m_RevisionHistory.m_sLastEditedBy = _str;
-      break;
-    }
+static void DumpModelTable(const ONX_Model& model, enum ONXModelTable which, ON_TextLog& log)
+{
+  switch(which)
+  {
+  case onxDumpAll:
+    model.Dump(log);
+    break;
+  case onxDumpSummary:
+    model.DumpSummary(log);
+    break;
+  case onxBitmapTable:
+    model.DumpBitmapTable(log);
+    break;
+  case onxTextureMappingTable:
+    model.DumpTextureMappingTable(log);
+    break;
+  case onxMaterialTable:
+    model.DumpMaterialTable(log);
+    break;
+  case onxLinetypeTable:
+    model.DumpLinetypeTable(log);
+    break;
+  case onxLayerTable:
+    model.DumpLayerTable(log);
+    break;
+  case onxLightTable:
+    model.DumpLightTable(log);
+    break;
+  case onxGroupTable:
+    model.DumpGroupTable(log);
+    break;
+  case onxFontTable:
+    model.DumpFontTable(log);
+    break;
+  case onxDimStyleTable:
+    model.DumpDimStyleTable(log);
+    break;
+  case onxHatchPatternTable:
+    model.DumpHatchPatternTable(log);
+    break;
+  case onxIDefTable:
+    model.DumpIDefTable(log);
+    break;
+  case onxObjectTable:
+    model.DumpObjectTable(log);
+    break;
+  case onxHistoryRecordTable:
+    model.DumpHistoryRecordTable(log);
+    break;
+  case onxUserDataTable:
+    model.DumpUserDataTable(log);
+    break;
+  default:
+    break;
   }
 }
 
-RH_C_FUNCTION int ONX_Model_GetRevision(const ONX_Model* pConstModel)
+RH_C_FUNCTION void ONX_Model_Dump(const ONX_Model* pConstModel, enum ONXModelTable which, CRhCmnStringHolder* pStringHolder)
 {
-  int rc = 0;
-  if( pConstModel )
-    rc = pConstModel->m_properties.m_RevisionHistory.m_revision_count;
-  return rc;
+  if( pConstModel && pStringHolder )
+  {
+    ON_wString s;
+    ON_TextLog log(s);
+    DumpModelTable(*pConstModel, which, log);
+    pStringHolder->Set(s);
+  }
 }
 
-RH_C_FUNCTION void ONX_Model_SetRevision(ONX_Model* pModel, int rev)
+RH_C_FUNCTION void ONX_Model_Dump2(const ONX_Model* pConstModel, ON_TextLog* pTextLog)
 {
-  if( pModel )
-    pModel->m_properties.m_RevisionHistory.m_revision_count = rev;
+  if( pConstModel && pTextLog )
+    pConstModel->Dump(*pTextLog);
 }
 
-RH_C_FUNCTION ON_3dmSettings* ONX_Model_3dmSettingsPointer(ONX_Model* pModel)
+// Same as ONX_Model_Dump but writes to pTextLog, which may be a streaming log
+// created with ON_TextLog_NewFileDescriptor or ON_TextLog_NewCallback.
+RH_C_FUNCTION void ONX_Model_Dump3(const ONX_Model* pConstModel, enum ONXModelTable which, ON_TextLog* pTextLog)
 {
-  ON_3dmSettings* rc = NULL;
-  if( pModel )
-    rc = &(pModel->m_settings);
-  return rc;
+  if( pConstModel && pTextLog )
+    DumpModelTable(*pConstModel, which, *pTextLog);
 }
 
-RH_C_FUNCTION ON_3dmView* ONX_Model_ViewPointer(ONX_Model* pModel, ON_UUID id, const ON_3dmView* pConstView, bool named_view_table)
+RH_C_FUNCTION const ON_Geometry* ONX_Model_ModelObjectGeometry(const ONX_Model* pConstModel, int index)
 {
-  ON_3dmView* rc = NULL;
-  if( pModel )
+  const ON_Geometry* rc = NULL;
+  if( pConstModel && index>=0 && index<pConstModel->m_object_table.Count() )
   {
-    ON_ClassArray<ON_3dmView>* views = named_view_table ? &(pModel->m_settings.m_named_views) : &(pModel->m_settings.m_views);
-    if( views )
-    {
-      for( int i=0; i<views->Count(); i++ )
-      {
-        ON_3dmView* pView = views->At(i);
-        if( pView && pView->m_vp.ViewportId() == id )
-        {
-          if( ::ON_UuidIsNil(id) && pConstView!=pView )
-            continue;
-          rc = pView;
-          break;
-        }
-      }
-    }
+    rc = ON_Geometry::Cast(pConstModel->m_object_table[index].m_object);
   }
   return rc;
 }
 
-RH_C_FUNCTION ON_3dmView* ONX_Model_ViewTable_Pointer(ONX_Model* pModel, int index, bool named_view_table)
+// The attributes are owned by the model. Code that edits the layer, material
+// or groups through this pointer must call
+// ONX_Model_ObjectTable_InvalidateKeyIndices afterwards.
+RH_C_FUNCTION const ON_3dmObjectAttributes* ONX_Model_ModelObjectAttributes(const ONX_Model* pConstModel, int index)
 {
-  ON_3dmView* pView = NULL;
-  if( pModel )
+  const ON_3dmObjectAttributes* rc = NULL;
+  if( pConstModel && index>=0 && index<pConstModel->m_object_table.Count() )
   {
-    pView = named_view_table ? pModel->m_settings.m_named_views.At(index) :
-                               pModel->m_settings.m_views.At(index);
+    rc = &(pConstModel->m_object_table[index].m_attributes);
   }
-  return pView;
+  return rc;
 }
 
-RH_C_FUNCTION ON_UUID ONX_Model_ViewTable_Id(const ONX_Model* pConstModel, int index, bool named_view_table)
+RH_C_FUNCTION bool ONX_Model_ObjectTable_LayerIndexTest(const ONX_Model* pConstModel, int objectIndex, int layerIndex)
 {
-  if( pConstModel )
+  bool rc = false;
+  if( pConstModel && objectIndex>=0 && objectIndex<pConstModel->m_object_table.Count() )
   {
-    const ON_3dmView* pView = named_view_table ? pConstModel->m_settings.m_named_views.At(index) :
-                                                 pConstModel->m_settings.m_views.At(index);
-    if( pView )
-      return pView->m_vp.ViewportId();
+    const ONX_Model_Object& obj = pConstModel->m_object_table[objectIndex];
+    rc = obj.m_attributes.m_layer_index == layerIndex;
   }
-  return ::ON_nil_uuid;
+  return rc;
 }
 
-RH_C_FUNCTION void ONX_Model_ViewTable_Clear(ONX_Model* pModel, bool named_view_table)
+// keyType: 0 = layer, 1 = material, 2 = group (see ObjectKeyType). The index
+// follows edits made through the C API; after editing object attributes in
+// place call ONX_Model_ObjectTable_InvalidateKeyIndices first.
+RH_C_FUNCTION int ONX_Model_ObjectTable_KeyObjectCount(const ONX_Model* pConstModel, int keyType, int key)
 {
-  if( pModel )
-  {
-    if( named_view_table )
-      pModel->m_settings.m_named_views.Empty();
-    else
-      pModel->m_settings.m_views.Empty();
-  }
+  int rc = 0;
+  if( pConstModel )
+    rc = ModelObjectKeyIndex(pConstModel, keyType, key, NULL);
+  return rc;
 }
 
-RH_C_FUNCTION int ONX_Model_ViewTable_Index(const ONX_Model* pConstModel, const ON_3dmView* pConstView, bool named_view_table)
+// Fills indices with the sorted table indices of every object on the layer,
+// material or group and returns how many there are. Same caveat as
+// ONX_Model_ObjectTable_KeyObjectCount about attributes edited in place.
+RH_C_FUNCTION int ONX_Model_ObjectTable_KeyObjects(const ONX_Model* pConstModel, int keyType, int key, ON_SimpleArray<int>* indices)
 {
-  int rc = -1;
-  if( pConstModel && pConstView )
-  {
-    const ON_ClassArray<ON_3dmView>* views = named_view_table ? &(pConstModel->m_settings.m_named_views) : &(pConstModel->m_settings.m_views);
-    if( views )
-    {
-      for( int i=0; i<views->Count(); i++ )
-      {
-        if( views->At(i) == pConstView )
-        {
-          rc = i;
-          break;
-        }
-      }
-    }
-  }
+  int rc = 0;
+  if( pConstModel && indices )
+    rc = ModelObjectKeyIndex(pConstModel, keyType, key, indices);
   return rc;
 }
 
-RH_C_FUNCTION void ONX_Model_ViewTable_Insert(ONX_Model* pModel, const ON_3dmView* pConstView, int index, bool named_view_table)
+// Object attributes edited in place are not seen by the layer, material and
+// group indices; call this to have them rebuilt on the next query.
+RH_C_FUNCTION void ONX_Model_ObjectTable_InvalidateKeyIndices(const ONX_Model* pConstModel)
 {
-  if( pModel && pConstView && index>=0)
+  CRhCmnModelState* state = GetModelState(pConstModel, false);
+  if( state )
   {
-    ON_ClassArray<ON_3dmView>* views = named_view_table ? &(pModel->m_settings.m_named_views) : &(pModel->m_settings.m_views);
-    if( views )
-    {
-      views->Insert(index, *pConstView);
-    }
+    state->m_index_lock.Enter();
+    for( int i = 0; i < oktCount; i++ )
+      state->m_key_indices[i].Invalidate();
+    state->m_index_lock.Leave();
   }
 }
 
-RH_C_FUNCTION void ONX_Model_ViewTable_RemoveAt(ONX_Model* pModel, int index, bool named_view_table)
+RH_C_FUNCTION ON_UUID ONX_Model_ObjectTable_AddPoint(ONX_Model* pModel, ON_3DPOINT_STRUCT point, const ON_3dmObjectAttributes* pConstAttributes)
 {
-  if( pModel && index>=0)
+  if( pModel )
   {
-    ON_ClassArray<ON_3dmView>* views = named_view_table ? &(pModel->m_settings.m_named_views) : &(pModel->m_settings.m_views);
-    if( views )
-      views->Remove(index);
+    ONX_Model_Object mo;
+    if( pConstAttributes )
+      mo.m_attributes = *pConstAttributes;
+    mo.m_object = new ON_Point(point.val[0], point.val[1], point.val[2]);
+    ::ON_CreateUuid(mo.m_attributes.m_uuid);
+    AppendModelObject(pModel, mo);
+    return mo.m_attributes.m_uuid;
   }
+  return ::ON_nil_uuid;
 }
 
-RH_C_FUNCTION ON_UUID ONX_Model_UserDataTable_Uuid(const ONX_Model* pConstModel, int index)
+RH_C_FUNCTION ON_UUID ONX_Model_ObjectTable_AddPointCloud(ONX_Model* pModel, int count, /*ARRAY*/const ON_3dPoint* points, const ON_3dmObjectAttributes* pConstAttributes)
 {
-  if( pConstModel )
+  if( pModel && count>0 && points )
   {
-    const ONX_Model_UserData* pUD = pConstModel->m_userdata_table.At(index);
-    if( pUD )
-      return pUD->m_uuid;
+    ONX_Model_Object mo;
+    if( pConstAttributes )
+      mo.m_attributes = *pConstAttributes;
+    ON_PointCloud* pCloud = new ON_PointCloud();
+    pCloud->m_P.Append(count, points);
+    mo.m_object = pCloud;
+    ::ON_CreateUuid(mo.m_attributes.m_uuid);
+    AppendModelObject(pModel, mo);
+    return mo.m_attributes.m_uuid;
   }
   return ::ON_nil_uuid;
 }
 
-RH_C_FUNCTION void ONX_Model_UserDataTable_Clear(ONX_Model* pModel)
+RH_C_FUNCTION ON_UUID ONX_Model_ObjectTable_AddPointCloud2(ONX_Model* pModel, const ON_PointCloud* pConstPointCloud, const ON_3dmObjectAttributes* pConstAttributes)
 {
-  if( pModel )
-    pModel->m_userdata_table.Empty();
+  if( pModel && pConstPointCloud )
+  {
+    ONX_Model_Object mo;
+    if( pConstAttributes )
+      mo.m_attributes = *pConstAttributes;
+    mo.m_object = new ON_PointCloud(*pConstPointCloud);
+    ::ON_CreateUuid(mo.m_attributes.m_uuid);
+    AppendModelObject(pModel, mo);
+    return mo.m_attributes.m_uuid;
+  }
+  return ::ON_nil_uuid;
 }
 
-#if !defined(OPENNURBS_BUILD)
-RH_C_FUNCTION bool ONX_Model_ReadPreviewImage(const RHMONO_STRING* path, CRhinoDib* pRhinoDib)
+RH_C_FUNCTION ON_UUID ONX_Model_ObjectTable_AddClippingPlane(ONX_Model* pModel, const ON_PLANE_STRUCT* plane, double du, double dv, int count, /*ARRAY*/const ON_UUID* clippedViewportIds, const ON_3dmObjectAttributes* pConstAttributes)
 {
-  bool rc = false;
-  INPUTSTRINGCOERCE(_path, path);
-  if( NULL==pRhinoDib )
-    return false;
-
-  FILE* fp = ON::OpenFile( _path, L"rb" );
-  if( fp )
+  if( pModel && plane && du>0.0 && dv>0.0 && count>0 && clippedViewportIds )
   {
-    ON_BinaryFile file( ON::read3dm, fp);
-    int version = 0;
-    ON_String comments;
-    if( file.Read3dmStartSection( &version, comments ) )
+    ON_Plane temp = FromPlaneStruct(*plane);
+    if( temp.IsValid() )
     {
-      ON_3dmProperties prop;
-      if( file.Read3dmProperties(prop) )
-      {
-        BITMAPINFO* pBMI = prop.m_PreviewImage.m_bmi;
-        if( pBMI )
-        {
-          pRhinoDib->SetDib(pBMI, false);
-          rc = true;
-        }
+      ON_Interval domain0( 0.0, du );
+      ON_Interval domain1( 0.0, dv );
+
+      ON_PlaneSurface srf( temp );
+      srf.SetExtents( 0, domain0, true );
+      srf.SetExtents( 1, domain1, true );
+      srf.SetDomain( 0, domain0.Min(), domain0.Max() );
+      srf.SetDomain( 1, domain1.Min(), domain1.Max() );
+      if( srf.IsValid() )
+      {
+        ON_ClippingPlaneSurface* cps = new ON_ClippingPlaneSurface(srf);
+        for( int i=0; i<count; i++ )
+          cps->m_clipping_plane.m_viewport_ids.AddUuid(clippedViewportIds[i]);
+
+        ONX_Model_Object mo;
+        if( pConstAttributes )
+          mo.m_attributes = *pConstAttributes;
+        mo.m_object = cps;
+        ::ON_CreateUuid(mo.m_attributes.m_uuid);
+        AppendModelObject(pModel, mo);
+        return mo.m_attributes.m_uuid;
       }
     }
-    ON::CloseFile(fp);
   }
-  return rc;
+  return ::ON_nil_uuid;
 }
-#endif
 
-class CBinaryFileHelper : public ON_BinaryFile
+RH_C_FUNCTION ON_UUID ONX_Model_ObjectTable_AddLinearDimension( ONX_Model* pModel, const ON_LinearDimension2* pConstDimension, const ON_3dmObjectAttributes* pConstAttributes )
 {
-public:
-  CBinaryFileHelper(ON::archive_mode mode, FILE* fp)
-  : ON_BinaryFile(mode, fp)
+  if( pModel && pConstDimension )
   {
-    m_file_pointer = fp;
+    ONX_Model_Object mo;
+    if( pConstAttributes )
+      mo.m_attributes = *pConstAttributes;
+    mo.m_object = new ON_LinearDimension2(*pConstDimension);
+    ::ON_CreateUuid(mo.m_attributes.m_uuid);
+    AppendModelObject(pModel, mo);
+    return mo.m_attributes.m_uuid;
   }
+  return ::ON_nil_uuid;
+}
 
-  FILE* m_file_pointer;
-};
-
-RH_C_FUNCTION CBinaryFileHelper* ON_BinaryFile_Open(const RHMONO_STRING* path, int mode)
+RH_C_FUNCTION ON_UUID ONX_Model_ObjectTable_AddLine( ONX_Model* pModel, ON_3DPOINT_STRUCT pt0, ON_3DPOINT_STRUCT pt1, const ON_3dmObjectAttributes* pConstAttributes )
 {
-  // 22-Jan-2014 Dale Fugier, http://mcneel.myjetbrains.com/youtrack/issue/RH-23765
-
-  ON::archive_mode archive_mode = ON::ArchiveMode(mode);
-  if( archive_mode == ON::unknown_archive_mode )
-    return NULL;
-
-  INPUTSTRINGCOERCE(_path, path);
-
-  FILE* fp = 0;
-  if( archive_mode == ON::read || archive_mode == ON::read3dm )
-    fp = ON::OpenFile( _path, L"rb" );
-  else if( archive_mode == ON::write || archive_mode == ON::write3dm )
-    fp = ON::OpenFile( _path, L"wb" );
-  else
-    fp = ON::OpenFile( _path, L"r+b" );
-  
-  if( fp )
-    return new CBinaryFileHelper( archive_mode, fp );
-
-  return NULL;
+  if( pModel )
+  {
+    ONX_Model_Object mo;
+    if( pConstAttributes )
+      mo.m_attributes = *pConstAttributes;
+    ON_3dPoint _pt0(pt0.val);
+    ON_3dPoint _pt1(pt1.val);
+    mo.m_object = new ON_LineCurve(_pt0, _pt1);
+    ::ON_CreateUuid(mo.m_attributes.m_uuid);
+    AppendModelObject(pModel, mo);
+    return mo.m_attributes.m_uuid;
+  }
+  return ::ON_nil_uuid;
 }
 
-RH_C_FUNCTION void ON_BinaryFile_Close(CBinaryFileHelper* pBinaryFile)
+RH_C_FUNCTION ON_UUID ONX_Model_ObjectTable_AddPolyline( ONX_Model* pModel, int count, /*ARRAY*/const ON_3dPoint* points, const ON_3dmObjectAttributes* pConstAttributes )
 {
-  if( pBinaryFile )
+  if( pModel && count>0 && points )
   {
-    if( pBinaryFile->m_file_pointer )
-      ON::CloseFile(pBinaryFile->m_file_pointer);
-    delete pBinaryFile;
+    ONX_Model_Object mo;
+    if( pConstAttributes )
+      mo.m_attributes = *pConstAttributes;
+    ON_PolylineCurve* pC = new ON_PolylineCurve();
+    pC->m_pline.Append(count, points);
+    mo.m_object = pC;
+    ::ON_CreateUuid(mo.m_attributes.m_uuid);
+    AppendModelObject(pModel, mo);
+    return mo.m_attributes.m_uuid;
   }
+  return ::ON_nil_uuid;
 }
 
-
-
-
-
-class ONX_Model_WithFilter : public ONX_Model
+RH_C_FUNCTION ON_UUID ONX_Model_ObjectTable_AddArc(ONX_Model* pModel, ON_Arc* pArc, const ON_3dmObjectAttributes* pConstAttributes )
 {
-public:
-  bool FilteredRead( ON_BinaryArchive& archive, unsigned int table_filter, unsigned int model_object_type_filter, ON_TextLog* error_log );
+  if( pModel && pArc )
+  {
+    pArc->plane.UpdateEquation();
+    ONX_Model_Object mo;
+    if( pConstAttributes )
+      mo.m_attributes = *pConstAttributes;
+    ON_ArcCurve* pC = new ON_ArcCurve(*pArc);
+    mo.m_object = pC;
+    ::ON_CreateUuid(mo.m_attributes.m_uuid);
+    AppendModelObject(pModel, mo);
+    return mo.m_attributes.m_uuid;
+  }
+  return ::ON_nil_uuid;
+}
 
-  bool FilteredRead( const wchar_t* filename, unsigned int table_filter, unsigned int model_object_type_filter, ON_TextLog* error_log );
-};
+RH_C_FUNCTION ON_UUID ONX_Model_ObjectTable_AddCircle(ONX_Model* pModel, const ON_CIRCLE_STRUCT* pCircle, const ON_3dmObjectAttributes* pConstAttributes )
+{
+  if( pModel && pCircle )
+  {
+    ON_Circle circle = FromCircleStruct(*pCircle);
+    ONX_Model_Object mo;
+    if( pConstAttributes )
+      mo.m_attributes = *pConstAttributes;
+    ON_ArcCurve* pC = new ON_ArcCurve(circle);
+    mo.m_object = pC;
+    ::ON_CreateUuid(mo.m_attributes.m_uuid);
+    AppendModelObject(pModel, mo);
+    return mo.m_attributes.m_uuid;
+  }
+  return ::ON_nil_uuid;
+}
 
-static 
-bool CheckForCRCErrors( 
-          ON_BinaryArchive& archive, 
-          ONX_Model& model,
-          ON_TextLog* error_log,
-          const char* sSection
-          )
+RH_C_FUNCTION ON_UUID ONX_Model_ObjectTable_AddEllipse(ONX_Model* pModel, ON_Ellipse* pEllipse, const ON_3dmObjectAttributes* pConstAttributes)
 {
-  // returns true if new CRC errors are found
-  bool rc = false;
-  int new_crc_count = archive.BadCRCCount();
-  
-  if ( model.m_crc_error_count != new_crc_count ) 
+  if( pModel && pEllipse )
   {
-    if ( error_log )
+    pEllipse->plane.UpdateEquation();
+    ON_NurbsCurve* nc = new ON_NurbsCurve();
+    if(2 == pEllipse->GetNurbForm(*nc) )
     {
-      error_log->Print("ERROR: Corrupt %s. (CRC errors).\n",sSection);
-      error_log->Print("-- Attempting to continue.\n");
+      ONX_Model_Object mo;
+      if( pConstAttributes )
+        mo.m_attributes = *pConstAttributes;
+      mo.m_object = nc;
+      ::ON_CreateUuid(mo.m_attributes.m_uuid);
+      AppendModelObject(pModel, mo);
+      return mo.m_attributes.m_uuid;
     }
-    model.m_crc_error_count = new_crc_count;
-    rc = true;
+    // didn't work. delete the NurbsCurve
+    delete nc;
   }
-
-  return rc;
+  return ::ON_nil_uuid;
 }
 
-
-bool ONX_Model_WithFilter::FilteredRead(ON_BinaryArchive& archive, unsigned int table_filter, unsigned int model_object_type_filter, ON_TextLog* error_log )
+RH_C_FUNCTION ON_UUID ONX_Model_ObjectTable_AddSphere(ONX_Model* pModel, ON_Sphere* sphere, const ON_3dmObjectAttributes* pConstAttributes)
 {
-  const int max_error_count = 2000;
-  int error_count = 0;
-  bool return_code = true;
-  int count, rc;
-
-  Destroy(); // get rid of any residual stuff
-
-  // STEP 1: REQUIRED - Read start section
-  if ( !archive.Read3dmStartSection( &m_3dm_file_version, m_sStartSectionComments ) )
+  if( pModel && sphere )
   {
-    if ( error_log) error_log->Print("ERROR: Unable to read start section. (ON_BinaryArchive::Read3dmStartSection() returned false.)\n");
-    return false;
+    // make sure the plane equation is in-sync for this sphere
+    sphere->plane.UpdateEquation();
+    ON_RevSurface* pRevSurface = sphere->RevSurfaceForm(false);
+    if( pRevSurface )
+    {
+      ONX_Model_Object mo;
+      if( pConstAttributes )
+        mo.m_attributes = *pConstAttributes;
+      mo.m_object = pRevSurface;
+      ::ON_CreateUuid(mo.m_attributes.m_uuid);
+      AppendModelObject(pModel, mo);
+      return mo.m_attributes.m_uuid;
+    }
   }
-  else if ( CheckForCRCErrors( archive, *this, error_log, "start section" ) )
-    return_code = false;
+  return ::ON_nil_uuid;
+}
 
-  // STEP 2: REQUIRED - Read properties section
-  if ( !archive.Read3dmProperties( m_properties ) )
+RH_C_FUNCTION ON_UUID ONX_Model_ObjectTable_AddCurve(ONX_Model* pModel, const ON_Curve* pConstCurve, const ON_3dmObjectAttributes* pConstAttributes)
+{
+  if( pModel && pConstCurve )
   {
-    if ( error_log) error_log->Print("ERROR: Unable to read properties section. (ON_BinaryArchive::Read3dmProperties() returned false.)\n");
-    return false;
+    ON_Curve* pCurve = pConstCurve->DuplicateCurve();
+    if( pCurve )
+    {
+      ONX_Model_Object mo;
+      if( pConstAttributes )
+        mo.m_attributes = *pConstAttributes;
+      mo.m_object = pCurve;
+      ::ON_CreateUuid(mo.m_attributes.m_uuid);
+      AppendModelObject(pModel, mo);
+      return mo.m_attributes.m_uuid;
+    }
   }
-  else if ( CheckForCRCErrors( archive, *this, error_log, "properties section" ) )
-    return_code = false;
-
-  // version of opennurbs used to write the file.
-  m_3dm_opennurbs_version = archive.ArchiveOpenNURBSVersion();
+  return ::ON_nil_uuid;
+}
 
-  // STEP 3: REQUIRED - Read properties section
-  if ( !archive.Read3dmSettings( m_settings ) )
+RH_C_FUNCTION ON_UUID ONX_Model_ObjectTable_AddTextDot(ONX_Model* pModel, const ON_TextDot* pConstDot, const ON_3dmObjectAttributes* pConstAttributes)
+{
+  if( pModel && pConstDot )
   {
-    if ( error_log) error_log->Print("ERROR: Unable to read settings section. (ON_BinaryArchive::Read3dmSettings() returned false.)\n");
-    return false;
+    ON_TextDot* pDot = pConstDot->Duplicate();
+    if( pDot )
+    {
+      ONX_Model_Object mo;
+      if( pConstAttributes )
+        mo.m_attributes = *pConstAttributes;
+      mo.m_object = pDot;
+      ::ON_CreateUuid(mo.m_attributes.m_uuid);
+      AppendModelObject(pModel, mo);
+      return mo.m_attributes.m_uuid;
+    }
   }
-  else if ( CheckForCRCErrors( archive, *this, error_log, "settings section" ) )
-    return_code = false;
+  return ::ON_nil_uuid;
+}
 
-  // STEP 4: REQUIRED - Read embedded bitmap table
-  if ( archive.BeginRead3dmBitmapTable() )
+RH_C_FUNCTION ON_UUID ONX_Model_ObjectTable_AddText(ONX_Model* pModel, const RHMONO_STRING* _text, const ON_PLANE_STRUCT* plane, double height, const RHMONO_STRING* _fontName, int fontStyle, int justification, const ON_3dmObjectAttributes* pConstAttributes)
+{
+  INPUTSTRINGCOERCE(text, _text);
+  INPUTSTRINGCOERCE(fontName, _fontName);
+  if( pModel && plane && text && text[0]!=0 )
   {
-    // At the moment no bitmaps are embedded so this table is empty
-    ON_Bitmap* pBitmap = NULL;
-    for( count = 0; true; count++ ) 
+    ON_Plane temp = FromPlaneStruct(*plane);
+    if( temp.IsValid() )
     {
-      pBitmap = NULL;
-      rc = archive.Read3dmBitmap(&pBitmap);
-      if ( rc==0 )
-        break; // end of bitmap table
-      if ( rc < 0 ) 
-      {
-        if ( error_log) 
+      if( height <= 0.0 )
+        height = 1.0;
+      bool bBold = (0!=(fontStyle&1));
+      bool bItalic = (0!=(fontStyle&2));
+
+      ON_wString font_str( fontName );
+      font_str.TrimLeftAndRight();
+      if( font_str.IsEmpty() )
+        font_str = L"Arial";
+
+      int font_index = -1;
+      for( int i=0; i<pModel->m_font_table.Count(); i++ )
+      {
+        const ON_Font& fnt = pModel->m_font_table[i];
+        if( fnt.IsItalic()==bItalic && fnt.IsBold()==bBold && font_str.Compare(fnt.m_facename)==0 )
+        {
+          font_index = i;
+          break;
+        }
+      }
+      if( -1==font_index )
+      {
+        // create a new font and add it to the font table
+        ON_Font fnt;
+        fnt.SetBold(bBold);
+        fnt.SetIsItalic(bItalic);
+        fnt.SetFontFaceName(font_str);
+        ON_wString fontname(font_str);
+        if(bBold)
+          fontname += L" Bold";
+        if(bItalic)
+          fontname += L" Italic";
+        fnt.SetFontName(fontname);
+        fnt.SetFontIndex( pModel->m_font_table.Count() );
+        pModel->m_font_table.Append(fnt);
+        font_index = fnt.FontIndex();
+      }
+      
+
+      ON_TextEntity2* text_entity = new ON_TextEntity2();
+      text_entity->SetHeight( height );
+      text_entity->SetTextValue( text );
+      text_entity->SetTextFormula( 0 );
+      text_entity->SetPlane( temp );
+      text_entity->SetFontIndex( font_index );
+      if( justification>0 )
+        text_entity->SetJustification((unsigned int)justification);
+
+      ONX_Model_Object mo;
+      if( pConstAttributes )
+        mo.m_attributes = *pConstAttributes;
+      mo.m_object = text_entity;
+      ::ON_CreateUuid(mo.m_attributes.m_uuid);
+      AppendModelObject(pModel, mo);
+      return mo.m_attributes.m_uuid;
+    }
+  }
+  return ::ON_nil_uuid;
+}
+
+RH_C_FUNCTION ON_UUID ONX_Model_ObjectTable_AddSurface(ONX_Model* pModel, const ON_Surface* pConstSurface, const ON_3dmObjectAttributes* pConstAttributes)
+{
+  if( pModel && pConstSurface )
+  {
+    ON_Surface* pSurface = pConstSurface->Duplicate();
+    if( pSurface )
+    {
+      ONX_Model_Object mo;
+      if( pConstAttributes )
+        mo.m_attributes = *pConstAttributes;
+      mo.m_object = pSurface;
+      ::ON_CreateUuid(mo.m_attributes.m_uuid);
+      AppendModelObject(pModel, mo);
+      return mo.m_attributes.m_uuid;
+    }
+  }
+  return ::ON_nil_uuid;
+}
+
+RH_C_FUNCTION ON_UUID ONX_Model_ObjectTable_AddExtrusion(ONX_Model* pModel, const ON_Extrusion* pConstExtrusion, const ON_3dmObjectAttributes* pConstAttributes)
+{
+  if( pModel && pConstExtrusion )
+  {
+    ON_Surface* pExtrusion = pConstExtrusion->Duplicate();
+    if( pExtrusion )
+    {
+      ONX_Model_Object mo;
+      if( pConstAttributes )
+        mo.m_attributes = *pConstAttributes;
+      mo.m_object = pExtrusion;
+      ::ON_CreateUuid(mo.m_attributes.m_uuid);
+      AppendModelObject(pModel, mo);
+      return mo.m_attributes.m_uuid;
+    }
+  }
+  return ::ON_nil_uuid;
+}
+
+RH_C_FUNCTION ON_UUID ONX_Model_ObjectTable_AddMesh(ONX_Model* pModel, const ON_Mesh* pConstMesh, const ON_3dmObjectAttributes* pConstAttributes)
+{
+  if( pModel && pConstMesh )
+  {
+    ON_Mesh* pMesh = pConstMesh->Duplicate();
+    if( pMesh )
+    {
+      ONX_Model_Object mo;
+      if( pConstAttributes )
+        mo.m_attributes = *pConstAttributes;
+      mo.m_object = pMesh;
+      ::ON_CreateUuid(mo.m_attributes.m_uuid);
+      AppendModelObject(pModel, mo);
+      return mo.m_attributes.m_uuid;
+    }
+  }
+  return ::ON_nil_uuid;
+}
+
+RH_C_FUNCTION ON_UUID ONX_Model_ObjectTable_AddBrep(ONX_Model* pModel, const ON_Brep* pConstBrep, const ON_3dmObjectAttributes* pConstAttributes)
+{
+  if( pModel && pConstBrep )
+  {
+    ON_Brep* pBrep = pConstBrep->Duplicate();
+    if( pBrep )
+    {
+      ONX_Model_Object mo;
+      if( pConstAttributes )
+        mo.m_attributes = *pConstAttributes;
+      mo.m_object = pBrep;
+      ::ON_CreateUuid(mo.m_attributes.m_uuid);
+      AppendModelObject(pModel, mo);
+      return mo.m_attributes.m_uuid;
+    }
+  }
+  return ::ON_nil_uuid;
+}
+
+RH_C_FUNCTION ON_UUID ONX_Model_ObjectTable_AddLeader(ONX_Model* pModel, const RHMONO_STRING* _text, const ON_PLANE_STRUCT* plane, int count, /*ARRAY*/const ON_2dPoint* points2d, const ON_3dmObjectAttributes* pConstAttributes)
+{
+  INPUTSTRINGCOERCE(text, _text);
+  if( pModel && plane && count>1 && points2d )
+  {
+    ON_Leader2* leader = new ON_Leader2();
+
+    ON_Plane temp = FromPlaneStruct(*plane);
+    leader->SetPlane(temp);
+    for( int i=0; i<count; i++ )
+      leader->m_points.Append(points2d[i]);
+
+    leader->SetTextValue(text);
+
+    ONX_Model_Object mo;
+    if( pConstAttributes )
+      mo.m_attributes = *pConstAttributes;
+    mo.m_object = leader;
+    ::ON_CreateUuid(mo.m_attributes.m_uuid);
+    AppendModelObject(pModel, mo);
+    return mo.m_attributes.m_uuid;
+  }
+  return ::ON_nil_uuid;
+}
+
+RH_C_FUNCTION ON_UUID ONX_Model_ObjectTable_AddHatch(ONX_Model* pModel, const ON_Hatch* pConstHatch, const ON_3dmObjectAttributes* pConstAttributes)
+{
+  if( pModel && pConstHatch )
+  {
+    ON_Hatch* pHatch = pConstHatch->Duplicate();
+    if( pHatch )
+    {
+      ONX_Model_Object mo;
+      if( pConstAttributes )
+        mo.m_attributes = *pConstAttributes;
+      mo.m_object = pHatch;
+      ::ON_CreateUuid(mo.m_attributes.m_uuid);
+      AppendModelObject(pModel, mo);
+      return mo.m_attributes.m_uuid;
+    }
+  }
+  return ::ON_nil_uuid;
+}
+
+RH_C_FUNCTION ON_UUID ONX_Model_ObjectTable_AddPolyLine(ONX_Model* pModel, int count, /*ARRAY*/const ON_3dPoint* points, const ON_3dmObjectAttributes* pConstAttributes)
+{
+  if( pModel && points && count>1)
+  {
+    CHack3dPointArray pl(count, (ON_3dPoint*)points);
+
+    ON_PolylineCurve* pCurve = new ON_PolylineCurve(pl);
+    ONX_Model_Object mo;
+    if( pConstAttributes )
+      mo.m_attributes = *pConstAttributes;
+    mo.m_object = pCurve;
+    ::ON_CreateUuid(mo.m_attributes.m_uuid);
+    AppendModelObject(pModel, mo);
+    return mo.m_attributes.m_uuid;
+  }
+  return ::ON_nil_uuid;
+}
+
+/*
+Description:
+  Shared part of the ObjectTable_Add*s batch functions. Reserves room for
+  count objects, then for each i calls create(i, context) and appends the
+  result in place. pAttributes is NULL or holds 0 (defaults), 1 (shared by
+  every object) or count pointers. ids, when not NULL, receives count
+  uuids, nil for items create rejected. Returns the number of objects
+  added.
+*/
+typedef ON_Object* (*ADDOBJECTSPROC)(int index, const void* context);
+
+static int AddModelObjects(ONX_Model* pModel, int count, ADDOBJECTSPROC create, const void* context, const ON_SimpleArray<const ON_3dmObjectAttributes*>* pAttributes, ON_UUID* ids)
+{
+  if( NULL == pModel || count < 1 )
+    return 0;
+  const int attributeCount = pAttributes ? pAttributes->Count() : 0;
+  if( attributeCount != 0 && attributeCount != 1 && attributeCount != count )
+    return 0;
+
+  int rc = 0;
+  CRhCmnModelState* state = GetModelState(pModel, false);
+  pModel->m_object_table.Reserve(pModel->m_object_table.Count() + count);
+  for( int i = 0; i < count; i++ )
+  {
+    if( ids )
+      ids[i] = ON_nil_uuid;
+    ON_Object* pObject = create(i, context);
+    if( NULL == pObject )
+      continue;
+    // construct in place rather than copying a local ONX_Model_Object
+    ONX_Model_Object& mo = pModel->m_object_table.AppendNew();
+    const ON_3dmObjectAttributes* pConstAttributes = NULL;
+    if( 1 == attributeCount )
+      pConstAttributes = (*pAttributes)[0];
+    else if( attributeCount > 1 )
+      pConstAttributes = (*pAttributes)[i];
+    if( pConstAttributes )
+      mo.m_attributes = *pConstAttributes;
+    mo.m_object = pObject;
+    ::ON_CreateUuid(mo.m_attributes.m_uuid);
+    ModelObjectAppended(state, pModel);
+    if( ids )
+      ids[i] = mo.m_attributes.m_uuid;
+    rc++;
+  }
+  return rc;
+}
+
+static ON_Object* CreatePointAt(int index, const void* context)
+{
+  const ON_3dPoint* points = (const ON_3dPoint*)context;
+  return new ON_Point(points[index]);
+}
+
+static ON_Object* CreateLineAt(int index, const void* context)
+{
+  const ON_3dPoint* points = (const ON_3dPoint*)context;
+  return new ON_LineCurve(points[2*index], points[2*index+1]);
+}
+
+struct AddPolylinesContext
+{
+  const int* m_offsets;
+  const ON_3dPoint* m_points;
+};
+
+static ON_Object* CreatePolylineAt(int index, const void* context)
+{
+  const AddPolylinesContext* ctx = (const AddPolylinesContext*)context;
+  const int start = ctx->m_offsets[index];
+  const int count = ctx->m_offsets[index+1] - start;
+  if( start < 0 || count < 2 )
+    return NULL;
+  ON_PolylineCurve* pCurve = new ON_PolylineCurve();
+  pCurve->m_pline.Append(count, ctx->m_points + start);
+  return pCurve;
+}
+
+static ON_Object* CreateMeshAt(int index, const void* context)
+{
+  const ON_SimpleArray<ON_Mesh*>* meshes = (const ON_SimpleArray<ON_Mesh*>*)context;
+  const ON_Mesh* pConstMesh = (*meshes)[index];
+  return pConstMesh ? pConstMesh->Duplicate() : NULL;
+}
+
+RH_C_FUNCTION int ONX_Model_ObjectTable_AddPoints(ONX_Model* pModel, int count, /*ARRAY*/const ON_3dPoint* points, const ON_SimpleArray<const ON_3dmObjectAttributes*>* pAttributes, /*ARRAY*/ON_UUID* ids)
+{
+  int rc = 0;
+  if( pModel && count>0 && points )
+    rc = AddModelObjects(pModel, count, CreatePointAt, points, pAttributes, ids);
+  return rc;
+}
+
+// endpoints holds 2*count points, start and end of each line
+RH_C_FUNCTION int ONX_Model_ObjectTable_AddLines(ONX_Model* pModel, int count, /*ARRAY*/const ON_3dPoint* endpoints, const ON_SimpleArray<const ON_3dmObjectAttributes*>* pAttributes, /*ARRAY*/ON_UUID* ids)
+{
+  int rc = 0;
+  if( pModel && count>0 && endpoints )
+    rc = AddModelObjects(pModel, count, CreateLineAt, endpoints, pAttributes, ids);
+  return rc;
+}
+
+// Polyline i is points[offsets[i]] through points[offsets[i+1]-1], so
+// offsets holds count+1 entries. Polylines with fewer than two points are
+// skipped and get a nil id.
+RH_C_FUNCTION int ONX_Model_ObjectTable_AddPolylines(ONX_Model* pModel, int count, /*ARRAY*/const int* offsets, /*ARRAY*/const ON_3dPoint* points, const ON_SimpleArray<const ON_3dmObjectAttributes*>* pAttributes, /*ARRAY*/ON_UUID* ids)
+{
+  int rc = 0;
+  if( pModel && count>0 && offsets && points )
+  {
+    AddPolylinesContext ctx;
+    ctx.m_offsets = offsets;
+    ctx.m_points = points;
+    rc = AddModelObjects(pModel, count, CreatePolylineAt, &ctx, pAttributes, ids);
+  }
+  return rc;
+}
+
+// Adds copies of the meshes. ids, when not NULL, holds one entry per mesh.
+RH_C_FUNCTION int ONX_Model_ObjectTable_AddMeshes(ONX_Model* pModel, const ON_SimpleArray<ON_Mesh*>* pConstMeshes, const ON_SimpleArray<const ON_3dmObjectAttributes*>* pAttributes, /*ARRAY*/ON_UUID* ids)
+{
+  int rc = 0;
+  if( pModel && pConstMeshes && pConstMeshes->Count()>0 )
+    rc = AddModelObjects(pModel, pConstMeshes->Count(), CreateMeshAt, pConstMeshes, pAttributes, ids);
+  return rc;
+}
+
+RH_C_FUNCTION bool ONX_Model_ObjectTable_Delete(ONX_Model* pModel, ON_UUID object_id)
+{
+  bool rc = false;
+  if( pModel )
+  {
+    int index = ModelIdTableIndex(pModel, mitObjectTable, object_id);
+    if( index >= 0 )
+    {
+      pModel->m_object_table.Remove(index);
+      ModelObjectDeleted(pModel, object_id, index);
+      rc = true;
+    }
+  }
+  return rc;
+}
+
+// Union of the object bounding boxes. Boxes are cached per object, so only
+// objects added since the previous call are measured.
+RH_C_FUNCTION void ONX_Model_BoundingBox(const ONX_Model* pConstModel, ON_BoundingBox* pBBox)
+{
+  if( pConstModel && pBBox )
+  {
+    CRhCmnModelState* state = LockObjectBoxCache(pConstModel, 0);
+    if( state )
+    {
+      *pBBox = state->m_boxes.m_union;
+      state->m_index_lock.Leave();
+    }
+  }
+}
+
+// Copies the bounding box of the first count objects into boxes as
+// min x,y,z, max x,y,z. Objects that are not geometry get an unset box.
+// Returns the number of boxes copied.
+RH_C_FUNCTION int ONX_Model_ObjectTable_BoundingBoxes(const ONX_Model* pConstModel, int count, /*ARRAY*/double* boxes, int maxThreads)
+{
+  int rc = 0;
+  if( pConstModel && count>0 && boxes )
+  {
+    CRhCmnModelState* state = LockObjectBoxCache(pConstModel, maxThreads);
+    if( state )
+    {
+      const ON_SimpleArray<ON_BoundingBox>& cached = state->m_boxes.m_boxes;
+      rc = cached.Count() < count ? cached.Count() : count;
+      for( int i=0; i<rc; i++ )
+      {
+        const ON_BoundingBox& bbox = cached[i];
+        double* b = boxes + 6*i;
+        b[0] = bbox.m_min.x; b[1] = bbox.m_min.y; b[2] = bbox.m_min.z;
+        b[3] = bbox.m_max.x; b[4] = bbox.m_max.y; b[5] = bbox.m_max.z;
+      }
+      state->m_index_lock.Leave();
+    }
+  }
+  return rc;
+}
+
+// Objects whose geometry was changed in place keep their old box until this
+// is called
+RH_C_FUNCTION void ONX_Model_ObjectTable_InvalidateBoundingBoxes(const ONX_Model* pConstModel)
+{
+  CRhCmnModelState* state = GetModelState(pConstModel, false);
+  if( state )
+  {
+    state->m_index_lock.Enter();
+    state->m_boxes.Invalidate();
+    state->m_index_lock.Leave();
+  }
+}
+
+RH_C_FUNCTION ON_Linetype* ONX_Model_GetLinetypePointer(ONX_Model* pModel, ON_UUID id)
+{
+  ON_Linetype* rc = NULL;
+  if( pModel )
+  {
+    int index = ModelIdTableIndex(pModel, mitLinetypeTable, id);
+    if( index >= 0 )
+      rc = &(pModel->m_linetype_table[index]);
+  }
+  return rc;
+}
+
+RH_C_FUNCTION ON_Bitmap* ONX_Model_GetBitmapPointer(ONX_Model* pModel, int index)
+{
+  ON_Bitmap* rc = NULL;
+  if( pModel && index >= 0 && index < pModel->m_bitmap_table.Count())
+    rc = pModel->m_bitmap_table[index];
+  return rc;
+}
+
+RH_C_FUNCTION ON_Layer* ONX_Model_GetLayerPointer(ONX_Model* pModel, ON_UUID id)
+{
+  ON_Layer* rc = NULL;
+  if( pModel )
+  {
+    int index = ModelIdTableIndex(pModel, mitLayerTable, id);
+    if( index >= 0 )
+      rc = &(pModel->m_layer_table[index]);
+  }
+  return rc;
+}
+
+RH_C_FUNCTION ON_DimStyle* ONX_Model_GetDimStylePointer(ONX_Model* pModel, ON_UUID id)
+{
+  ON_DimStyle* rc = NULL;
+  if( pModel )
+  {
+    int index = ModelIdTableIndex(pModel, mitDimstyleTable, id);
+    if( index >= 0 )
+      rc = &(pModel->m_dimstyle_table[index]);
+  }
+  return rc;
+}
+
+RH_C_FUNCTION ON_HatchPattern* ONX_Model_GetHatchPatternPointer(ONX_Model* pModel, ON_UUID id)
+{
+  ON_HatchPattern* rc = NULL;
+  if( pModel )
+  {
+    int index = ModelIdTableIndex(pModel, mitHatchpatternTable, id);
+    if( index >= 0 )
+      rc = &(pModel->m_hatch_pattern_table[index]);
+  }
+  return rc;
+}
+
+RH_C_FUNCTION ON_Material* ONX_Model_GetMaterialPointer(ONX_Model* pModel, ON_UUID id)
+{
+  ON_Material* rc = NULL;
+  if( pModel )
+  {
+    int index = ModelIdTableIndex(pModel, mitMaterialTable, id);
+    if( index >= 0 )
+      rc = &(pModel->m_material_table[index]);
+  }
+  return rc;
+}
+
+RH_C_FUNCTION void ONX_Model_LinetypeTable_Insert(ONX_Model* pModel, const ON_Linetype* pConstLinetype, int index)
+{
+  if( pModel && pConstLinetype && index>=0)
+  {
+    pModel->m_linetype_table.Insert(index, *pConstLinetype);
+    // update indices
+    for( int i=index; i<pModel->m_linetype_table.Count(); i++ )
+      pModel->m_linetype_table[i].m_linetype_index = i;
+    ModelTableChanged(pModel, ttfLinetypeTable);
+  }
+}
+
+RH_C_FUNCTION void ONX_Model_LayerTable_Insert(ONX_Model* pModel, const ON_Layer* pConstLayer, int index)
+{
+  if( pModel && pConstLayer && index>=0)
+  {
+    pModel->m_layer_table.Insert(index, *pConstLayer);
+    // update layer indices
+    for( int i=index; i<pModel->m_layer_table.Count(); i++ )
+      pModel->m_layer_table[i].m_layer_index = i;
+    ModelTableChanged(pModel, ttfLayerTable);
+  }
+}
+
+RH_C_FUNCTION void ONX_Model_DimStyleTable_Insert(ONX_Model* pModel, const ON_DimStyle* pConstDimStyle, int index)
+{
+  if( pModel && pConstDimStyle && index>=0)
+  {
+    pModel->m_dimstyle_table.Insert(index, *pConstDimStyle);
+    // update indices
+    for( int i=index; i<pModel->m_dimstyle_table.Count(); i++ )
+      pModel->m_dimstyle_table[i].m_dimstyle_index = i;
+    ModelTableChanged(pModel, ttfDimstyleTable);
+  }
+}
+
+RH_C_FUNCTION void ONX_Model_HatchPatternTable_Insert(ONX_Model* pModel, const ON_HatchPattern* pConstHatchPattern, int index)
+{
+  if( pModel && pConstHatchPattern && index>=0)
+  {
+    pModel->m_hatch_pattern_table.Insert(index, *pConstHatchPattern);
+    // update indices
+    for( int i=index; i<pModel->m_hatch_pattern_table.Count(); i++ )
+      pModel->m_hatch_pattern_table[i].m_hatchpattern_index = i;
+    ModelTableChanged(pModel, ttfHatchpatternTable);
+  }
+}
+
+RH_C_FUNCTION void ONX_Model_InstanceDefinitionTable_Insert(ONX_Model* pModel, const ON_InstanceDefinition* pConstInstanceDefinition, int index)
+{
+  if( pModel && pConstInstanceDefinition && index>=0 )
+  {
+    pModel->m_idef_table.Insert(index, *pConstInstanceDefinition);
+    ModelTableChanged(pModel, ttfInstanceDefinitionTable);
+  }
+}
+
+RH_C_FUNCTION void ONX_Model_MaterialTable_Insert(ONX_Model* pModel, const ON_Material* pConstMaterial, int index)
+{
+  if( pModel && pConstMaterial && index>=0)
+  {
+    pModel->m_material_table.Insert(index, *pConstMaterial);
+    // update indices
+    for( int i=index; i<pModel->m_material_table.Count(); i++ )
+      pModel->m_material_table[i].m_material_index = i;
+    ModelTableChanged(pModel, ttfMaterialTable);
+  }
+}
+
+RH_C_FUNCTION void ONX_Model_LinetypeTable_RemoveAt(ONX_Model* pModel, int index)
+{
+  if( pModel && index>=0)
+  {
+    pModel->m_linetype_table.Remove(index);
+    // update indices
+    for( int i=index; i<pModel->m_linetype_table.Count(); i++ )
+      pModel->m_linetype_table[i].m_linetype_index = i;
+    ModelTableChanged(pModel, ttfLinetypeTable);
+  }
+}
+
+RH_C_FUNCTION void ONX_Model_LayerTable_RemoveAt(ONX_Model* pModel, int index)
+{
+  if( pModel && index>=0)
+  {
+    pModel->m_layer_table.Remove(index);
+    // update indices
+    for( int i=index; i<pModel->m_layer_table.Count(); i++ )
+      pModel->m_layer_table[i].m_layer_index = i;
+    ModelTableChanged(pModel, ttfLayerTable);
+  }
+}
+
+RH_C_FUNCTION void ONX_Model_DimStyleTable_RemoveAt(ONX_Model* pModel, int index)
+{
+  if( pModel && index>=0)
+  {
+    pModel->m_dimstyle_table.Remove(index);
+    // update indices
+    for( int i=index; i<pModel->m_dimstyle_table.Count(); i++ )
+      pModel->m_dimstyle_table[i].m_dimstyle_index = i;
+    ModelTableChanged(pModel, ttfDimstyleTable);
+  }
+}
+
+RH_C_FUNCTION void ONX_Model_HatchPatternTable_RemoveAt(ONX_Model* pModel, int index)
+{
+  if( pModel && index>=0)
+  {
+    pModel->m_hatch_pattern_table.Remove(index);
+    // update indices
+    for( int i=index; i<pModel->m_hatch_pattern_table.Count(); i++ )
+      pModel->m_hatch_pattern_table[i].m_hatchpattern_index = i;
+    ModelTableChanged(pModel, ttfHatchpatternTable);
+  }
+}
+
+RH_C_FUNCTION void ONX_Model_InstanceDefinitionTable_RemoveAt(ONX_Model* pModel, int index)
+{
+  if( pModel && index>=0)
+  {
+    pModel->m_idef_table.Remove(index);
+    ModelTableChanged(pModel, ttfInstanceDefinitionTable);
+  }
+}
+
+RH_C_FUNCTION void ONX_Model_MaterialTable_RemoveAt(ONX_Model* pModel, int index)
+{
+  if( pModel && index>=0)
+  {
+    pModel->m_material_table.Remove(index);
+    // update indices
+    for( int i=index; i<pModel->m_material_table.Count(); i++ )
+      pModel->m_material_table[i].m_material_index = i;
+    ModelTableChanged(pModel, ttfMaterialTable);
+  }
+}
+
+RH_C_FUNCTION ON_UUID ONX_Model_LinetypeTable_Id(const ONX_Model* pConstModel, int index)
+{
+  if( pConstModel && index>=0 && index<pConstModel->m_linetype_table.Count())
+  {
+    return pConstModel->m_linetype_table[index].m_linetype_id;
+  }
+  return ::ON_nil_uuid;
+}
+
+RH_C_FUNCTION ON_UUID ONX_Model_LayerTable_Id(const ONX_Model* pConstModel, int index)
+{
+  if( pConstModel && index>=0 && index<pConstModel->m_layer_table.Count())
+  {
+    return pConstModel->m_layer_table[index].m_layer_id;
+  }
+  return ::ON_nil_uuid;
+}
+
+RH_C_FUNCTION ON_UUID ONX_Model_DimStyleTable_Id(const ONX_Model* pConstModel, int index)
+{
+  if( pConstModel && index>=0 && index<pConstModel->m_dimstyle_table.Count())
+  {
+    return pConstModel->m_dimstyle_table[index].m_dimstyle_id;
+  }
+  return ::ON_nil_uuid;
+}
+
+RH_C_FUNCTION ON_UUID ONX_Model_HatchPatternTable_Id(const ONX_Model* pConstModel, int index)
+{
+  if( pConstModel && index>=0 && index<pConstModel->m_hatch_pattern_table.Count())
+  {
+    return pConstModel->m_hatch_pattern_table[index].m_hatchpattern_id;
+  }
+  return ::ON_nil_uuid;
+}
+
+RH_C_FUNCTION ON_UUID ONX_Model_InstanceDefinitionTable_Id(const ONX_Model* pConstModel, int index)
+{
+  if( pConstModel && index>=0 && index<pConstModel->m_idef_table.Count())
+  {
+    return pConstModel->m_idef_table[index].m_uuid;
+  }
+  return ::ON_nil_uuid;
+}
+
+RH_C_FUNCTION int ONX_Model_InstanceDefinitionTable_Index(const ONX_Model* pConstModel, ON_UUID id)
+{
+  if( pConstModel )
+    return ModelIdTableIndex(pConstModel, mitInstanceDefinitionTable, id);
+  return -1;
+}
+
+RH_C_FUNCTION const ON_InstanceDefinition* ONX_Model_GetInstanceDefinitionPointer(const ONX_Model* pConstModel, ON_UUID id)
+{
+  if( pConstModel )
+  {
+    int index = ModelIdTableIndex(pConstModel, mitInstanceDefinitionTable, id);
+    if( index >= 0 )
+      return pConstModel->m_idef_table.At(index);
+  }
+  return NULL;
+}
+
+// Resolves count ids against one table in a single call. indices receives
+// -1 for ids that are not found. Returns the number found.
+RH_C_FUNCTION int ONX_Model_ResolveIds(const ONX_Model* pConstModel, enum ModelIdTable table, int count, /*ARRAY*/const ON_UUID* ids, /*ARRAY*/int* indices)
+{
+  int rc = 0;
+  if( pConstModel && count>0 && ids && indices )
+    rc = ModelIdTableIndices(pConstModel, (int)table, count, ids, indices);
+  return rc;
+}
+
+RH_C_FUNCTION ON_UUID ONX_Model_MaterialTable_Id(const ONX_Model* pConstModel, int index)
+{
+  if( pConstModel && index>=0 && index<pConstModel->m_material_table.Count())
+  {
+    return pConstModel->m_material_table[index].m_material_id;
+  }
+  return ::ON_nil_uuid;
+}
+
+RH_C_FUNCTION void ONX_Model_TableClear(ONX_Model* pModel, enum ONXModelTable which_table)
+{
+  if( pModel )
+  {
+    pModel->m_layer_table.Empty();
+    switch(which_table)
+    {
+    case onxBitmapTable:
+      {
+        for( int i=0; i<pModel->m_bitmap_table.Count(); i++ )
+        {
+          ON_Bitmap* pBitmap = pModel->m_bitmap_table[i];
+          if( pBitmap )
+            delete pBitmap;
+          pModel->m_bitmap_table[i] = NULL;
+        }
+        pModel->m_bitmap_table.Empty();
+      }
+      break;
+    case onxTextureMappingTable:
+      pModel->m_mapping_table.Empty();
+      break;
+    case onxMaterialTable:
+      pModel->m_material_table.Empty();
+      break;
+    case onxLinetypeTable:
+      pModel->m_linetype_table.Empty();
+      break;
+    case onxLayerTable:
+      pModel->m_layer_table.Empty();
+      break;
+    case onxLightTable:
+      pModel->m_light_table.Empty();
+      break;
+    case onxGroupTable:
+      pModel->m_group_table.Empty();
+      break;
+    case onxFontTable:
+      pModel->m_font_table.Empty();
+      break;
+    case onxDimStyleTable:
+      pModel->m_dimstyle_table.Empty();
+      break;
+    case onxHatchPatternTable:
+      pModel->m_hatch_pattern_table.Empty();
+      break;
+    case onxIDefTable:
+      pModel->m_idef_table.Empty();
+      break;
+    case onxObjectTable:
+      ModelObjectTableCleared(pModel);
+      pModel->m_object_table.Empty();
+      break;
+    case onxHistoryRecordTable:
+      {
+        for( int i=0; i<pModel->m_history_record_table.Count(); i++ )
+        {
+          ON_HistoryRecord* pRecord = pModel->m_history_record_table[i];
+          if( pRecord )
+            delete pRecord;
+          pModel->m_history_record_table[i] = NULL;
+        }
+        pModel->m_history_record_table.Empty();
+      }
+      break;
+    case onxUserDataTable:
+      pModel->m_userdata_table.Empty();
+      break;
+    }
+    // m_layer_table is emptied whatever table was asked for
+    unsigned int tables = ttfLayerTable;
+    switch(which_table)
+    {
+    case onxMaterialTable: tables |= ttfMaterialTable; break;
+    case onxLinetypeTable: tables |= ttfLinetypeTable; break;
+    case onxDimStyleTable: tables |= ttfDimstyleTable; break;
+    case onxHatchPatternTable: tables |= ttfHatchpatternTable; break;
+    case onxIDefTable: tables |= ttfInstanceDefinitionTable; break;
+    case onxBitmapTable: tables |= ttfBitmapTable; break;
+    case onxTextureMappingTable: tables |= ttfTextureMappingTable; break;
+    case onxLightTable: tables |= ttfLightTable; break;
+    case onxGroupTable: tables |= ttfGroupTable; break;
+    case onxFontTable: tables |= ttfFontTable; break;
+    case onxHistoryRecordTable: tables |= ttfHistoryrecordTable; break;
+    case onxUserDataTable: tables |= ttfUserTable; break;
+    default: break;
+    }
+    ModelTableChanged(pModel, tables);
+  }
+}
+
+
+RH_C_FUNCTION void ONX_Model_GetString( const ONX_Model* pConstModel, int which, CRhCmnStringHolder* pString )
+{
+  const int idxApplicationName = 0;
+  const int idxApplicationUrl = 1;
+  const int idxApplicationDetails = 2;
+  const int idxCreatedBy = 3;
+  const int idxLastCreatedBy = 4;
+
+  if( pConstModel && pString )
+  {
+    switch(which)
+    {
+    case idxApplicationName:
+      pString->Set( pConstModel->m_properties.m_Application.m_application_name );
+      break;
+    case idxApplicationUrl:
+      pString->Set( pConstModel->m_properties.m_Application.m_application_URL );
+      break;
+    case idxApplicationDetails:
+      pString->Set( pConstModel->m_properties.m_Application.m_application_details );
+      break;
+    case idxCreatedBy:
+      pString->Set( pConstModel->m_properties.m_RevisionHistory.m_sCreatedBy );
+      break;
+    case idxLastCreatedBy:
+      pString->Set( pConstModel->m_properties.m_RevisionHistory.m_sLastEditedBy );
+      break;
+    }
+  }
+}
+
+RH_C_FUNCTION void ONX_Model_SetString( ONX_Model* pModel, int which, const RHMONO_STRING* str )
+{
+  const int idxApplicationName = 0;
+  const int idxApplicationUrl = 1;
+  const int idxApplicationDetails = 2;
+  const int idxCreatedBy = 3;
+  const int idxLastCreatedBy = 4;
+  INPUTSTRINGCOERCE(_str, str);
+
+  if( pModel )
+  {
+    switch(which)
+    {
+    case idxApplicationName:
+      pModel->m_properties.m_Application.m_application_name = _str;
+      break;
+    case idxApplicationUrl:
+      pModel->m_properties.m_Application.m_application_URL = _str;
+      break;
+    case idxApplicationDetails:
+      pModel->m_properties.m_Application.m_application_details = _str;
+      break;
+    case idxCreatedBy:
+      pModel->m_properties.m_RevisionHistory.m_sCreatedBy = _str;
+      break;
+    case idxLastCreatedBy:
+      pModel->m_properties.m_RevisionHistory.m_sLastEditedBy = _str;
+      break;
+    }
+  }
+}
+
+RH_C_FUNCTION int ONX_Model_GetRevision(const ONX_Model* pConstModel)
+{
+  int rc = 0;
+  if( pConstModel )
+    rc = pConstModel->m_properties.m_RevisionHistory.m_revision_count;
+  return rc;
+}
+
+RH_C_FUNCTION void ONX_Model_SetRevision(ONX_Model* pModel, int rev)
+{
+  if( pModel )
+    pModel->m_properties.m_RevisionHistory.m_revision_count = rev;
+}
+
+RH_C_FUNCTION ON_3dmSettings* ONX_Model_3dmSettingsPointer(ONX_Model* pModel)
+{
+  ON_3dmSettings* rc = NULL;
+  if( pModel )
+    rc = &(pModel->m_settings);
+  return rc;
+}
+
+RH_C_FUNCTION ON_3dmView* ONX_Model_ViewPointer(ONX_Model* pModel, ON_UUID id, const ON_3dmView* pConstView, bool named_view_table)
+{
+  ON_3dmView* rc = NULL;
+  if( pModel )
+  {
+    ON_ClassArray<ON_3dmView>* views = named_view_table ? &(pModel->m_settings.m_named_views) : &(pModel->m_settings.m_views);
+    if( views )
+    {
+      for( int i=0; i<views->Count(); i++ )
+      {
+        ON_3dmView* pView = views->At(i);
+        if( pView && pView->m_vp.ViewportId() == id )
+        {
+          if( ::ON_UuidIsNil(id) && pConstView!=pView )
+            continue;
+          rc = pView;
+          break;
+        }
+      }
+    }
+  }
+  return rc;
+}
+
+RH_C_FUNCTION ON_3dmView* ONX_Model_ViewTable_Pointer(ONX_Model* pModel, int index, bool named_view_table)
+{
+  ON_3dmView* pView = NULL;
+  if( pModel )
+  {
+    pView = named_view_table ? pModel->m_settings.m_named_views.At(index) :
+                               pModel->m_settings.m_views.At(index);
+  }
+  return pView;
+}
+
+RH_C_FUNCTION ON_UUID ONX_Model_ViewTable_Id(const ONX_Model* pConstModel, int index, bool named_view_table)
+{
+  if( pConstModel )
+  {
+    const ON_3dmView* pView = named_view_table ? pConstModel->m_settings.m_named_views.At(index) :
+                                                 pConstModel->m_settings.m_views.At(index);
+    if( pView )
+      return pView->m_vp.ViewportId();
+  }
+  return ::ON_nil_uuid;
+}
+
+RH_C_FUNCTION void ONX_Model_ViewTable_Clear(ONX_Model* pModel, bool named_view_table)
+{
+  if( pModel )
+  {
+    if( named_view_table )
+      pModel->m_settings.m_named_views.Empty();
+    else
+      pModel->m_settings.m_views.Empty();
+    ModelTableChanged(pModel, ttfSettingsTable);
+  }
+}
+
+RH_C_FUNCTION int ONX_Model_ViewTable_Index(const ONX_Model* pConstModel, const ON_3dmView* pConstView, bool named_view_table)
+{
+  int rc = -1;
+  if( pConstModel && pConstView )
+  {
+    const ON_ClassArray<ON_3dmView>* views = named_view_table ? &(pConstModel->m_settings.m_named_views) : &(pConstModel->m_settings.m_views);
+    if( views )
+    {
+      for( int i=0; i<views->Count(); i++ )
+      {
+        if( views->At(i) == pConstView )
+        {
+          rc = i;
+          break;
+        }
+      }
+    }
+  }
+  return rc;
+}
+
+RH_C_FUNCTION void ONX_Model_ViewTable_Insert(ONX_Model* pModel, const ON_3dmView* pConstView, int index, bool named_view_table)
+{
+  if( pModel && pConstView && index>=0)
+  {
+    ON_ClassArray<ON_3dmView>* views = named_view_table ? &(pModel->m_settings.m_named_views) : &(pModel->m_settings.m_views);
+    if( views )
+    {
+      views->Insert(index, *pConstView);
+      ModelTableChanged(pModel, ttfSettingsTable);
+    }
+  }
+}
+
+RH_C_FUNCTION void ONX_Model_ViewTable_RemoveAt(ONX_Model* pModel, int index, bool named_view_table)
+{
+  if( pModel && index>=0)
+  {
+    ON_ClassArray<ON_3dmView>* views = named_view_table ? &(pModel->m_settings.m_named_views) : &(pModel->m_settings.m_views);
+    if( views )
+    {
+      views->Remove(index);
+      ModelTableChanged(pModel, ttfSettingsTable);
+    }
+  }
+}
+
+RH_C_FUNCTION ON_UUID ONX_Model_UserDataTable_Uuid(const ONX_Model* pConstModel, int index)
+{
+  if( pConstModel )
+  {
+    const ONX_Model_UserData* pUD = pConstModel->m_userdata_table.At(index);
+    if( pUD )
+      return pUD->m_uuid;
+  }
+  return ::ON_nil_uuid;
+}
+
+RH_C_FUNCTION void ONX_Model_UserDataTable_Clear(ONX_Model* pModel)
+{
+  if( pModel )
+    pModel->m_userdata_table.Empty();
+}
+
+/*
+Description:
+  Reads only the preview image of a 3dm file. The start section is read as
+  usual, then the properties table is entered and every chunk except the
+  preview image is skipped without being decoded. Nothing after the
+  properties table is touched.
+*/
+static bool ReadPreviewBitmap(const wchar_t* filename, ON_WindowsBitmap& bitmap)
+{
+  bool rc = false;
+  FILE* fp = ON::OpenFile( filename, L"rb" );
+  if( 0 == fp )
+    return false;
+  {
+    ON_BinaryFile file( ON::read3dm, fp );
+    int version = 0;
+    ON_String comments;
+    if( file.Read3dmStartSection( &version, comments ) )
+    {
+      if( file.Archive3dmVersion() < 2 )
+      {
+        // version 1 files have no properties table
+        ON_3dmProperties prop;
+        if( file.Read3dmProperties(prop) && prop.m_PreviewImage.m_bmi )
+        {
+          bitmap = prop.m_PreviewImage;
+          rc = true;
+        }
+      }
+      else
+      {
+        ON__UINT32 tcode = 0;
+        ON__INT64 big_value = 0;
+        if( file.BeginRead3dmBigChunk( &tcode, &big_value ) )
+        {
+          while( TCODE_PROPERTIES_TABLE == tcode && !rc )
+          {
+            ON__UINT32 sub_tcode = 0;
+            ON__INT64 sub_value = 0;
+            if( !file.BeginRead3dmBigChunk( &sub_tcode, &sub_value ) )
+              break;
+            if( TCODE_PROPERTIES_PREVIEWIMAGE == sub_tcode )
+              rc = bitmap.ReadUncompressed(file);
+            else if( TCODE_PROPERTIES_COMPRESSED_PREVIEWIMAGE == sub_tcode )
+              rc = bitmap.ReadCompressed(file);
+            if( !file.EndRead3dmChunk() )
+              rc = false;
+            if( TCODE_ENDOFTABLE == sub_tcode )
+              break;
+          }
+          file.EndRead3dmChunk();
+        }
+      }
+    }
+  }
+  ON::CloseFile(fp);
+  return rc && NULL != bitmap.m_bmi;
+}
+
+#if !defined(OPENNURBS_BUILD)
+RH_C_FUNCTION bool ONX_Model_ReadPreviewImage(const RHMONO_STRING* path, CRhinoDib* pRhinoDib)
+{
+  bool rc = false;
+  INPUTSTRINGCOERCE(_path, path);
+  if( NULL==pRhinoDib || NULL==_path )
+    return false;
+
+  ON_WindowsBitmap bitmap;
+  if( ReadPreviewBitmap(_path, bitmap) )
+  {
+    pRhinoDib->SetDib(bitmap.m_bmi, false);
+    rc = true;
+  }
+  return rc;
+}
+#endif
+
+class CBinaryFileHelper : public ON_BinaryFile
+{
+public:
+  CBinaryFileHelper(ON::archive_mode mode, FILE* fp)
+  : ON_BinaryFile(mode, fp)
+  {
+    m_file_pointer = fp;
+  }
+
+  FILE* m_file_pointer;
+};
+
+RH_C_FUNCTION CBinaryFileHelper* ON_BinaryFile_Open(const RHMONO_STRING* path, int mode)
+{
+  // 22-Jan-2014 Dale Fugier, http://mcneel.myjetbrains.com/youtrack/issue/RH-23765
+
+  ON::archive_mode archive_mode = ON::ArchiveMode(mode);
+  if( archive_mode == ON::unknown_archive_mode )
+    return NULL;
+
+  INPUTSTRINGCOERCE(_path, path);
+
+  FILE* fp = 0;
+  if( archive_mode == ON::read || archive_mode == ON::read3dm )
+    fp = ON::OpenFile( _path, L"rb" );
+  else if( archive_mode == ON::write || archive_mode == ON::write3dm )
+    fp = ON::OpenFile( _path, L"wb" );
+  else
+    fp = ON::OpenFile( _path, L"r+b" );
+  
+  if( fp )
+    return new CBinaryFileHelper( archive_mode, fp );
+
+  return NULL;
+}
+
+RH_C_FUNCTION void ON_BinaryFile_Close(CBinaryFileHelper* pBinaryFile)
+{
+  if( pBinaryFile )
+  {
+    if( pBinaryFile->m_file_pointer )
+      ON::CloseFile(pBinaryFile->m_file_pointer);
+    delete pBinaryFile;
+  }
+}
+
+
+
+
+
+// CRhCmnMappedFile maps an entire file read-only into the address space
+// so a 3dm archive can be read through ON_Read3dmBufferArchive. Chunk reads
+// then come straight out of the OS page cache instead of going through
+// buffered FILE* reads, and the pages are shared between processes that
+// load the same file.
+class CRhCmnMappedFile
+{
+public:
+  CRhCmnMappedFile();
+  ~CRhCmnMappedFile();
+
+  bool Open( const wchar_t* filename );
+  void Close();
+
+  const unsigned char* Buffer() const { return m_buffer; }
+  size_t SizeOfBuffer() const { return m_sizeof_buffer; }
+
+private:
+  CRhCmnMappedFile(const CRhCmnMappedFile&);
+  CRhCmnMappedFile& operator=(const CRhCmnMappedFile&);
+
+  const unsigned char* m_buffer;
+  size_t m_sizeof_buffer;
+#if defined(_WIN32)
+  HANDLE m_file;
+  HANDLE m_mapping;
+#else
+  int m_fd;
+#endif
+};
+
+CRhCmnMappedFile::CRhCmnMappedFile()
+: m_buffer(NULL)
+, m_sizeof_buffer(0)
+#if defined(_WIN32)
+, m_file(INVALID_HANDLE_VALUE)
+, m_mapping(NULL)
+#else
+, m_fd(-1)
+#endif
+{
+}
+
+CRhCmnMappedFile::~CRhCmnMappedFile()
+{
+  Close();
+}
+
+bool CRhCmnMappedFile::Open( const wchar_t* filename )
+{
+  Close();
+  if( NULL==filename || 0==filename[0] )
+    return false;
+
+#if defined(_WIN32)
+  m_file = ::CreateFileW(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  if( INVALID_HANDLE_VALUE==m_file )
+    return false;
+  LARGE_INTEGER file_size;
+  if( !::GetFileSizeEx(m_file, &file_size) || file_size.QuadPart<=0 || (ON__UINT64)file_size.QuadPart > (ON__UINT64)((size_t)-1) )
+  {
+    Close();
+    return false;
+  }
+  m_mapping = ::CreateFileMappingW(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+  if( NULL==m_mapping )
+  {
+    Close();
+    return false;
+  }
+  m_buffer = (const unsigned char*)::MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+  if( NULL==m_buffer )
+  {
+    Close();
+    return false;
+  }
+  m_sizeof_buffer = (size_t)file_size.QuadPart;
+#else
+  // Same narrow string conversion ON::OpenFile uses on this platform
+  ON_String fn(filename);
+  m_fd = ::open(fn.Array(), O_RDONLY);
+  if( m_fd < 0 )
+    return false;
+  struct stat sb;
+  if( 0!=::fstat(m_fd, &sb) || sb.st_size<=0 || (ON__UINT64)sb.st_size > (ON__UINT64)((size_t)-1) )
+  {
+    Close();
+    return false;
+  }
+  void* p = ::mmap(NULL, (size_t)sb.st_size, PROT_READ, MAP_SHARED, m_fd, 0);
+  if( MAP_FAILED==p )
+  {
+    Close();
+    return false;
+  }
+  ::madvise(p, (size_t)sb.st_size, MADV_SEQUENTIAL);
+  m_buffer = (const unsigned char*)p;
+  m_sizeof_buffer = (size_t)sb.st_size;
+#endif
+  return true;
+}
+
+void CRhCmnMappedFile::Close()
+{
+#if defined(_WIN32)
+  if( m_buffer )
+    ::UnmapViewOfFile(m_buffer);
+  if( m_mapping )
+    ::CloseHandle(m_mapping);
+  if( INVALID_HANDLE_VALUE!=m_file )
+    ::CloseHandle(m_file);
+  m_mapping = NULL;
+  m_file = INVALID_HANDLE_VALUE;
+#else
+  if( m_buffer )
+    ::munmap((void*)m_buffer, m_sizeof_buffer);
+  if( m_fd >= 0 )
+    ::close(m_fd);
+  m_fd = -1;
+#endif
+  m_buffer = NULL;
+  m_sizeof_buffer = 0;
+}
+
+// Bits passed as the options argument of ONX_Model_ReadFile3.
+// rfoParallelObjectTable implies rfoMemoryMapped and is ignored while
+// managed user data classes are registered. rfoLazyUserData keeps user data
+// of registered managed classes as raw bytes until CRhCmnUserData_Find first
+// asks for it.
+enum ReadFileOptions : unsigned int
+{
+  rfoNone         = 0,
+  rfoMemoryMapped = 1, // read through a memory mapping of the file instead of FILE*
+  rfoParallelObjectTable = 2, // decode object table records on worker threads
+  rfoLazyUserData = 4 // keep managed user data as raw bytes until it is asked for
+};
+
+RH_C_FUNCTION ONX_Model* ONX_Model_ReadFileMapped(const RHMONO_STRING* path, CRhCmnStringHolder* pStringHolder)
+{
+  ONX_Model* rc = NULL;
+  if( path )
+  {
+    INPUTSTRINGCOERCE(_path, path);
+    ON_wString s;
+    ON_TextLog log(s);
+    ON_TextLog* pLog = pStringHolder ? &log : NULL;
+    CRhCmnMappedFile mapped_file;
+    if( mapped_file.Open(_path) )
+    {
+      rc = new ONX_Model();
+      ON_Read3dmBufferArchive archive(mapped_file.SizeOfBuffer(), mapped_file.Buffer(), false, 0, 0);
+      if( !rc->Read(archive, pLog) )
+      {
+        ONX_Model_Delete(rc);
+        rc = NULL;
+      }
+    }
+    else
+    {
+      // Could not map the file (empty, too large for the address space, ...)
+      // Fall back to a regular buffered read.
+      rc = new ONX_Model();
+      if( !rc->Read(_path, pLog) )
+      {
+        ONX_Model_Delete(rc);
+        rc = NULL;
+      }
+    }
+    if( pStringHolder )
+      pStringHolder->Set(s);
+  }
+  return rc;
+}
+
+// One object record in a CRhCmnArchiveIndex
+struct CRhCmnObjectIndexEntry
+{
+  ON__UINT64 m_offset; // absolute offset of the TCODE_OBJECT_RECORD chunk
+  ON__UINT64 m_size;   // size of the chunk including header and CRC
+  ON_UUID m_uuid;
+  unsigned int m_object_type; // ON::object_type
+  int m_layer_index;
+  ON_BoundingBox m_bbox; // unset when the object is not geometry or could not be read
+};
+
+class ONX_Model_WithFilter : public ONX_Model
+{
+public:
+  ONX_Model_WithFilter();
+
+  bool FilteredRead( ON_BinaryArchive& archive, unsigned int table_filter, unsigned int model_object_type_filter, ON_TextLog* error_log );
+
+  bool FilteredRead( const wchar_t* filename, unsigned int table_filter, unsigned int model_object_type_filter, ON_TextLog* error_log );
+
+  // options are ReadFileOptions bits
+  bool FilteredRead( const wchar_t* filename, unsigned int table_filter, unsigned int model_object_type_filter, unsigned int options, ON_TextLog* error_log );
+
+  /*
+  Description:
+    Only keep objects whose bounding box intersects region. When index is
+    not NULL it must describe the file being read (see CRhCmnArchiveIndex);
+    objects whose indexed box is outside region are then skipped without
+    being deserialized.
+  Parameters:
+    region - [in] NULL removes the filter
+    index - [in] optional object entries of the file's index
+  */
+  void SetRegionFilter( const ON_BoundingBox* region, const ON_SimpleArray<CRhCmnObjectIndexEntry>* index );
+
+  // True when bbox intersects the region filter. Objects without a valid box
+  // are always kept.
+  bool PassesRegionFilter( const ON_BoundingBox& bbox ) const;
+
+private:
+  bool ReadObjectTableInParallel( ON_BinaryArchive& archive, unsigned int object_filter, ON_TextLog* error_log, int& error_count, int max_error_count );
+
+  // archive.BadCRCCount() plus the CRC errors found by the worker archives
+  // of a parallel object table read, which archive never sees.
+  int BadCRCCount( const ON_BinaryArchive& archive ) const;
+
+  // Returns true when the index says the record at offset is outside the
+  // region. Offsets must be passed in increasing order.
+  bool IndexedOutsideRegion( ON__UINT64 offset );
+
+  // Set while reading through a memory mapped file. m_mapped_buffer is the
+  // start of the mapping and lets object records be sliced out of the file
+  // without copying.
+  const unsigned char* m_mapped_buffer;
+  unsigned int m_read_options;
+  int m_parallel_crc_error_count;
+
+  bool m_bRegionFilter;
+  ON_BoundingBox m_region;
+  const ON_SimpleArray<CRhCmnObjectIndexEntry>* m_region_index;
+  int m_region_index_cursor;
+};
+
+ONX_Model_WithFilter::ONX_Model_WithFilter()
+: m_mapped_buffer(NULL)
+, m_read_options(rfoNone)
+, m_parallel_crc_error_count(0)
+, m_bRegionFilter(false)
+, m_region_index(NULL)
+, m_region_index_cursor(0)
+{
+}
+
+void ONX_Model_WithFilter::SetRegionFilter( const ON_BoundingBox* region, const ON_SimpleArray<CRhCmnObjectIndexEntry>* index )
+{
+  m_bRegionFilter = ( NULL != region && region->IsValid() );
+  if ( m_bRegionFilter )
+    m_region = *region;
+  else
+    m_region.Destroy();
+  m_region_index = m_bRegionFilter ? index : NULL;
+  m_region_index_cursor = 0;
+}
+
+bool ONX_Model_WithFilter::PassesRegionFilter( const ON_BoundingBox& bbox ) const
+{
+  if ( !m_bRegionFilter || !bbox.IsValid() )
+    return true;
+  return bbox.m_min.x <= m_region.m_max.x && bbox.m_max.x >= m_region.m_min.x
+      && bbox.m_min.y <= m_region.m_max.y && bbox.m_max.y >= m_region.m_min.y
+      && bbox.m_min.z <= m_region.m_max.z && bbox.m_max.z >= m_region.m_min.z;
+}
+
+bool ONX_Model_WithFilter::IndexedOutsideRegion( ON__UINT64 offset )
+{
+  if ( NULL == m_region_index )
+    return false;
+  const int count = m_region_index->Count();
+  while ( m_region_index_cursor < count && (*m_region_index)[m_region_index_cursor].m_offset < offset )
+    m_region_index_cursor++;
+  if ( m_region_index_cursor < count && (*m_region_index)[m_region_index_cursor].m_offset == offset )
+    return !PassesRegionFilter( (*m_region_index)[m_region_index_cursor].m_bbox );
+  return false;
+}
+
+/*
+Description:
+  Reads one TCODE_OBJECT_RECORD using only public ON_BinaryArchive
+  functions. This is the same record layout ON_BinaryArchive::Read3dmObject()
+  reads for version 2 and later archives, but it does not require the
+  archive to be positioned inside an object table, so it can decode a
+  record that was sliced out of a file into its own buffer archive. Unlike
+  Read3dmObject(), a record whose type does not pass object_filter is
+  skipped without deserializing the object.
+Parameters:
+  object_type - [out] if not NULL, the ON::object_type stored in the record.
+Returns:
+  0 at the end of the object table
+  1 object and attributes read
+  2 object skipped because it did not pass object_filter
+  3 object skipped because it is newer than this code
+  -1 failure
+*/
+static int ReadObjectRecord( ON_BinaryArchive& archive, ON_Object** ppObject, ON_3dmObjectAttributes* pAttributes, unsigned int object_filter, unsigned int* object_type )
+{
+  if ( ppObject )
+    *ppObject = NULL;
+  if ( pAttributes )
+    pAttributes->Default();
+  if ( object_type )
+    *object_type = 0;
+  if ( 0 == object_filter )
+    object_filter = 0xFFFFFFFF;
+
+  ON__UINT32 tcode = 0;
+  ON__INT64 big_value = 0;
+  if ( !archive.BeginRead3dmBigChunk( &tcode, &big_value ) )
+    return -1;
+
+  int rc = -1;
+  if ( TCODE_ENDOFTABLE == tcode )
+    rc = 0;
+  else if ( TCODE_OBJECT_RECORD == tcode && archive.BeginRead3dmBigChunk( &tcode, &big_value ) )
+  {
+    if ( TCODE_OBJECT_RECORD_TYPE == tcode )
+    {
+      rc = ( 0 != (object_filter & (unsigned int)big_value) ) ? 1 : 2;
+      if ( object_type )
+        *object_type = (unsigned int)big_value;
+    }
+    if ( !archive.EndRead3dmChunk() )
+      rc = -1;
+
+    if ( 1 == rc )
+    {
+      ON_Object* pObject = NULL;
+      switch ( archive.ReadObject( &pObject ) )
+      {
+      case 1:
+        rc = 1;
+        break;
+      case 3:
+        rc = 3;
+        break;
+      default:
+        rc = -1;
+        break;
+      }
+      if ( ppObject )
+        *ppObject = pObject;
+      else if ( pObject )
+        delete pObject;
+    }
+
+    while ( 1 == rc )
+    {
+      tcode = 0;
+      if ( !archive.BeginRead3dmBigChunk( &tcode, &big_value ) )
+      {
+        rc = -1;
+        break;
+      }
+      if ( TCODE_OBJECT_RECORD_ATTRIBUTES == tcode )
+      {
+        if ( pAttributes && !pAttributes->Read( archive ) )
+          rc = -1;
+      }
+      else if ( TCODE_OBJECT_RECORD_ATTRIBUTES_USERDATA == tcode )
+      {
+        if ( pAttributes && !archive.ReadObjectUserData( *pAttributes ) )
+          rc = -1;
+      }
+      if ( !archive.EndRead3dmChunk() )
+      {
+        rc = -1;
+        break;
+      }
+      if ( TCODE_OBJECT_RECORD_END == tcode )
+        break;
+    }
+  }
+
+  // Skips whatever part of the record was not read
+  if ( !archive.EndRead3dmChunk() )
+    rc = -1;
+
+  if ( rc < 0 && ppObject && *ppObject )
+  {
+    delete *ppObject;
+    *ppObject = NULL;
+  }
+  return rc;
+}
+
+struct ParallelObjectRecord
+{
+  ParallelObjectRecord() : m_offset(0), m_size(0), m_bSkip(false), m_rc(-1), m_bad_crc_count(0), m_object(NULL) {}
+
+  // in
+  ON__UINT64 m_offset; // from start of the mapped file
+  size_t m_size;
+  bool m_bSkip;        // outside the region filter, dropped without a warning
+  // out
+  int m_rc;            // ReadObjectRecord return code
+  int m_bad_crc_count;
+  ON_Object* m_object;
+  ON_3dmObjectAttributes m_attributes;
+};
+
+struct ParallelObjectTableContext
+{
+  const unsigned char* m_buffer;
+  int m_3dm_version;
+  int m_opennurbs_version;
+  unsigned int m_object_filter;
+  const ONX_Model_WithFilter* m_model;
+  ON_ClassArray<ParallelObjectRecord>* m_records;
+};
+
+static void DecodeObjectRecordAt(int index, void* context)
+{
+  ParallelObjectTableContext* ctx = (ParallelObjectTableContext*)context;
+  ParallelObjectRecord& record = (*ctx->m_records)[index];
+  if ( record.m_bSkip )
+  {
+    record.m_rc = 2;
+    return;
+  }
+  // Each worker reads its record through a private archive over the slice.
+  // Reading the whole chunk, trailer included, verifies its CRC.
+  ON_Read3dmBufferArchive archive( record.m_size, ctx->m_buffer + record.m_offset, false, ctx->m_3dm_version, ctx->m_opennurbs_version );
+  record.m_rc = ReadObjectRecord( archive, &record.m_object, &record.m_attributes, ctx->m_object_filter, NULL );
+  record.m_bad_crc_count = archive.BadCRCCount();
+
+  const ON_Geometry* pGeometry = ON_Geometry::Cast( record.m_object );
+  if ( pGeometry && !ctx->m_model->PassesRegionFilter( pGeometry->BoundingBox() ) )
+  {
+    delete record.m_object;
+    record.m_object = NULL;
+    record.m_bSkip = true;
+  }
+}
+
+bool ONX_Model_WithFilter::ReadObjectTableInParallel( ON_BinaryArchive& archive, unsigned int object_filter, ON_TextLog* error_log, int& error_count, int max_error_count )
+{
+  // The calling thread only walks the chunk headers to find where each
+  // object record starts and ends. That is a few bytes per record, so all
+  // records are located first and then decoded on worker threads. Results
+  // are appended in table order so object indices match a sequential read.
+  ON_ClassArray<ParallelObjectRecord> records;
+  for (;;)
+  {
+    const ON__UINT64 pos0 = archive.CurrentPosition();
+    ON__UINT32 tcode = 0;
+    ON__INT64 big_value = 0;
+    if ( !archive.BeginRead3dmBigChunk( &tcode, &big_value ) || !archive.EndRead3dmChunk() )
+    {
+      if ( error_log ) error_log->Print("ERROR: Object table entry %d is corrupt. (ON_BinaryArchive::BeginRead3dmBigChunk() failed.)\n", records.Count());
+      return false;
+    }
+    const ON__UINT64 pos1 = archive.CurrentPosition();
+    if ( TCODE_ENDOFTABLE == tcode )
+      break;
+    if ( pos1 <= pos0 )
+      return false;
+    // A record with an unexpected typecode is still queued. The worker
+    // fails to decode it and it is reported as a corrupt entry below.
+    ParallelObjectRecord& record = records.AppendNew();
+    record.m_offset = pos0;
+    record.m_size = (size_t)(pos1 - pos0);
+    record.m_bSkip = IndexedOutsideRegion( pos0 );
+  }
+
+  ParallelObjectTableContext ctx;
+  ctx.m_buffer = m_mapped_buffer;
+  ctx.m_3dm_version = archive.Archive3dmVersion();
+  ctx.m_opennurbs_version = archive.ArchiveOpenNURBSVersion();
+  ctx.m_object_filter = object_filter;
+  ctx.m_model = this;
+  ctx.m_records = &records;
+  RhCmnParallelFor( records.Count(), DecodeObjectRecordAt, &ctx, 0 );
+
+  // Reports in the same way as the serial loop in FilteredRead
+  m_object_table.Reserve( m_object_table.Count() + records.Count() );
+  for ( int count = 0; count < records.Count(); count++ )
+  {
+    ParallelObjectRecord& record = records[count];
+    m_parallel_crc_error_count += record.m_bad_crc_count;
+    if ( record.m_rc < 0 )
+    {
+      if ( error_log)
+      {
+        error_log->Print("ERROR: Object table entry %d is corrupt. (ON_BinaryArchive::Read3dmObject() < 0.)\n",count);
+        error_count++;
+        if ( error_count > max_error_count )
+        {
+          // Free everything that was decoded but not handed to the model
+          for ( int i = count; i < records.Count(); i++ )
+          {
+            if ( records[i].m_object )
+              delete records[i].m_object;
+            records[i].m_object = NULL;
+          }
+          return false;
+        }
+        error_log->Print("-- Attempting to continue.\n");
+      }
+      continue;
+    }
+    if ( m_crc_error_count != BadCRCCount( archive ) )
+    {
+      if ( error_log)
+      {
+        error_log->Print("ERROR: Object table entry %d is corrupt. (CRC errors).\n",count);
+        error_log->Print("-- Attempting to continue.\n");
+      }
+      m_crc_error_count = BadCRCCount( archive );
+    }
+    if ( record.m_bSkip )
+      continue;
+    if ( record.m_object )
+    {
+      ONX_Model_Object& mo = m_object_table.AppendNew();
+      mo.m_object = record.m_object;
+      mo.m_bDeleteObject = true;
+      mo.m_attributes = record.m_attributes;
+      record.m_object = NULL;
+    }
+    else if ( error_log )
+    {
+      if ( 2 == record.m_rc )
+        error_log->Print("WARNING: Skipping object table entry %d because it's filtered.\n",count);
+      else if ( 3 == record.m_rc )
+        error_log->Print("WARNING: Skipping object table entry %d because it's newer than this code.  Update your OpenNURBS toolkit.\n",count);
+      else
+        error_log->Print("WARNING: Skipping object table entry %d for unknown reason.\n",count);
+    }
+  }
+
+  return true;
+}
+
+int ONX_Model_WithFilter::BadCRCCount( const ON_BinaryArchive& archive ) const
+{
+  return archive.BadCRCCount() + m_parallel_crc_error_count;
+}
+
+static 
+bool CheckForCRCErrors( 
+          int new_crc_count, 
+          ONX_Model& model,
+          ON_TextLog* error_log,
+          const char* sSection
+          )
+{
+  // returns true if new CRC errors are found
+  bool rc = false;
+  
+  if ( model.m_crc_error_count != new_crc_count ) 
+  {
+    if ( error_log )
+    {
+      error_log->Print("ERROR: Corrupt %s. (CRC errors).\n",sSection);
+      error_log->Print("-- Attempting to continue.\n");
+    }
+    model.m_crc_error_count = new_crc_count;
+    rc = true;
+  }
+
+  return rc;
+}
+
+
+bool ONX_Model_WithFilter::FilteredRead(ON_BinaryArchive& archive, unsigned int table_filter, unsigned int model_object_type_filter, ON_TextLog* error_log )
+{
+  const int max_error_count = 2000;
+  int error_count = 0;
+  bool return_code = true;
+  int count, rc;
+
+  Destroy(); // get rid of any residual stuff
+  m_parallel_crc_error_count = 0;
+
+  // STEP 1: REQUIRED - Read start section
+  if ( !archive.Read3dmStartSection( &m_3dm_file_version, m_sStartSectionComments ) )
+  {
+    if ( error_log) error_log->Print("ERROR: Unable to read start section. (ON_BinaryArchive::Read3dmStartSection() returned false.)\n");
+    return false;
+  }
+  else if ( CheckForCRCErrors( BadCRCCount( archive ), *this, error_log, "start section" ) )
+    return_code = false;
+
+  // STEP 2: REQUIRED - Read properties section
+  if ( !archive.Read3dmProperties( m_properties ) )
+  {
+    if ( error_log) error_log->Print("ERROR: Unable to read properties section. (ON_BinaryArchive::Read3dmProperties() returned false.)\n");
+    return false;
+  }
+  else if ( CheckForCRCErrors( BadCRCCount( archive ), *this, error_log, "properties section" ) )
+    return_code = false;
+
+  // version of opennurbs used to write the file.
+  m_3dm_opennurbs_version = archive.ArchiveOpenNURBSVersion();
+
+  // STEP 3: REQUIRED - Read properties section
+  if ( !archive.Read3dmSettings( m_settings ) )
+  {
+    if ( error_log) error_log->Print("ERROR: Unable to read settings section. (ON_BinaryArchive::Read3dmSettings() returned false.)\n");
+    return false;
+  }
+  else if ( CheckForCRCErrors( BadCRCCount( archive ), *this, error_log, "settings section" ) )
+    return_code = false;
+
+  // STEP 4: REQUIRED - Read embedded bitmap table
+  if ( archive.BeginRead3dmBitmapTable() )
+  {
+    // At the moment no bitmaps are embedded so this table is empty
+    ON_Bitmap* pBitmap = NULL;
+    for( count = 0; true; count++ ) 
+    {
+      pBitmap = NULL;
+      rc = archive.Read3dmBitmap(&pBitmap);
+      if ( rc==0 )
+        break; // end of bitmap table
+      if ( rc < 0 ) 
+      {
+        if ( error_log) 
+        {
+          error_log->Print("ERROR: Corrupt bitmap found. (ON_BinaryArchive::Read3dmBitmap() < 0.)\n");
+          error_count++;
+          if ( error_count > max_error_count )
+            return false;
+          error_log->Print("-- Attempting to continue.\n");
+        }
+        return_code = false;
+      }
+      m_bitmap_table.Append(pBitmap);
+    }
+
+    // If BeginRead3dmBitmapTable() returns true, 
+    // then you MUST call EndRead3dmBitmapTable().
+    if ( !archive.EndRead3dmBitmapTable() )
+    {
+      if ( error_log) error_log->Print("ERROR: Corrupt bitmap table. (ON_BinaryArchive::EndRead3dmBitmapTable() returned false.)\n");
+      return false;
+    }
+    if ( CheckForCRCErrors( BadCRCCount( archive ), *this, error_log, "bitmap table" ) )
+      return_code = false;
+  }
+  else     
+  {
+    if ( error_log) 
+    {
+      error_log->Print("WARNING: Missing or corrupt bitmap table. (ON_BinaryArchive::BeginRead3dmBitmapTable() returned false.)\n");
+      error_log->Print("-- Attempting to continue.\n");
+    }
+    return_code = false;
+  }
+
+
+
+  // STEP 5: REQUIRED - Read texture mapping table
+  if ( archive.BeginRead3dmTextureMappingTable() )
+  {
+    ON_TextureMapping* pTextureMapping = NULL;
+    for( count = 0; true; count++ ) 
+    {
+      rc = archive.Read3dmTextureMapping(&pTextureMapping);
+      if ( rc==0 )
+        break; // end of texture_mapping table
+      if ( rc < 0 ) 
+      {
+        if ( error_log) 
+        {
+          error_log->Print("ERROR: Corrupt render texture_mapping found. (ON_BinaryArchive::Read3dmTextureMapping() < 0.)\n");
+          error_count++;
+          if ( error_count > max_error_count )
+            return false;
+          error_log->Print("-- Attempting to continue.\n");
+        }
+        continue;
+      }
+      ON_UserDataHolder ud;
+      ud.MoveUserDataFrom(*pTextureMapping);
+      m_mapping_table.Append(*pTextureMapping);
+      pTextureMapping->m_mapping_index = count;
+      ud.MoveUserDataTo(*m_mapping_table.Last(),false);
+      delete pTextureMapping;
+      pTextureMapping = NULL;
+    }
+    
+    // If BeginRead3dmTextureMappingTable() returns true, 
+    // then you MUST call EndRead3dmTextureMappingTable().
+    if ( !archive.EndRead3dmTextureMappingTable() )
+    {
+      if ( error_log) error_log->Print("ERROR: Corrupt render texture_mapping table. (ON_BinaryArchive::EndRead3dmTextureMappingTable() returned false.)\n");
+      return false;
+    }
+    if ( CheckForCRCErrors( BadCRCCount( archive ), *this, error_log, "render texture_mapping table" ) )
+      return_code = false;
+  }
+  else     
+  {
+    if ( error_log)
+    {
+      error_log->Print("WARNING: Missing or corrupt render texture_mapping table. (ON_BinaryArchive::BeginRead3dmTextureMappingTable() returned false.)\n");
+      error_log->Print("-- Attempting to continue.\n");
+    }
+    return_code = false;
+  }
+
+
+  // STEP 6: REQUIRED - Read render material table
+  if ( archive.BeginRead3dmMaterialTable() )
+  {
+    ON_Material* pMaterial = NULL;
+    for( count = 0; true; count++ ) 
+    {
+      rc = archive.Read3dmMaterial(&pMaterial);
+      if ( rc==0 )
+        break; // end of material table
+      if ( rc < 0 ) 
+      {
+        if ( error_log) 
+        {
+          error_log->Print("ERROR: Corrupt render material found. (ON_BinaryArchive::Read3dmMaterial() < 0.)\n");
+          error_count++;
+          if ( error_count > max_error_count )
+            return false;
+          error_log->Print("-- Attempting to continue.\n");
+        }
+        pMaterial = new ON_Material; // use default
+        pMaterial->m_material_index = count;
+      }
+      ON_UserDataHolder ud;
+      ud.MoveUserDataFrom(*pMaterial);
+      m_material_table.Append(*pMaterial);
+      ud.MoveUserDataTo(*m_material_table.Last(),false);
+      delete pMaterial;
+      pMaterial = NULL;
+    }
+    
+    // If BeginRead3dmMaterialTable() returns true, 
+    // then you MUST call EndRead3dmMaterialTable().
+    if ( !archive.EndRead3dmMaterialTable() )
+    {
+      if ( error_log) error_log->Print("ERROR: Corrupt render material table. (ON_BinaryArchive::EndRead3dmMaterialTable() returned false.)\n");
+      return false;
+    }
+    if ( CheckForCRCErrors( BadCRCCount( archive ), *this, error_log, "render material table" ) )
+      return_code = false;
+  }
+  else     
+  {
+    if ( error_log)
+    {
+      error_log->Print("WARNING: Missing or corrupt render material table. (ON_BinaryArchive::BeginRead3dmMaterialTable() returned false.)\n");
+      error_log->Print("-- Attempting to continue.\n");
+    }
+    return_code = false;
+  }
+
+
+  // STEP 7: REQUIRED - Read line type table
+  if ( archive.BeginRead3dmLinetypeTable() )
+  {
+    ON_Linetype* pLinetype = NULL;
+    for( count = 0; true; count++ ) 
+    {
+      rc = archive.Read3dmLinetype(&pLinetype);
+      if ( rc==0 )
+        break; // end of linetype table
+      if ( rc < 0 ) 
+      {
+        if ( error_log) 
+        {
+          error_log->Print("ERROR: Corrupt render linetype found. (ON_BinaryArchive::Read3dmLinetype() < 0.)\n");
+          error_count++;
+          if ( error_count > max_error_count )
+            return false;
+          error_log->Print("-- Attempting to continue.\n");
+        }
+        pLinetype = new ON_Linetype; // use default
+        pLinetype->m_linetype_index = count;
+      }
+      ON_UserDataHolder ud;
+      ud.MoveUserDataFrom(*pLinetype);
+      m_linetype_table.Append(*pLinetype);
+      ud.MoveUserDataTo(*m_linetype_table.Last(),false);
+      delete pLinetype;
+      pLinetype = NULL;
+    }
+    
+    // If BeginRead3dmLinetypeTable() returns true, 
+    // then you MUST call EndRead3dmLinetypeTable().
+    if ( !archive.EndRead3dmLinetypeTable() )
+    {
+      if ( error_log) error_log->Print("ERROR: Corrupt render linetype table. (ON_BinaryArchive::EndRead3dmLinetypeTable() returned false.)\n");
+      return false;
+    }
+    if ( CheckForCRCErrors( BadCRCCount( archive ), *this, error_log, "render linetype table" ) )
+      return_code = false;
+  }
+  else     
+  {
+    if ( error_log)
+    {
+      error_log->Print("WARNING: Missing or corrupt render linetype table. (ON_BinaryArchive::BeginRead3dmLinetypeTable() returned false.)\n");
+      error_log->Print("-- Attempting to continue.\n");
+    }
+    return_code = false;
+  }
+
+  // STEP 8: REQUIRED - Read layer table
+  if ( archive.BeginRead3dmLayerTable() )
+  {
+    ON_Layer* pLayer = NULL;
+    for( count = 0; true; count++ ) 
+    {
+      pLayer = NULL;
+      rc = archive.Read3dmLayer(&pLayer);
+      if ( rc==0 )
+        break; // end of layer table
+      if ( rc < 0 ) 
+      {
+        if ( error_log)
+        {
+          error_log->Print("ERROR: Corrupt layer found. (ON_BinaryArchive::Read3dmLayer() < 0.)\n");
+          error_count++;
+          if ( error_count > max_error_count )
+            return false;
+          error_log->Print("-- Attempting to continue.\n");
+        }
+        pLayer = new ON_Layer; // use default
+        pLayer->m_layer_index = count;
+      }
+      ON_UserDataHolder ud;
+      ud.MoveUserDataFrom(*pLayer);
+      m_layer_table.Append(*pLayer);
+      ud.MoveUserDataTo(*m_layer_table.Last(),false);
+      delete pLayer;
+      pLayer = NULL;
+    }
+    
+    // If BeginRead3dmLayerTable() returns true, 
+    // then you MUST call EndRead3dmLayerTable().
+    if ( !archive.EndRead3dmLayerTable() )
+    {
+      if ( error_log) error_log->Print("ERROR: Corrupt render layer table. (ON_BinaryArchive::EndRead3dmLayerTable() returned false.)\n");
+      return false;
+    }
+    if ( CheckForCRCErrors( BadCRCCount( archive ), *this, error_log, "layer table" ) )
+      return_code = false;
+  }
+  else     
+  {
+    if ( error_log) 
+    {
+      error_log->Print("WARNING: Missing or corrupt layer table. (ON_BinaryArchive::BeginRead3dmLayerTable() returned false.)\n");
+      error_log->Print("-- Attempting to continue.\n");
+    }
+    return_code = false;
+  }
+
+  // STEP 9: REQUIRED - Read group table
+  if ( archive.BeginRead3dmGroupTable() )
+  {
+    ON_Group* pGroup = NULL;
+    for( count = 0; true; count++ ) 
+    {
+      rc = archive.Read3dmGroup(&pGroup);
+      if ( rc==0 )
+        break; // end of group table
+      if ( rc < 0 ) 
+      {
+        if ( error_log)
+        {
+          error_log->Print("ERROR: Corrupt group found. (ON_BinaryArchive::Read3dmGroup() < 0.)\n");
+          error_count++;
+          if ( error_count > max_error_count )
+            return false;
+          error_log->Print("-- Attempting to continue.\n");
+        }
+        pGroup = new ON_Group; // use default
+        pGroup->m_group_index = -1;
+      }
+      ON_UserDataHolder ud;
+      ud.MoveUserDataFrom(*pGroup);
+      m_group_table.Append(*pGroup);
+      ud.MoveUserDataTo(*m_group_table.Last(),false);
+      delete pGroup;
+      pGroup = NULL;
+    }
+    
+    // If BeginRead3dmGroupTable() returns true, 
+    // then you MUST call EndRead3dmGroupTable().
+    if ( !archive.EndRead3dmGroupTable() )
+    {
+      if ( error_log) error_log->Print("ERROR: Corrupt group table. (ON_BinaryArchive::EndRead3dmGroupTable() returned false.)\n");
+      return false;
+    }
+    if ( CheckForCRCErrors( BadCRCCount( archive ), *this, error_log, "group table" ) )
+      return_code = false;
+  }
+  else     
+  {
+    if ( error_log) 
+    {
+      error_log->Print("WARNING: Missing or corrupt group table. (ON_BinaryArchive::BeginRead3dmGroupTable() returned false.)\n");
+      error_log->Print("-- Attempting to continue.\n");
+    }
+    return_code = false;
+  }
+
+  // STEP 10: REQUIRED - Read font table
+  if ( archive.BeginRead3dmFontTable() )
+  {
+    ON_Font* pFont = NULL;
+    for( count = 0; true; count++ ) 
+    {
+      rc = archive.Read3dmFont(&pFont);
+      if ( rc==0 )
+        break; // end of font table
+      if ( rc < 0 ) 
+      {
+        if ( error_log)
+        {
+          error_log->Print("ERROR: Corrupt font found. (ON_BinaryArchive::Read3dmFont() < 0.)\n");
+          error_count++;
+          if ( error_count > max_error_count )
+            return false;
+          error_log->Print("-- Attempting to continue.\n");
+        }
+        pFont = new ON_Font; // use default
+        pFont->m_font_index = -1;
+      }
+      ON_UserDataHolder ud;
+      ud.MoveUserDataFrom(*pFont);
+      m_font_table.Append(*pFont);
+      ud.MoveUserDataTo(*m_font_table.Last(),false);
+      delete pFont;
+      pFont = NULL;
+    }
+    
+    // If BeginRead3dmFontTable() returns true, 
+    // then you MUST call EndRead3dmFontTable().
+    if ( !archive.EndRead3dmFontTable() )
+    {
+      if ( error_log) error_log->Print("ERROR: Corrupt font table. (ON_BinaryArchive::EndRead3dmFontTable() returned false.)\n");
+      return false;
+    }
+    if ( CheckForCRCErrors( BadCRCCount( archive ), *this, error_log, "font table" ) )
+      return_code = false;
+  }
+  else     
+  {
+    if ( error_log)
+    {
+      error_log->Print("WARNING: Missing or corrupt font table. (ON_BinaryArchive::BeginRead3dmFontTable() returned false.)\n");
+      error_log->Print("-- Attempting to continue.\n");
+    }
+    return_code = false;
+  }
+
+  // STEP 11: REQUIRED - Read dimstyle table
+  if ( archive.BeginRead3dmDimStyleTable() )
+  {
+    ON_DimStyle* pDimStyle = NULL;
+    for( count = 0; true; count++ ) 
+    {
+      rc = archive.Read3dmDimStyle(&pDimStyle);
+      if ( rc==0 )
+        break; // end of dimstyle table
+      if ( rc < 0 ) 
+      {
+        if ( error_log)
+        {
+          error_log->Print("ERROR: Corrupt dimstyle found. (ON_BinaryArchive::Read3dmDimStyle() < 0.)\n");
+          error_count++;
+          if ( error_count > max_error_count )
+            return false;
+          error_log->Print("-- Attempting to continue.\n");
+        }
+        pDimStyle = new ON_DimStyle; // use default
+        pDimStyle->m_dimstyle_index = count;
+      }
+      ON_UserDataHolder ud;
+      ud.MoveUserDataFrom(*pDimStyle);
+      m_dimstyle_table.Append(*pDimStyle);
+      ud.MoveUserDataTo(*m_dimstyle_table.Last(),false);
+      delete pDimStyle;
+      pDimStyle = NULL;
+    }
+    
+    // If BeginRead3dmDimStyleTable() returns true, 
+    // then you MUST call EndRead3dmDimStyleTable().
+    if ( !archive.EndRead3dmDimStyleTable() )
+    {
+      if ( error_log) error_log->Print("ERROR: Corrupt dimstyle table. (ON_BinaryArchive::EndRead3dmDimStyleTable() returned false.)\n");
+      return false;
+    }
+    if ( CheckForCRCErrors( BadCRCCount( archive ), *this, error_log, "dimstyle table" ) )
+      return_code = false;
+  }
+  else     
+  {
+    if ( error_log)
+    {
+      error_log->Print("WARNING: Missing or corrupt dimstyle table. (ON_BinaryArchive::BeginRead3dmDimStyleTable() returned false.)\n");
+      error_log->Print("-- Attempting to continue.\n");
+    }
+    return_code = false;
+  }
+
+  // STEP 12: REQUIRED - Read render lights table
+  if ( archive.BeginRead3dmLightTable() )
+  {
+    ON_Light* pLight = NULL;
+    ON_3dmObjectAttributes object_attributes;
+    for( count = 0; true; count++ ) 
+    {
+      object_attributes.Default();
+      rc = archive.Read3dmLight(&pLight,&object_attributes);
+      if ( rc==0 )
+        break; // end of light table
+      if ( rc < 0 ) 
+      {
+        if ( error_log)
+        {
+          error_log->Print("ERROR: Corrupt render light found. (ON_BinaryArchive::Read3dmLight() < 0.)\n");
+          error_count++;
+          if ( error_count > max_error_count )
+            return false;
+          error_log->Print("-- Attempting to continue.\n");
+        }
+        continue;
+      }
+      ONX_Model_RenderLight& light = m_light_table.AppendNew();
+      ON_UserDataHolder ud;
+      ud.MoveUserDataFrom(*pLight);
+      light.m_light = *pLight;
+      ud.MoveUserDataTo(light.m_light,false);
+      light.m_attributes = object_attributes;
+      delete pLight;
+      pLight = NULL;
+    }
+    
+    // If BeginRead3dmLightTable() returns true, 
+    // then you MUST call EndRead3dmLightTable().
+    if ( !archive.EndRead3dmLightTable() )
+    {
+      if ( error_log) error_log->Print("ERROR: Corrupt render light table. (ON_BinaryArchive::EndRead3dmLightTable() returned false.)\n");
+      return false;
+    }
+    if ( CheckForCRCErrors( BadCRCCount( archive ), *this, error_log, "render light table" ) )
+      return_code = false;
+  }
+  else     
+  {
+    if ( error_log)
+    {
+      error_log->Print("WARNING: Missing or corrupt render light table. (ON_BinaryArchive::BeginRead3dmLightTable() returned false.)\n");
+      error_log->Print("-- Attempting to continue.\n");
+    }
+    return_code = false;
+  }
+
+  // STEP 13 - read hatch pattern table
+  if ( archive.BeginRead3dmHatchPatternTable() )
+  {
+    ON_HatchPattern* pHatchPattern = NULL;
+    for( count = 0; true; count++ ) 
+    {
+      rc = archive.Read3dmHatchPattern(&pHatchPattern);
+      if ( rc==0 )
+        break; // end of hatchpattern table
+      if ( rc < 0 ) 
+      {
+        if ( error_log)
+        {
+          error_log->Print("ERROR: Corrupt hatchpattern found. (ON_BinaryArchive::Read3dmHatchPattern() < 0.)\n");
+          error_count++;
+          if ( error_count > max_error_count )
+            return false;
+          error_log->Print("-- Attempting to continue.\n");
+        }
+        pHatchPattern = new ON_HatchPattern; // use default
+        pHatchPattern->m_hatchpattern_index = count;
+      }
+      ON_UserDataHolder ud;
+      ud.MoveUserDataFrom(*pHatchPattern);
+      m_hatch_pattern_table.Append(*pHatchPattern);
+      ud.MoveUserDataTo(*m_hatch_pattern_table.Last(),false);
+      delete pHatchPattern;
+      pHatchPattern = NULL;
+    }
+    
+    // If BeginRead3dmHatchPatternTable() returns true, 
+    // then you MUST call EndRead3dmHatchPatternTable().
+    if ( !archive.EndRead3dmHatchPatternTable() )
+    {
+      if ( error_log) error_log->Print("ERROR: Corrupt hatchpattern table. (ON_BinaryArchive::EndRead3dmHatchPatternTable() returned false.)\n");
+      return false;
+    }
+    if ( CheckForCRCErrors( BadCRCCount( archive ), *this, error_log, "hatchpattern table" ) )
+      return_code = false;
+  }
+  else     
+  {
+    if ( error_log)
+    {
+      error_log->Print("WARNING: Missing or corrupt hatchpattern table. (ON_BinaryArchive::BeginRead3dmHatchPatternTable() returned false.)\n");
+      error_log->Print("-- Attempting to continue.\n");
+    }
+    return_code = false;
+  }
+
+  // STEP 14: REQUIRED - Read instance definition table
+  if ( archive.BeginRead3dmInstanceDefinitionTable() )
+  {
+    ON_InstanceDefinition* pIDef = NULL;
+    for( count = 0; true; count++ ) 
+    {
+      rc = archive.Read3dmInstanceDefinition(&pIDef);
+      if ( rc==0 )
+        break; // end of instance definition table
+      if ( rc < 0 ) 
+      {
+        if ( error_log)
+        {
+          error_log->Print("ERROR: Corrupt instance definition found. (ON_BinaryArchive::Read3dmInstanceDefinition() < 0.)\n");
+          error_count++;
+          if ( error_count > max_error_count )
+            return false;
+          error_log->Print("-- Attempting to continue.\n");
+        }
+        continue;
+      }
+      ON_UserDataHolder ud;
+      ud.MoveUserDataFrom(*pIDef);
+      m_idef_table.Append(*pIDef);
+      ud.MoveUserDataTo(*m_idef_table.Last(),false);
+      delete pIDef;
+    }
+    
+    // If BeginRead3dmInstanceDefinitionTable() returns true, 
+    // then you MUST call EndRead3dmInstanceDefinitionTable().
+    if ( !archive.EndRead3dmInstanceDefinitionTable() )
+    {
+      if ( error_log) error_log->Print("ERROR: Corrupt instance definition table. (ON_BinaryArchive::EndRead3dmInstanceDefinitionTable() returned false.)\n");
+      return false;
+    }
+    if ( CheckForCRCErrors( BadCRCCount( archive ), *this, error_log, "instance definition table" ) )
+      return_code = false;
+  }
+  else     
+  {
+    if ( error_log)
+    {
+      error_log->Print("WARNING: Missing or corrupt instance definition table. (ON_BinaryArchive::BeginRead3dmInstanceDefinitionTable() returned false.)\n");
+      error_log->Print("-- Attempting to continue.\n");
+    }
+    return_code = false;
+  }
+
+
+
+  // STEP 15: REQUIRED - Read object (geometry and annotation) table
+  if ( archive.BeginRead3dmObjectTable() )
+  {
+    // optional filter made by setting ON::object_type bits 
+    // For example, if you just wanted to just read points and meshes, you would use
+    // object_filter = ON::point_object | ON::mesh_object;
+
+    int object_filter = model_object_type_filter;
+
+    // Managed user data classes are created through process wide state and
+    // read by .NET callbacks, so those objects are read serially.
+    if ( 0 != m_mapped_buffer && 0 != (m_read_options & rfoParallelObjectTable) && archive.Archive3dmVersion() >= 2 && !RhCmnManagedUserDataRegistered() )
+    {
+      if ( !ReadObjectTableInParallel( archive, (unsigned int)object_filter, error_log, error_count, max_error_count ) )
+        return false;
+    }
+    else
+    {
+      for( count = 0; true; count++ ) 
+      {
+        if ( IndexedOutsideRegion( archive.CurrentPosition() ) )
         {
-          error_log->Print("ERROR: Corrupt bitmap found. (ON_BinaryArchive::Read3dmBitmap() < 0.)\n");
+          // Skip the whole record without deserializing it
+          ON__UINT32 tcode = 0;
+          ON__INT64 big_value = 0;
+          if ( archive.BeginRead3dmBigChunk( &tcode, &big_value ) && archive.EndRead3dmChunk() )
+            continue;
+          if ( error_log) error_log->Print("ERROR: Object table entry %d is corrupt. (ON_BinaryArchive::BeginRead3dmBigChunk() failed.)\n",count);
+          return false;
+        }
+        ON_Object* pObject = NULL;
+        ON_3dmObjectAttributes attributes;
+        rc = archive.Read3dmObject(&pObject,&attributes,object_filter);
+        if ( rc == 0 )
+          break; // end of object table
+        if ( rc < 0 ) 
+        {
+          if ( error_log)
+          {
+            error_log->Print("ERROR: Object table entry %d is corrupt. (ON_BinaryArchive::Read3dmObject() < 0.)\n",count);
+            error_count++;
+            if ( error_count > max_error_count )
+              return false;
+            error_log->Print("-- Attempting to continue.\n");
+          }
+          continue;
+        }
+        if ( m_crc_error_count != BadCRCCount( archive ) ) 
+        {
+          if ( error_log)
+          {
+            error_log->Print("ERROR: Object table entry %d is corrupt. (CRC errors).\n",count);
+            error_log->Print("-- Attempting to continue.\n");
+          }
+          m_crc_error_count = BadCRCCount( archive );
+        }
+        if ( pObject ) 
+        {
+          // 20 June 2014 S. Baer
+          // The filtered Read3dmObject function does not appear to actually do filtering.
+          // While we wait for that to get fixed in OpenNURBS, just check the object type
+          // here and make sure it passes the filter test. This is being done here because
+          // Dan needs access to this funtionality with the currently available OpenNURBS
+          const ON_Geometry* pGeometry = ON_Geometry::Cast(pObject);
+          if( (0==object_filter || (pObject->ObjectType() & object_filter) != 0)
+              && (0==pGeometry || PassesRegionFilter(pGeometry->BoundingBox())) )
+          {
+            ONX_Model_Object& mo = m_object_table.AppendNew();
+            mo.m_object = pObject;
+            mo.m_bDeleteObject = true;
+            mo.m_attributes = attributes;
+          }
+          else
+          {
+            delete pObject;
+            pObject = 0;
+          }
+        }
+        else
+        {
+          if ( error_log)
+          {
+            if ( rc == 2 )
+              error_log->Print("WARNING: Skipping object table entry %d because it's filtered.\n",count);
+            else if ( rc == 3 )
+              error_log->Print("WARNING: Skipping object table entry %d because it's newer than this code.  Update your OpenNURBS toolkit.\n",count);
+            else
+              error_log->Print("WARNING: Skipping object table entry %d for unknown reason.\n",count);
+          }
+        }
+      }
+    }
+    
+    // If BeginRead3dmObjectTable() returns true, 
+    // then you MUST call EndRead3dmObjectTable().
+    if ( !archive.EndRead3dmObjectTable() )
+    {
+      if ( error_log) error_log->Print("ERROR: Corrupt object light table. (ON_BinaryArchive::EndRead3dmObjectTable() returned false.)\n");
+      return false;
+    }
+    if ( CheckForCRCErrors( BadCRCCount( archive ), *this, error_log, "object table" ) )
+      return_code = false;
+  }
+  else     
+  {
+    if ( error_log)
+    {
+      error_log->Print("WARNING: Missing or corrupt object table. (ON_BinaryArchive::BeginRead3dmObjectTable() returned false.)\n");
+      error_log->Print("-- Attempting to continue.\n");
+    }
+    return_code = false;
+  }
+
+  // STEP 16: Read history table
+  if ( archive.BeginRead3dmHistoryRecordTable() )
+  {
+    for( count = 0; true; count++ ) 
+    {
+      ON_HistoryRecord* pHistoryRecord = NULL;
+      rc = archive.Read3dmHistoryRecord(pHistoryRecord);
+      if ( rc == 0 )
+        break; // end of history record table
+      if ( rc < 0 ) 
+      {
+        if ( error_log)
+        {
+          error_log->Print("ERROR: History record table entry %d is corrupt. (ON_BinaryArchive::Read3dmHistoryRecord() < 0.)\n",count);
           error_count++;
           if ( error_count > max_error_count )
             return false;
           error_log->Print("-- Attempting to continue.\n");
         }
-        return_code = false;
+        continue;
+      }
+      if ( m_crc_error_count != BadCRCCount( archive ) ) 
+      {
+        if ( error_log)
+        {
+          error_log->Print("ERROR: History record table entry %d is corrupt. (CRC errors).\n",count);
+          error_log->Print("-- Attempting to continue.\n");
+        }
+        m_crc_error_count = BadCRCCount( archive );
+      }
+      if ( pHistoryRecord ) 
+      {
+        m_history_record_table.Append(pHistoryRecord);
+      }
+      else
+      {
+        if ( error_log)
+        {
+          error_log->Print("WARNING: Skipping history record table entry %d for unknown reason.\n",count);
+        }
       }
-      m_bitmap_table.Append(pBitmap);
     }
-
-    // If BeginRead3dmBitmapTable() returns true, 
-    // then you MUST call EndRead3dmBitmapTable().
-    if ( !archive.EndRead3dmBitmapTable() )
+    
+    // If BeginRead3dmHistoryRecordTable() returns true, 
+    // then you MUST call EndRead3dmHistoryRecordTable().
+    if ( !archive.EndRead3dmHistoryRecordTable() )
     {
-      if ( error_log) error_log->Print("ERROR: Corrupt bitmap table. (ON_BinaryArchive::EndRead3dmBitmapTable() returned false.)\n");
+      if ( error_log) error_log->Print("ERROR: Corrupt object light table. (ON_BinaryArchive::EndRead3dmObjectTable() returned false.)\n");
       return false;
     }
-    if ( CheckForCRCErrors( archive, *this, error_log, "bitmap table" ) )
+    if ( CheckForCRCErrors( BadCRCCount( archive ), *this, error_log, "history record table" ) )
       return_code = false;
   }
   else     
   {
-    if ( error_log) 
+    if ( error_log)
+    {
+      error_log->Print("WARNING: Missing or corrupt history record table. (ON_BinaryArchive::BeginRead3dmHistoryRecordTable() returned false.)\n");
+      error_log->Print("-- Attempting to continue.\n");
+    }
+    return_code = false;
+  }
+
+  // STEP 17: OPTIONAL - Read user tables as anonymous goo
+  // If you develop a plug-ins or application that uses OpenNURBS files,
+  // you can store anything you want in a user table.
+  for(count=0;true;count++)
+  {
+    if ( archive.Archive3dmVersion() <= 1 )
+    {
+      // no user tables in version 1 archives.
+      break;
+    }
+
+    {
+      ON__UINT32 tcode = 0;
+      ON__INT64 big_value = 0;
+      if ( !archive.PeekAt3dmBigChunkType(&tcode,&big_value) )
+        break;
+      if ( TCODE_USER_TABLE != tcode )
+        break;
+    }
+    ON_UUID plugin_id = ON_nil_uuid;
+    bool bGoo = false;
+    int usertable_3dm_version = 0;
+    int usertable_opennurbs_version = 0;
+    if ( !archive.BeginRead3dmUserTable( plugin_id, &bGoo, &usertable_3dm_version, &usertable_opennurbs_version ) )
+    {
+      // attempt to skip bogus user table
+      const ON__UINT64 pos0 = archive.CurrentPosition();
+      ON__UINT32 tcode = 0;
+      ON__INT64 big_value = 0;
+      if  ( !archive.BeginRead3dmBigChunk(&tcode,&big_value) )
+        break;
+      if ( !archive.EndRead3dmChunk() )
+        break;
+      const ON__UINT64 pos1 = archive.CurrentPosition();
+      if (pos1 <= pos0)
+        break;
+      if ( TCODE_USER_TABLE != tcode )
+        break;
+
+      continue; // skip this bogus user table
+    }
+
+    ONX_Model_UserData& ud = m_userdata_table.AppendNew();
+    ud.m_uuid = plugin_id;
+    ud.m_usertable_3dm_version = usertable_3dm_version;
+    ud.m_usertable_opennurbs_version = usertable_opennurbs_version;
+
+    if ( !archive.Read3dmAnonymousUserTable( usertable_3dm_version, usertable_opennurbs_version, ud.m_goo ) )
+    {
+      if ( error_log) error_log->Print("ERROR: User data table entry %d is corrupt. (ON_BinaryArchive::Read3dmAnonymousUserTable() is false.)\n",count);
+      break;
+    }
+
+    // If BeginRead3dmObjectTable() returns true, 
+    // then you MUST call EndRead3dmUserTable().
+    if ( !archive.EndRead3dmUserTable() )
+    {
+      if ( error_log) error_log->Print("ERROR: Corrupt user data table. (ON_BinaryArchive::EndRead3dmUserTable() returned false.)\n");
+      break;
+    }
+  }
+
+  // STEP 18: OPTIONAL - check for end mark
+  if ( !archive.Read3dmEndMark(&m_file_length) )
+  {
+    if ( archive.Archive3dmVersion() != 1 ) 
+    {
+      // some v1 files are missing end-of-archive markers
+      if ( error_log) error_log->Print("ERROR: ON_BinaryArchive::Read3dmEndMark(&m_file_length) returned false.\n");
+    }
+  }
+
+  // Remap layer, material, linetype, font, dimstyle, hatch pattern, etc., 
+  // indices so the correspond to the model's table array index.
+  //
+  // Polish also sets revision history information if it is missing.
+  // In this case, that is not appropriate so the value of
+  // m_properties.m_RevisionHistory is saved before calling Polish()
+  // and restored afterwards.
+  const ON_3dmRevisionHistory saved_revision_history(m_properties.m_RevisionHistory);
+  Polish();
+  m_properties.m_RevisionHistory = saved_revision_history;
+
+  return return_code;
+}
+
+bool ONX_Model_WithFilter::FilteredRead( const wchar_t* filename, unsigned int table_filter, unsigned int model_object_type_filter, ON_TextLog* error_log )
+{
+  return FilteredRead(filename, table_filter, model_object_type_filter, rfoNone, error_log);
+}
+
+bool ONX_Model_WithFilter::FilteredRead( const wchar_t* filename, unsigned int table_filter, unsigned int model_object_type_filter, unsigned int options, ON_TextLog* error_log )
+{
+  bool bCallDestroy = true;
+  bool rc = false;
+
+  if ( 0 != filename )
+  {
+    // Only reads on this thread are lazy, and only for this call
+    const bool bLazyUserData = 0 != (options & rfoLazyUserData);
+    CRhCmnLazyUserDataRead lazy_user_data(bLazyUserData);
+    CRhCmnMappedFile mapped_file;
+    if ( 0 != (options & (rfoMemoryMapped|rfoParallelObjectTable)) && mapped_file.Open(filename) )
+    {
+      // The mapping only has to outlive the archive. Everything read
+      // into the model is a copy.
+      ON_Read3dmBufferArchive archive(mapped_file.SizeOfBuffer(), mapped_file.Buffer(), false, 0, 0);
+      m_mapped_buffer = mapped_file.Buffer();
+      m_read_options = options;
+      rc = FilteredRead(archive, table_filter, model_object_type_filter, error_log);
+      m_mapped_buffer = NULL;
+      m_read_options = rfoNone;
+      bCallDestroy = false;
+    }
+    else
+    {
+      FILE* fp = ON::OpenFile(filename,L"rb");
+      if ( 0 != fp )
+      {
+        ON_BinaryFile file(ON::read3dm,fp);
+        rc = FilteredRead(file, table_filter, model_object_type_filter, error_log);
+        ON::CloseFile(fp);
+        bCallDestroy = false;
+      }
+    }
+    if( rc && bLazyUserData )
+      FinishLazyUserDataRead(*this);
+  }
+
+  if ( bCallDestroy )
+    Destroy();
+
+  return rc;
+}
+
+
+
+RH_C_FUNCTION ONX_Model* ONX_Model_ReadFile2(const RHMONO_STRING* path, ReadFileTableTypeFilter tableFilter, ObjectTypeFilter objectTypeFilter, CRhCmnStringHolder* pStringHolder)
+{
+  ONX_Model_WithFilter* rc = NULL;
+  if( path )
+  {
+    INPUTSTRINGCOERCE(_path, path);
+    rc = new ONX_Model_WithFilter();
+    ON_wString s;
+    ON_TextLog log(s);
+    ON_TextLog* pLog = pStringHolder ? &log : NULL;
+    unsigned int table_filter = (unsigned int)tableFilter;
+    unsigned int obj_filter = (unsigned int)objectTypeFilter;
+    if( !rc->FilteredRead(_path, table_filter, obj_filter, pLog) )
+    {
+      ONX_Model_Delete(rc);
+      rc = NULL;
+    }
+    if( pStringHolder )
+      pStringHolder->Set(s);
+  }
+  return rc;
+}
+
+RH_C_FUNCTION ONX_Model* ONX_Model_ReadFile3(const RHMONO_STRING* path, ReadFileTableTypeFilter tableFilter, ObjectTypeFilter objectTypeFilter, ReadFileOptions options, CRhCmnStringHolder* pStringHolder)
+{
+  ONX_Model_WithFilter* rc = NULL;
+  if( path )
+  {
+    INPUTSTRINGCOERCE(_path, path);
+    rc = new ONX_Model_WithFilter();
+    ON_wString s;
+    ON_TextLog log(s);
+    ON_TextLog* pLog = pStringHolder ? &log : NULL;
+    unsigned int table_filter = (unsigned int)tableFilter;
+    unsigned int obj_filter = (unsigned int)objectTypeFilter;
+    if( !rc->FilteredRead(_path, table_filter, obj_filter, (unsigned int)options, pLog) )
     {
-      error_log->Print("WARNING: Missing or corrupt bitmap table. (ON_BinaryArchive::BeginRead3dmBitmapTable() returned false.)\n");
-      error_log->Print("-- Attempting to continue.\n");
+      ONX_Model_Delete(rc);
+      rc = NULL;
     }
-    return_code = false;
+    if( pStringHolder )
+      pStringHolder->Set(s);
   }
+  return rc;
+}
+
+// Forward-only cursor over the object table of a 3dm file. Only the object
+// currently being handed out is ever in memory, so a file of any size can
+// be visited with a roughly constant footprint.
+class CRhCmnObjectCursor
+{
+public:
+  CRhCmnObjectCursor();
+  ~CRhCmnObjectCursor();
 
+  bool Open( const wchar_t* filename, unsigned int object_filter, bool bMemoryMapped );
+  void Close();
 
+  // Returns the next geometric object that passes the filter or NULL at the
+  // end of the table. The caller owns the returned object.
+  ON_Geometry* Next( ON_3dmObjectAttributes* pAttributes, int* table_index );
 
-  // STEP 5: REQUIRED - Read texture mapping table
-  if ( archive.BeginRead3dmTextureMappingTable() )
+private:
+  CRhCmnObjectCursor(const CRhCmnObjectCursor&);
+  CRhCmnObjectCursor& operator=(const CRhCmnObjectCursor&);
+
+  bool SeekToObjectTable();
+
+  FILE* m_fp;
+  CRhCmnMappedFile m_mapped_file;
+  ON_BinaryArchive* m_archive;
+  unsigned int m_object_filter;
+  int m_table_index; // index of the next record in the object table
+  int m_error_count;
+  bool m_bInObjectTable;
+};
+
+CRhCmnObjectCursor::CRhCmnObjectCursor()
+: m_fp(NULL)
+, m_archive(NULL)
+, m_object_filter(0)
+, m_table_index(0)
+, m_error_count(0)
+, m_bInObjectTable(false)
+{
+}
+
+CRhCmnObjectCursor::~CRhCmnObjectCursor()
+{
+  Close();
+}
+
+void CRhCmnObjectCursor::Close()
+{
+  if( m_archive )
   {
-    ON_TextureMapping* pTextureMapping = NULL;
-    for( count = 0; true; count++ ) 
-    {
-      rc = archive.Read3dmTextureMapping(&pTextureMapping);
-      if ( rc==0 )
-        break; // end of texture_mapping table
-      if ( rc < 0 ) 
-      {
-        if ( error_log) 
-        {
-          error_log->Print("ERROR: Corrupt render texture_mapping found. (ON_BinaryArchive::Read3dmTextureMapping() < 0.)\n");
-          error_count++;
-          if ( error_count > max_error_count )
-            return false;
-          error_log->Print("-- Attempting to continue.\n");
-        }
-        continue;
-      }
-      ON_UserDataHolder ud;
-      ud.MoveUserDataFrom(*pTextureMapping);
-      m_mapping_table.Append(*pTextureMapping);
-      pTextureMapping->m_mapping_index = count;
-      ud.MoveUserDataTo(*m_mapping_table.Last(),false);
-      delete pTextureMapping;
-      pTextureMapping = NULL;
-    }
-    
-    // If BeginRead3dmTextureMappingTable() returns true, 
-    // then you MUST call EndRead3dmTextureMappingTable().
-    if ( !archive.EndRead3dmTextureMappingTable() )
-    {
-      if ( error_log) error_log->Print("ERROR: Corrupt render texture_mapping table. (ON_BinaryArchive::EndRead3dmTextureMappingTable() returned false.)\n");
-      return false;
-    }
-    if ( CheckForCRCErrors( archive, *this, error_log, "render texture_mapping table" ) )
-      return_code = false;
+    if( m_bInObjectTable )
+      m_archive->EndRead3dmObjectTable();
+    delete m_archive;
   }
-  else     
+  m_archive = NULL;
+  m_bInObjectTable = false;
+  if( m_fp )
+    ON::CloseFile(m_fp);
+  m_fp = NULL;
+  m_mapped_file.Close();
+}
+
+bool CRhCmnObjectCursor::Open( const wchar_t* filename, unsigned int object_filter, bool bMemoryMapped )
+{
+  Close();
+  m_object_filter = object_filter;
+  m_table_index = 0;
+  m_error_count = 0;
+
+  if( bMemoryMapped && m_mapped_file.Open(filename) )
+    m_archive = new ON_Read3dmBufferArchive(m_mapped_file.SizeOfBuffer(), m_mapped_file.Buffer(), false, 0, 0);
+  else
   {
-    if ( error_log)
-    {
-      error_log->Print("WARNING: Missing or corrupt render texture_mapping table. (ON_BinaryArchive::BeginRead3dmTextureMappingTable() returned false.)\n");
-      error_log->Print("-- Attempting to continue.\n");
-    }
-    return_code = false;
+    m_fp = ON::OpenFile(filename, L"rb");
+    if( m_fp )
+      m_archive = new ON_BinaryFile(ON::read3dm, m_fp);
   }
 
-
-  // STEP 6: REQUIRED - Read render material table
-  if ( archive.BeginRead3dmMaterialTable() )
+  if( NULL==m_archive || !SeekToObjectTable() )
   {
-    ON_Material* pMaterial = NULL;
-    for( count = 0; true; count++ ) 
-    {
-      rc = archive.Read3dmMaterial(&pMaterial);
-      if ( rc==0 )
-        break; // end of material table
-      if ( rc < 0 ) 
-      {
-        if ( error_log) 
-        {
-          error_log->Print("ERROR: Corrupt render material found. (ON_BinaryArchive::Read3dmMaterial() < 0.)\n");
-          error_count++;
-          if ( error_count > max_error_count )
-            return false;
-          error_log->Print("-- Attempting to continue.\n");
-        }
-        pMaterial = new ON_Material; // use default
-        pMaterial->m_material_index = count;
-      }
-      ON_UserDataHolder ud;
-      ud.MoveUserDataFrom(*pMaterial);
-      m_material_table.Append(*pMaterial);
-      ud.MoveUserDataTo(*m_material_table.Last(),false);
-      delete pMaterial;
-      pMaterial = NULL;
-    }
-    
-    // If BeginRead3dmMaterialTable() returns true, 
-    // then you MUST call EndRead3dmMaterialTable().
-    if ( !archive.EndRead3dmMaterialTable() )
-    {
-      if ( error_log) error_log->Print("ERROR: Corrupt render material table. (ON_BinaryArchive::EndRead3dmMaterialTable() returned false.)\n");
-      return false;
-    }
-    if ( CheckForCRCErrors( archive, *this, error_log, "render material table" ) )
-      return_code = false;
+    Close();
+    return false;
   }
-  else     
+  return true;
+}
+
+bool CRhCmnObjectCursor::SeekToObjectTable()
+{
+  int version = 0;
+  ON_String comments;
+  if( !m_archive->Read3dmStartSection(&version, comments) )
+    return false;
+  // Version 1 files do not have an object table
+  if( m_archive->Archive3dmVersion() < 2 )
+    return false;
+
+  // The properties carry the opennurbs version that wrote the file, which
+  // object readers depend on, so they are read. Every other table in front
+  // of the object table is skipped without being parsed.
+  ON_3dmProperties properties;
+  if( !m_archive->Read3dmProperties(properties) )
+    return false;
+
+  for(;;)
   {
-    if ( error_log)
-    {
-      error_log->Print("WARNING: Missing or corrupt render material table. (ON_BinaryArchive::BeginRead3dmMaterialTable() returned false.)\n");
-      error_log->Print("-- Attempting to continue.\n");
-    }
-    return_code = false;
+    ON__UINT32 tcode = 0;
+    ON__INT64 big_value = 0;
+    if( !m_archive->PeekAt3dmBigChunkType(&tcode, &big_value) )
+      return false;
+    if( TCODE_OBJECT_TABLE==tcode )
+      break;
+    if( TCODE_ENDOFFILE==tcode )
+      return false;
+    const ON__UINT64 pos0 = m_archive->CurrentPosition();
+    if( !m_archive->BeginRead3dmBigChunk(&tcode, &big_value) )
+      return false;
+    if( !m_archive->EndRead3dmChunk() )
+      return false;
+    if( m_archive->CurrentPosition() <= pos0 )
+      return false;
   }
 
+  m_bInObjectTable = m_archive->BeginRead3dmObjectTable();
+  return m_bInObjectTable;
+}
 
-  // STEP 7: REQUIRED - Read line type table
-  if ( archive.BeginRead3dmLinetypeTable() )
+ON_Geometry* CRhCmnObjectCursor::Next( ON_3dmObjectAttributes* pAttributes, int* table_index )
+{
+  const int max_error_count = 2000;
+  ON_3dmObjectAttributes attributes;
+  while( m_bInObjectTable )
   {
-    ON_Linetype* pLinetype = NULL;
-    for( count = 0; true; count++ ) 
+    ON_Object* pObject = NULL;
+    const int index = m_table_index++;
+    const int rc = ReadObjectRecord(*m_archive, &pObject, &attributes, m_object_filter, NULL);
+    if( 0==rc )
+      break;
+    if( rc < 0 )
     {
-      rc = archive.Read3dmLinetype(&pLinetype);
-      if ( rc==0 )
-        break; // end of linetype table
-      if ( rc < 0 ) 
-      {
-        if ( error_log) 
-        {
-          error_log->Print("ERROR: Corrupt render linetype found. (ON_BinaryArchive::Read3dmLinetype() < 0.)\n");
-          error_count++;
-          if ( error_count > max_error_count )
-            return false;
-          error_log->Print("-- Attempting to continue.\n");
-        }
-        pLinetype = new ON_Linetype; // use default
-        pLinetype->m_linetype_index = count;
-      }
-      ON_UserDataHolder ud;
-      ud.MoveUserDataFrom(*pLinetype);
-      m_linetype_table.Append(*pLinetype);
-      ud.MoveUserDataTo(*m_linetype_table.Last(),false);
-      delete pLinetype;
-      pLinetype = NULL;
+      if( ++m_error_count > max_error_count )
+        break;
+      continue;
     }
-    
-    // If BeginRead3dmLinetypeTable() returns true, 
-    // then you MUST call EndRead3dmLinetypeTable().
-    if ( !archive.EndRead3dmLinetypeTable() )
+    ON_Geometry* pGeometry = ON_Geometry::Cast(pObject);
+    if( pGeometry )
     {
-      if ( error_log) error_log->Print("ERROR: Corrupt render linetype table. (ON_BinaryArchive::EndRead3dmLinetypeTable() returned false.)\n");
-      return false;
+      if( pAttributes )
+        *pAttributes = attributes;
+      if( table_index )
+        *table_index = index;
+      return pGeometry;
     }
-    if ( CheckForCRCErrors( archive, *this, error_log, "render linetype table" ) )
-      return_code = false;
+    if( pObject )
+      delete pObject;
   }
-  else     
+
+  // End of table or too many errors
+  if( m_bInObjectTable )
   {
-    if ( error_log)
-    {
-      error_log->Print("WARNING: Missing or corrupt render linetype table. (ON_BinaryArchive::BeginRead3dmLinetypeTable() returned false.)\n");
-      error_log->Print("-- Attempting to continue.\n");
-    }
-    return_code = false;
+    m_archive->EndRead3dmObjectTable();
+    m_bInObjectTable = false;
   }
+  return NULL;
+}
 
-  // STEP 8: REQUIRED - Read layer table
-  if ( archive.BeginRead3dmLayerTable() )
+RH_C_FUNCTION CRhCmnObjectCursor* ONX_Model_ObjectCursor_Open(const RHMONO_STRING* path, ObjectTypeFilter objectTypeFilter, bool memoryMapped)
+{
+  CRhCmnObjectCursor* rc = NULL;
+  if( path )
   {
-    ON_Layer* pLayer = NULL;
-    for( count = 0; true; count++ ) 
-    {
-      pLayer = NULL;
-      rc = archive.Read3dmLayer(&pLayer);
-      if ( rc==0 )
-        break; // end of layer table
-      if ( rc < 0 ) 
-      {
-        if ( error_log)
-        {
-          error_log->Print("ERROR: Corrupt layer found. (ON_BinaryArchive::Read3dmLayer() < 0.)\n");
-          error_count++;
-          if ( error_count > max_error_count )
-            return false;
-          error_log->Print("-- Attempting to continue.\n");
-        }
-        pLayer = new ON_Layer; // use default
-        pLayer->m_layer_index = count;
-      }
-      ON_UserDataHolder ud;
-      ud.MoveUserDataFrom(*pLayer);
-      m_layer_table.Append(*pLayer);
-      ud.MoveUserDataTo(*m_layer_table.Last(),false);
-      delete pLayer;
-      pLayer = NULL;
-    }
-    
-    // If BeginRead3dmLayerTable() returns true, 
-    // then you MUST call EndRead3dmLayerTable().
-    if ( !archive.EndRead3dmLayerTable() )
+    INPUTSTRINGCOERCE(_path, path);
+    rc = new CRhCmnObjectCursor();
+    if( !rc->Open(_path, (unsigned int)objectTypeFilter, memoryMapped) )
     {
-      if ( error_log) error_log->Print("ERROR: Corrupt render layer table. (ON_BinaryArchive::EndRead3dmLayerTable() returned false.)\n");
-      return false;
+      delete rc;
+      rc = NULL;
     }
-    if ( CheckForCRCErrors( archive, *this, error_log, "layer table" ) )
-      return_code = false;
   }
-  else     
+  return rc;
+}
+
+// Returns NULL when there are no more objects. The returned geometry is
+// owned by the caller and must be freed with ON_Object_Delete. pAttributes,
+// when not NULL, receives a copy of the object's attributes.
+RH_C_FUNCTION ON_Geometry* ONX_Model_ObjectCursor_Next(CRhCmnObjectCursor* pCursor, ON_3dmObjectAttributes* pAttributes, int* tableIndex)
+{
+  ON_Geometry* rc = NULL;
+  if( pCursor )
+    rc = pCursor->Next(pAttributes, tableIndex);
+  return rc;
+}
+
+RH_C_FUNCTION void ONX_Model_ObjectCursor_Close(CRhCmnObjectCursor* pCursor)
+{
+  if( pCursor )
+    delete pCursor;
+}
+
+static bool SeekFileFromStart( FILE* fp, ON__UINT64 offset )
+{
+#if defined(_WIN32)
+  return 0 == _fseeki64(fp, (__int64)offset, SEEK_SET);
+#else
+  return 0 == fseeko(fp, (off_t)offset, SEEK_SET);
+#endif
+}
+
+/*
+Table of contents of a 3dm archive: the absolute offset of every top level
+chunk (start of each table) plus one entry per object record. The index is
+built with a single pass over the file and can be saved next to it. With
+it, any object can be read by slicing its record straight out of the file.
+*/
+class CRhCmnArchiveIndex
+{
+public:
+  CRhCmnArchiveIndex();
+  ~CRhCmnArchiveIndex();
+
+  bool Build( const wchar_t* filename );
+  bool WriteSidecar( const wchar_t* sidecar_filename ) const;
+  bool ReadSidecar( const wchar_t* sidecar_filename, const wchar_t* filename );
+
+  // Thread safe when the source file is memory mapped.
+  ON_Geometry* ReadObject( int index, ON_3dmObjectAttributes* pAttributes ) const;
+
+  int m_3dm_version;
+  int m_opennurbs_version;
+  ON__UINT64 m_file_size;
+  ON__UINT64 m_file_time; // last modified time when the index was built
+  ON_SimpleArray<ON__UINT32> m_table_typecode;
+  ON_SimpleArray<ON__UINT64> m_table_offset;
+  ON_SimpleArray<CRhCmnObjectIndexEntry> m_objects;
+
+private:
+  CRhCmnArchiveIndex(const CRhCmnArchiveIndex&);
+  CRhCmnArchiveIndex& operator=(const CRhCmnArchiveIndex&);
+
+  bool OpenSource( const wchar_t* filename );
+  void CloseSource();
+
+  CRhCmnMappedFile m_mapped_file;
+  FILE* m_fp;
+};
+
+// Identifies a sidecar written by CRhCmnArchiveIndex::WriteSidecar
+// {C5E3E0B7-4F3A-4E84-9C4B-2D6B0D8A1F10}
+static const ON_UUID ArchiveIndexSidecarId = { 0xc5e3e0b7, 0x4f3a, 0x4e84, { 0x9c, 0x4b, 0x2d, 0x6b, 0x0d, 0x8a, 0x1f, 0x10 } };
+
+CRhCmnArchiveIndex::CRhCmnArchiveIndex()
+: m_3dm_version(0)
+, m_opennurbs_version(0)
+, m_file_size(0)
+, m_file_time(0)
+, m_fp(NULL)
+{
+}
+
+CRhCmnArchiveIndex::~CRhCmnArchiveIndex()
+{
+  CloseSource();
+}
+
+bool CRhCmnArchiveIndex::OpenSource( const wchar_t* filename )
+{
+  CloseSource();
+  if( m_mapped_file.Open(filename) )
+    return true;
+  m_fp = ON::OpenFile(filename, L"rb");
+  return NULL != m_fp;
+}
+
+void CRhCmnArchiveIndex::CloseSource()
+{
+  m_mapped_file.Close();
+  if( m_fp )
+    ON::CloseFile(m_fp);
+  m_fp = NULL;
+}
+
+static bool GetSourceFileStats( const wchar_t* filename, ON__UINT64* file_size, ON__UINT64* file_time )
+{
+  bool rc = false;
+  FILE* fp = ON::OpenFile(filename, L"rb");
+  if( fp )
   {
-    if ( error_log) 
-    {
-      error_log->Print("WARNING: Missing or corrupt layer table. (ON_BinaryArchive::BeginRead3dmLayerTable() returned false.)\n");
-      error_log->Print("-- Attempting to continue.\n");
-    }
-    return_code = false;
+    size_t sz = 0;
+    time_t create_time = 0;
+    time_t modify_time = 0;
+    rc = ON::GetFileStats(fp, &sz, &create_time, &modify_time);
+    *file_size = (ON__UINT64)sz;
+    *file_time = (ON__UINT64)modify_time;
+    ON::CloseFile(fp);
   }
+  return rc;
+}
 
-  // STEP 9: REQUIRED - Read group table
-  if ( archive.BeginRead3dmGroupTable() )
+bool CRhCmnArchiveIndex::Build( const wchar_t* filename )
+{
+  m_table_typecode.Empty();
+  m_table_offset.Empty();
+  m_objects.Empty();
+  if( !GetSourceFileStats(filename, &m_file_size, &m_file_time) || !OpenSource(filename) )
+    return false;
+
+  ON_BinaryArchive* archive = NULL;
+  if( m_mapped_file.Buffer() )
+    archive = new ON_Read3dmBufferArchive(m_mapped_file.SizeOfBuffer(), m_mapped_file.Buffer(), false, 0, 0);
+  else
+    archive = new ON_BinaryFile(ON::read3dm, m_fp);
+
+  bool rc = false;
+  int version = 0;
+  ON_String comments;
+  if( archive->Read3dmStartSection(&version, comments) && archive->Archive3dmVersion() >= 2 )
   {
-    ON_Group* pGroup = NULL;
-    for( count = 0; true; count++ ) 
+    for(;;)
     {
-      rc = archive.Read3dmGroup(&pGroup);
-      if ( rc==0 )
-        break; // end of group table
-      if ( rc < 0 ) 
+      ON__UINT32 tcode = 0;
+      ON__INT64 big_value = 0;
+      const ON__UINT64 pos0 = archive->CurrentPosition();
+      if( !archive->PeekAt3dmBigChunkType(&tcode, &big_value) )
+        break;
+      m_table_typecode.Append(tcode);
+      m_table_offset.Append(pos0);
+      if( TCODE_ENDOFFILE==tcode )
       {
-        if ( error_log)
+        rc = true;
+        break;
+      }
+
+      if( TCODE_PROPERTIES_TABLE==tcode )
+      {
+        ON_3dmProperties properties;
+        if( !archive->Read3dmProperties(properties) )
+          break;
+      }
+      else if( TCODE_OBJECT_TABLE==tcode )
+      {
+        if( !archive->BeginRead3dmObjectTable() )
+          break;
+        for(;;)
         {
-          error_log->Print("ERROR: Corrupt group found. (ON_BinaryArchive::Read3dmGroup() < 0.)\n");
-          error_count++;
-          if ( error_count > max_error_count )
-            return false;
-          error_log->Print("-- Attempting to continue.\n");
+          ON_Object* pObject = NULL;
+          ON_3dmObjectAttributes attributes;
+          unsigned int object_type = 0;
+          const ON__UINT64 record_pos0 = archive->CurrentPosition();
+          const int read_rc = ReadObjectRecord(*archive, &pObject, &attributes, 0, &object_type);
+          const ON__UINT64 record_pos1 = archive->CurrentPosition();
+          if( 0==read_rc || record_pos1 <= record_pos0 )
+            break;
+          // Records that fail to read still get an entry so entry i stays
+          // object table record i. Those entries have a nil uuid, no layer
+          // and an unset box.
+          CRhCmnObjectIndexEntry& entry = m_objects.AppendNew();
+          entry.m_offset = record_pos0;
+          entry.m_size = record_pos1 - record_pos0;
+          entry.m_uuid = read_rc > 0 ? attributes.m_uuid : ON_nil_uuid;
+          entry.m_object_type = object_type;
+          entry.m_layer_index = read_rc > 0 ? attributes.m_layer_index : -1;
+          entry.m_bbox.Destroy();
+          const ON_Geometry* pGeometry = ON_Geometry::Cast(pObject);
+          if( read_rc > 0 && pGeometry )
+            entry.m_bbox = pGeometry->BoundingBox();
+          if( pObject )
+            delete pObject;
         }
-        pGroup = new ON_Group; // use default
-        pGroup->m_group_index = -1;
+        if( !archive->EndRead3dmObjectTable() )
+          break;
       }
-      ON_UserDataHolder ud;
-      ud.MoveUserDataFrom(*pGroup);
-      m_group_table.Append(*pGroup);
-      ud.MoveUserDataTo(*m_group_table.Last(),false);
-      delete pGroup;
-      pGroup = NULL;
-    }
-    
-    // If BeginRead3dmGroupTable() returns true, 
-    // then you MUST call EndRead3dmGroupTable().
-    if ( !archive.EndRead3dmGroupTable() )
-    {
-      if ( error_log) error_log->Print("ERROR: Corrupt group table. (ON_BinaryArchive::EndRead3dmGroupTable() returned false.)\n");
-      return false;
+      else
+      {
+        if( !archive->BeginRead3dmBigChunk(&tcode, &big_value) || !archive->EndRead3dmChunk() )
+          break;
+      }
+      if( archive->CurrentPosition() <= pos0 )
+        break;
     }
-    if ( CheckForCRCErrors( archive, *this, error_log, "group table" ) )
-      return_code = false;
   }
-  else     
+  m_3dm_version = archive->Archive3dmVersion();
+  m_opennurbs_version = archive->ArchiveOpenNURBSVersion();
+  delete archive;
+  return rc;
+}
+
+bool CRhCmnArchiveIndex::WriteSidecar( const wchar_t* sidecar_filename ) const
+{
+  FILE* fp = ON::OpenFile(sidecar_filename, L"wb");
+  if( NULL==fp )
+    return false;
+  bool rc = false;
   {
-    if ( error_log) 
+    ON_BinaryFile file(ON::write, fp);
+    if( file.BeginWrite3dmChunk(TCODE_ANONYMOUS_CHUNK, 1, 0) )
     {
-      error_log->Print("WARNING: Missing or corrupt group table. (ON_BinaryArchive::BeginRead3dmGroupTable() returned false.)\n");
-      error_log->Print("-- Attempting to continue.\n");
+      rc = file.WriteUuid(ArchiveIndexSidecarId)
+        && file.WriteInt(m_3dm_version)
+        && file.WriteInt(m_opennurbs_version)
+        && file.WriteBigInt(m_file_size)
+        && file.WriteBigInt(m_file_time)
+        && file.WriteInt(m_table_typecode.Count());
+      for( int i=0; rc && i<m_table_typecode.Count(); i++ )
+        rc = file.WriteInt((int)m_table_typecode[i]) && file.WriteBigInt(m_table_offset[i]);
+      rc = rc && file.WriteInt(m_objects.Count());
+      for( int i=0; rc && i<m_objects.Count(); i++ )
+      {
+        const CRhCmnObjectIndexEntry& entry = m_objects[i];
+        rc = file.WriteBigInt(entry.m_offset)
+          && file.WriteBigInt(entry.m_size)
+          && file.WriteUuid(entry.m_uuid)
+          && file.WriteInt((int)entry.m_object_type)
+          && file.WriteInt(entry.m_layer_index)
+          && file.WriteDouble(3, &entry.m_bbox.m_min.x)
+          && file.WriteDouble(3, &entry.m_bbox.m_max.x);
+      }
+      if( !file.EndWrite3dmChunk() )
+        rc = false;
     }
-    return_code = false;
   }
+  ON::CloseFile(fp);
+  return rc;
+}
 
-  // STEP 10: REQUIRED - Read font table
-  if ( archive.BeginRead3dmFontTable() )
+bool CRhCmnArchiveIndex::ReadSidecar( const wchar_t* sidecar_filename, const wchar_t* filename )
+{
+  m_table_typecode.Empty();
+  m_table_offset.Empty();
+  m_objects.Empty();
+
+  ON__UINT64 file_size = 0;
+  ON__UINT64 file_time = 0;
+  if( !GetSourceFileStats(filename, &file_size, &file_time) )
+    return false;
+
+  FILE* fp = ON::OpenFile(sidecar_filename, L"rb");
+  if( NULL==fp )
+    return false;
+  bool rc = false;
   {
-    ON_Font* pFont = NULL;
-    for( count = 0; true; count++ ) 
+    ON_BinaryFile file(ON::read, fp);
+    int major = 0, minor = 0;
+    ON__UINT32 tcode = 0;
+    ON__INT64 big_value = 0;
+    if( file.BeginRead3dmBigChunk(&tcode, &big_value) )
     {
-      rc = archive.Read3dmFont(&pFont);
-      if ( rc==0 )
-        break; // end of font table
-      if ( rc < 0 ) 
+      ON_UUID id = ON_nil_uuid;
+      int table_count = 0;
+      int object_count = 0;
+      rc = TCODE_ANONYMOUS_CHUNK==tcode
+        && file.Read3dmChunkVersion(&major, &minor) && 1==major
+        && file.ReadUuid(id) && id==ArchiveIndexSidecarId
+        && file.ReadInt(&m_3dm_version)
+        && file.ReadInt(&m_opennurbs_version)
+        && file.ReadBigInt(&m_file_size)
+        && file.ReadBigInt(&m_file_time)
+        && m_file_size==file_size && m_file_time==file_time // stale index
+        && file.ReadInt(&table_count) && table_count>=0;
+      for( int i=0; rc && i<table_count; i++ )
       {
-        if ( error_log)
-        {
-          error_log->Print("ERROR: Corrupt font found. (ON_BinaryArchive::Read3dmFont() < 0.)\n");
-          error_count++;
-          if ( error_count > max_error_count )
-            return false;
-          error_log->Print("-- Attempting to continue.\n");
-        }
-        pFont = new ON_Font; // use default
-        pFont->m_font_index = -1;
+        int typecode = 0;
+        ON__UINT64 offset = 0;
+        rc = file.ReadInt(&typecode) && file.ReadBigInt(&offset);
+        m_table_typecode.Append((ON__UINT32)typecode);
+        m_table_offset.Append(offset);
       }
-      ON_UserDataHolder ud;
-      ud.MoveUserDataFrom(*pFont);
-      m_font_table.Append(*pFont);
-      ud.MoveUserDataTo(*m_font_table.Last(),false);
-      delete pFont;
-      pFont = NULL;
-    }
-    
-    // If BeginRead3dmFontTable() returns true, 
-    // then you MUST call EndRead3dmFontTable().
-    if ( !archive.EndRead3dmFontTable() )
-    {
-      if ( error_log) error_log->Print("ERROR: Corrupt font table. (ON_BinaryArchive::EndRead3dmFontTable() returned false.)\n");
-      return false;
+      // Every entry takes 88 bytes (two 64 bit offsets, a uuid, two ints and
+      // six doubles), so a count the chunk cannot hold is corrupt and must
+      // not size the allocation.
+      const ON__UINT64 sizeof_entry = 88;
+      rc = rc && file.ReadInt(&object_count) && object_count>=0
+        && big_value >= 0 && (ON__UINT64)object_count*sizeof_entry <= (ON__UINT64)big_value;
+      if( rc )
+        m_objects.Reserve(object_count);
+      for( int i=0; rc && i<object_count; i++ )
+      {
+        CRhCmnObjectIndexEntry& entry = m_objects.AppendNew();
+        int object_type = 0;
+        rc = file.ReadBigInt(&entry.m_offset)
+          && file.ReadBigInt(&entry.m_size)
+          && file.ReadUuid(entry.m_uuid)
+          && file.ReadInt(&object_type)
+          && file.ReadInt(&entry.m_layer_index)
+          && file.ReadDouble(3, &entry.m_bbox.m_min.x)
+          && file.ReadDouble(3, &entry.m_bbox.m_max.x);
+        entry.m_object_type = (unsigned int)object_type;
+      }
+      if( !file.EndRead3dmChunk() )
+        rc = false;
     }
-    if ( CheckForCRCErrors( archive, *this, error_log, "font table" ) )
-      return_code = false;
   }
-  else     
+  ON::CloseFile(fp);
+
+  if( rc )
+    rc = OpenSource(filename);
+  if( !rc )
   {
-    if ( error_log)
-    {
-      error_log->Print("WARNING: Missing or corrupt font table. (ON_BinaryArchive::BeginRead3dmFontTable() returned false.)\n");
-      error_log->Print("-- Attempting to continue.\n");
-    }
-    return_code = false;
+    m_table_typecode.Empty();
+    m_table_offset.Empty();
+    m_objects.Empty();
   }
+  return rc;
+}
 
-  // STEP 11: REQUIRED - Read dimstyle table
-  if ( archive.BeginRead3dmDimStyleTable() )
+ON_Geometry* CRhCmnArchiveIndex::ReadObject( int index, ON_3dmObjectAttributes* pAttributes ) const
+{
+  if( index < 0 || index >= m_objects.Count() )
+    return NULL;
+  const CRhCmnObjectIndexEntry& entry = m_objects[index];
+  if( entry.m_offset + entry.m_size > m_file_size || entry.m_size > (ON__UINT64)((size_t)-1) )
+    return NULL;
+
+  const unsigned char* record = NULL;
+  ON_SimpleArray<unsigned char> record_buffer;
+  if( m_mapped_file.Buffer() )
   {
-    ON_DimStyle* pDimStyle = NULL;
-    for( count = 0; true; count++ ) 
-    {
-      rc = archive.Read3dmDimStyle(&pDimStyle);
-      if ( rc==0 )
-        break; // end of dimstyle table
-      if ( rc < 0 ) 
-      {
-        if ( error_log)
-        {
-          error_log->Print("ERROR: Corrupt dimstyle found. (ON_BinaryArchive::Read3dmDimStyle() < 0.)\n");
-          error_count++;
-          if ( error_count > max_error_count )
-            return false;
-          error_log->Print("-- Attempting to continue.\n");
-        }
-        pDimStyle = new ON_DimStyle; // use default
-        pDimStyle->m_dimstyle_index = count;
-      }
-      ON_UserDataHolder ud;
-      ud.MoveUserDataFrom(*pDimStyle);
-      m_dimstyle_table.Append(*pDimStyle);
-      ud.MoveUserDataTo(*m_dimstyle_table.Last(),false);
-      delete pDimStyle;
-      pDimStyle = NULL;
-    }
-    
-    // If BeginRead3dmDimStyleTable() returns true, 
-    // then you MUST call EndRead3dmDimStyleTable().
-    if ( !archive.EndRead3dmDimStyleTable() )
-    {
-      if ( error_log) error_log->Print("ERROR: Corrupt dimstyle table. (ON_BinaryArchive::EndRead3dmDimStyleTable() returned false.)\n");
-      return false;
-    }
-    if ( CheckForCRCErrors( archive, *this, error_log, "dimstyle table" ) )
-      return_code = false;
+    if( entry.m_offset + entry.m_size > (ON__UINT64)m_mapped_file.SizeOfBuffer() )
+      return NULL;
+    record = m_mapped_file.Buffer() + entry.m_offset;
   }
-  else     
+  else if( m_fp )
   {
-    if ( error_log)
-    {
-      error_log->Print("WARNING: Missing or corrupt dimstyle table. (ON_BinaryArchive::BeginRead3dmDimStyleTable() returned false.)\n");
-      error_log->Print("-- Attempting to continue.\n");
-    }
-    return_code = false;
+    record_buffer.SetCapacity((int)entry.m_size);
+    record_buffer.SetCount((int)entry.m_size);
+    if( !SeekFileFromStart(m_fp, entry.m_offset) )
+      return NULL;
+    if( fread(record_buffer.Array(), 1, (size_t)entry.m_size, m_fp) != (size_t)entry.m_size )
+      return NULL;
+    record = record_buffer.Array();
   }
+  if( NULL==record )
+    return NULL;
 
-  // STEP 12: REQUIRED - Read render lights table
-  if ( archive.BeginRead3dmLightTable() )
+  ON_Object* pObject = NULL;
+  ON_3dmObjectAttributes attributes;
+  ON_Read3dmBufferArchive archive((size_t)entry.m_size, record, false, m_3dm_version, m_opennurbs_version);
+  ReadObjectRecord(archive, &pObject, &attributes, 0, NULL);
+  ON_Geometry* rc = ON_Geometry::Cast(pObject);
+  if( rc )
   {
-    ON_Light* pLight = NULL;
-    ON_3dmObjectAttributes object_attributes;
-    for( count = 0; true; count++ ) 
+    if( pAttributes )
+      *pAttributes = attributes;
+  }
+  else if( pObject )
+    delete pObject;
+  return rc;
+}
+
+RH_C_FUNCTION CRhCmnArchiveIndex* ONX_Model_ArchiveIndex_Build(const RHMONO_STRING* path)
+{
+  CRhCmnArchiveIndex* rc = NULL;
+  if( path )
+  {
+    INPUTSTRINGCOERCE(_path, path);
+    rc = new CRhCmnArchiveIndex();
+    if( !rc->Build(_path) )
     {
-      object_attributes.Default();
-      rc = archive.Read3dmLight(&pLight,&object_attributes);
-      if ( rc==0 )
-        break; // end of light table
-      if ( rc < 0 ) 
-      {
-        if ( error_log)
-        {
-          error_log->Print("ERROR: Corrupt render light found. (ON_BinaryArchive::Read3dmLight() < 0.)\n");
-          error_count++;
-          if ( error_count > max_error_count )
-            return false;
-          error_log->Print("-- Attempting to continue.\n");
-        }
-        continue;
-      }
-      ONX_Model_RenderLight& light = m_light_table.AppendNew();
-      ON_UserDataHolder ud;
-      ud.MoveUserDataFrom(*pLight);
-      light.m_light = *pLight;
-      ud.MoveUserDataTo(light.m_light,false);
-      light.m_attributes = object_attributes;
-      delete pLight;
-      pLight = NULL;
+      delete rc;
+      rc = NULL;
     }
-    
-    // If BeginRead3dmLightTable() returns true, 
-    // then you MUST call EndRead3dmLightTable().
-    if ( !archive.EndRead3dmLightTable() )
+  }
+  return rc;
+}
+
+// Returns NULL if the sidecar is missing, damaged or was built from a
+// different version of the file at path.
+RH_C_FUNCTION CRhCmnArchiveIndex* ONX_Model_ArchiveIndex_ReadSidecar(const RHMONO_STRING* sidecarPath, const RHMONO_STRING* path)
+{
+  CRhCmnArchiveIndex* rc = NULL;
+  if( sidecarPath && path )
+  {
+    INPUTSTRINGCOERCE(_sidecarPath, sidecarPath);
+    INPUTSTRINGCOERCE(_path, path);
+    rc = new CRhCmnArchiveIndex();
+    if( !rc->ReadSidecar(_sidecarPath, _path) )
     {
-      if ( error_log) error_log->Print("ERROR: Corrupt render light table. (ON_BinaryArchive::EndRead3dmLightTable() returned false.)\n");
-      return false;
+      delete rc;
+      rc = NULL;
     }
-    if ( CheckForCRCErrors( archive, *this, error_log, "render light table" ) )
-      return_code = false;
   }
-  else     
+  return rc;
+}
+
+RH_C_FUNCTION bool ONX_Model_ArchiveIndex_WriteSidecar(const CRhCmnArchiveIndex* pConstIndex, const RHMONO_STRING* sidecarPath)
+{
+  bool rc = false;
+  if( pConstIndex && sidecarPath )
+  {
+    INPUTSTRINGCOERCE(_sidecarPath, sidecarPath);
+    rc = pConstIndex->WriteSidecar(_sidecarPath);
+  }
+  return rc;
+}
+
+RH_C_FUNCTION void ONX_Model_ArchiveIndex_Delete(CRhCmnArchiveIndex* pIndex)
+{
+  if( pIndex )
+    delete pIndex;
+}
+
+RH_C_FUNCTION int ONX_Model_ArchiveIndex_ObjectCount(const CRhCmnArchiveIndex* pConstIndex)
+{
+  if( pConstIndex )
+    return pConstIndex->m_objects.Count();
+  return 0;
+}
+
+RH_C_FUNCTION bool ONX_Model_ArchiveIndex_GetObjectInfo(const CRhCmnArchiveIndex* pConstIndex, int index, ON_UUID* id, unsigned int* objectType, int* layerIndex, ON_BoundingBox* bbox)
+{
+  bool rc = false;
+  if( pConstIndex && index>=0 && index<pConstIndex->m_objects.Count() )
+  {
+    const CRhCmnObjectIndexEntry& entry = pConstIndex->m_objects[index];
+    if( id )
+      *id = entry.m_uuid;
+    if( objectType )
+      *objectType = entry.m_object_type;
+    if( layerIndex )
+      *layerIndex = entry.m_layer_index;
+    if( bbox )
+      *bbox = entry.m_bbox;
+    rc = true;
+  }
+  return rc;
+}
+
+// Copies min/max corners of every indexed object into boxes[6*count]
+RH_C_FUNCTION int ONX_Model_ArchiveIndex_GetBoundingBoxes(const CRhCmnArchiveIndex* pConstIndex, int count, /*ARRAY*/double* boxes)
+{
+  int rc = 0;
+  if( pConstIndex && boxes && count>0 )
   {
-    if ( error_log)
+    rc = pConstIndex->m_objects.Count();
+    if( rc > count )
+      rc = count;
+    for( int i=0; i<rc; i++ )
     {
-      error_log->Print("WARNING: Missing or corrupt render light table. (ON_BinaryArchive::BeginRead3dmLightTable() returned false.)\n");
-      error_log->Print("-- Attempting to continue.\n");
+      const ON_BoundingBox& bbox = pConstIndex->m_objects[i].m_bbox;
+      double* b = boxes + 6*i;
+      b[0] = bbox.m_min.x; b[1] = bbox.m_min.y; b[2] = bbox.m_min.z;
+      b[3] = bbox.m_max.x; b[4] = bbox.m_max.y; b[5] = bbox.m_max.z;
     }
-    return_code = false;
   }
+  return rc;
+}
 
-  // STEP 13 - read hatch pattern table
-  if ( archive.BeginRead3dmHatchPatternTable() )
+RH_C_FUNCTION int ONX_Model_ArchiveIndex_TableCount(const CRhCmnArchiveIndex* pConstIndex)
+{
+  if( pConstIndex )
+    return pConstIndex->m_table_typecode.Count();
+  return 0;
+}
+
+RH_C_FUNCTION bool ONX_Model_ArchiveIndex_GetTable(const CRhCmnArchiveIndex* pConstIndex, int index, unsigned int* typecode, ON__INT64* offset)
+{
+  bool rc = false;
+  if( pConstIndex && typecode && offset && index>=0 && index<pConstIndex->m_table_typecode.Count() )
   {
-    ON_HatchPattern* pHatchPattern = NULL;
-    for( count = 0; true; count++ ) 
+    *typecode = pConstIndex->m_table_typecode[index];
+    *offset = (ON__INT64)pConstIndex->m_table_offset[index];
+    rc = true;
+  }
+  return rc;
+}
+
+// Reads object table entry index by seeking straight to its record. Caller
+// owns the returned geometry and frees it with ON_Object_Delete.
+RH_C_FUNCTION ON_Geometry* ONX_Model_ArchiveIndex_ReadObject(const CRhCmnArchiveIndex* pConstIndex, int index, ON_3dmObjectAttributes* pAttributes)
+{
+  ON_Geometry* rc = NULL;
+  if( pConstIndex )
+    rc = pConstIndex->ReadObject(index, pAttributes);
+  return rc;
+}
+
+/*
+Reads only the objects whose bounding box intersects region. When
+pConstIndex is an index of the same file, objects the index places outside
+region are skipped without being deserialized; otherwise each object is
+read and its box tested before it enters the object table. An index whose
+recorded size or time differs from the file at path is ignored.
+*/
+RH_C_FUNCTION ONX_Model* ONX_Model_ReadFile4(const RHMONO_STRING* path, ReadFileTableTypeFilter tableFilter, ObjectTypeFilter objectTypeFilter, ReadFileOptions options, const ON_BoundingBox* region, const CRhCmnArchiveIndex* pConstIndex, CRhCmnStringHolder* pStringHolder)
+{
+  ONX_Model_WithFilter* rc = NULL;
+  if( path )
+  {
+    INPUTSTRINGCOERCE(_path, path);
+    ON_wString s;
+    ON_TextLog log(s);
+    ON_TextLog* pLog = pStringHolder ? &log : NULL;
+    if( pConstIndex )
     {
-      rc = archive.Read3dmHatchPattern(&pHatchPattern);
-      if ( rc==0 )
-        break; // end of hatchpattern table
-      if ( rc < 0 ) 
+      ON__UINT64 file_size = 0;
+      ON__UINT64 file_time = 0;
+      if( !GetSourceFileStats(_path, &file_size, &file_time)
+          || file_size != pConstIndex->m_file_size
+          || file_time != pConstIndex->m_file_time )
       {
-        if ( error_log)
-        {
-          error_log->Print("ERROR: Corrupt hatchpattern found. (ON_BinaryArchive::Read3dmHatchPattern() < 0.)\n");
-          error_count++;
-          if ( error_count > max_error_count )
-            return false;
-          error_log->Print("-- Attempting to continue.\n");
-        }
-        pHatchPattern = new ON_HatchPattern; // use default
-        pHatchPattern->m_hatchpattern_index = count;
+        if( pLog )
+          pLog->Print("WARNING: Archive index does not match the file. Reading without it.\n");
+        pConstIndex = NULL;
       }
-      ON_UserDataHolder ud;
-      ud.MoveUserDataFrom(*pHatchPattern);
-      m_hatch_pattern_table.Append(*pHatchPattern);
-      ud.MoveUserDataTo(*m_hatch_pattern_table.Last(),false);
-      delete pHatchPattern;
-      pHatchPattern = NULL;
     }
-    
-    // If BeginRead3dmHatchPatternTable() returns true, 
-    // then you MUST call EndRead3dmHatchPatternTable().
-    if ( !archive.EndRead3dmHatchPatternTable() )
+    rc = new ONX_Model_WithFilter();
+    rc->SetRegionFilter(region, pConstIndex ? &pConstIndex->m_objects : NULL);
+    unsigned int table_filter = (unsigned int)tableFilter;
+    unsigned int obj_filter = (unsigned int)objectTypeFilter;
+    bool bRead = rc->FilteredRead(_path, table_filter, obj_filter, (unsigned int)options, pLog);
+    rc->SetRegionFilter(NULL, NULL);
+    if( !bRead )
     {
-      if ( error_log) error_log->Print("ERROR: Corrupt hatchpattern table. (ON_BinaryArchive::EndRead3dmHatchPatternTable() returned false.)\n");
-      return false;
+      ONX_Model_Delete(rc);
+      rc = NULL;
     }
-    if ( CheckForCRCErrors( archive, *this, error_log, "hatchpattern table" ) )
-      return_code = false;
+    if( pStringHolder )
+      pStringHolder->Set(s);
   }
-  else     
+  return rc;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Incremental save journal
+//
+// A journal is a file of segments appended next to a base 3dm file. Each
+// ONX_Model_Journal_Save appends one segment holding what changed since the
+// previous save: the ids of deleted objects, full copies of any edited
+// layer, material, linetype, dimstyle, hatch pattern or instance definition
+// tables, and the objects that were added or marked dirty. Loading replays
+// the segments in order on top of the base file. ONX_Model_Journal_Compact
+// writes a fresh base file and removes the journal.
+//
+// Edits made through the C API are tracked. Edits made in place through a
+// pointer into the model are not; report them with
+// ONX_Model_Journal_MarkObjectDirty or ONX_Model_Journal_MarkTableDirty.
+// Changes to any other part of the model (properties, settings and views,
+// bitmaps, texture mappings, groups, fonts, lights, history records and
+// user tables) cannot be journaled. Once one of those is changed,
+// ONX_Model_Journal_Save fails until ONX_Model_Journal_Compact has written
+// the whole model.
+//
+// Every segment is stamped with the size and time of the base file it was
+// written against, so a journal left behind by an older base is refused.
+// A segment is applied only after it has been read completely, so a
+// segment cut short by a crash is ignored.
+
+// ReadFileTableTypeFilter bits of the tables a segment can hold
+static const unsigned int ModelJournalTables = ttfLayerTable | ttfMaterialTable | ttfLinetypeTable |
+                                               ttfDimstyleTable | ttfHatchpatternTable | ttfInstanceDefinitionTable;
+
+static const ON_UUID ModelJournalSegmentId = { 0x2d0f6b83, 0x1c57, 0x4a9e, { 0xb3, 0x28, 0x6e, 0x41, 0xf0, 0x9a, 0x57, 0xc2 } };
+
+class CRhCmnJournalFile : public ON_BinaryFile
+{
+public:
+  CRhCmnJournalFile(ON::archive_mode mode, FILE* fp)
+  : ON_BinaryFile(mode, fp)
   {
-    if ( error_log)
-    {
-      error_log->Print("WARNING: Missing or corrupt hatchpattern table. (ON_BinaryArchive::BeginRead3dmHatchPatternTable() returned false.)\n");
-      error_log->Print("-- Attempting to continue.\n");
-    }
-    return_code = false;
+    SetArchive3dmVersion(50);
+    ON_SetBinaryArchiveOpenNURBSVersion(*this, ON::Version());
   }
+};
 
-  // STEP 14: REQUIRED - Read instance definition table
-  if ( archive.BeginRead3dmInstanceDefinitionTable() )
+template <class T>
+static bool WriteJournalTable( ON_BinaryArchive& archive, const ON_ClassArray<T>& table )
+{
+  bool rc = archive.WriteInt(table.Count());
+  for( int i = 0; rc && i < table.Count(); i++ )
+    rc = archive.WriteObject(table[i]);
+  return rc;
+}
+
+template <class T>
+static bool ReadJournalTable( ON_BinaryArchive& archive, ON_ClassArray<T>& table )
+{
+  int count = 0;
+  if( !archive.ReadInt(&count) || count < 0 )
+    return false;
+  table.Empty();
+  table.Reserve(count);
+  for( int i = 0; i < count; i++ )
   {
-    ON_InstanceDefinition* pIDef = NULL;
-    for( count = 0; true; count++ ) 
-    {
-      rc = archive.Read3dmInstanceDefinition(&pIDef);
-      if ( rc==0 )
-        break; // end of instance definition table
-      if ( rc < 0 ) 
-      {
-        if ( error_log)
-        {
-          error_log->Print("ERROR: Corrupt instance definition found. (ON_BinaryArchive::Read3dmInstanceDefinition() < 0.)\n");
-          error_count++;
-          if ( error_count > max_error_count )
-            return false;
-          error_log->Print("-- Attempting to continue.\n");
-        }
-        continue;
-      }
-      ON_UserDataHolder ud;
-      ud.MoveUserDataFrom(*pIDef);
-      m_idef_table.Append(*pIDef);
-      ud.MoveUserDataTo(*m_idef_table.Last(),false);
-      delete pIDef;
-    }
-    
-    // If BeginRead3dmInstanceDefinitionTable() returns true, 
-    // then you MUST call EndRead3dmInstanceDefinitionTable().
-    if ( !archive.EndRead3dmInstanceDefinitionTable() )
-    {
-      if ( error_log) error_log->Print("ERROR: Corrupt instance definition table. (ON_BinaryArchive::EndRead3dmInstanceDefinitionTable() returned false.)\n");
+    ON_Object* pObject = NULL;
+    archive.ReadObject(&pObject);
+    const T* pElement = T::Cast(pObject);
+    if( pElement )
+      table.Append(*pElement);
+    if( pObject )
+      delete pObject;
+    if( NULL == pElement )
       return false;
-    }
-    if ( CheckForCRCErrors( archive, *this, error_log, "instance definition table" ) )
-      return_code = false;
   }
-  else     
+  return true;
+}
+
+static bool WriteJournalSegment( ON_BinaryArchive& archive, const ONX_Model& model, CRhCmnModelState& state, ON__UINT64 base_size, ON__UINT64 base_time )
+{
+  state.m_dirty_objects.QuickSort(ON_UuidCompare);
+  int dirty_count = 0;
+  for( int i = 0; i < model.m_object_table.Count(); i++ )
   {
-    if ( error_log)
+    const ONX_Model_Object& mo = model.m_object_table[i];
+    if( mo.m_object && SortedUuidsContain(state.m_dirty_objects, mo.m_attributes.m_uuid) )
+      dirty_count++;
+  }
+
+  MaterializeLazyUserData(model, archive.Archive3dmVersion());
+  if( !archive.BeginWrite3dmChunk(TCODE_ANONYMOUS_CHUNK, 1, 0) )
+    return false;
+  bool rc = archive.WriteUuid(ModelJournalSegmentId)
+    && archive.WriteBigInt(base_size)
+    && archive.WriteBigInt(base_time)
+    && archive.WriteInt(state.m_deleted_objects.Count());
+  for( int i = 0; rc && i < state.m_deleted_objects.Count(); i++ )
+    rc = archive.WriteUuid(state.m_deleted_objects[i]);
+
+  const unsigned int tables = state.m_dirty_tables;
+  if( rc )
+    rc = archive.WriteInt(tables);
+  if( rc && (tables & ttfLayerTable) )
+    rc = WriteJournalTable(archive, model.m_layer_table);
+  if( rc && (tables & ttfMaterialTable) )
+    rc = WriteJournalTable(archive, model.m_material_table);
+  if( rc && (tables & ttfLinetypeTable) )
+    rc = WriteJournalTable(archive, model.m_linetype_table);
+  if( rc && (tables & ttfDimstyleTable) )
+    rc = WriteJournalTable(archive, model.m_dimstyle_table);
+  if( rc && (tables & ttfHatchpatternTable) )
+    rc = WriteJournalTable(archive, model.m_hatch_pattern_table);
+  if( rc && (tables & ttfInstanceDefinitionTable) )
+    rc = WriteJournalTable(archive, model.m_idef_table);
+
+  if( rc )
+    rc = archive.WriteInt(dirty_count);
+  for( int i = 0; rc && i < model.m_object_table.Count(); i++ )
+  {
+    const ONX_Model_Object& mo = model.m_object_table[i];
+    if( mo.m_object && SortedUuidsContain(state.m_dirty_objects, mo.m_attributes.m_uuid) )
+      rc = archive.WriteObject(mo.m_object) && archive.WriteObject(mo.m_attributes);
+  }
+
+  if( !archive.EndWrite3dmChunk() )
+    rc = false;
+  return rc;
+}
+
+// Everything one segment changes, read before any of it is applied
+class CRhCmnJournalSegment
+{
+public:
+  CRhCmnJournalSegment() : m_tables(0) {}
+  ~CRhCmnJournalSegment()
+  {
+    for( int i = 0; i < m_objects.Count(); i++ )
     {
-      error_log->Print("WARNING: Missing or corrupt instance definition table. (ON_BinaryArchive::BeginRead3dmInstanceDefinitionTable() returned false.)\n");
-      error_log->Print("-- Attempting to continue.\n");
+      if( m_objects[i] )
+        delete m_objects[i];
     }
-    return_code = false;
   }
 
+  bool Read( ON_BinaryArchive& archive, ON__UINT64 base_size, ON__UINT64 base_time, bool* bWrongBase );
+  void Apply( ONX_Model& model );
 
+  ON_SimpleArray<ON_UUID> m_deleted;
+  unsigned int m_tables;
+  ON_ObjectArray<ON_Layer> m_layers;
+  ON_ObjectArray<ON_Material> m_materials;
+  ON_ObjectArray<ON_Linetype> m_linetypes;
+  ON_ObjectArray<ON_DimStyle> m_dimstyles;
+  ON_ObjectArray<ON_HatchPattern> m_hatch_patterns;
+  ON_ObjectArray<ON_InstanceDefinition> m_idefs;
+  ON_SimpleArray<ON_Object*> m_objects;
+  ON_ClassArray<ON_3dmObjectAttributes> m_attributes;
+};
 
-  // STEP 15: REQUIRED - Read object (geometry and annotation) table
-  if ( archive.BeginRead3dmObjectTable() )
+bool CRhCmnJournalSegment::Read( ON_BinaryArchive& archive, ON__UINT64 base_size, ON__UINT64 base_time, bool* bWrongBase )
+{
+  int major_version = 0;
+  int minor_version = 0;
+  if( !archive.BeginRead3dmChunk(TCODE_ANONYMOUS_CHUNK, &major_version, &minor_version) )
+    return false;
+
+  ON_UUID id = ON_nil_uuid;
+  ON__UINT64 segment_base_size = 0;
+  ON__UINT64 segment_base_time = 0;
+  int count = 0;
+  bool rc = 1 == major_version
+    && archive.ReadUuid(id)
+    && id == ModelJournalSegmentId
+    && archive.ReadBigInt(&segment_base_size)
+    && archive.ReadBigInt(&segment_base_time);
+  if( rc && (segment_base_size != base_size || segment_base_time != base_time) )
+  {
+    *bWrongBase = true;
+    rc = false;
+  }
+
+  if( rc )
+    rc = archive.ReadInt(&count) && count >= 0;
+  if( rc )
+  {
+    m_deleted.SetCapacity(count);
+    m_deleted.SetCount(count);
+    for( int i = 0; rc && i < count; i++ )
+      rc = archive.ReadUuid(m_deleted[i]);
+  }
+
+  int tables = 0;
+  if( rc )
+    rc = archive.ReadInt(&tables);
+  m_tables = (unsigned int)tables;
+  if( rc && (m_tables & ttfLayerTable) )
+    rc = ReadJournalTable(archive, m_layers);
+  if( rc && (m_tables & ttfMaterialTable) )
+    rc = ReadJournalTable(archive, m_materials);
+  if( rc && (m_tables & ttfLinetypeTable) )
+    rc = ReadJournalTable(archive, m_linetypes);
+  if( rc && (m_tables & ttfDimstyleTable) )
+    rc = ReadJournalTable(archive, m_dimstyles);
+  if( rc && (m_tables & ttfHatchpatternTable) )
+    rc = ReadJournalTable(archive, m_hatch_patterns);
+  if( rc && (m_tables & ttfInstanceDefinitionTable) )
+    rc = ReadJournalTable(archive, m_idefs);
+
+  count = 0;
+  if( rc )
+    rc = archive.ReadInt(&count) && count >= 0;
+  for( int i = 0; rc && i < count; i++ )
   {
-    // optional filter made by setting ON::object_type bits 
-    // For example, if you just wanted to just read points and meshes, you would use
-    // object_filter = ON::point_object | ON::mesh_object;
+    ON_Object* pObject = NULL;
+    ON_Object* pAttributes = NULL;
+    archive.ReadObject(&pObject);
+    archive.ReadObject(&pAttributes);
+    const ON_3dmObjectAttributes* pConstAttributes = ON_3dmObjectAttributes::Cast(pAttributes);
+    rc = pObject && pConstAttributes;
+    if( rc )
+    {
+      m_objects.Append(pObject);
+      m_attributes.Append(*pConstAttributes);
+    }
+    else if( pObject )
+      delete pObject;
+    if( pAttributes )
+      delete pAttributes;
+  }
 
-    int object_filter = model_object_type_filter;
+  if( !archive.EndRead3dmChunk() )
+    rc = false;
+  return rc;
+}
 
-    for( count = 0; true; count++ ) 
+void CRhCmnJournalSegment::Apply( ONX_Model& model )
+{
+  if( m_deleted.Count() > 0 )
+  {
+    m_deleted.QuickSort(ON_UuidCompare);
+    for( int i = model.m_object_table.Count() - 1; i >= 0; i-- )
     {
-      ON_Object* pObject = NULL;
-      ON_3dmObjectAttributes attributes;
-      rc = archive.Read3dmObject(&pObject,&attributes,object_filter);
-      if ( rc == 0 )
-        break; // end of object table
-      if ( rc < 0 ) 
-      {
-        if ( error_log)
-        {
-          error_log->Print("ERROR: Object table entry %d is corrupt. (ON_BinaryArchive::Read3dmObject() < 0.)\n",count);
-          error_count++;
-          if ( error_count > max_error_count )
-            return false;
-          error_log->Print("-- Attempting to continue.\n");
-        }
-        continue;
-      }
-      if ( m_crc_error_count != archive.BadCRCCount() ) 
-      {
-        if ( error_log)
-        {
-          error_log->Print("ERROR: Object table entry %d is corrupt. (CRC errors).\n",count);
-          error_log->Print("-- Attempting to continue.\n");
-        }
-        m_crc_error_count = archive.BadCRCCount();
-      }
-      if ( pObject ) 
+      if( SortedUuidsContain(m_deleted, model.m_object_table[i].m_attributes.m_uuid) )
+        model.m_object_table.Remove(i);
+    }
+  }
+
+  if( m_tables & ttfLayerTable )
+    model.m_layer_table = m_layers;
+  if( m_tables & ttfMaterialTable )
+    model.m_material_table = m_materials;
+  if( m_tables & ttfLinetypeTable )
+    model.m_linetype_table = m_linetypes;
+  if( m_tables & ttfDimstyleTable )
+    model.m_dimstyle_table = m_dimstyles;
+  if( m_tables & ttfHatchpatternTable )
+    model.m_hatch_pattern_table = m_hatch_patterns;
+  if( m_tables & ttfInstanceDefinitionTable )
+    model.m_idef_table = m_idefs;
+
+  if( m_objects.Count() > 0 )
+  {
+    // Objects already in the model were edited and are replaced in place
+    ON_SimpleArray<ON_UuidIndex> existing(model.m_object_table.Count());
+    for( int i = 0; i < model.m_object_table.Count(); i++ )
+    {
+      ON_UuidIndex& ui = existing.AppendNew();
+      ui.m_id = model.m_object_table[i].m_attributes.m_uuid;
+      ui.m_i = i;
+    }
+    existing.QuickSort(ON_UuidIndex::CompareId);
+
+    for( int i = 0; i < m_objects.Count(); i++ )
+    {
+      ONX_Model_Object mo;
+      mo.m_object = m_objects[i];
+      mo.m_bDeleteObject = true;
+      mo.m_attributes = m_attributes[i];
+      m_objects[i] = NULL;
+
+      int index = -1;
+      ON_UuidIndex key;
+      key.m_id = mo.m_attributes.m_uuid;
+      int i0 = 0;
+      int i1 = existing.Count();
+      while( i0 < i1 )
       {
-        // 20 June 2014 S. Baer
-        // The filtered Read3dmObject function does not appear to actually do filtering.
-        // While we wait for that to get fixed in OpenNURBS, just check the object type
-        // here and make sure it passes the filter test. This is being done here because
-        // Dan needs access to this funtionality with the currently available OpenNURBS
-        if( 0==object_filter || (pObject->ObjectType() & object_filter) != 0)
+        const int k = (i0 + i1) / 2;
+        const int c = ON_UuidIndex::CompareId(&existing[k], &key);
+        if( 0 == c )
         {
-          ONX_Model_Object& mo = m_object_table.AppendNew();
-          mo.m_object = pObject;
-          mo.m_bDeleteObject = true;
-          mo.m_attributes = attributes;
+          index = existing[k].m_i;
+          break;
         }
+        if( c < 0 )
+          i0 = k + 1;
         else
-        {
-          delete pObject;
-          pObject = 0;
-        }
+          i1 = k;
       }
+      if( index >= 0 )
+        model.m_object_table[index] = mo;
       else
-      {
-        if ( error_log)
-        {
-          if ( rc == 2 )
-            error_log->Print("WARNING: Skipping object table entry %d because it's filtered.\n",count);
-          else if ( rc == 3 )
-            error_log->Print("WARNING: Skipping object table entry %d because it's newer than this code.  Update your OpenNURBS toolkit.\n",count);
-          else
-            error_log->Print("WARNING: Skipping object table entry %d for unknown reason.\n",count);
-        }
-      }
+        model.m_object_table.Append(mo);
     }
-    
-    // If BeginRead3dmObjectTable() returns true, 
-    // then you MUST call EndRead3dmObjectTable().
-    if ( !archive.EndRead3dmObjectTable() )
-    {
-      if ( error_log) error_log->Print("ERROR: Corrupt object light table. (ON_BinaryArchive::EndRead3dmObjectTable() returned false.)\n");
+  }
+}
+
+static FILE* OpenJournalForAppend( const wchar_t* journal_path )
+{
+  FILE* fp = ON::OpenFile(journal_path, L"r+b");
+  if( 0 == fp )
+    return ON::OpenFile(journal_path, L"w+b");
+  // Chunk lengths are patched with a seek back, which "ab" would defeat
+#if defined(_WIN32)
+  if( 0 != _fseeki64(fp, 0, SEEK_END) )
+#else
+  if( 0 != fseeko(fp, 0, SEEK_END) )
+#endif
+  {
+    ON::CloseFile(fp);
+    return 0;
+  }
+  return fp;
+}
+
+static bool RemoveLocalFile( const wchar_t* path )
+{
+#if defined(_WIN32)
+  return 0 != ::DeleteFileW(path);
+#else
+  ON_String fn(path);
+  return 0 == ::remove(fn.Array());
+#endif
+}
+
+static bool RenameLocalFile( const wchar_t* from, const wchar_t* to )
+{
+#if defined(_WIN32)
+  return 0 != ::MoveFileExW(from, to, MOVEFILE_REPLACE_EXISTING);
+#else
+  ON_String fn_from(from);
+  ON_String fn_to(to);
+  return 0 == ::rename(fn_from.Array(), fn_to.Array());
+#endif
+}
+
+// Starts or stops change tracking for incremental saves. Starting clears
+// anything tracked before.
+RH_C_FUNCTION void ONX_Model_Journal_Enable(ONX_Model* pModel, bool enable)
+{
+  CRhCmnModelState* state = GetModelState(pModel, enable);
+  if( state )
+  {
+    state->m_bJournal = enable;
+    state->m_dirty_objects.Empty();
+    state->m_deleted_objects.Empty();
+    state->m_dirty_tables = 0;
+  }
+}
+
+// Objects edited in place through a pointer into the object table are not
+// seen by the tracker; mark them so the next save picks them up.
+RH_C_FUNCTION void ONX_Model_Journal_MarkObjectDirty(ONX_Model* pModel, ON_UUID id)
+{
+  ModelObjectAdded(pModel, id);
+}
+
+// tables is a combination of ReadFileTableTypeFilter bits. ttfObjectTable
+// marks every object dirty. Tables a journal cannot hold make the next
+// ONX_Model_Journal_Save fail (see the journal notes above).
+RH_C_FUNCTION void ONX_Model_Journal_MarkTableDirty(ONX_Model* pModel, unsigned int tables)
+{
+  CRhCmnModelState* state = GetModelState(pModel, false);
+  if( state && (tables & ttfObjectTable) )
+  {
+    for( int i=0; i<pModel->m_object_table.Count(); i++ )
+      ModelObjectAdded(pModel, pModel->m_object_table[i].m_attributes.m_uuid);
+    InvalidateModelIndices(state, ttfObjectTable);
+  }
+  ModelTableChanged(pModel, tables & ~(unsigned int)ttfObjectTable);
+}
+
+RH_C_FUNCTION bool ONX_Model_Journal_IsDirty(const ONX_Model* pConstModel)
+{
+  bool rc = false;
+  const CRhCmnModelState* state = GetModelState(pConstModel, false);
+  if( state && state->m_bJournal )
+    rc = state->m_dirty_objects.Count() > 0 || state->m_deleted_objects.Count() > 0 || state->m_dirty_tables != 0;
+  return rc;
+}
+
+// Appends the changes made since the last save to journalPath. basePath is
+// the 3dm file the journal applies to; it is not modified. Fails without
+// writing anything if a part of the model a journal cannot hold was changed;
+// use ONX_Model_Journal_Compact then.
+RH_C_FUNCTION bool ONX_Model_Journal_Save(ONX_Model* pModel, const RHMONO_STRING* basePath, const RHMONO_STRING* journalPath)
+{
+  bool rc = false;
+  INPUTSTRINGCOERCE(_basePath, basePath);
+  INPUTSTRINGCOERCE(_journalPath, journalPath);
+  CRhCmnModelState* state = GetModelState(pModel, false);
+  if( pModel && state && state->m_bJournal && _basePath && _journalPath )
+  {
+    if( !ONX_Model_Journal_IsDirty(pModel) )
+      return true;
+    if( 0 != (state->m_dirty_tables & ~ModelJournalTables) )
+      return false;
+    ON__UINT64 base_size = 0;
+    ON__UINT64 base_time = 0;
+    if( !GetSourceFileStats(_basePath, &base_size, &base_time) )
       return false;
+    FILE* fp = OpenJournalForAppend(_journalPath);
+    if( 0 == fp )
+      return false;
+    {
+      CRhCmnJournalFile file(ON::write3dm, fp);
+      rc = WriteJournalSegment(file, *pModel, *state, base_size, base_time);
     }
-    if ( CheckForCRCErrors( archive, *this, error_log, "object table" ) )
-      return_code = false;
-  }
-  else     
-  {
-    if ( error_log)
+    ON::CloseFile(fp);
+    if( rc )
     {
-      error_log->Print("WARNING: Missing or corrupt object table. (ON_BinaryArchive::BeginRead3dmObjectTable() returned false.)\n");
-      error_log->Print("-- Attempting to continue.\n");
+      state->m_dirty_objects.Empty();
+      state->m_deleted_objects.Empty();
+      state->m_dirty_tables = 0;
     }
-    return_code = false;
   }
+  return rc;
+}
 
-  // STEP 16: Read history table
-  if ( archive.BeginRead3dmHistoryRecordTable() )
+// Applies the segments in journal_path to a model read from base_path and
+// reports problems to log. Returns the number of segments applied or -1 when
+// the journal was written against a different version of base_path.
+static int ReplayModelJournal( ONX_Model& model, const wchar_t* base_path, const wchar_t* journal_path, ON_TextLog& log )
+{
+  ON__UINT64 base_size = 0;
+  ON__UINT64 base_time = 0;
+  if( !GetSourceFileStats(base_path, &base_size, &base_time) )
+    return -1;
+  FILE* fp = ON::OpenFile(journal_path, L"rb");
+  if( 0 == fp )
+    return 0; // no journal, nothing to replay
+  int rc = 0;
   {
-    for( count = 0; true; count++ ) 
+    CRhCmnJournalFile file(ON::read3dm, fp);
+    for(;;)
     {
-      ON_HistoryRecord* pHistoryRecord = NULL;
-      rc = archive.Read3dmHistoryRecord(pHistoryRecord);
-      if ( rc == 0 )
-        break; // end of history record table
-      if ( rc < 0 ) 
-      {
-        if ( error_log)
-        {
-          error_log->Print("ERROR: History record table entry %d is corrupt. (ON_BinaryArchive::Read3dmHistoryRecord() < 0.)\n",count);
-          error_count++;
-          if ( error_count > max_error_count )
-            return false;
-          error_log->Print("-- Attempting to continue.\n");
-        }
-        continue;
-      }
-      if ( m_crc_error_count != archive.BadCRCCount() ) 
-      {
-        if ( error_log)
-        {
-          error_log->Print("ERROR: History record table entry %d is corrupt. (CRC errors).\n",count);
-          error_log->Print("-- Attempting to continue.\n");
-        }
-        m_crc_error_count = archive.BadCRCCount();
-      }
-      if ( pHistoryRecord ) 
-      {
-        m_history_record_table.Append(pHistoryRecord);
-      }
-      else
+      ON__UINT32 tcode = 0;
+      ON__INT64 big_value = 0;
+      if( !file.PeekAt3dmBigChunkType(&tcode, &big_value) )
+        break;
+      CRhCmnJournalSegment segment;
+      bool bWrongBase = false;
+      if( !segment.Read(file, base_size, base_time, &bWrongBase) )
       {
-        if ( error_log)
+        if( bWrongBase )
         {
-          error_log->Print("WARNING: Skipping history record table entry %d for unknown reason.\n",count);
+          log.Print("Journal was written against a different version of the base file.\n");
+          rc = -1;
         }
+        else
+          log.Print("Journal segment %d is incomplete and was ignored.\n", rc);
+        break;
       }
+      segment.Apply(model);
+      rc++;
     }
-    
-    // If BeginRead3dmHistoryRecordTable() returns true, 
-    // then you MUST call EndRead3dmHistoryRecordTable().
-    if ( !archive.EndRead3dmHistoryRecordTable() )
-    {
-      if ( error_log) error_log->Print("ERROR: Corrupt object light table. (ON_BinaryArchive::EndRead3dmObjectTable() returned false.)\n");
-      return false;
-    }
-    if ( CheckForCRCErrors( archive, *this, error_log, "history record table" ) )
-      return_code = false;
   }
-  else     
+  ON::CloseFile(fp);
+  CRhCmnModelState* state = GetModelState(&model, false);
+  if( state && rc > 0 )
+    InvalidateModelIndices(state, 0xFFFFFFFF);
+  return rc;
+}
+
+// Applies the segments in journalPath to a model read from basePath.
+// Returns the number of segments applied or -1 when the journal was
+// written against a different version of basePath.
+RH_C_FUNCTION int ONX_Model_Journal_Replay(ONX_Model* pModel, const RHMONO_STRING* basePath, const RHMONO_STRING* journalPath, CRhCmnStringHolder* pStringHolder)
+{
+  int rc = 0;
+  INPUTSTRINGCOERCE(_basePath, basePath);
+  INPUTSTRINGCOERCE(_journalPath, journalPath);
+  if( pModel && _basePath && _journalPath )
   {
-    if ( error_log)
-    {
-      error_log->Print("WARNING: Missing or corrupt history record table. (ON_BinaryArchive::BeginRead3dmHistoryRecordTable() returned false.)\n");
-      error_log->Print("-- Attempting to continue.\n");
-    }
-    return_code = false;
+    ON_wString s;
+    ON_TextLog log(s);
+    rc = ReplayModelJournal(*pModel, _basePath, _journalPath, log);
+    if( pStringHolder )
+      pStringHolder->Set(s);
   }
+  return rc;
+}
 
-  // STEP 17: OPTIONAL - Read user tables as anonymous goo
-  // If you develop a plug-ins or application that uses OpenNURBS files,
-  // you can store anything you want in a user table.
-  for(count=0;true;count++)
+// Reads basePath, replays journalPath on top of it and starts change
+// tracking so the next ONX_Model_Journal_Save appends to the same journal.
+// pStringHolder receives the messages of the read followed by those of the
+// replay.
+RH_C_FUNCTION ONX_Model* ONX_Model_ReadFileWithJournal(const RHMONO_STRING* basePath, const RHMONO_STRING* journalPath, CRhCmnStringHolder* pStringHolder)
+{
+  ONX_Model* rc = NULL;
+  INPUTSTRINGCOERCE(_basePath, basePath);
+  INPUTSTRINGCOERCE(_journalPath, journalPath);
+  if( _basePath && _journalPath )
   {
-    if ( archive.Archive3dmVersion() <= 1 )
+    ON_wString s;
+    ON_TextLog log(s);
+    rc = new ONX_Model();
+    if( !rc->Read(_basePath, &log) || ReplayModelJournal(*rc, _basePath, _journalPath, log) < 0 )
     {
-      // no user tables in version 1 archives.
-      break;
+      ONX_Model_Delete(rc);
+      rc = NULL;
     }
+    else
+      ONX_Model_Journal_Enable(rc, true);
+    if( pStringHolder )
+      pStringHolder->Set(s);
+  }
+  return rc;
+}
 
+// Writes the whole model to basePath and removes the journal. The new base
+// is written next to the old one first so a failed write loses nothing.
+RH_C_FUNCTION bool ONX_Model_Journal_Compact(ONX_Model* pModel, const RHMONO_STRING* basePath, const RHMONO_STRING* journalPath, int version)
+{
+  bool rc = false;
+  INPUTSTRINGCOERCE(_basePath, basePath);
+  INPUTSTRINGCOERCE(_journalPath, journalPath);
+  if( pModel && _basePath && _journalPath )
+  {
+    ON_wString temp_path(_basePath);
+    temp_path += L".compact";
+    FILE* fp = ON::OpenFile(temp_path, L"wb");
+    if( 0 == fp )
+      return false;
     {
-      ON__UINT32 tcode = 0;
-      ON__INT64 big_value = 0;
-      if ( !archive.PeekAt3dmBigChunkType(&tcode,&big_value) )
-        break;
-      if ( TCODE_USER_TABLE != tcode )
-        break;
+      ON_BinaryFile file(ON::write3dm, fp);
+      MaterializeLazyUserData(*pModel, version);
+      rc = pModel->Write(file, version, 0, 0);
     }
-    ON_UUID plugin_id = ON_nil_uuid;
-    bool bGoo = false;
-    int usertable_3dm_version = 0;
-    int usertable_opennurbs_version = 0;
-    if ( !archive.BeginRead3dmUserTable( plugin_id, &bGoo, &usertable_3dm_version, &usertable_opennurbs_version ) )
+    ON::CloseFile(fp);
+    if( rc )
+      rc = RenameLocalFile(temp_path, _basePath);
+    if( !rc )
     {
-      // attempt to skip bogus user table
-      const ON__UINT64 pos0 = archive.CurrentPosition();
-      ON__UINT32 tcode = 0;
-      ON__INT64 big_value = 0;
-      if  ( !archive.BeginRead3dmBigChunk(&tcode,&big_value) )
-        break;
-      if ( !archive.EndRead3dmChunk() )
-        break;
-      const ON__UINT64 pos1 = archive.CurrentPosition();
-      if (pos1 <= pos0)
-        break;
-      if ( TCODE_USER_TABLE != tcode )
-        break;
-
-      continue; // skip this bogus user table
+      RemoveLocalFile(temp_path);
+      return false;
     }
-
-    ONX_Model_UserData& ud = m_userdata_table.AppendNew();
-    ud.m_uuid = plugin_id;
-    ud.m_usertable_3dm_version = usertable_3dm_version;
-    ud.m_usertable_opennurbs_version = usertable_opennurbs_version;
-
-    if ( !archive.Read3dmAnonymousUserTable( usertable_3dm_version, usertable_opennurbs_version, ud.m_goo ) )
+    RemoveLocalFile(_journalPath);
+    CRhCmnModelState* state = GetModelState(pModel, false);
+    if( state )
     {
-      if ( error_log) error_log->Print("ERROR: User data table entry %d is corrupt. (ON_BinaryArchive::Read3dmAnonymousUserTable() is false.)\n",count);
-      break;
+      state->m_dirty_objects.Empty();
+      state->m_deleted_objects.Empty();
+      state->m_dirty_tables = 0;
     }
+  }
+  return rc;
+}
 
-    // If BeginRead3dmObjectTable() returns true, 
-    // then you MUST call EndRead3dmUserTable().
-    if ( !archive.EndRead3dmUserTable() )
+// {6C1D7A52-93E4-4B8F-A0C6-2F5E81B4D937}
+static const ON_UUID PreviewCacheEntryId =
+{ 0x6c1d7a52, 0x93e4, 0x4b8f, { 0xa0, 0xc6, 0x2f, 0x5e, 0x81, 0xb4, 0xd9, 0x37 } };
+
+// Preview image of a single file as 32 bit BGRA pixels, top row first.
+class CRhCmnPreviewImage
+{
+public:
+  CRhCmnPreviewImage() : m_width(0), m_height(0) {}
+
+  bool SetBitmap( const ON_WindowsBitmap& bitmap );
+  bool ReadCache( const wchar_t* cache_path, const ON_wString& source, ON__UINT64 file_size, ON__UINT64 file_time );
+  // temp_id keeps the temporary files of concurrent writers apart
+  bool WriteCache( const wchar_t* cache_path, const ON_wString& source, ON__UINT64 file_size, ON__UINT64 file_time ) const;
+
+  int m_width;
+  int m_height;
+  ON_SimpleArray<unsigned char> m_bgra;
+};
+
+bool CRhCmnPreviewImage::SetBitmap( const ON_WindowsBitmap& bitmap )
+{
+  const int width = bitmap.Width();
+  const int height = bitmap.Height();
+  m_width = 0;
+  m_height = 0;
+  m_bgra.Empty();
+  if( width < 1 || height < 1 )
+    return false;
+
+  m_bgra.Reserve(4*width*height);
+  m_bgra.SetCount(4*width*height);
+  for( int row=0; row<height; row++ )
+  {
+    // DIB scan lines are stored bottom up
+    unsigned char* dst = m_bgra.Array() + 4*width*(height-1-row);
+    for( int col=0; col<width; col++ )
     {
-      if ( error_log) error_log->Print("ERROR: Corrupt user data table. (ON_BinaryArchive::EndRead3dmUserTable() returned false.)\n");
-      break;
+      const ON_Color c = bitmap.Pixel(col, row);
+      *dst++ = (unsigned char)c.Blue();
+      *dst++ = (unsigned char)c.Green();
+      *dst++ = (unsigned char)c.Red();
+      *dst++ = 255;
     }
   }
+  m_width = width;
+  m_height = height;
+  return true;
+}
 
-  // STEP 18: OPTIONAL - check for end mark
-  if ( !archive.Read3dmEndMark(&m_file_length) )
+bool CRhCmnPreviewImage::ReadCache( const wchar_t* cache_path, const ON_wString& source, ON__UINT64 file_size, ON__UINT64 file_time )
+{
+  bool rc = false;
+  FILE* fp = ON::OpenFile(cache_path, L"rb");
+  if( 0 == fp )
+    return false;
   {
-    if ( archive.Archive3dmVersion() != 1 ) 
+    CRhCmnJournalFile file(ON::read, fp);
+    ON_UUID id = ON_nil_uuid;
+    ON_wString cached_source;
+    ON__UINT64 cached_size = 0;
+    ON__UINT64 cached_time = 0;
+    int width = 0;
+    int height = 0;
+    rc = file.ReadUuid(id)
+      && 0 == ON_UuidCompare(id, PreviewCacheEntryId)
+      && file.ReadString(cached_source)
+      && file.ReadBigInt(&cached_size)
+      && file.ReadBigInt(&cached_time)
+      && cached_size == file_size
+      && cached_time == file_time
+      && 0 == cached_source.Compare(source)
+      && file.ReadInt(&width)
+      && file.ReadInt(&height)
+      && width > 0 && height > 0;
+    if( rc )
     {
-      // some v1 files are missing end-of-archive markers
-      if ( error_log) error_log->Print("ERROR: ON_BinaryArchive::Read3dmEndMark(&m_file_length) returned false.\n");
+      // width and height come from the file; the pixel count must fit the
+      // int sized buffer before it is trusted
+      const ON__UINT64 expected_size = 4 * (ON__UINT64)width * (ON__UINT64)height;
+      size_t sizeof_buffer = 0;
+      rc = expected_size <= 0x7FFFFFFF
+        && file.ReadCompressedBufferSize(&sizeof_buffer)
+        && (ON__UINT64)sizeof_buffer == expected_size;
+      if( rc )
+      {
+        m_bgra.Reserve((int)sizeof_buffer);
+        m_bgra.SetCount((int)sizeof_buffer);
+        int bFailedCRC = 0;
+        rc = file.ReadCompressedBuffer(sizeof_buffer, m_bgra.Array(), &bFailedCRC) && !bFailedCRC;
+      }
+    }
+    if( rc )
+    {
+      m_width = width;
+      m_height = height;
     }
+    else
+      m_bgra.Empty();
   }
+  ON::CloseFile(fp);
+  return rc;
+}
 
-  // Remap layer, material, linetype, font, dimstyle, hatch pattern, etc., 
-  // indices so the correspond to the model's table array index.
-  //
-  // Polish also sets revision history information if it is missing.
-  // In this case, that is not appropriate so the value of
-  // m_properties.m_RevisionHistory is saved before calling Polish()
-  // and restored afterwards.
-  const ON_3dmRevisionHistory saved_revision_history(m_properties.m_RevisionHistory);
-  Polish();
-  m_properties.m_RevisionHistory = saved_revision_history;
+bool CRhCmnPreviewImage::WriteCache( const wchar_t* cache_path, const ON_wString& source, ON__UINT64 file_size, ON__UINT64 file_time ) const
+{
+  if( m_width < 1 || m_height < 1 )
+    return false;
 
-  return return_code;
+  // Write next to the final name and rename so readers never see a partial
+  // entry. Writers in this batch, in other calls and in other processes can
+  // share a cache folder, so every writer names its temporary file with a
+  // fresh uuid.
+  ON_UUID temp_id = ON_nil_uuid;
+  if( !ON_CreateUuid(temp_id) )
+    return false;
+  ON_wString temp_name;
+  ON_UuidToString(temp_id, temp_name);
+  ON_wString temp_path(cache_path);
+  temp_path += L".";
+  temp_path += temp_name;
+  temp_path += L".tmp";
+  FILE* fp = ON::OpenFile(temp_path, L"wb");
+  if( 0 == fp )
+    return false;
+  bool rc = false;
+  {
+    CRhCmnJournalFile file(ON::write, fp);
+    rc = file.WriteUuid(PreviewCacheEntryId)
+      && file.WriteString(source)
+      && file.WriteBigInt(file_size)
+      && file.WriteBigInt(file_time)
+      && file.WriteInt(m_width)
+      && file.WriteInt(m_height)
+      && file.WriteCompressedBuffer(m_bgra.Count(), m_bgra.Array());
+  }
+  ON::CloseFile(fp);
+  if( rc )
+    rc = RenameLocalFile(temp_path, cache_path);
+  if( !rc )
+    RemoveLocalFile(temp_path);
+  return rc;
 }
 
-bool ONX_Model_WithFilter::FilteredRead( const wchar_t* filename, unsigned int table_filter, unsigned int model_object_type_filter, ON_TextLog* error_log )
+static ON_wString PreviewCachePath( const ON_wString& cache_folder, const ON_wString& source )
 {
-  bool bCallDestroy = true;
-  bool rc = false;
+  const size_t sizeof_source = source.Length()*sizeof(wchar_t);
+  const ON__UINT32 crc0 = ON_CRC32(0, sizeof_source, source.Array());
+  const ON__UINT32 crc1 = ON_CRC32(0x9E3779B9, sizeof_source, source.Array());
+  ON_wString name;
+  name.Format(L"%08X%08X.3dmpreview", crc0, crc1);
+  ON_wString path(cache_folder);
+  const int length = path.Length();
+  if( length > 0 && path[length-1] != L'/' && path[length-1] != L'\\' )
+    path += L"/";
+  path += name;
+  return path;
+}
 
-  if ( 0 != filename )
+struct ReadPreviewImagesContext
+{
+  const ON_ClassArray<ON_wString>* m_paths;
+  const wchar_t* m_cache_folder;
+  ON_SimpleArray<CRhCmnPreviewImage*>* m_images;
+};
+
+static void ReadPreviewImageAt(int index, void* context)
+{
+  ReadPreviewImagesContext* ctx = (ReadPreviewImagesContext*)context;
+  const ON_wString& source = (*ctx->m_paths)[index];
+  CRhCmnPreviewImage* pImage = new CRhCmnPreviewImage();
+
+  ON_wString cache_path;
+  ON__UINT64 file_size = 0;
+  ON__UINT64 file_time = 0;
+  bool bCache = ctx->m_cache_folder && GetSourceFileStats(source, &file_size, &file_time);
+  if( bCache )
   {
-    FILE* fp = ON::OpenFile(filename,L"rb");
-    if ( 0 != fp )
+    cache_path = PreviewCachePath(ctx->m_cache_folder, source);
+    if( pImage->ReadCache(cache_path, source, file_size, file_time) )
     {
-      ON_BinaryFile file(ON::read3dm,fp);
-      rc = FilteredRead(file, table_filter, model_object_type_filter, error_log);
-      ON::CloseFile(fp);
-      bCallDestroy = false;
+      (*ctx->m_images)[index] = pImage;
+      return;
     }
   }
 
-  if ( bCallDestroy )
-    Destroy();
+  ON_WindowsBitmap bitmap;
+  if( ReadPreviewBitmap(source, bitmap) && pImage->SetBitmap(bitmap) )
+  {
+    if( bCache )
+      pImage->WriteCache(cache_path, source, file_size, file_time);
+  }
+  else
+  {
+    delete pImage;
+    pImage = NULL;
+  }
+  (*ctx->m_images)[index] = pImage;
+}
 
+// Extracts the preview images of every file in pPaths on worker threads.
+// Only the start section and the preview chunk of each file are read. When
+// cacheFolder is not NULL, decoded previews are stored there keyed by path,
+// size and modification time, and reused while the source is unchanged.
+// The result has one entry per path with NULL entries for files without a
+// preview. Free with ONX_Model_PreviewImageArray_Delete.
+RH_C_FUNCTION ON_SimpleArray<CRhCmnPreviewImage*>* ONX_Model_ReadPreviewImages(const ON_ClassArray<ON_wString>* pPaths, const RHMONO_STRING* cacheFolder, int maxThreads)
+{
+  ON_SimpleArray<CRhCmnPreviewImage*>* rc = NULL;
+  if( pPaths )
+  {
+    INPUTSTRINGCOERCE(_cacheFolder, cacheFolder);
+    const int count = pPaths->Count();
+    rc = new ON_SimpleArray<CRhCmnPreviewImage*>(count);
+    rc->SetCount(count);
+    rc->Zero();
+    ReadPreviewImagesContext ctx;
+    ctx.m_paths = pPaths;
+    ctx.m_cache_folder = (_cacheFolder && _cacheFolder[0]) ? _cacheFolder : NULL;
+    ctx.m_images = rc;
+    RhCmnParallelFor(count, ReadPreviewImageAt, &ctx, maxThreads);
+  }
   return rc;
 }
 
+RH_C_FUNCTION int ONX_Model_PreviewImageArray_Count(const ON_SimpleArray<CRhCmnPreviewImage*>* pConstImages)
+{
+  if( pConstImages )
+    return pConstImages->Count();
+  return 0;
+}
 
+RH_C_FUNCTION bool ONX_Model_PreviewImageArray_GetSize(const ON_SimpleArray<CRhCmnPreviewImage*>* pConstImages, int index, int* width, int* height)
+{
+  bool rc = false;
+  if( pConstImages && index>=0 && index<pConstImages->Count() && width && height )
+  {
+    const CRhCmnPreviewImage* pImage = (*pConstImages)[index];
+    *width = pImage ? pImage->m_width : 0;
+    *height = pImage ? pImage->m_height : 0;
+    rc = NULL != pImage;
+  }
+  return rc;
+}
 
-RH_C_FUNCTION ONX_Model* ONX_Model_ReadFile2(const RHMONO_STRING* path, ReadFileTableTypeFilter tableFilter, ObjectTypeFilter objectTypeFilter, CRhCmnStringHolder* pStringHolder)
+// Copies 4*width*height bytes of BGRA pixels, top row first.
+RH_C_FUNCTION bool ONX_Model_PreviewImageArray_CopyPixels(const ON_SimpleArray<CRhCmnPreviewImage*>* pConstImages, int index, int length, /*ARRAY*/unsigned char* bgra)
 {
-  ONX_Model_WithFilter* rc = NULL;
-  if( path )
+  bool rc = false;
+  if( pConstImages && index>=0 && index<pConstImages->Count() && bgra )
   {
-    INPUTSTRINGCOERCE(_path, path);
-    rc = new ONX_Model_WithFilter();
-    ON_wString s;
-    ON_TextLog log(s);
-    ON_TextLog* pLog = pStringHolder ? &log : NULL;
-    unsigned int table_filter = (unsigned int)tableFilter;
-    unsigned int obj_filter = (unsigned int)objectTypeFilter;
-    if( !rc->FilteredRead(_path, table_filter, obj_filter, pLog) )
+    const CRhCmnPreviewImage* pImage = (*pConstImages)[index];
+    if( pImage && length >= pImage->m_bgra.Count() )
     {
-      delete rc;
-      rc = NULL;
+      memcpy(bgra, pImage->m_bgra.Array(), pImage->m_bgra.Count());
+      rc = true;
     }
-    if( pStringHolder )
-      pStringHolder->Set(s);
   }
   return rc;
 }
+
+RH_C_FUNCTION void ONX_Model_PreviewImageArray_Delete(ON_SimpleArray<CRhCmnPreviewImage*>* pImages)
+{
+  if( pImages )
+  {
+    for( int i=0; i<pImages->Count(); i++ )
+    {
+      CRhCmnPreviewImage* pImage = (*pImages)[i];
+      if( pImage )
+        delete pImage;
+    }
+    delete pImages;
+  }
+}
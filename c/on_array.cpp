@@ -401,6 +401,45 @@ RH_C_FUNCTION ON_Surface* ON_SurfaceArray_Get(ON_SimpleArray<ON_Surface*>* pSurf
   return rc;
 }
 
+///////////////////////////////////////////////////////////////////////////////////////
+// ON_SimpleArray<ON_Object*>
+// Passes batches of objects to and from the buffer archive functions. The
+// array never owns the objects it holds.
+
+RH_C_FUNCTION ON_SimpleArray<ON_Object*>* ON_ObjectArray_New(int initial_capacity)
+{
+  return new ON_SimpleArray<ON_Object*>(initial_capacity);
+}
+
+RH_C_FUNCTION void ON_ObjectArray_Delete(ON_SimpleArray<ON_Object*>* pObjectArray)
+{
+  if( pObjectArray )
+    delete pObjectArray;
+}
+
+RH_C_FUNCTION int ON_ObjectArray_Count(const ON_SimpleArray<ON_Object*>* pConstObjectArray)
+{
+  int rc = 0;
+  if( pConstObjectArray )
+    rc = pConstObjectArray->Count();
+  return rc;
+}
+
+RH_C_FUNCTION void ON_ObjectArray_Append(ON_SimpleArray<ON_Object*>* pObjectArray, ON_Object* pObject)
+{
+  if( pObjectArray && pObject )
+    pObjectArray->Append(pObject);
+}
+
+// Entries filled in by a batch read may be NULL
+RH_C_FUNCTION ON_Object* ON_ObjectArray_Get(const ON_SimpleArray<ON_Object*>* pConstObjectArray, int index)
+{
+  ON_Object* rc = NULL;
+  if( pConstObjectArray && index>=0 && index<pConstObjectArray->Count() )
+    rc = (*pConstObjectArray)[index];
+  return rc;
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////
 
 RH_C_FUNCTION ON_SimpleArray<ON_Interval>* ON_IntervalArray_New()
@@ -458,9 +497,6 @@ RH_C_FUNCTION void ON_BezierCurve_Delete(ON_BezierCurve* pBez)
     delete pBez;
 }
 
-// The following is available in opennurbs but only used the Rhino SDK
-// version of RhinoCommon.
-#if !defined(OPENNURBS_BUILD)
 RH_C_FUNCTION ON_SimpleArray<const ON_3dmObjectAttributes*>* ON_SimpleArray_3dmObjectAttributes_New()
 {
   return new ON_SimpleArray<const ON_3dmObjectAttributes*>();
@@ -491,7 +527,6 @@ RH_C_FUNCTION const ON_3dmObjectAttributes* ON_SimpleArray_3dmObjectAttributes_G
     return (*pArray)[index];
   return 0;
 }
-#endif
 /////////////////////////////////////////////////////////////////////////////
 // ON_SimpleArray<ON_Curve*> 
 
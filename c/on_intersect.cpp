@@ -1,5 +1,10 @@
 #include "StdAfx.h"
 
+#if defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#include <emmintrin.h>
+#define RHCMN_SSE2
+#endif
+
 RH_C_FUNCTION bool ON_Intersect_LineLine(ON_Line* lineA, ON_Line* lineB, double* a, double* b)
 {
   bool rc = false;
@@ -568,3 +573,693 @@ RH_C_FUNCTION void ON_Intersect_MeshPolyline_Fill(ON_SimpleArray<ON_CMX_EVENT>*
 }
 
 #endif
+
+/////////////////////////////////////////////////////////////////////////////
+// Mesh ray engine
+//
+// The mesh is triangulated once (quads split along vi[0]-vi[2], the split
+// ON_MESH_POINT barycentrics assume) and stored relative to the center of
+// its bounding box so single precision keeps its accuracy far from the
+// origin. A bounding volume hierarchy is built with a binned surface area
+// heuristic and flattened depth first: the left child of a node is the next
+// node and only the right child index is stored. Every leaf holds one packet
+// of up to four triangles in structure-of-arrays layout, so a leaf is
+// tested with a single four wide ray/triangle test.
+
+class CRhCmnMeshRayEngine
+{
+public:
+  bool Create( const ON_Mesh& mesh );
+
+  // Ray is P + t*V. Returns the face index of the closest hit with
+  // t_min < t < t_max, or -1.
+  int FirstHit( const ON_3dPoint& P, const ON_3dVector& V, double t_min, double t_max, double* t, double barycentrics[4] ) const;
+  bool AnyHit( const ON_3dPoint& P, const ON_3dVector& V, double t_min, double t_max ) const;
+
+private:
+  struct Node
+  {
+    float m_min[3];
+    int m_right;  // interior: index of right child, leaf: packet index
+    float m_max[3];
+    int m_axis;   // interior: split axis, leaf: -1
+  };
+
+  // Four triangles as vertex 0 plus the two edges leaving it
+  struct Packet
+  {
+    float m_v0[3][4];
+    float m_e1[3][4];
+    float m_e2[3][4];
+  };
+
+  struct Ray
+  {
+    float m_origin[3];
+    float m_dir[3];
+    float m_inv_dir[3];
+    float m_t_min;
+  };
+
+  struct BuildTriangle
+  {
+    float m_v[3][3];
+    float m_min[3];
+    float m_max[3];
+    float m_center[3];
+    int m_face;
+    int m_half;  // 0 = vi[0],vi[1],vi[2]  1 = vi[0],vi[2],vi[3]
+  };
+
+  void Build( ON_SimpleArray<BuildTriangle>& tris, int begin, int end, int depth );
+  int MakeLeaf( const BuildTriangle* tris, int count );
+  void MakeRay( const ON_3dPoint& P, const ON_3dVector& V, double t_min, Ray& ray ) const;
+  bool HitBox( const Node& node, const Ray& ray, float t_max ) const;
+  int HitPacket( int packet, const Ray& ray, float* t_best, float* u, float* v ) const;
+
+  ON_3dPoint m_center;
+  ON_SimpleArray<Node> m_nodes;
+  ON_SimpleArray<Packet> m_packets;
+  ON_SimpleArray<int> m_faces;   // 4 per packet, -1 for padding
+  ON_SimpleArray<char> m_halves; // 4 per packet
+};
+
+static const int MeshRayMaxDepth = 96;
+
+bool CRhCmnMeshRayEngine::Create( const ON_Mesh& mesh )
+{
+  m_nodes.Empty();
+  m_packets.Empty();
+  m_faces.Empty();
+  m_halves.Empty();
+
+  const int vertex_count = mesh.m_V.Count();
+  const int face_count = mesh.m_F.Count();
+  if( vertex_count < 3 || face_count < 1 )
+    return false;
+  const ON_BoundingBox bbox = mesh.BoundingBox();
+  if( !bbox.IsValid() )
+    return false;
+  m_center = bbox.Center();
+
+  ON_SimpleArray<BuildTriangle> tris(2*face_count);
+  for( int fi=0; fi<face_count; fi++ )
+  {
+    const ON_MeshFace& face = mesh.m_F[fi];
+    if( !face.IsValid(vertex_count) )
+      continue;
+    const int half_count = face.IsQuad() ? 2 : 1;
+    for( int half=0; half<half_count; half++ )
+    {
+      const int vi[3] = { face.vi[0], face.vi[half+1], face.vi[half+2] };
+      BuildTriangle& tri = tris.AppendNew();
+      tri.m_face = fi;
+      tri.m_half = half;
+      for( int k=0; k<3; k++ )
+      {
+        const ON_3fPoint& p = mesh.m_V[vi[k]];
+        tri.m_v[k][0] = (float)(p.x - m_center.x);
+        tri.m_v[k][1] = (float)(p.y - m_center.y);
+        tri.m_v[k][2] = (float)(p.z - m_center.z);
+      }
+      for( int a=0; a<3; a++ )
+      {
+        tri.m_min[a] = ON_Min(tri.m_v[0][a], ON_Min(tri.m_v[1][a], tri.m_v[2][a]));
+        tri.m_max[a] = ON_Max(tri.m_v[0][a], ON_Max(tri.m_v[1][a], tri.m_v[2][a]));
+        tri.m_center[a] = 0.5f*(tri.m_min[a] + tri.m_max[a]);
+      }
+    }
+  }
+  if( tris.Count() < 1 )
+    return false;
+
+  const int leaf_estimate = tris.Count()/2 + 1;
+  m_nodes.SetCapacity(2*leaf_estimate);
+  m_packets.SetCapacity(leaf_estimate);
+  Build(tris, 0, tris.Count(), 0);
+  return true;
+}
+
+int CRhCmnMeshRayEngine::MakeLeaf( const BuildTriangle* tris, int count )
+{
+  const int packet_index = m_packets.Count();
+  Packet& packet = m_packets.AppendNew();
+  memset(&packet, 0, sizeof(packet));
+  for( int lane=0; lane<4; lane++ )
+  {
+    if( lane < count )
+    {
+      const BuildTriangle& tri = tris[lane];
+      for( int a=0; a<3; a++ )
+      {
+        packet.m_v0[a][lane] = tri.m_v[0][a];
+        packet.m_e1[a][lane] = tri.m_v[1][a] - tri.m_v[0][a];
+        packet.m_e2[a][lane] = tri.m_v[2][a] - tri.m_v[0][a];
+      }
+      m_faces.Append(tri.m_face);
+      m_halves.Append((char)tri.m_half);
+    }
+    else
+    {
+      // zero edges give a zero determinant, so padding never hits
+      m_faces.Append(-1);
+      m_halves.Append(0);
+    }
+  }
+  return packet_index;
+}
+
+void CRhCmnMeshRayEngine::Build( ON_SimpleArray<BuildTriangle>& tris, int begin, int end, int depth )
+{
+  const int node_index = m_nodes.Count();
+  {
+    Node& node = m_nodes.AppendNew();
+    for( int a=0; a<3; a++ )
+    {
+      node.m_min[a] = tris[begin].m_min[a];
+      node.m_max[a] = tris[begin].m_max[a];
+    }
+    for( int i=begin+1; i<end; i++ )
+    {
+      for( int a=0; a<3; a++ )
+      {
+        if( tris[i].m_min[a] < node.m_min[a] ) node.m_min[a] = tris[i].m_min[a];
+        if( tris[i].m_max[a] > node.m_max[a] ) node.m_max[a] = tris[i].m_max[a];
+      }
+    }
+  }
+
+  const int count = end - begin;
+  if( count <= 4 )
+  {
+    const int packet = MakeLeaf(tris.Array() + begin, count);
+    m_nodes[node_index].m_right = packet;
+    m_nodes[node_index].m_axis = -1;
+    return;
+  }
+
+  // split axis = longest extent of the triangle centers
+  float cmin[3], cmax[3];
+  for( int a=0; a<3; a++ )
+    cmin[a] = cmax[a] = tris[begin].m_center[a];
+  for( int i=begin+1; i<end; i++ )
+  {
+    for( int a=0; a<3; a++ )
+    {
+      if( tris[i].m_center[a] < cmin[a] ) cmin[a] = tris[i].m_center[a];
+      if( tris[i].m_center[a] > cmax[a] ) cmax[a] = tris[i].m_center[a];
+    }
+  }
+  int axis = 0;
+  if( cmax[1]-cmin[1] > cmax[axis]-cmin[axis] ) axis = 1;
+  if( cmax[2]-cmin[2] > cmax[axis]-cmin[axis] ) axis = 2;
+  const float extent = cmax[axis] - cmin[axis];
+
+  int mid = -1;
+  if( extent > 0.0f && depth < MeshRayMaxDepth )
+  {
+    // binned surface area heuristic
+    const int bin_count = 16;
+    int bin_tris[bin_count];
+    float bin_min[bin_count][3], bin_max[bin_count][3];
+    for( int b=0; b<bin_count; b++ )
+    {
+      bin_tris[b] = 0;
+      for( int a=0; a<3; a++ )
+      {
+        bin_min[b][a] = ON_UNSET_POSITIVE_FLOAT;
+        bin_max[b][a] = ON_UNSET_FLOAT;
+      }
+    }
+    const float scale = bin_count / extent;
+    for( int i=begin; i<end; i++ )
+    {
+      int b = (int)((tris[i].m_center[axis] - cmin[axis]) * scale);
+      if( b >= bin_count ) b = bin_count-1;
+      bin_tris[b]++;
+      for( int a=0; a<3; a++ )
+      {
+        if( tris[i].m_min[a] < bin_min[b][a] ) bin_min[b][a] = tris[i].m_min[a];
+        if( tris[i].m_max[a] > bin_max[b][a] ) bin_max[b][a] = tris[i].m_max[a];
+      }
+    }
+
+    // sweep from the right to get the cost of every right hand side
+    float right_area[bin_count];
+    int right_tris[bin_count];
+    {
+      float rmin[3] = { ON_UNSET_POSITIVE_FLOAT, ON_UNSET_POSITIVE_FLOAT, ON_UNSET_POSITIVE_FLOAT };
+      float rmax[3] = { ON_UNSET_FLOAT, ON_UNSET_FLOAT, ON_UNSET_FLOAT };
+      int n = 0;
+      for( int b=bin_count-1; b>0; b-- )
+      {
+        n += bin_tris[b];
+        for( int a=0; a<3; a++ )
+        {
+          if( bin_min[b][a] < rmin[a] ) rmin[a] = bin_min[b][a];
+          if( bin_max[b][a] > rmax[a] ) rmax[a] = bin_max[b][a];
+        }
+        const float dx = rmax[0]-rmin[0], dy = rmax[1]-rmin[1], dz = rmax[2]-rmin[2];
+        right_area[b] = n ? dx*dy + dy*dz + dz*dx : 0.0f;
+        right_tris[b] = n;
+      }
+    }
+
+    float best_cost = ON_UNSET_POSITIVE_FLOAT;
+    int best_bin = -1;
+    {
+      float lmin[3] = { ON_UNSET_POSITIVE_FLOAT, ON_UNSET_POSITIVE_FLOAT, ON_UNSET_POSITIVE_FLOAT };
+      float lmax[3] = { ON_UNSET_FLOAT, ON_UNSET_FLOAT, ON_UNSET_FLOAT };
+      int n = 0;
+      for( int b=1; b<bin_count; b++ )
+      {
+        n += bin_tris[b-1];
+        for( int a=0; a<3; a++ )
+        {
+          if( bin_min[b-1][a] < lmin[a] ) lmin[a] = bin_min[b-1][a];
+          if( bin_max[b-1][a] > lmax[a] ) lmax[a] = bin_max[b-1][a];
+        }
+        if( 0 == n || 0 == right_tris[b] )
+          continue;
+        const float dx = lmax[0]-lmin[0], dy = lmax[1]-lmin[1], dz = lmax[2]-lmin[2];
+        const float cost = (dx*dy + dy*dz + dz*dx)*n + right_area[b]*right_tris[b];
+        if( cost < best_cost )
+        {
+          best_cost = cost;
+          best_bin = b;
+        }
+      }
+    }
+
+    if( best_bin > 0 )
+    {
+      // partition in place around the chosen bin boundary
+      int i = begin;
+      int j = end-1;
+      while( i <= j )
+      {
+        int b = (int)((tris[i].m_center[axis] - cmin[axis]) * scale);
+        if( b >= bin_count ) b = bin_count-1;
+        if( b < best_bin )
+          i++;
+        else
+        {
+          const BuildTriangle tmp = tris[i];
+          tris[i] = tris[j];
+          tris[j] = tmp;
+          j--;
+        }
+      }
+      mid = i;
+    }
+  }
+
+  if( mid <= begin || mid >= end )
+  {
+    // Centers coincide, the heuristic found nothing or the tree is already
+    // deep: split by count. Only the halves matter here, so an unsorted
+    // split is acceptable.
+    mid = begin + count/2;
+  }
+
+  Build(tris, begin, mid, depth+1);
+  const int right = m_nodes.Count();
+  Build(tris, mid, end, depth+1);
+  m_nodes[node_index].m_right = right;
+  m_nodes[node_index].m_axis = axis;
+}
+
+void CRhCmnMeshRayEngine::MakeRay( const ON_3dPoint& P, const ON_3dVector& V, double t_min, Ray& ray ) const
+{
+  const double origin[3] = { P.x - m_center.x, P.y - m_center.y, P.z - m_center.z };
+  const double dir[3] = { V.x, V.y, V.z };
+  for( int a=0; a<3; a++ )
+  {
+    ray.m_origin[a] = (float)origin[a];
+    ray.m_dir[a] = (float)dir[a];
+    // keep the slab test finite for axis aligned rays
+    double d = dir[a];
+    if( fabs(d) < 1.0e-30 )
+      d = (d < 0.0) ? -1.0e-30 : 1.0e-30;
+    ray.m_inv_dir[a] = (float)(1.0/d);
+  }
+  ray.m_t_min = (float)t_min;
+}
+
+bool CRhCmnMeshRayEngine::HitBox( const Node& node, const Ray& ray, float t_max ) const
+{
+  float t0 = ray.m_t_min;
+  float t1 = t_max;
+  for( int a=0; a<3; a++ )
+  {
+    float tn = (node.m_min[a] - ray.m_origin[a]) * ray.m_inv_dir[a];
+    float tf = (node.m_max[a] - ray.m_origin[a]) * ray.m_inv_dir[a];
+    if( tn > tf )
+    {
+      const float tmp = tn;
+      tn = tf;
+      tf = tmp;
+    }
+    if( tn > t0 ) t0 = tn;
+    if( tf < t1 ) t1 = tf;
+    if( t0 > t1 )
+      return false;
+  }
+  return true;
+}
+
+// Moller-Trumbore against the four lanes of a packet. Returns the lane of
+// the closest hit with t_min < t < *t_best and updates *t_best, or -1.
+int CRhCmnMeshRayEngine::HitPacket( int packet_index, const Ray& ray, float* t_best, float* u_out, float* v_out ) const
+{
+  const Packet& p = m_packets[packet_index];
+  int lane_hit = -1;
+#if defined(RHCMN_SSE2)
+  const __m128 dx = _mm_set1_ps(ray.m_dir[0]);
+  const __m128 dy = _mm_set1_ps(ray.m_dir[1]);
+  const __m128 dz = _mm_set1_ps(ray.m_dir[2]);
+  const __m128 e1x = _mm_loadu_ps(p.m_e1[0]), e1y = _mm_loadu_ps(p.m_e1[1]), e1z = _mm_loadu_ps(p.m_e1[2]);
+  const __m128 e2x = _mm_loadu_ps(p.m_e2[0]), e2y = _mm_loadu_ps(p.m_e2[1]), e2z = _mm_loadu_ps(p.m_e2[2]);
+
+  // pvec = dir x e2
+  const __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+  const __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+  const __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+  const __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+  const __m128 inv_det = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+  // tvec = origin - v0
+  const __m128 tx = _mm_sub_ps(_mm_set1_ps(ray.m_origin[0]), _mm_loadu_ps(p.m_v0[0]));
+  const __m128 ty = _mm_sub_ps(_mm_set1_ps(ray.m_origin[1]), _mm_loadu_ps(p.m_v0[1]));
+  const __m128 tz = _mm_sub_ps(_mm_set1_ps(ray.m_origin[2]), _mm_loadu_ps(p.m_v0[2]));
+  const __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, px), _mm_mul_ps(ty, py)), _mm_mul_ps(tz, pz)), inv_det);
+
+  // qvec = tvec x e1
+  const __m128 qx = _mm_sub_ps(_mm_mul_ps(ty, e1z), _mm_mul_ps(tz, e1y));
+  const __m128 qy = _mm_sub_ps(_mm_mul_ps(tz, e1x), _mm_mul_ps(tx, e1z));
+  const __m128 qz = _mm_sub_ps(_mm_mul_ps(tx, e1y), _mm_mul_ps(ty, e1x));
+  const __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), inv_det);
+  const __m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), inv_det);
+
+  const __m128 zero = _mm_setzero_ps();
+  __m128 mask = _mm_cmpneq_ps(det, zero);
+  mask = _mm_and_ps(mask, _mm_cmpge_ps(u, zero));
+  mask = _mm_and_ps(mask, _mm_cmpge_ps(v, zero));
+  mask = _mm_and_ps(mask, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+  mask = _mm_and_ps(mask, _mm_cmpgt_ps(t, _mm_set1_ps(ray.m_t_min)));
+  mask = _mm_and_ps(mask, _mm_cmplt_ps(t, _mm_set1_ps(*t_best)));
+  const int bits = _mm_movemask_ps(mask);
+  if( bits )
+  {
+    float tt[4], uu[4], vv[4];
+    _mm_storeu_ps(tt, t);
+    _mm_storeu_ps(uu, u);
+    _mm_storeu_ps(vv, v);
+    for( int lane=0; lane<4; lane++ )
+    {
+      if( (bits & (1<<lane)) && tt[lane] < *t_best )
+      {
+        *t_best = tt[lane];
+        *u_out = uu[lane];
+        *v_out = vv[lane];
+        lane_hit = lane;
+      }
+    }
+  }
+#else
+  for( int lane=0; lane<4; lane++ )
+  {
+    const float e1[3] = { p.m_e1[0][lane], p.m_e1[1][lane], p.m_e1[2][lane] };
+    const float e2[3] = { p.m_e2[0][lane], p.m_e2[1][lane], p.m_e2[2][lane] };
+    const float* d = ray.m_dir;
+    const float pv[3] = { d[1]*e2[2] - d[2]*e2[1], d[2]*e2[0] - d[0]*e2[2], d[0]*e2[1] - d[1]*e2[0] };
+    const float det = e1[0]*pv[0] + e1[1]*pv[1] + e1[2]*pv[2];
+    if( 0.0f == det )
+      continue;
+    const float inv_det = 1.0f/det;
+    const float tv[3] = { ray.m_origin[0] - p.m_v0[0][lane], ray.m_origin[1] - p.m_v0[1][lane], ray.m_origin[2] - p.m_v0[2][lane] };
+    const float u = (tv[0]*pv[0] + tv[1]*pv[1] + tv[2]*pv[2]) * inv_det;
+    if( !(u >= 0.0f) )
+      continue;
+    const float qv[3] = { tv[1]*e1[2] - tv[2]*e1[1], tv[2]*e1[0] - tv[0]*e1[2], tv[0]*e1[1] - tv[1]*e1[0] };
+    const float v = (d[0]*qv[0] + d[1]*qv[1] + d[2]*qv[2]) * inv_det;
+    if( !(v >= 0.0f) || u+v > 1.0f )
+      continue;
+    const float t = (e2[0]*qv[0] + e2[1]*qv[1] + e2[2]*qv[2]) * inv_det;
+    if( t > ray.m_t_min && t < *t_best )
+    {
+      *t_best = t;
+      *u_out = u;
+      *v_out = v;
+      lane_hit = lane;
+    }
+  }
+#endif
+  return lane_hit;
+}
+
+int CRhCmnMeshRayEngine::FirstHit( const ON_3dPoint& P, const ON_3dVector& V, double t_min, double t_max, double* t, double barycentrics[4] ) const
+{
+  if( m_nodes.Count() < 1 )
+    return -1;
+  Ray ray;
+  MakeRay(P, V, t_min, ray);
+  float t_best = (t_max > 0.0 && t_max < ON_UNSET_POSITIVE_FLOAT) ? (float)t_max : ON_UNSET_POSITIVE_FLOAT;
+  int hit_slot = -1;
+  float hit_u = 0.0f, hit_v = 0.0f;
+
+  int stack[MeshRayMaxDepth + 64];
+  int stack_count = 0;
+  stack[stack_count++] = 0;
+  while( stack_count > 0 )
+  {
+    const int node_index = stack[--stack_count];
+    const Node& node = m_nodes[node_index];
+    if( !HitBox(node, ray, t_best) )
+      continue;
+    if( node.m_axis < 0 )
+    {
+      float u, v;
+      const int lane = HitPacket(node.m_right, ray, &t_best, &u, &v);
+      if( lane >= 0 )
+      {
+        hit_slot = 4*node.m_right + lane;
+        hit_u = u;
+        hit_v = v;
+      }
+      continue;
+    }
+    // visit the child on the near side of the split first
+    const int left = node_index + 1;
+    if( ray.m_dir[node.m_axis] < 0.0f )
+    {
+      stack[stack_count++] = left;
+      stack[stack_count++] = node.m_right;
+    }
+    else
+    {
+      stack[stack_count++] = node.m_right;
+      stack[stack_count++] = left;
+    }
+  }
+  if( hit_slot < 0 )
+    return -1;
+
+  if( t )
+    *t = t_best;
+  if( barycentrics )
+  {
+    const double w = 1.0 - hit_u - hit_v;
+    if( 0 == m_halves[hit_slot] )
+    {
+      barycentrics[0] = w;
+      barycentrics[1] = hit_u;
+      barycentrics[2] = hit_v;
+      barycentrics[3] = 0.0;
+    }
+    else
+    {
+      // second half of a quad: vi[0], vi[2], vi[3]
+      barycentrics[0] = w;
+      barycentrics[1] = 0.0;
+      barycentrics[2] = hit_u;
+      barycentrics[3] = hit_v;
+    }
+  }
+  return m_faces[hit_slot];
+}
+
+bool CRhCmnMeshRayEngine::AnyHit( const ON_3dPoint& P, const ON_3dVector& V, double t_min, double t_max ) const
+{
+  if( m_nodes.Count() < 1 )
+    return false;
+  Ray ray;
+  MakeRay(P, V, t_min, ray);
+  const float t_limit = (t_max > 0.0 && t_max < ON_UNSET_POSITIVE_FLOAT) ? (float)t_max : ON_UNSET_POSITIVE_FLOAT;
+
+  int stack[MeshRayMaxDepth + 64];
+  int stack_count = 0;
+  stack[stack_count++] = 0;
+  while( stack_count > 0 )
+  {
+    const int node_index = stack[--stack_count];
+    const Node& node = m_nodes[node_index];
+    if( !HitBox(node, ray, t_limit) )
+      continue;
+    if( node.m_axis < 0 )
+    {
+      float t_best = t_limit, u, v;
+      if( HitPacket(node.m_right, ray, &t_best, &u, &v) >= 0 )
+        return true;
+      continue;
+    }
+    stack[stack_count++] = node.m_right;
+    stack[stack_count++] = node_index + 1;
+  }
+  return false;
+}
+
+struct MeshRaysContext
+{
+  const CRhCmnMeshRayEngine* m_engine;
+  const double* m_rays; // origin and direction, 6 doubles per ray
+  int m_count;
+  int m_block_size;
+  double m_t_min;
+  double m_t_max;
+  double* m_t;
+  int* m_face_indices;
+  double* m_barycentrics;
+  int* m_any_hit;
+  int* m_hits; // one count per block
+};
+
+static void FirstHitBlockAt(int block, void* context)
+{
+  MeshRaysContext* ctx = (MeshRaysContext*)context;
+  const int i0 = block * ctx->m_block_size;
+  int i1 = i0 + ctx->m_block_size;
+  if( i1 > ctx->m_count )
+    i1 = ctx->m_count;
+  int hits = 0;
+  for( int i=i0; i<i1; i++ )
+  {
+    const double* r = ctx->m_rays + 6*i;
+    double t = -1.0;
+    double* barycentrics = ctx->m_barycentrics ? ctx->m_barycentrics + 4*i : NULL;
+    const int face = ctx->m_engine->FirstHit(ON_3dPoint(r[0],r[1],r[2]), ON_3dVector(r[3],r[4],r[5]), ctx->m_t_min, ctx->m_t_max, &t, barycentrics);
+    ctx->m_face_indices[i] = face;
+    ctx->m_t[i] = (face >= 0) ? t : -1.0;
+    if( face >= 0 )
+      hits++;
+    else if( barycentrics )
+      barycentrics[0] = barycentrics[1] = barycentrics[2] = barycentrics[3] = 0.0;
+  }
+  ctx->m_hits[block] = hits;
+}
+
+static void AnyHitBlockAt(int block, void* context)
+{
+  MeshRaysContext* ctx = (MeshRaysContext*)context;
+  const int i0 = block * ctx->m_block_size;
+  int i1 = i0 + ctx->m_block_size;
+  if( i1 > ctx->m_count )
+    i1 = ctx->m_count;
+  int hits = 0;
+  for( int i=i0; i<i1; i++ )
+  {
+    const double* r = ctx->m_rays + 6*i;
+    const bool hit = ctx->m_engine->AnyHit(ON_3dPoint(r[0],r[1],r[2]), ON_3dVector(r[3],r[4],r[5]), ctx->m_t_min, ctx->m_t_max);
+    ctx->m_any_hit[i] = hit ? 1 : 0;
+    if( hit )
+      hits++;
+  }
+  ctx->m_hits[block] = hits;
+}
+
+static int CastMeshRays(const CRhCmnMeshRayEngine* pConstEngine, int count, const double* rays, double tMin, double tMax, RHCMN_PARALLEL_FOR_FUNC func, MeshRaysContext& ctx, int maxThreads)
+{
+  const int block_size = 64;
+  const int block_count = (count + block_size - 1) / block_size;
+  ON_SimpleArray<int> hits(block_count);
+  hits.SetCount(block_count);
+  hits.Zero();
+  ctx.m_engine = pConstEngine;
+  ctx.m_rays = rays;
+  ctx.m_count = count;
+  ctx.m_block_size = block_size;
+  ctx.m_t_min = tMin;
+  ctx.m_t_max = tMax;
+  ctx.m_hits = hits.Array();
+  RhCmnParallelFor(block_count, func, &ctx, maxThreads);
+  int rc = 0;
+  for( int i=0; i<block_count; i++ )
+    rc += hits[i];
+  return rc;
+}
+
+// Builds a ray engine from the current state of the mesh. Later edits to
+// the mesh are not seen; create a new engine after changing it.
+RH_C_FUNCTION CRhCmnMeshRayEngine* ON_MeshRayEngine_New(const ON_Mesh* pConstMesh)
+{
+  CRhCmnMeshRayEngine* rc = NULL;
+  if( pConstMesh )
+  {
+    rc = new CRhCmnMeshRayEngine();
+    if( !rc->Create(*pConstMesh) )
+    {
+      delete rc;
+      rc = NULL;
+    }
+  }
+  return rc;
+}
+
+RH_C_FUNCTION void ON_MeshRayEngine_Delete(CRhCmnMeshRayEngine* pEngine)
+{
+  if( pEngine )
+    delete pEngine;
+}
+
+// Closest hit of a single ray P + t*V with tMin < t < tMax (tMax <= 0 means
+// no limit). Returns the face index or -1.
+RH_C_FUNCTION int ON_MeshRayEngine_FirstHit(const CRhCmnMeshRayEngine* pConstEngine, const ON_3dRay* pConstRay, double tMin, double tMax, double* t, /*ARRAY*/double* barycentrics)
+{
+  int rc = -1;
+  if( pConstEngine && pConstRay )
+    rc = pConstEngine->FirstHit(pConstRay->m_P, pConstRay->m_V, tMin, tMax, t, barycentrics);
+  return rc;
+}
+
+// Casts count rays given as origin and direction (6 doubles per ray) on
+// worker threads. t and faceIndices receive -1 for misses; barycentrics, four
+// per ray in ON_MESH_POINT order, may be NULL. Returns the number of hits.
+RH_C_FUNCTION int ON_MeshRayEngine_FirstHits(const CRhCmnMeshRayEngine* pConstEngine, int count, /*ARRAY*/const double* rays, double tMin, double tMax, /*ARRAY*/double* t, /*ARRAY*/int* faceIndices, /*ARRAY*/double* barycentrics, int maxThreads)
+{
+  int rc = 0;
+  if( pConstEngine && count>0 && rays && t && faceIndices )
+  {
+    MeshRaysContext ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.m_t = t;
+    ctx.m_face_indices = faceIndices;
+    ctx.m_barycentrics = barycentrics;
+    rc = CastMeshRays(pConstEngine, count, rays, tMin, tMax, FirstHitBlockAt, ctx, maxThreads);
+  }
+  return rc;
+}
+
+// Occlusion form of ON_MeshRayEngine_FirstHits: each ray stops at the first
+// triangle it finds. hit receives 1 or 0 per ray. Returns the number of hits.
+RH_C_FUNCTION int ON_MeshRayEngine_AnyHits(const CRhCmnMeshRayEngine* pConstEngine, int count, /*ARRAY*/const double* rays, double tMin, double tMax, /*ARRAY*/int* hit, int maxThreads)
+{
+  int rc = 0;
+  if( pConstEngine && count>0 && rays && hit )
+  {
+    MeshRaysContext ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.m_any_hit = hit;
+    rc = CastMeshRays(pConstEngine, count, rays, tMin, tMax, AnyHitBlockAt, ctx, maxThreads);
+  }
+  return rc;
+}
@@ -149,26 +149,110 @@ RH_C_FUNCTION bool ON_Mesh_InsertFace(ON_Mesh* pMesh, int index, int vertex1, in
   return rc;
 }
 
-//RH_C_FUNCTION bool ON_Mesh_SetVertices(ON_Mesh* ptr, int count, ON_3fPoint* locations, bool append)
-//{
-//  bool rc = false;
-//  if( ptr && count>0 && locations )
-//  {
-//    int startIndex = 0;
-//    if( append )
-//      int startIndex = ptr->m_V.Count();
-//    
-//    ptr->m_V.SetCapacity(startIndex + count);
-//    ON_3fPoint* dest = ptr->m_V.Array() + startIndex;
-//    ::memcpy(dest, locations, count*sizeof(ON_3fPoint));
-//    ptr->m_V.SetCount(startIndex+count);
-//
-//    rc = true;
-//    ptr->InvalidateBoundingBoxes();
-//    ptr->DestroyTopology();
-//  }
-//  return rc;
-//}
+// True if no face of mesh uses a vertex index at or past vertexCount
+static bool FacesFitVertexCount(const ON_Mesh* pMesh, int vertexCount)
+{
+  const int faceCount = pMesh->m_F.Count();
+  for( int i=0; i<faceCount; i++ )
+  {
+    const int* vi = pMesh->m_F[i].vi;
+    for( int j=0; j<4; j++ )
+    {
+      if( (unsigned int)vi[j] >= (unsigned int)vertexCount )
+        return false;
+    }
+  }
+  return true;
+}
+
+// After the vertex list was replaced, empties the per vertex lists that no
+// longer have one entry per vertex. Lists of the same length are kept.
+static void DropStaleVertexLists(ON_Mesh* pMesh)
+{
+  const int vertexCount = pMesh->m_V.Count();
+  if( pMesh->m_N.Count() != vertexCount )
+    pMesh->m_N.SetCount(0);
+  if( pMesh->m_T.Count() != vertexCount )
+    pMesh->m_T.SetCount(0);
+  if( pMesh->m_S.Count() != vertexCount )
+    pMesh->m_S.SetCount(0);
+  if( pMesh->m_K.Count() != vertexCount )
+    pMesh->m_K.SetCount(0);
+  if( pMesh->m_C.Count() != vertexCount )
+    pMesh->m_C.SetCount(0);
+  if( pMesh->m_H.Count() != vertexCount )
+    pMesh->m_H.SetCount(0);
+  for( int i=0; i<pMesh->m_TC.Count(); i++ )
+  {
+    if( pMesh->m_TC[i].m_T.Count() != vertexCount )
+    {
+      pMesh->m_TC.Destroy();
+      break;
+    }
+  }
+}
+
+// Replaces or appends count vertices in one call. The runtime cache is
+// destroyed once for the whole batch. When replacing, the call fails and
+// changes nothing if an existing face uses an index at or past count;
+// normals, colors, texture coordinates and other per vertex lists that do
+// not match the new count are emptied.
+RH_C_FUNCTION bool ON_Mesh_SetVertices(ON_Mesh* pMesh, int count, /*ARRAY*/const ON_3fPoint* locations, bool append)
+{
+  bool rc = false;
+  if( pMesh && count>0 && locations )
+  {
+    if( !append && !FacesFitVertexCount(pMesh, count) )
+      return false;
+
+    int startIndex = 0;
+    if( append )
+      startIndex = pMesh->m_V.Count();
+
+    pMesh->m_V.SetCapacity(startIndex + count);
+    ON_3fPoint* dest = pMesh->m_V.Array() + startIndex;
+    ::memcpy(dest, locations, count*sizeof(ON_3fPoint));
+    pMesh->m_V.SetCount(startIndex+count);
+    if( !append )
+      DropStaleVertexLists(pMesh);
+
+    rc = true;
+    pMesh->InvalidateBoundingBoxes();
+    pMesh->DestroyRuntimeCache();
+  }
+  return rc;
+}
+
+// Same as ON_Mesh_SetVertices but takes 3*count doubles
+RH_C_FUNCTION bool ON_Mesh_SetVertices2(ON_Mesh* pMesh, int count, /*ARRAY*/const double* xyz, bool append)
+{
+  bool rc = false;
+  if( pMesh && count>0 && xyz )
+  {
+    if( !append && !FacesFitVertexCount(pMesh, count) )
+      return false;
+
+    int startIndex = 0;
+    if( append )
+      startIndex = pMesh->m_V.Count();
+
+    pMesh->m_V.SetCapacity(startIndex + count);
+    // ON_3fPoint is three packed floats, so convert as one flat run that
+    // the compiler can vectorize
+    float* dest = &(pMesh->m_V.Array()[startIndex].x);
+    const int length = 3*count;
+    for( int i=0; i<length; i++ )
+      dest[i] = (float)xyz[i];
+    pMesh->m_V.SetCount(startIndex+count);
+    if( !append )
+      DropStaleVertexLists(pMesh);
+
+    rc = true;
+    pMesh->InvalidateBoundingBoxes();
+    pMesh->DestroyRuntimeCache();
+  }
+  return rc;
+}
 
 RH_C_FUNCTION bool ON_Mesh_SetNormal(ON_Mesh* pMesh, int index, ON_3FVECTOR_STRUCT vector, bool faceNormal)
 {
@@ -296,17 +380,14 @@ RH_C_FUNCTION bool ON_Mesh_SetVertexColors(ON_Mesh* pMesh, int count, /*ARRAY*/c
   bool rc = false;
   if( pMesh && count>0 && argb )
   {
-    unsigned int* list = (unsigned int*)argb;
-    for( int i=0; i<count; i++ )
-      list[i] = ARGB_to_ABGR(list[i]);
-
     int startIndex = 0;
     if( append )
       startIndex = pMesh->m_C.Count();
     
+    // convert straight into m_C; the caller's array is left untouched
     pMesh->m_C.SetCapacity(startIndex + count);
     ON_Color* dest = pMesh->m_C.Array() + startIndex;
-    ::memcpy(dest, list, count*sizeof(unsigned int));
+    RhCmnSwizzleColors(count, (const unsigned int*)argb, (unsigned int*)dest);
     pMesh->m_C.SetCount(startIndex+count);
     memset(&(pMesh->m_Ctag),0,sizeof(pMesh->m_Ctag));
     rc = true;
@@ -314,45 +395,103 @@ RH_C_FUNCTION bool ON_Mesh_SetVertexColors(ON_Mesh* pMesh, int count, /*ARRAY*/c
   return rc;
 }
 
-//RH_C_FUNCTION bool ON_Mesh_SetFaces(ON_Mesh* ptr, int count, int* vertices, bool quads, bool append)
-//{
-//  bool rc = false;
-//  if( ptr && count>2 && vertices )
-//  {
-//    if( !append )
-//      ptr->m_F.SetCount(0);
-//    int faceid = ptr->m_F.Count();
-//    int start = faceid;
-//    if( quads )
-//    {
-//      int end = count/4 + start;
-//      for( int i=start; i<end; i++ )
-//      {
-//        int index0 = *vertices++;
-//        int index1 = *vertices++;
-//        int index2 = *vertices++;
-//        int index3 = *vertices++;
-//        ptr->SetQuad(i, index0, index1, index2, index3);
-//      }
-//    }
-//    else
-//    {
-//      int end = count/3 + start;
-//      for( int i=start; i<end; i++ )
-//      {
-//        int index0 = *vertices++;
-//        int index1 = *vertices++;
-//        int index2 = *vertices++;
-//        ptr->SetTriangle(i, index0, index1, index2);
-//      }
-//    }
-//
-//    rc = true;
-//    ptr->InvalidateBoundingBoxes();
-//    ptr->DestroyTopology();
-//  }
-//  return rc;
-//}
+// Replaces or appends faceCount faces in one call. vertices holds
+// verticesPerFace (3 or 4) indices per face. Fails without changing the mesh
+// if an index does not refer to an existing vertex. Replacing the faces
+// empties the face normals.
+RH_C_FUNCTION bool ON_Mesh_SetFaces(ON_Mesh* pMesh, int faceCount, int verticesPerFace, /*ARRAY*/const int* vertices, bool append)
+{
+  bool rc = false;
+  if( pMesh && faceCount>0 && vertices && (3==verticesPerFace || 4==verticesPerFace) )
+  {
+    const unsigned int vertexCount = (unsigned int)pMesh->m_V.Count();
+    const int length = faceCount*verticesPerFace;
+    for( int i=0; i<length; i++ )
+    {
+      if( (unsigned int)vertices[i] >= vertexCount )
+        return false;
+    }
+
+    int startIndex = 0;
+    if( append )
+      startIndex = pMesh->m_F.Count();
+
+    pMesh->m_F.SetCapacity(startIndex + faceCount);
+    ON_MeshFace* dest = pMesh->m_F.Array() + startIndex;
+    if( 4==verticesPerFace )
+    {
+      ::memcpy(dest, vertices, faceCount*sizeof(ON_MeshFace));
+    }
+    else
+    {
+      for( int i=0; i<faceCount; i++ )
+      {
+        dest[i].vi[0] = vertices[0];
+        dest[i].vi[1] = vertices[1];
+        dest[i].vi[2] = vertices[2];
+        dest[i].vi[3] = vertices[2];
+        vertices += 3;
+      }
+    }
+    pMesh->m_F.SetCount(startIndex+faceCount);
+    // face normals of the replaced faces no longer apply
+    if( !append )
+      pMesh->m_FN.SetCount(0);
+
+    rc = true;
+    pMesh->DestroyRuntimeCache();
+  }
+  return rc;
+}
+
+// Mixed triangles and quads. faceSizes holds 3 or 4 for each face and
+// vertices holds the indices of all faces back to back.
+RH_C_FUNCTION bool ON_Mesh_SetFaces2(ON_Mesh* pMesh, int faceCount, /*ARRAY*/const int* faceSizes, /*ARRAY*/const int* vertices, bool append)
+{
+  bool rc = false;
+  if( pMesh && faceCount>0 && faceSizes && vertices )
+  {
+    const unsigned int vertexCount = (unsigned int)pMesh->m_V.Count();
+    const int* vi = vertices;
+    for( int i=0; i<faceCount; i++ )
+    {
+      const int size = faceSizes[i];
+      if( 3!=size && 4!=size )
+        return false;
+      for( int j=0; j<size; j++ )
+      {
+        if( (unsigned int)vi[j] >= vertexCount )
+          return false;
+      }
+      vi += size;
+    }
+
+    int startIndex = 0;
+    if( append )
+      startIndex = pMesh->m_F.Count();
+
+    pMesh->m_F.SetCapacity(startIndex + faceCount);
+    ON_MeshFace* dest = pMesh->m_F.Array() + startIndex;
+    vi = vertices;
+    for( int i=0; i<faceCount; i++ )
+    {
+      dest[i].vi[0] = vi[0];
+      dest[i].vi[1] = vi[1];
+      dest[i].vi[2] = vi[2];
+      dest[i].vi[3] = (4==faceSizes[i]) ? vi[3] : vi[2];
+      vi += faceSizes[i];
+    }
+    pMesh->m_F.SetCount(startIndex+faceCount);
+    // face normals of the replaced faces no longer apply
+    if( !append )
+      pMesh->m_FN.SetCount(0);
+
+    rc = true;
+    pMesh->DestroyRuntimeCache();
+  }
+  return rc;
+}
+
 RH_C_FUNCTION void ON_Mesh_SetInt( ON_Mesh* pMesh, int which, int value )
 {
   const int idxVertexCount = 0;
@@ -781,6 +920,124 @@ RH_C_FUNCTION bool ON_Mesh_GetTextureCoordinate(const ON_Mesh* pConstMesh, int i
   return rc;
 }
 
+template <class T>
+static bool CopyMeshRange( const ON_SimpleArray<T>& list, int start, int count, T* dest )
+{
+  if( NULL==dest || start<0 || count<0 || count > list.Count()-start )
+    return false;
+  if( count>0 )
+    ::memcpy(dest, list.Array()+start, count*sizeof(T));
+  return true;
+}
+
+// The bulk getters below copy list[start] through list[start+count-1] into
+// the caller's buffer and fail if the range is outside the list.
+RH_C_FUNCTION bool ON_Mesh_GetVertices(const ON_Mesh* pConstMesh, int start, int count, /*ARRAY*/ON_3fPoint* vertices)
+{
+  bool rc = false;
+  if( pConstMesh )
+    rc = CopyMeshRange(pConstMesh->m_V, start, count, vertices);
+  return rc;
+}
+
+// Four vertex indices per face
+RH_C_FUNCTION bool ON_Mesh_GetFaces(const ON_Mesh* pConstMesh, int start, int count, /*ARRAY*/int* faces)
+{
+  bool rc = false;
+  if( pConstMesh )
+    rc = CopyMeshRange(pConstMesh->m_F, start, count, (ON_MeshFace*)faces);
+  return rc;
+}
+
+RH_C_FUNCTION bool ON_Mesh_GetNormals(const ON_Mesh* pConstMesh, int start, int count, /*ARRAY*/ON_3fVector* normals, bool faceNormals)
+{
+  bool rc = false;
+  if( pConstMesh )
+    rc = CopyMeshRange(faceNormals ? pConstMesh->m_FN : pConstMesh->m_N, start, count, normals);
+  return rc;
+}
+
+// Two floats (s,t) per texture coordinate
+RH_C_FUNCTION bool ON_Mesh_GetTextureCoordinates(const ON_Mesh* pConstMesh, int start, int count, /*ARRAY*/float* tcs)
+{
+  bool rc = false;
+  if( pConstMesh )
+    rc = CopyMeshRange(pConstMesh->m_T, start, count, (ON_2fPoint*)tcs);
+  return rc;
+}
+
+// Colors are converted to System.Drawing.Color ARGB layout
+RH_C_FUNCTION bool ON_Mesh_GetVertexColors(const ON_Mesh* pConstMesh, int start, int count, /*ARRAY*/int* argb)
+{
+  bool rc = false;
+  if( pConstMesh && argb && start>=0 && count>=0 && count <= pConstMesh->m_C.Count()-start )
+  {
+    const unsigned int* src = (const unsigned int*)(pConstMesh->m_C.Array() + start);
+    RhCmnSwizzleColors(count, src, (unsigned int*)argb);
+    rc = true;
+  }
+  return rc;
+}
+
+enum MeshListType : int
+{
+  mltVertices = 0,            // ON_3fPoint
+  mltFaces = 1,               // ON_MeshFace
+  mltVertexNormals = 2,       // ON_3fVector
+  mltFaceNormals = 3,         // ON_3fVector
+  mltVertexColors = 4,        // ON_Color (ABGR, alpha 0 is opaque)
+  mltTextureCoordinates = 5   // ON_2fPoint
+};
+
+template <class T>
+static const void* MeshListView( const ON_SimpleArray<T>& list, int* count, int* capacity )
+{
+  *count = list.Count();
+  *capacity = list.Capacity();
+  return list.Array();
+}
+
+// Gives direct read access to one of the mesh lists without copying. The
+// view is valid only until the next call that changes the mesh; the caller
+// must ask for a new view after any such call. The lists have no change
+// counter, so comparing pointer, count and capacity with an earlier call does
+// not tell whether the view is current: values can be written in place, and
+// a freed array can be reallocated at the same address with the same sizes.
+// The view must not be written to.
+RH_C_FUNCTION const void* ON_Mesh_GetListView(const ON_Mesh* pConstMesh, enum MeshListType which, int* count, int* capacity)
+{
+  const void* rc = NULL;
+  if( pConstMesh && count && capacity )
+  {
+    *count = 0;
+    *capacity = 0;
+    switch(which)
+    {
+    case mltVertices:
+      rc = MeshListView(pConstMesh->m_V, count, capacity);
+      break;
+    case mltFaces:
+      rc = MeshListView(pConstMesh->m_F, count, capacity);
+      break;
+    case mltVertexNormals:
+      rc = MeshListView(pConstMesh->m_N, count, capacity);
+      break;
+    case mltFaceNormals:
+      rc = MeshListView(pConstMesh->m_FN, count, capacity);
+      break;
+    case mltVertexColors:
+      rc = MeshListView(pConstMesh->m_C, count, capacity);
+      break;
+    case mltTextureCoordinates:
+      rc = MeshListView(pConstMesh->m_T, count, capacity);
+      break;
+    default:
+      break;
+    }
+  }
+  return rc;
+}
+
 // !!!!IMPORTANT!!!! Use an array of ints instead of bools. Bools have to be marshaled
 // in different ways through .NET which can cause all sorts of problems.
 RH_C_FUNCTION bool ON_Mesh_NakedEdgePoints( const ON_Mesh* pMesh, /*ARRAY*/int* naked_status, int count )
@@ -1742,6 +1999,37 @@ RH_C_FUNCTION int ON_Mesh_GetClosestPoint(const ON_Mesh* ptr, ON_3DPOINT_STRUCT
   return rc;
 }
 
+// Normal at a mesh point: interpolated vertex normals when the mesh has
+// them, otherwise the face normal or the normal of the hit triangle.
+static ON_3dVector MeshPointNormal(const ON_Mesh& mesh, const ON_MESH_POINT& mp)
+{
+  ON_3dVector normal = ON_3dVector::ZeroVector;
+  if( mesh.m_N.Count()>0 )
+  {
+    const ON_MeshFace& face = mesh.m_F[mp.m_face_index];
+    ON_3dVector n0 = mesh.m_N[face.vi[0]];
+    ON_3dVector n1 = mesh.m_N[face.vi[1]];
+    ON_3dVector n2 = mesh.m_N[face.vi[2]];
+    ON_3dVector n3 = mesh.m_N[face.vi[3]];
+    normal = (n0 * mp.m_t[0]) +
+             (n1 * mp.m_t[1]) +
+             (n2 * mp.m_t[2]) +
+             (n3 * mp.m_t[3]);
+    normal.Unitize();
+  }
+  else if( mesh.m_FN.Count()>0 )
+  {
+    normal = mesh.m_FN[mp.m_face_index];
+  }
+  else
+  {
+    ON_3dPoint pA, pB, pC;
+    if( mp.GetTriangle(pA, pB, pC ) )
+      normal = ON_TriangleNormal(pA, pB, pC);
+  }
+  return normal;
+}
+
 RH_C_FUNCTION int ON_Mesh_GetClosestPoint2(const ON_Mesh* pMesh, ON_3DPOINT_STRUCT testPoint, ON_3dPoint* closestPt, ON_3dVector* closestNormal, double max_dist)
 {
   int rc = -1;
@@ -1754,31 +2042,7 @@ RH_C_FUNCTION int ON_Mesh_GetClosestPoint2(const ON_Mesh* pMesh, ON_3DPOINT_STRU
       if( mp.m_face_index>=0 && mp.m_face_index<pMesh->m_F.Count() )
       {
         *closestPt = mp.m_P;
-        if( pMesh->m_N.Count()>0 )
-        {
-          const ON_MeshFace& face = pMesh->m_F[mp.m_face_index];
-          ON_3dVector n0 = pMesh->m_N[face.vi[0]];
-          ON_3dVector n1 = pMesh->m_N[face.vi[1]];
-          ON_3dVector n2 = pMesh->m_N[face.vi[2]];
-          ON_3dVector n3 = pMesh->m_N[face.vi[3]];
-          *closestNormal = (n0 * mp.m_t[0]) +
-                           (n1 * mp.m_t[1]) +
-                           (n2 * mp.m_t[2]) +
-                           (n3 * mp.m_t[3]);
-          closestNormal->Unitize();
-        }
-        else if( pMesh->m_FN.Count()>0 )
-        {
-          *closestNormal = pMesh->m_FN[mp.m_face_index];
-        }
-        else
-        {
-          ON_3dPoint pA, pB, pC;
-          if( mp.GetTriangle(pA, pB, pC ) )
-          {
-            *closestNormal = ON_TriangleNormal(pA, pB, pC);
-          }
-        }
+        *closestNormal = MeshPointNormal(*pMesh, mp);
         rc = mp.m_face_index;
       }
     }
@@ -1836,6 +2100,104 @@ RH_C_FUNCTION bool ON_Mesh_GetClosestPoint3(const ON_Mesh* pConstMesh, ON_3DPOIN
   return rc;
 }
 
+struct ClosestPointsContext
+{
+  const ON_Mesh* m_mesh;
+  const ON_3dPoint* m_points;
+  int m_count;
+  int m_block_size;
+  double m_max_dist;
+  int* m_face_indices;
+  double* m_t;
+  ON_3dPoint* m_closest_points;
+  ON_3dVector* m_normals;
+  int* m_hits; // one count per block
+};
+
+static void ClosestPointBlockAt(int block, void* context)
+{
+  ClosestPointsContext* ctx = (ClosestPointsContext*)context;
+  const ON_Mesh& mesh = *ctx->m_mesh;
+  const int i0 = block * ctx->m_block_size;
+  int i1 = i0 + ctx->m_block_size;
+  if( i1 > ctx->m_count )
+    i1 = ctx->m_count;
+  int hits = 0;
+  for( int i=i0; i<i1; i++ )
+  {
+    ON_MESH_POINT mp;
+    double* t = ctx->m_t + 4*i;
+    if( mesh.GetClosestPoint(ctx->m_points[i], &mp, ctx->m_max_dist) && mp.m_face_index>=0 && mp.m_face_index<mesh.m_F.Count() )
+    {
+      ctx->m_face_indices[i] = mp.m_face_index;
+      t[0] = mp.m_t[0];
+      t[1] = mp.m_t[1];
+      t[2] = mp.m_t[2];
+      t[3] = mp.m_t[3];
+      ctx->m_closest_points[i] = mp.m_P;
+      if( ctx->m_normals )
+        ctx->m_normals[i] = MeshPointNormal(mesh, mp);
+      hits++;
+    }
+    else
+    {
+      ctx->m_face_indices[i] = -1;
+      t[0] = t[1] = t[2] = t[3] = 0.0;
+      ctx->m_closest_points[i] = ON_3dPoint::UnsetPoint;
+      if( ctx->m_normals )
+        ctx->m_normals[i] = ON_3dVector::ZeroVector;
+    }
+  }
+  ctx->m_hits[block] = hits;
+}
+
+// Batch form of ON_Mesh_GetClosestPoint3. The mesh tree is built once and
+// the points are split into blocks that are answered on worker threads.
+// Output arrays run parallel to points: faceIndices (-1 when nothing is
+// within maxDistance), t holds four barycentric parameters per point, and
+// normals may be NULL. Returns the number of points that found a face.
+RH_C_FUNCTION int ON_Mesh_GetClosestPoints(const ON_Mesh* pConstMesh,
+                                           int count,
+                                           /*ARRAY*/const ON_3dPoint* points,
+                                           double maxDistance,
+                                           /*ARRAY*/int* faceIndices,
+                                           /*ARRAY*/double* t,
+                                           /*ARRAY*/ON_3dPoint* closestPoints,
+                                           /*ARRAY*/ON_3dVector* normals,
+                                           int maxThreads)
+{
+  int rc = 0;
+  if( pConstMesh && count>0 && points && faceIndices && t && closestPoints )
+  {
+    // Build the tree here so worker threads only ever read it
+    if( NULL == pConstMesh->MeshTree(true) )
+      return 0;
+
+    const int block_size = 256;
+    const int block_count = (count + block_size - 1) / block_size;
+    ON_SimpleArray<int> hits(block_count);
+    hits.SetCount(block_count);
+    hits.Zero();
+
+    ClosestPointsContext ctx;
+    ctx.m_mesh = pConstMesh;
+    ctx.m_points = points;
+    ctx.m_count = count;
+    ctx.m_block_size = block_size;
+    ctx.m_max_dist = maxDistance;
+    ctx.m_face_indices = faceIndices;
+    ctx.m_t = t;
+    ctx.m_closest_points = closestPoints;
+    ctx.m_normals = normals;
+    ctx.m_hits = hits.Array();
+    RhCmnParallelFor(block_count, ClosestPointBlockAt, &ctx, maxThreads);
+
+    for( int i=0; i<block_count; i++ )
+      rc += hits[i];
+  }
+  return rc;
+}
+
 RH_C_FUNCTION bool ON_Mesh_MeshPointAt(const ON_Mesh* pConstMesh, int faceIndex, double t0, double t1, double t2, double t3, ON_3dPoint* p)
 {
   bool rc = false;
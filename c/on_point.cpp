@@ -1,22 +1,48 @@
 #include "StdAfx.h"
 
+#if defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#include <emmintrin.h>
+#define RHCMN_SSE2
+#endif
+
+// ON_Color defines alpha=0 as opaque where System.Drawing.Color defines alpha=255 as opaque.
+// 255-alpha is alpha^0xff and red and blue trade places, so the same
+// conversion works in both directions.
+static inline unsigned int SwizzleColor( unsigned int c )
+{
+  return ((c ^ 0xff000000) & 0xff00ff00) | ((c >> 16) & 0x000000ff) | ((c & 0x000000ff) << 16);
+}
+
 unsigned int ARGB_to_ABGR( unsigned int argb )
 {
-  // ON_Color defines alpha=0 as opaque where System.Drawing.Color defines alpha=255 as opaque
   // This function is for converting from System.Drawing.Color to ON_Color
-  unsigned int alpha = (argb & 0xff000000)>>24;
-  alpha = (255-alpha);
-  unsigned int abgr = (alpha)<<24 | (argb & 0x000000ff)<<16 | (argb & 0x0000ff00) | (argb & 0x00ff0000)>>16;
-  return abgr;
+  return SwizzleColor(argb);
 }
 unsigned int ABGR_to_ARGB( unsigned int abgr )
 {
-  // ON_Color defines alpha=0 as opaque where System.Drawing.Color defines alpha=255 as opaque
   // This function is for converting from ON_Color to System.Drawing.Color
-  unsigned int alpha = (abgr & 0xff000000)>>24;
-  alpha = (255-alpha);
-  unsigned int argb = (alpha)<<24 | (abgr & 0x000000ff)<<16 | (abgr & 0x0000ff00) | (abgr & 0x00ff0000)>>16;
-  return argb;
+  return SwizzleColor(abgr);
+}
+
+void RhCmnSwizzleColors( int count, const unsigned int* src, unsigned int* dst )
+{
+  // SwizzleColor on four colors at a time
+  int i = 0;
+#if defined(RHCMN_SSE2)
+  const __m128i alpha_mask = _mm_set1_epi32((int)0xff000000);
+  const __m128i ag_mask = _mm_set1_epi32((int)0xff00ff00);
+  const __m128i byte_mask = _mm_set1_epi32(0x000000ff);
+  for( ; i+4<=count; i+=4 )
+  {
+    const __m128i c = _mm_loadu_si128((const __m128i*)(src+i));
+    const __m128i ag = _mm_and_si128(_mm_xor_si128(c, alpha_mask), ag_mask);
+    const __m128i r = _mm_and_si128(_mm_srli_epi32(c, 16), byte_mask);
+    const __m128i b = _mm_slli_epi32(_mm_and_si128(c, byte_mask), 16);
+    _mm_storeu_si128((__m128i*)(dst+i), _mm_or_si128(ag, _mm_or_si128(r, b)));
+  }
+#endif
+  for( ; i<count; i++ )
+    dst[i] = SwizzleColor(src[i]);
 }
 
 RH_C_FUNCTION void ON_Interval_Intersection( ON_Interval* ptr, ON_INTERVAL_STRUCT a, ON_INTERVAL_STRUCT b )
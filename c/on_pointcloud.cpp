@@ -252,6 +252,7 @@ RH_C_FUNCTION bool ON_PointCloud_SetColor( ON_PointCloud* pPointCloud, int index
     unsigned int abgr = ARGB_to_ABGR(argb);
     ON_Color color = abgr;
     pPointCloud->m_C[index] = color;
+    rc = true;
   }
   return rc;
 }
@@ -531,13 +532,22 @@ RH_C_FUNCTION void ON_PointCloud_GetColors(const ON_PointCloud* pConstPointCloud
 {
   if( pConstPointCloud && colors && (count==pConstPointCloud->m_C.Count()) && (count>0) )
   {
-    for( int i = 0; i < pConstPointCloud->m_C.Count(); i++)
-    {
-      unsigned int abgr = (unsigned int)(pConstPointCloud->m_C[i]);
-      colors[i] = (int)ABGR_to_ARGB(abgr);
-    }
+    const unsigned int* source = (const unsigned int*)pConstPointCloud->m_C.Array();
+    RhCmnSwizzleColors(count, source, (unsigned int*)colors);
   }
 }
+RH_C_FUNCTION bool ON_PointCloud_SetColors( ON_PointCloud* pPointCloud, int count, /*ARRAY*/const int* colors)
+{
+  bool rc = false;
+  if( pPointCloud && colors && (count==pPointCloud->m_P.Count()) && (count>0) )
+  {
+    ON_PointCloud_FixPointCloud(pPointCloud, false, true, false);
+    unsigned int* dest = (unsigned int*)pPointCloud->m_C.Array();
+    RhCmnSwizzleColors(count, (const unsigned int*)colors, dest);
+    rc = true;
+  }
+  return rc;
+}
 
 // not currently available in stand alone OpenNURBS build
 #if !defined(OPENNURBS_BUILD)
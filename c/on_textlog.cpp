@@ -1,5 +1,11 @@
 #include "StdAfx.h"
 
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
 RH_C_FUNCTION ON_TextLog* ON_TextLog_New(ON_wString* pString)
 {
   if( pString )
@@ -38,6 +44,165 @@ RH_C_FUNCTION ON_TextLog* ON_TextLog_New2(const RHMONO_STRING* _filename)
   return new ON_TextLog();
 }
 
+typedef int (CALLBACK* TEXTLOGWRITEPROC)(int serial_number, const char* utf8, int length);
+
+// Text log that collects output as UTF-8 in a fixed size buffer and hands
+// every full buffer to a file descriptor or a callback. Memory use does not
+// grow with the amount of text written.
+class CRhCmnStreamTextLog : public ON_TextLog
+{
+public:
+  CRhCmnStreamTextLog(int fd, TEXTLOGWRITEPROC callback, int serial_number, int chunk_size);
+  virtual ~CRhCmnStreamTextLog();
+
+  bool Flush();
+
+protected:
+  virtual void AppendText( const char* s );
+  virtual void AppendText( const wchar_t* s );
+
+private:
+  void Append( const char* s, int length );
+  bool WriteChunk( const char* s, int length );
+
+  int m_fd;
+  TEXTLOGWRITEPROC m_callback;
+  int m_serial_number;
+  bool m_bFailed;
+  ON_SimpleArray<char> m_buffer;
+  ON_SimpleArray<char> m_utf8;
+};
+
+CRhCmnStreamTextLog::CRhCmnStreamTextLog(int fd, TEXTLOGWRITEPROC callback, int serial_number, int chunk_size)
+: m_fd(fd)
+, m_callback(callback)
+, m_serial_number(serial_number)
+, m_bFailed(false)
+{
+  if( chunk_size < 256 )
+    chunk_size = 256;
+  m_buffer.Reserve(chunk_size);
+}
+
+CRhCmnStreamTextLog::~CRhCmnStreamTextLog()
+{
+  Flush();
+}
+
+bool CRhCmnStreamTextLog::WriteChunk( const char* s, int length )
+{
+  if( m_bFailed )
+    return false;
+  if( m_callback )
+  {
+    if( 0 == m_callback(m_serial_number, s, length) )
+      m_bFailed = true;
+  }
+  else
+  {
+    while( length > 0 && !m_bFailed )
+    {
+#if defined(_WIN32)
+      const int written = ::_write(m_fd, s, (unsigned int)length);
+#else
+      const int written = (int)::write(m_fd, s, (size_t)length);
+#endif
+      if( written <= 0 )
+        m_bFailed = true;
+      else
+      {
+        s += written;
+        length -= written;
+      }
+    }
+  }
+  return !m_bFailed;
+}
+
+bool CRhCmnStreamTextLog::Flush()
+{
+  bool rc = true;
+  if( m_buffer.Count() > 0 )
+    rc = WriteChunk(m_buffer.Array(), m_buffer.Count());
+  m_buffer.SetCount(0);
+  return rc && !m_bFailed;
+}
+
+void CRhCmnStreamTextLog::Append( const char* s, int length )
+{
+  const int capacity = m_buffer.Capacity();
+  while( length > 0 )
+  {
+    int n = capacity - m_buffer.Count();
+    if( n > length )
+      n = length;
+    m_buffer.Append(n, s);
+    s += n;
+    length -= n;
+    if( m_buffer.Count() >= capacity )
+      Flush();
+  }
+}
+
+void CRhCmnStreamTextLog::AppendText( const char* s )
+{
+  if( s && s[0] )
+    Append(s, (int)strlen(s));
+}
+
+void CRhCmnStreamTextLog::AppendText( const wchar_t* s )
+{
+  if( 0 == s || 0 == s[0] )
+    return;
+  const int length = (int)wcslen(s);
+  unsigned int error_status = 0;
+  const int utf8_count = ON_ConvertWideCharToUTF8(false, s, length, 0, 0, &error_status, 0xFFFFFFFF, 0xFFFD, 0);
+  if( utf8_count <= 0 )
+    return;
+  m_utf8.Reserve(utf8_count);
+  error_status = 0;
+  const int rc = ON_ConvertWideCharToUTF8(false, s, length, m_utf8.Array(), utf8_count, &error_status, 0xFFFFFFFF, 0xFFFD, 0);
+  if( rc > 0 )
+    Append(m_utf8.Array(), rc);
+}
+
+// Creates a text log that streams UTF-8 text in chunkSize pieces to the open
+// file descriptor fd. The descriptor is not closed by ON_TextLog_Delete.
+RH_C_FUNCTION ON_TextLog* ON_TextLog_NewFileDescriptor(int fd, int chunkSize)
+{
+  if( fd < 0 )
+    return NULL;
+  return new CRhCmnStreamTextLog(fd, NULL, 0, chunkSize);
+}
+
+// Creates a text log that passes UTF-8 text in chunkSize pieces to callback.
+// Writing stops when the callback returns 0.
+RH_C_FUNCTION ON_TextLog* ON_TextLog_NewCallback(TEXTLOGWRITEPROC callback, int serial_number, int chunkSize)
+{
+  if( 0 == callback )
+    return NULL;
+  return new CRhCmnStreamTextLog(-1, callback, serial_number, chunkSize);
+}
+
+// Hands any buffered text to the file, descriptor or callback of the log.
+// Returns false if a write failed.
+RH_C_FUNCTION bool ON_TextLog_Flush(ON_TextLog* pTextLog)
+{
+  bool rc = false;
+  if( pTextLog )
+  {
+    CRhCmnStreamTextLog* pStreamLog = dynamic_cast<CRhCmnStreamTextLog*>(pTextLog);
+    if( pStreamLog )
+      rc = pStreamLog->Flush();
+    else
+    {
+      FILE* f = ((HackTextLog*)pTextLog)->GetFile();
+      rc = (0 == f || 0 == fflush(f));
+    }
+  }
+  return rc;
+}
+
 RH_C_FUNCTION void ON_TextLog_PushPopIndent(ON_TextLog* pTextLog, bool push)
 {
   if( pTextLog )
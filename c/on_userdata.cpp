@@ -177,6 +177,11 @@ const CRhCmnClassId* CRhCmnClassIdList::GetClassId( const ON_UUID& id )
 
 static CRhCmnClassIdList g_classIds;
 
+bool RhCmnManagedUserDataRegistered()
+{
+  return g_classIds.m_class_ids.Count() > 0;
+}
+
 const CRhCmnUserData* CRhCmnUserData::Cast( const ON_Object* p )
 {
   // The only reason I'm using an #if block below instead of always
@@ -202,8 +207,34 @@ const CRhCmnUserData* CRhCmnUserData::Cast( const ON_Object* p )
 }
 
 
+// When set, user data of registered managed classes is not created while
+// archives are read on this thread. openNURBS then keeps the payload as
+// ON_UnknownUserData (raw bytes plus class id and archive versions) and
+// writes those bytes back unchanged. CRhCmnUserData_Find turns the blob into
+// the managed class the first time it is asked for. Set for the duration of
+// a read by CRhCmnLazyUserDataRead; a per thread flag so one lazy read does
+// not change how other threads read.
+#if defined(_WIN32)
+static __declspec(thread) bool t_bLazyUserDataRead = false;
+#else
+static __thread bool t_bLazyUserDataRead = false;
+#endif
+
+CRhCmnLazyUserDataRead::CRhCmnLazyUserDataRead(bool lazy)
+{
+  m_previous = t_bLazyUserDataRead;
+  t_bLazyUserDataRead = lazy;
+}
+
+CRhCmnLazyUserDataRead::~CRhCmnLazyUserDataRead()
+{
+  t_bLazyUserDataRead = m_previous;
+}
+
 static ON_Object* RhCmnClassIdCreateOnObject()
 {
+  if( t_bLazyUserDataRead )
+    return NULL;
   ON_UUID managed_type_id = ON_GetMostRecentClassIdCreateUuid();
   const CRhCmnClassId* pClassId = g_classIds.GetClassId(managed_type_id);
   if( !pClassId || NULL==CRhCmnUserData::m_create)
@@ -330,12 +361,114 @@ RH_C_FUNCTION bool CRhCmnUserData_Delete(ON_UserData* pUserData, bool only_if_no
   return false;
 }
 
+// Creates the managed user data for a blob left by a lazy read and replaces
+// the blob on its owner. Returns NULL if the class is not registered or the
+// bytes can not be read, in which case the blob stays attached.
+// With bReplayXform the transform of the blob is what was applied to the
+// owner since the read (see RhCmnFinishLazyUserDataRead): the managed object
+// keeps the identity transform it was saved with and is transformed once,
+// as it would have been had it been read eagerly. Otherwise the transform
+// is the one stored in the archive and is only copied.
+static CRhCmnUserData* MaterializeUnknownUserData( ON_UnknownUserData* pUnknown, bool bReplayXform )
+{
+  ON_Object* pOwner = pUnknown ? pUnknown->Owner() : NULL;
+  if( NULL==pOwner || NULL==CRhCmnUserData::m_create || NULL==CRhCmnUserData::m_readwrite )
+    return NULL;
+  const CRhCmnClassId* pClassId = g_classIds.GetClassId(pUnknown->m_unknownclass_uuid);
+  if( NULL==pClassId )
+    return NULL;
+
+  ON_UserData* pCreated = CRhCmnUserData::m_create(pClassId->m_managed_object_type);
+  CRhCmnUserData* rc = CRhCmnUserData::Cast(pCreated);
+  if( NULL==rc )
+  {
+    if( pCreated )
+      delete pCreated;
+    return NULL;
+  }
+  rc->m_userdata_uuid = pUnknown->m_userdata_uuid;
+  rc->m_application_uuid = pUnknown->m_application_uuid;
+  rc->m_userdata_copycount = pUnknown->m_userdata_copycount;
+  ON_Xform xform = pUnknown->m_userdata_xform;
+  if( bReplayXform )
+    rc->m_userdata_xform.Identity();
+  else
+    rc->m_userdata_xform = xform;
+
+  ON_Read3dmBufferArchive archive(pUnknown->m_sizeof_buffer, pUnknown->m_buffer, false, pUnknown->m_3dm_version, pUnknown->m_3dm_opennurbs_version);
+  if( !rc->Read(archive) )
+  {
+    delete rc;
+    return NULL;
+  }
+  pOwner->DetachUserData(pUnknown);
+  delete pUnknown;
+  pOwner->AttachUserData(rc);
+  if( bReplayXform && !xform.IsIdentity() )
+    rc->Transform(xform);
+  return rc;
+}
+
+// Blobs of registered managed classes attached to object.
+static void GetManagedUnknownUserData( const ON_Object* object, ON_SimpleArray<ON_UnknownUserData*>& blobs )
+{
+  for( ON_UserData* pUD = object ? object->FirstUserData() : NULL; pUD; pUD = pUD->Next() )
+  {
+    ON_UnknownUserData* pUnknown = ON_UnknownUserData::Cast(pUD);
+    if( pUnknown && g_classIds.GetClassId(pUnknown->m_unknownclass_uuid) )
+      blobs.Append(pUnknown);
+  }
+}
+
+// 3dm versions are 1 to 5 or 50 for V5 archives.
+static int Normalized3dmVersion( int version )
+{
+  return (version > 0 && version < 10) ? 10*version : version;
+}
+
+void RhCmnFinishLazyUserDataRead( const ON_Object* object )
+{
+  ON_SimpleArray<ON_UnknownUserData*> blobs;
+  GetManagedUnknownUserData(object, blobs);
+  for( int i=0; i<blobs.Count(); i++ )
+  {
+    if( !blobs[i]->m_userdata_xform.IsIdentity() )
+      MaterializeUnknownUserData(blobs[i], false);
+  }
+}
+
+bool RhCmnMaterializeLazyUserData( const ON_Object* object, int archive_3dm_version )
+{
+  bool rc = true;
+  ON_SimpleArray<ON_UnknownUserData*> blobs;
+  GetManagedUnknownUserData(object, blobs);
+  for( int i=0; i<blobs.Count(); i++ )
+  {
+    // openNURBS drops unknown user data it can not copy as is into an archive
+    // of another version (chunk lengths differ between V4 and V5 archives),
+    // so the managed class writes those.
+    ON_UnknownUserData* pUnknown = blobs[i];
+    bool materialize = !pUnknown->m_userdata_xform.IsIdentity();
+    if( archive_3dm_version != 0 && Normalized3dmVersion(pUnknown->m_3dm_version) != Normalized3dmVersion(archive_3dm_version) )
+      materialize = true;
+    if( materialize && NULL==MaterializeUnknownUserData(pUnknown, true) )
+      rc = false;
+  }
+  return rc;
+}
+
 RH_C_FUNCTION int CRhCmnUserData_Find(const ON_Object* pConstOnObject, ON_UUID managed_type_id)
 {
   int rc = -1;
   if( pConstOnObject )
   {
     ON_UserData* pUD = pConstOnObject->GetUserData(managed_type_id);
+    // User data kept as raw bytes by a lazy read is created on first use.
+    // This changes the user data list of a const object, but not what the
+    // object reports.
+    ON_UnknownUserData* pUnknown = ON_UnknownUserData::Cast(pUD);
+    if( pUnknown )
+      pUD = MaterializeUnknownUserData(pUnknown, true);
     CRhCmnUserData* pRhCmnUd = CRhCmnUserData::Cast(pUD);
     if( pRhCmnUd )
       rc = pRhCmnUd->m_serial_number;
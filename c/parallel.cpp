@@ -0,0 +1,181 @@
+#include "StdAfx.h"
+
+#if defined(_WIN32)
+#include <process.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+int RhCmnProcessorCount()
+{
+  static int processor_count = 0;
+  if( processor_count < 1 )
+  {
+    int count = 1;
+#if defined(_WIN32)
+    SYSTEM_INFO si;
+    memset(&si, 0, sizeof(si));
+    ::GetSystemInfo(&si);
+    count = (int)si.dwNumberOfProcessors;
+#else
+    long n = ::sysconf(_SC_NPROCESSORS_ONLN);
+    if( n > 0 && n < 1024 )
+      count = (int)n;
+#endif
+    processor_count = count > 0 ? count : 1;
+  }
+  return processor_count;
+}
+
+struct RhCmnParallelForJob
+{
+  RHCMN_PARALLEL_FOR_FUNC m_func;
+  void* m_context;
+  int m_count;
+  volatile long m_next;
+};
+
+// True while this thread runs indices of a RhCmnParallelFor. Threads are
+// started for every call and not pooled, so a nested call made from func runs
+// serially on its thread instead of starting threads of its own; otherwise
+// every level would multiply the thread count.
+#if defined(_WIN32)
+static __declspec(thread) bool t_bInParallelFor = false;
+#else
+static __thread bool t_bInParallelFor = false;
+#endif
+
+static void RunParallelForJob(RhCmnParallelForJob* job)
+{
+  const bool previous = t_bInParallelFor;
+  t_bInParallelFor = true;
+  // Every thread, including the calling thread, pulls the next index
+  // until the range is exhausted. This keeps threads busy when items
+  // take very different amounts of time.
+  for(;;)
+  {
+#if defined(_WIN32)
+    int index = (int)::InterlockedIncrement(&job->m_next) - 1;
+#else
+    int index = (int)__sync_fetch_and_add(&job->m_next, 1);
+#endif
+    if( index >= job->m_count )
+      break;
+    job->m_func(index, job->m_context);
+  }
+  t_bInParallelFor = previous;
+}
+
+#if defined(_WIN32)
+static unsigned __stdcall ParallelForThreadProc(void* p)
+{
+  RunParallelForJob((RhCmnParallelForJob*)p);
+  return 0;
+}
+#else
+static void* ParallelForThreadProc(void* p)
+{
+  RunParallelForJob((RhCmnParallelForJob*)p);
+  return NULL;
+}
+#endif
+
+void RhCmnParallelFor(int count, RHCMN_PARALLEL_FOR_FUNC func, void* context, int max_threads)
+{
+  if( count < 1 || NULL==func )
+    return;
+
+  int thread_count = max_threads > 0 ? max_threads : RhCmnProcessorCount();
+  if( thread_count > count )
+    thread_count = count;
+  if( t_bInParallelFor )
+    thread_count = 1;
+
+  if( thread_count < 2 )
+  {
+    for( int i=0; i<count; i++ )
+      func(i, context);
+    return;
+  }
+
+  RhCmnParallelForJob job;
+  job.m_func = func;
+  job.m_context = context;
+  job.m_count = count;
+  job.m_next = 0;
+
+  // The calling thread does its share of the work, so start one less
+  // helper thread. If a helper fails to start, the remaining threads
+  // simply pick up its indices.
+#if defined(_WIN32)
+  ON_SimpleArray<HANDLE> threads(thread_count-1);
+  for( int i=1; i<thread_count; i++ )
+  {
+    HANDLE h = (HANDLE)::_beginthreadex(NULL, 0, ParallelForThreadProc, &job, 0, NULL);
+    if( h )
+      threads.Append(h);
+  }
+  RunParallelForJob(&job);
+  for( int i=0; i<threads.Count(); i++ )
+  {
+    ::WaitForSingleObject(threads[i], INFINITE);
+    ::CloseHandle(threads[i]);
+  }
+#else
+  ON_SimpleArray<pthread_t> threads(thread_count-1);
+  for( int i=1; i<thread_count; i++ )
+  {
+    pthread_t t;
+    if( 0==::pthread_create(&t, NULL, ParallelForThreadProc, &job) )
+      threads.Append(t);
+  }
+  RunParallelForJob(&job);
+  for( int i=0; i<threads.Count(); i++ )
+    ::pthread_join(threads[i], NULL);
+#endif
+}
+
+CRhCmnCriticalSection::CRhCmnCriticalSection()
+{
+#if defined(_WIN32)
+  CRITICAL_SECTION* cs = new CRITICAL_SECTION;
+  ::InitializeCriticalSection(cs);
+  m_cs = cs;
+#else
+  pthread_mutex_t* mutex = new pthread_mutex_t;
+  ::pthread_mutex_init(mutex, NULL);
+  m_cs = mutex;
+#endif
+}
+
+CRhCmnCriticalSection::~CRhCmnCriticalSection()
+{
+#if defined(_WIN32)
+  CRITICAL_SECTION* cs = (CRITICAL_SECTION*)m_cs;
+  ::DeleteCriticalSection(cs);
+  delete cs;
+#else
+  pthread_mutex_t* mutex = (pthread_mutex_t*)m_cs;
+  ::pthread_mutex_destroy(mutex);
+  delete mutex;
+#endif
+}
+
+void CRhCmnCriticalSection::Enter()
+{
+#if defined(_WIN32)
+  ::EnterCriticalSection((CRITICAL_SECTION*)m_cs);
+#else
+  ::pthread_mutex_lock((pthread_mutex_t*)m_cs);
+#endif
+}
+
+void CRhCmnCriticalSection::Leave()
+{
+#if defined(_WIN32)
+  ::LeaveCriticalSection((CRITICAL_SECTION*)m_cs);
+#else
+  ::pthread_mutex_unlock((pthread_mutex_t*)m_cs);
+#endif
+}
@@ -138,6 +138,10 @@ ON_Circle FromCircleStruct(const ON_CIRCLE_STRUCT& cs);
 
 unsigned int ARGB_to_ABGR( unsigned int argb );
 unsigned int ABGR_to_ARGB( unsigned int abgr );
+// Converts count colors between ON_Color and System.Drawing.Color layout
+// (on_point.cpp). The conversion is its own inverse, so it serves both
+// directions. src and dst may be the same array.
+void RhCmnSwizzleColors( int count, const unsigned int* src, unsigned int* dst );
 
 class CHack3dPointArray : public ON_Polyline
 {
@@ -179,4 +183,63 @@ private:
 #if defined(ON_COMPILER_ANDROIDNDK)
   ON_SimpleArray<ON__UINT16> m_android;
 #endif
-};
\ No newline at end of file
+};
+
+// Fork/join helper used by the batch entry points (parallel.cpp).
+// RhCmnParallelFor calls func(index, context) once for every index in
+// [0,count) using up to max_threads threads (max_threads<1 means one per
+// processor) and returns after every call has finished. func must be safe
+// to call concurrently for different indices. A call made from inside func
+// runs serially on the calling thread.
+typedef void (*RHCMN_PARALLEL_FOR_FUNC)(int index, void* context);
+int RhCmnProcessorCount();
+void RhCmnParallelFor(int count, RHCMN_PARALLEL_FOR_FUNC func, void* context, int max_threads);
+
+// True once a managed user data class has been registered (on_userdata.cpp).
+// Creating those classes goes through ON_GetMostRecentClassIdCreateUuid and
+// reading them calls back into .NET, so archives are decoded on the calling
+// thread while this is true.
+bool RhCmnManagedUserDataRegistered();
+
+// Lazy reading of managed user data (on_userdata.cpp). While an instance
+// made with lazy=true exists, user data of registered managed classes read
+// on the constructing thread is kept by openNURBS as ON_UnknownUserData and
+// only turned into the managed class when it is first asked for. Instances
+// nest; the destructor restores the previous setting for this thread.
+class CRhCmnLazyUserDataRead
+{
+public:
+  CRhCmnLazyUserDataRead(bool lazy);
+  ~CRhCmnLazyUserDataRead();
+private:
+  CRhCmnLazyUserDataRead(const CRhCmnLazyUserDataRead&);
+  CRhCmnLazyUserDataRead& operator=(const CRhCmnLazyUserDataRead&);
+  bool m_previous;
+};
+
+// Called on every object a lazy read produced, before anything can
+// transform it. Blobs saved with a transform are created right away, so the
+// transform of every blob left is what was applied to its owner since.
+void RhCmnFinishLazyUserDataRead(const ON_Object* object);
+
+// Called before object is written. Creates the managed class for blobs that
+// would not be written back correctly as raw bytes: blobs that were
+// transformed (the managed transform callback gets the transform) and, when
+// archive_3dm_version is not 0, blobs read from a different 3dm version.
+// Returns false if a blob could not be read; that blob stays attached.
+bool RhCmnMaterializeLazyUserData(const ON_Object* object, int archive_3dm_version);
+
+// Plain mutex for state shared between P/Invoke calls (parallel.cpp).
+// Not recursive.
+class CRhCmnCriticalSection
+{
+public:
+  CRhCmnCriticalSection();
+  ~CRhCmnCriticalSection();
+  void Enter();
+  void Leave();
+private:
+  CRhCmnCriticalSection(const CRhCmnCriticalSection&);
+  CRhCmnCriticalSection& operator=(const CRhCmnCriticalSection&);
+  void* m_cs;
+};
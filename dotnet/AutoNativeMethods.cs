@@ -724,6 +724,28 @@ internal enum ObjectAttrsBool : int
   [return: MarshalAs(UnmanagedType.U1)]
   internal static extern bool ON_BinaryArchive_WriteCompressedBuffer(IntPtr pArchive, uint size, byte[] pBuffer);
 
+  //bool ON_BinaryArchive_WriteCompressedBuffer2( ON_BinaryArchive* pArchive, unsigned int size, /*ARRAY*/const char* pBuffer, unsigned int blockSize, int maxThreads )
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  [return: MarshalAs(UnmanagedType.U1)]
+  internal static extern bool ON_BinaryArchive_WriteCompressedBuffer2(IntPtr pArchive, uint size, byte[] pBuffer, uint blockSize, int maxThreads);
+
+  //CRhCmnCompressedBufferReader* ON_BinaryArchive_OpenCompressedBuffer( ON_BinaryArchive* pArchive )
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern IntPtr ON_BinaryArchive_OpenCompressedBuffer(IntPtr pArchive);
+
+  //unsigned int ON_CompressedBufferReader_Size( const CRhCmnCompressedBufferReader* pConstReader )
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern uint ON_CompressedBufferReader_Size(IntPtr pConstReader);
+
+  //bool ON_CompressedBufferReader_Read( const CRhCmnCompressedBufferReader* pConstReader, unsigned int offset, unsigned int count, /*ARRAY*/char* pBuffer, int maxThreads )
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  [return: MarshalAs(UnmanagedType.U1)]
+  internal static extern bool ON_CompressedBufferReader_Read(IntPtr pConstReader, uint offset, uint count, [In,Out] byte[] pBuffer, int maxThreads);
+
+  //void ON_CompressedBufferReader_Delete( CRhCmnCompressedBufferReader* pReader )
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern void ON_CompressedBufferReader_Delete(IntPtr pReader);
+
   //bool ON_BinaryArchive_ReadShort(ON_BinaryArchive* pArchive, short* readShort)
   [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
   [return: MarshalAs(UnmanagedType.U1)]
@@ -945,6 +967,31 @@ internal enum ObjectAttrsBool : int
   [return: MarshalAs(UnmanagedType.U1)]
   internal static extern bool ON_BinaryArchive_EndWriteDictionaryEntry(IntPtr pArchive);
 
+  //CRhCmnDictionaryIndex* ON_BinaryArchive_ScanDictionary(ON_BinaryArchive* pArchive)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern IntPtr ON_BinaryArchive_ScanDictionary(IntPtr pArchive);
+
+  //int ON_DictionaryIndex_Count(const CRhCmnDictionaryIndex* pConstIndex)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern int ON_DictionaryIndex_Count(IntPtr pConstIndex);
+
+  //bool ON_DictionaryIndex_GetEntry(const CRhCmnDictionaryIndex* pConstIndex, int index, int* de_type, CRhCmnStringHolder* pStringHolder)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  [return: MarshalAs(UnmanagedType.U1)]
+  internal static extern bool ON_DictionaryIndex_GetEntry(IntPtr pConstIndex, int index, ref int de_type, IntPtr pStringHolder);
+
+  //int ON_DictionaryIndex_Find(const CRhCmnDictionaryIndex* pConstIndex, const RHMONO_STRING* name)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern int ON_DictionaryIndex_Find(IntPtr pConstIndex, [MarshalAs(UnmanagedType.LPWStr)]string name);
+
+  //int ON_DictionaryIndex_BeginReadEntry(const CRhCmnDictionaryIndex* pConstIndex, ON_BinaryArchive* pArchive, int index, int* de_type)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern int ON_DictionaryIndex_BeginReadEntry(IntPtr pConstIndex, IntPtr pArchive, int index, ref int de_type);
+
+  //void ON_DictionaryIndex_Delete(CRhCmnDictionaryIndex* pIndex)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern void ON_DictionaryIndex_Delete(IntPtr pIndex);
+
   //ON_Object* ON_ReadBufferArchive(int archive_3dm_version, int archive_on_version, int length, /*ARRAY*/const unsigned char* buffer)
   [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
   internal static extern IntPtr ON_ReadBufferArchive(int archive_3dm_version, int archive_on_version, int length, byte[] buffer);
@@ -961,6 +1008,30 @@ internal enum ObjectAttrsBool : int
   [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
   internal static extern IntPtr ON_WriteBufferArchive_Buffer(IntPtr pBinaryArchive);
 
+  //CRhCmnBufferWriter* ON_BufferWriter_New(int rhinoversion, bool writeuserdata)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern IntPtr ON_BufferWriter_New(int rhinoversion, [MarshalAs(UnmanagedType.U1)]bool writeuserdata);
+
+  //void ON_BufferWriter_Delete(CRhCmnBufferWriter* pWriter)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern void ON_BufferWriter_Delete(IntPtr pWriter);
+
+  //const unsigned char* ON_BufferWriter_WriteObject(CRhCmnBufferWriter* pWriter, const ON_Object* pConstObject, unsigned int* length)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern IntPtr ON_BufferWriter_WriteObject(IntPtr pWriter, IntPtr pConstObject, ref uint length);
+
+  //const unsigned char* ON_BufferWriter_WriteObjects(CRhCmnBufferWriter* pWriter, const ON_SimpleArray<ON_Object*>* pConstObjects, /*ARRAY*/unsigned int* offsets, unsigned int* length)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern IntPtr ON_BufferWriter_WriteObjects(IntPtr pWriter, IntPtr pConstObjects, [In,Out] uint[] offsets, ref uint length);
+
+  //int ON_ReadBufferArchive2(int archive_3dm_version, int archive_on_version, unsigned int length, /*ARRAY*/const unsigned char* buffer, int count, /*ARRAY*/const unsigned int* offsets, ON_SimpleArray<ON_Object*>* pObjects)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern int ON_ReadBufferArchive2(int archive_3dm_version, int archive_on_version, uint length, byte[] buffer, int count, uint[] offsets, IntPtr pObjects);
+
+  //int ON_ReadBufferArchives(int count, unsigned int length, /*ARRAY*/const unsigned char* buffer, /*ARRAY*/const unsigned int* offsets, /*ARRAY*/const int* archive_3dm_versions, /*ARRAY*/const int* archive_on_versions, ON_SimpleArray<ON_Object*>* pObjects, /*ARRAY*/int* status, int maxThreads)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern int ON_ReadBufferArchives(int count, uint length, byte[] buffer, uint[] offsets, int[] archive_3dm_versions, int[] archive_on_versions, IntPtr pObjects, [In,Out] int[] status, int maxThreads);
+
   //ONX_Model* ONX_Model_New()
   [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
   internal static extern IntPtr ONX_Model_New();
@@ -995,6 +1066,51 @@ internal enum ObjectAttrsBool : int
   [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
   internal static extern void ONX_Model_ReadApplicationDetails([MarshalAs(UnmanagedType.LPWStr)]string path, IntPtr pApplicationName, IntPtr pApplicationUrl, IntPtr pApplicationDetails);
 
+  //CRhCmnFileHeader* ONX_Model_ReadFileHeader(const RHMONO_STRING* path)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern IntPtr ONX_Model_ReadFileHeader([MarshalAs(UnmanagedType.LPWStr)]string path);
+
+  //void ONX_Model_FileHeader_Delete(CRhCmnFileHeader* pHeader)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern void ONX_Model_FileHeader_Delete(IntPtr pHeader);
+
+  //int ONX_Model_FileHeader_ArchiveVersion(const CRhCmnFileHeader* pConstHeader)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern int ONX_Model_FileHeader_ArchiveVersion(IntPtr pConstHeader);
+
+  //void ONX_Model_FileHeader_GetStartSectionComments(const CRhCmnFileHeader* pConstHeader, CRhCmnStringHolder* pString)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern void ONX_Model_FileHeader_GetStartSectionComments(IntPtr pConstHeader, IntPtr pString);
+
+  //bool ONX_Model_FileHeader_GetNotes(const CRhCmnFileHeader* pConstHeader, CRhCmnStringHolder* pString, bool* visible, bool* html, int* left, int* top, int* right, int* bottom)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  [return: MarshalAs(UnmanagedType.U1)]
+  internal static extern bool ONX_Model_FileHeader_GetNotes(IntPtr pConstHeader, IntPtr pString, [MarshalAs(UnmanagedType.U1)]ref bool visible, [MarshalAs(UnmanagedType.U1)]ref bool html, ref int left, ref int top, ref int right, ref int bottom);
+
+  //const ON_3dmRevisionHistory* ONX_Model_FileHeader_RevisionHistory(const CRhCmnFileHeader* pConstHeader, CRhCmnStringHolder* pStringCreated, CRhCmnStringHolder* pStringLastEdited, int* revision)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern IntPtr ONX_Model_FileHeader_RevisionHistory(IntPtr pConstHeader, IntPtr pStringCreated, IntPtr pStringLastEdited, ref int revision);
+
+  //void ONX_Model_FileHeader_GetApplicationDetails(const CRhCmnFileHeader* pConstHeader, CRhCmnStringHolder* pApplicationName, CRhCmnStringHolder* pApplicationUrl, CRhCmnStringHolder* pApplicationDetails)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern void ONX_Model_FileHeader_GetApplicationDetails(IntPtr pConstHeader, IntPtr pApplicationName, IntPtr pApplicationUrl, IntPtr pApplicationDetails);
+
+  //ON_SimpleArray<CRhCmnFileHeader*>* ONX_Model_ReadFileHeaders(const ON_ClassArray<ON_wString>* pPaths, int maxThreads)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern IntPtr ONX_Model_ReadFileHeaders(IntPtr pPaths, int maxThreads);
+
+  //int ONX_Model_FileHeaderArray_Count(const ON_SimpleArray<CRhCmnFileHeader*>* pConstHeaders)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern int ONX_Model_FileHeaderArray_Count(IntPtr pConstHeaders);
+
+  //const CRhCmnFileHeader* ONX_Model_FileHeaderArray_Get(const ON_SimpleArray<CRhCmnFileHeader*>* pConstHeaders, int index)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern IntPtr ONX_Model_FileHeaderArray_Get(IntPtr pConstHeaders, int index);
+
+  //void ONX_Model_FileHeaderArray_Delete(ON_SimpleArray<CRhCmnFileHeader*>* pHeaders)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern void ONX_Model_FileHeaderArray_Delete(IntPtr pHeaders);
+
   //ONX_Model* ONX_Model_ReadFile(const RHMONO_STRING* path, CRhCmnStringHolder* pStringHolder)
   [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
   internal static extern IntPtr ONX_Model_ReadFile([MarshalAs(UnmanagedType.LPWStr)]string path, IntPtr pStringHolder);
@@ -1009,6 +1125,11 @@ internal enum ObjectAttrsBool : int
   [return: MarshalAs(UnmanagedType.U1)]
   internal static extern bool ONX_Model_WriteFile2(IntPtr pModel, [MarshalAs(UnmanagedType.LPWStr)]string path, int version, [MarshalAs(UnmanagedType.U1)]bool writeRenderMeshes, [MarshalAs(UnmanagedType.U1)]bool writeAnalysisMeshes, [MarshalAs(UnmanagedType.U1)]bool writeUserData);
 
+  //bool ONX_Model_WriteFile3(ONX_Model* pModel, const RHMONO_STRING* path, int version, bool writeRenderMeshes, bool writeAnalysisMeshes, bool writeUserData, int maxThreads)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  [return: MarshalAs(UnmanagedType.U1)]
+  internal static extern bool ONX_Model_WriteFile3(IntPtr pModel, [MarshalAs(UnmanagedType.LPWStr)]string path, int version, [MarshalAs(UnmanagedType.U1)]bool writeRenderMeshes, [MarshalAs(UnmanagedType.U1)]bool writeAnalysisMeshes, [MarshalAs(UnmanagedType.U1)]bool writeUserData, int maxThreads);
+
   //void ONX_Model_Delete(ONX_Model* pModel)
   [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
   internal static extern void ONX_Model_Delete(IntPtr pModel);
@@ -1031,6 +1152,38 @@ internal enum ObjectAttrsBool : int
   [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
   internal static extern int ONX_Model_Audit(IntPtr pModel, [MarshalAs(UnmanagedType.U1)]bool attemptRepair, ref int repairCount, IntPtr pString, IntPtr warnings);
 
+  //int ONX_Model_Audit2(ONX_Model* pModel, bool attemptRepair, int* repairCount, ON_TextLog* pTextLog, ON_SimpleArray<int>* warnings)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern int ONX_Model_Audit2(IntPtr pModel, [MarshalAs(UnmanagedType.U1)]bool attemptRepair, ref int repairCount, IntPtr pTextLog, IntPtr warnings);
+
+  //ON_ClassArray<CRhCmnObjectAuditResult>* ONX_Model_ValidateObjects(const ONX_Model* pConstModel, bool collectMessages, int maxThreads)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern IntPtr ONX_Model_ValidateObjects(IntPtr pConstModel, [MarshalAs(UnmanagedType.U1)]bool collectMessages, int maxThreads);
+
+  //ON_ClassArray<CRhCmnObjectAuditResult>* ONX_Model_AuditObjects(ONX_Model* pModel, bool attemptRepair, bool collectMessages, int maxThreads)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern IntPtr ONX_Model_AuditObjects(IntPtr pModel, [MarshalAs(UnmanagedType.U1)]bool attemptRepair, [MarshalAs(UnmanagedType.U1)]bool collectMessages, int maxThreads);
+
+  //int ONX_Model_AuditResults_Count(const ON_ClassArray<CRhCmnObjectAuditResult>* pConstResults)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern int ONX_Model_AuditResults_Count(IntPtr pConstResults);
+
+  //int ONX_Model_AuditResults_GetStatus(const ON_ClassArray<CRhCmnObjectAuditResult>* pConstResults, int count, /*ARRAY*/int* status, /*ARRAY*/int* repairCounts)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern int ONX_Model_AuditResults_GetStatus(IntPtr pConstResults, int count, [In,Out] int[] status, [In,Out] int[] repairCounts);
+
+  //int ONX_Model_AuditResults_Get(const ON_ClassArray<CRhCmnObjectAuditResult>* pConstResults, int index, int* objectIndex, int* repairCount, CRhCmnStringHolder* pMessage)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern int ONX_Model_AuditResults_Get(IntPtr pConstResults, int index, ref int objectIndex, ref int repairCount, IntPtr pMessage);
+
+  //void ONX_Model_AuditResults_Text(const ON_ClassArray<CRhCmnObjectAuditResult>* pConstResults, CRhCmnStringHolder* pString)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern void ONX_Model_AuditResults_Text(IntPtr pConstResults, IntPtr pString);
+
+  //void ONX_Model_AuditResults_Delete(ON_ClassArray<CRhCmnObjectAuditResult>* pResults)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern void ONX_Model_AuditResults_Delete(IntPtr pResults);
+
   //void ONX_Model_GetStartSectionComments(const ONX_Model* pConstModel, CRhCmnStringHolder* pString)
   [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
   internal static extern void ONX_Model_GetStartSectionComments(IntPtr pConstModel, IntPtr pString);
@@ -1063,6 +1216,10 @@ internal enum ObjectAttrsBool : int
   [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
   internal static extern void ONX_Model_Dump2(IntPtr pConstModel, IntPtr pTextLog);
 
+  //void ONX_Model_Dump3(const ONX_Model* pConstModel, enum ONXModelTable which, ON_TextLog* pTextLog)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern void ONX_Model_Dump3(IntPtr pConstModel, ONXModelTable which, IntPtr pTextLog);
+
   //const ON_Geometry* ONX_Model_ModelObjectGeometry(const ONX_Model* pConstModel, int index)
   [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
   internal static extern IntPtr ONX_Model_ModelObjectGeometry(IntPtr pConstModel, int index);
@@ -1076,6 +1233,18 @@ internal enum ObjectAttrsBool : int
   [return: MarshalAs(UnmanagedType.U1)]
   internal static extern bool ONX_Model_ObjectTable_LayerIndexTest(IntPtr pConstModel, int objectIndex, int layerIndex);
 
+  //int ONX_Model_ObjectTable_KeyObjectCount(const ONX_Model* pConstModel, int keyType, int key)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern int ONX_Model_ObjectTable_KeyObjectCount(IntPtr pConstModel, int keyType, int key);
+
+  //int ONX_Model_ObjectTable_KeyObjects(const ONX_Model* pConstModel, int keyType, int key, ON_SimpleArray<int>* indices)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern int ONX_Model_ObjectTable_KeyObjects(IntPtr pConstModel, int keyType, int key, IntPtr indices);
+
+  //void ONX_Model_ObjectTable_InvalidateKeyIndices(const ONX_Model* pConstModel)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern void ONX_Model_ObjectTable_InvalidateKeyIndices(IntPtr pConstModel);
+
   //ON_UUID ONX_Model_ObjectTable_AddPoint(ONX_Model* pModel, ON_3DPOINT_STRUCT point, const ON_3dmObjectAttributes* pConstAttributes)
   [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
   internal static extern Guid ONX_Model_ObjectTable_AddPoint(IntPtr pModel, Point3d point, IntPtr pConstAttributes);
@@ -1160,6 +1329,22 @@ internal enum ObjectAttrsBool : int
   [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
   internal static extern Guid ONX_Model_ObjectTable_AddPolyLine(IntPtr pModel, int count, Point3d[] points, IntPtr pConstAttributes);
 
+  //int ONX_Model_ObjectTable_AddPoints(ONX_Model* pModel, int count, /*ARRAY*/const ON_3dPoint* points, const ON_SimpleArray<const ON_3dmObjectAttributes*>* pAttributes, /*ARRAY*/ON_UUID* ids)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern int ONX_Model_ObjectTable_AddPoints(IntPtr pModel, int count, Point3d[] points, IntPtr pAttributes, [In,Out] Guid[] ids);
+
+  //int ONX_Model_ObjectTable_AddLines(ONX_Model* pModel, int count, /*ARRAY*/const ON_3dPoint* endpoints, const ON_SimpleArray<const ON_3dmObjectAttributes*>* pAttributes, /*ARRAY*/ON_UUID* ids)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern int ONX_Model_ObjectTable_AddLines(IntPtr pModel, int count, Point3d[] endpoints, IntPtr pAttributes, [In,Out] Guid[] ids);
+
+  //int ONX_Model_ObjectTable_AddPolylines(ONX_Model* pModel, int count, /*ARRAY*/const int* offsets, /*ARRAY*/const ON_3dPoint* points, const ON_SimpleArray<const ON_3dmObjectAttributes*>* pAttributes, /*ARRAY*/ON_UUID* ids)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern int ONX_Model_ObjectTable_AddPolylines(IntPtr pModel, int count, int[] offsets, Point3d[] points, IntPtr pAttributes, [In,Out] Guid[] ids);
+
+  //int ONX_Model_ObjectTable_AddMeshes(ONX_Model* pModel, const ON_SimpleArray<ON_Mesh*>* pConstMeshes, const ON_SimpleArray<const ON_3dmObjectAttributes*>* pAttributes, /*ARRAY*/ON_UUID* ids)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern int ONX_Model_ObjectTable_AddMeshes(IntPtr pModel, IntPtr pConstMeshes, IntPtr pAttributes, [In,Out] Guid[] ids);
+
   //bool ONX_Model_ObjectTable_Delete(ONX_Model* pModel, ON_UUID object_id)
   [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
   [return: MarshalAs(UnmanagedType.U1)]
@@ -1169,6 +1354,14 @@ internal enum ObjectAttrsBool : int
   [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
   internal static extern void ONX_Model_BoundingBox(IntPtr pConstModel, ref BoundingBox pBBox);
 
+  //int ONX_Model_ObjectTable_BoundingBoxes(const ONX_Model* pConstModel, int count, /*ARRAY*/double* boxes, int maxThreads)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern int ONX_Model_ObjectTable_BoundingBoxes(IntPtr pConstModel, int count, [In,Out] double[] boxes, int maxThreads);
+
+  //void ONX_Model_ObjectTable_InvalidateBoundingBoxes(const ONX_Model* pConstModel)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern void ONX_Model_ObjectTable_InvalidateBoundingBoxes(IntPtr pConstModel);
+
   //ON_Linetype* ONX_Model_GetLinetypePointer(ONX_Model* pModel, ON_UUID id)
   [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
   internal static extern IntPtr ONX_Model_GetLinetypePointer(IntPtr pModel, Guid id);
@@ -1269,6 +1462,10 @@ internal enum ObjectAttrsBool : int
   [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
   internal static extern IntPtr ONX_Model_GetInstanceDefinitionPointer(IntPtr pConstModel, Guid id);
 
+  //int ONX_Model_ResolveIds(const ONX_Model* pConstModel, enum ModelIdTable table, int count, /*ARRAY*/const ON_UUID* ids, /*ARRAY*/int* indices)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern int ONX_Model_ResolveIds(IntPtr pConstModel, ModelIdTable table, int count, Guid[] ids, [In,Out] int[] indices);
+
   //ON_UUID ONX_Model_MaterialTable_Id(const ONX_Model* pConstModel, int index)
   [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
   internal static extern Guid ONX_Model_MaterialTable_Id(IntPtr pConstModel, int index);
@@ -1346,10 +1543,134 @@ internal enum ObjectAttrsBool : int
   [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
   internal static extern void ON_BinaryFile_Close(IntPtr pBinaryFile);
 
+  //ONX_Model* ONX_Model_ReadFileMapped(const RHMONO_STRING* path, CRhCmnStringHolder* pStringHolder)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern IntPtr ONX_Model_ReadFileMapped([MarshalAs(UnmanagedType.LPWStr)]string path, IntPtr pStringHolder);
+
   //ONX_Model* ONX_Model_ReadFile2(const RHMONO_STRING* path, ReadFileTableTypeFilter tableFilter, ObjectTypeFilter objectTypeFilter, CRhCmnStringHolder* pStringHolder)
   [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
   internal static extern IntPtr ONX_Model_ReadFile2([MarshalAs(UnmanagedType.LPWStr)]string path, ReadFileTableTypeFilter tableFilter, ObjectTypeFilter objectTypeFilter, IntPtr pStringHolder);
 
+  //ONX_Model* ONX_Model_ReadFile3(const RHMONO_STRING* path, ReadFileTableTypeFilter tableFilter, ObjectTypeFilter objectTypeFilter, ReadFileOptions options, CRhCmnStringHolder* pStringHolder)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern IntPtr ONX_Model_ReadFile3([MarshalAs(UnmanagedType.LPWStr)]string path, ReadFileTableTypeFilter tableFilter, ObjectTypeFilter objectTypeFilter, ReadFileOptions options, IntPtr pStringHolder);
+
+  //CRhCmnObjectCursor* ONX_Model_ObjectCursor_Open(const RHMONO_STRING* path, ObjectTypeFilter objectTypeFilter, bool memoryMapped)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern IntPtr ONX_Model_ObjectCursor_Open([MarshalAs(UnmanagedType.LPWStr)]string path, ObjectTypeFilter objectTypeFilter, [MarshalAs(UnmanagedType.U1)]bool memoryMapped);
+
+  //ON_Geometry* ONX_Model_ObjectCursor_Next(CRhCmnObjectCursor* pCursor, ON_3dmObjectAttributes* pAttributes, int* tableIndex)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern IntPtr ONX_Model_ObjectCursor_Next(IntPtr pCursor, IntPtr pAttributes, ref int tableIndex);
+
+  //void ONX_Model_ObjectCursor_Close(CRhCmnObjectCursor* pCursor)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern void ONX_Model_ObjectCursor_Close(IntPtr pCursor);
+
+  //CRhCmnArchiveIndex* ONX_Model_ArchiveIndex_Build(const RHMONO_STRING* path)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern IntPtr ONX_Model_ArchiveIndex_Build([MarshalAs(UnmanagedType.LPWStr)]string path);
+
+  //CRhCmnArchiveIndex* ONX_Model_ArchiveIndex_ReadSidecar(const RHMONO_STRING* sidecarPath, const RHMONO_STRING* path)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern IntPtr ONX_Model_ArchiveIndex_ReadSidecar([MarshalAs(UnmanagedType.LPWStr)]string sidecarPath, [MarshalAs(UnmanagedType.LPWStr)]string path);
+
+  //bool ONX_Model_ArchiveIndex_WriteSidecar(const CRhCmnArchiveIndex* pConstIndex, const RHMONO_STRING* sidecarPath)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  [return: MarshalAs(UnmanagedType.U1)]
+  internal static extern bool ONX_Model_ArchiveIndex_WriteSidecar(IntPtr pConstIndex, [MarshalAs(UnmanagedType.LPWStr)]string sidecarPath);
+
+  //void ONX_Model_ArchiveIndex_Delete(CRhCmnArchiveIndex* pIndex)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern void ONX_Model_ArchiveIndex_Delete(IntPtr pIndex);
+
+  //int ONX_Model_ArchiveIndex_ObjectCount(const CRhCmnArchiveIndex* pConstIndex)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern int ONX_Model_ArchiveIndex_ObjectCount(IntPtr pConstIndex);
+
+  //bool ONX_Model_ArchiveIndex_GetObjectInfo(const CRhCmnArchiveIndex* pConstIndex, int index, ON_UUID* id, unsigned int* objectType, int* layerIndex, ON_BoundingBox* bbox)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  [return: MarshalAs(UnmanagedType.U1)]
+  internal static extern bool ONX_Model_ArchiveIndex_GetObjectInfo(IntPtr pConstIndex, int index, ref Guid id, ref uint objectType, ref int layerIndex, ref BoundingBox bbox);
+
+  //int ONX_Model_ArchiveIndex_GetBoundingBoxes(const CRhCmnArchiveIndex* pConstIndex, int count, /*ARRAY*/double* boxes)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern int ONX_Model_ArchiveIndex_GetBoundingBoxes(IntPtr pConstIndex, int count, [In,Out] double[] boxes);
+
+  //int ONX_Model_ArchiveIndex_TableCount(const CRhCmnArchiveIndex* pConstIndex)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern int ONX_Model_ArchiveIndex_TableCount(IntPtr pConstIndex);
+
+  //bool ONX_Model_ArchiveIndex_GetTable(const CRhCmnArchiveIndex* pConstIndex, int index, unsigned int* typecode, ON__INT64* offset)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  [return: MarshalAs(UnmanagedType.U1)]
+  internal static extern bool ONX_Model_ArchiveIndex_GetTable(IntPtr pConstIndex, int index, ref uint typecode, ref Int64 offset);
+
+  //ON_Geometry* ONX_Model_ArchiveIndex_ReadObject(const CRhCmnArchiveIndex* pConstIndex, int index, ON_3dmObjectAttributes* pAttributes)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern IntPtr ONX_Model_ArchiveIndex_ReadObject(IntPtr pConstIndex, int index, IntPtr pAttributes);
+
+  //ONX_Model* ONX_Model_ReadFile4(const RHMONO_STRING* path, ReadFileTableTypeFilter tableFilter, ObjectTypeFilter objectTypeFilter, ReadFileOptions options, const ON_BoundingBox* region, const CRhCmnArchiveIndex* pConstIndex, CRhCmnStringHolder* pStringHolder)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern IntPtr ONX_Model_ReadFile4([MarshalAs(UnmanagedType.LPWStr)]string path, ReadFileTableTypeFilter tableFilter, ObjectTypeFilter objectTypeFilter, ReadFileOptions options, ref BoundingBox region, IntPtr pConstIndex, IntPtr pStringHolder);
+
+  //void ONX_Model_Journal_Enable(ONX_Model* pModel, bool enable)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern void ONX_Model_Journal_Enable(IntPtr pModel, [MarshalAs(UnmanagedType.U1)]bool enable);
+
+  //void ONX_Model_Journal_MarkObjectDirty(ONX_Model* pModel, ON_UUID id)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern void ONX_Model_Journal_MarkObjectDirty(IntPtr pModel, Guid id);
+
+  //void ONX_Model_Journal_MarkTableDirty(ONX_Model* pModel, unsigned int tables)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern void ONX_Model_Journal_MarkTableDirty(IntPtr pModel, uint tables);
+
+  //bool ONX_Model_Journal_IsDirty(const ONX_Model* pConstModel)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  [return: MarshalAs(UnmanagedType.U1)]
+  internal static extern bool ONX_Model_Journal_IsDirty(IntPtr pConstModel);
+
+  //bool ONX_Model_Journal_Save(ONX_Model* pModel, const RHMONO_STRING* basePath, const RHMONO_STRING* journalPath)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  [return: MarshalAs(UnmanagedType.U1)]
+  internal static extern bool ONX_Model_Journal_Save(IntPtr pModel, [MarshalAs(UnmanagedType.LPWStr)]string basePath, [MarshalAs(UnmanagedType.LPWStr)]string journalPath);
+
+  //int ONX_Model_Journal_Replay(ONX_Model* pModel, const RHMONO_STRING* basePath, const RHMONO_STRING* journalPath, CRhCmnStringHolder* pStringHolder)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern int ONX_Model_Journal_Replay(IntPtr pModel, [MarshalAs(UnmanagedType.LPWStr)]string basePath, [MarshalAs(UnmanagedType.LPWStr)]string journalPath, IntPtr pStringHolder);
+
+  //ONX_Model* ONX_Model_ReadFileWithJournal(const RHMONO_STRING* basePath, const RHMONO_STRING* journalPath, CRhCmnStringHolder* pStringHolder)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern IntPtr ONX_Model_ReadFileWithJournal([MarshalAs(UnmanagedType.LPWStr)]string basePath, [MarshalAs(UnmanagedType.LPWStr)]string journalPath, IntPtr pStringHolder);
+
+  //bool ONX_Model_Journal_Compact(ONX_Model* pModel, const RHMONO_STRING* basePath, const RHMONO_STRING* journalPath, int version)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  [return: MarshalAs(UnmanagedType.U1)]
+  internal static extern bool ONX_Model_Journal_Compact(IntPtr pModel, [MarshalAs(UnmanagedType.LPWStr)]string basePath, [MarshalAs(UnmanagedType.LPWStr)]string journalPath, int version);
+
+  //ON_SimpleArray<CRhCmnPreviewImage*>* ONX_Model_ReadPreviewImages(const ON_ClassArray<ON_wString>* pPaths, const RHMONO_STRING* cacheFolder, int maxThreads)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern IntPtr ONX_Model_ReadPreviewImages(IntPtr pPaths, [MarshalAs(UnmanagedType.LPWStr)]string cacheFolder, int maxThreads);
+
+  //int ONX_Model_PreviewImageArray_Count(const ON_SimpleArray<CRhCmnPreviewImage*>* pConstImages)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern int ONX_Model_PreviewImageArray_Count(IntPtr pConstImages);
+
+  //bool ONX_Model_PreviewImageArray_GetSize(const ON_SimpleArray<CRhCmnPreviewImage*>* pConstImages, int index, int* width, int* height)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  [return: MarshalAs(UnmanagedType.U1)]
+  internal static extern bool ONX_Model_PreviewImageArray_GetSize(IntPtr pConstImages, int index, ref int width, ref int height);
+
+  //bool ONX_Model_PreviewImageArray_CopyPixels(const ON_SimpleArray<CRhCmnPreviewImage*>* pConstImages, int index, int length, /*ARRAY*/unsigned char* bgra)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  [return: MarshalAs(UnmanagedType.U1)]
+  internal static extern bool ONX_Model_PreviewImageArray_CopyPixels(IntPtr pConstImages, int index, int length, [In,Out] byte[] bgra);
+
+  //void ONX_Model_PreviewImageArray_Delete(ON_SimpleArray<CRhCmnPreviewImage*>* pImages)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern void ONX_Model_PreviewImageArray_Delete(IntPtr pImages);
+
   internal enum ReadFileTableTypeFilter : int
   {
     None = 0,
@@ -1391,6 +1712,26 @@ internal enum ObjectTypeFilter : uint
     Any           = 0xFFFFFFFF
   }
 
+  internal enum ModelIdTable : int
+  {
+    ObjectTable = 0,
+    LayerTable,
+    LinetypeTable,
+    DimstyleTable,
+    HatchpatternTable,
+    MaterialTable,
+    InstanceDefinitionTable,
+    TableCount
+  }
+
+  internal enum ObjectKeyType : int
+  {
+    Layer = 0,
+    Material = 1,
+    Group = 2,
+    Count = 3
+  }
+
   internal enum ONXModelTable : int
   {
     DumpAll = 0,
@@ -1412,6 +1753,14 @@ internal enum ONXModelTable : int
     ViewTable = 16,
     NamedViewTable = 17,
   }
+
+  internal enum ReadFileOptions : uint
+  {
+    None         = 0,
+    MemoryMapped = 1, // read through a memory mapping of the file instead of FILE*
+    ParallelObjectTable = 2, // decode object table records on worker threads
+    LazyUserData = 4 // keep managed user data as raw bytes until it is asked for
+  }
   #endregion
 
 
@@ -1604,6 +1953,26 @@ internal enum ONXModelTable : int
   [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
   internal static extern IntPtr ON_SurfaceArray_Get(IntPtr pSurfaceArray, int index);
 
+  //ON_SimpleArray<ON_Object*>* ON_ObjectArray_New(int initial_capacity)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern IntPtr ON_ObjectArray_New(int initial_capacity);
+
+  //void ON_ObjectArray_Delete(ON_SimpleArray<ON_Object*>* pObjectArray)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern void ON_ObjectArray_Delete(IntPtr pObjectArray);
+
+  //int ON_ObjectArray_Count(const ON_SimpleArray<ON_Object*>* pConstObjectArray)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern int ON_ObjectArray_Count(IntPtr pConstObjectArray);
+
+  //void ON_ObjectArray_Append(ON_SimpleArray<ON_Object*>* pObjectArray, ON_Object* pObject)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern void ON_ObjectArray_Append(IntPtr pObjectArray, IntPtr pObject);
+
+  //ON_Object* ON_ObjectArray_Get(const ON_SimpleArray<ON_Object*>* pConstObjectArray, int index)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern IntPtr ON_ObjectArray_Get(IntPtr pConstObjectArray, int index);
+
   //ON_SimpleArray<ON_Interval>* ON_IntervalArray_New()
   [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
   internal static extern IntPtr ON_IntervalArray_New();
@@ -3090,6 +3459,26 @@ internal enum ONXModelTable : int
   //void ON_Intersect_MeshPolyline_Fill(ON_SimpleArray<ON_CMX_EVENT>* pCMX, int count, /*ARRAY*/ON_3dPoint* points, /*ARRAY*/int* faceIds)
   [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
   internal static extern void ON_Intersect_MeshPolyline_Fill(IntPtr pCMX, int count, [In,Out] Point3d[] points, [In,Out] int[] faceIds);
+
+  //CRhCmnMeshRayEngine* ON_MeshRayEngine_New(const ON_Mesh* pConstMesh)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern IntPtr ON_MeshRayEngine_New(IntPtr pConstMesh);
+
+  //void ON_MeshRayEngine_Delete(CRhCmnMeshRayEngine* pEngine)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern void ON_MeshRayEngine_Delete(IntPtr pEngine);
+
+  //int ON_MeshRayEngine_FirstHit(const CRhCmnMeshRayEngine* pConstEngine, const ON_3dRay* pConstRay, double tMin, double tMax, double* t, /*ARRAY*/double* barycentrics)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern int ON_MeshRayEngine_FirstHit(IntPtr pConstEngine, ref Ray3d pConstRay, double tMin, double tMax, ref double t, [In,Out] double[] barycentrics);
+
+  //int ON_MeshRayEngine_FirstHits(const CRhCmnMeshRayEngine* pConstEngine, int count, /*ARRAY*/const double* rays, double tMin, double tMax, /*ARRAY*/double* t, /*ARRAY*/int* faceIndices, /*ARRAY*/double* barycentrics, int maxThreads)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern int ON_MeshRayEngine_FirstHits(IntPtr pConstEngine, int count, double[] rays, double tMin, double tMax, [In,Out] double[] t, [In,Out] int[] faceIndices, [In,Out] double[] barycentrics, int maxThreads);
+
+  //int ON_MeshRayEngine_AnyHits(const CRhCmnMeshRayEngine* pConstEngine, int count, /*ARRAY*/const double* rays, double tMin, double tMax, /*ARRAY*/int* hit, int maxThreads)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern int ON_MeshRayEngine_AnyHits(IntPtr pConstEngine, int count, double[] rays, double tMin, double tMax, [In,Out] int[] hit, int maxThreads);
   #endregion
 
 
@@ -3657,6 +4046,16 @@ internal enum ONXModelTable : int
   [return: MarshalAs(UnmanagedType.U1)]
   internal static extern bool ON_Mesh_InsertFace(IntPtr pMesh, int index, int vertex1, int vertex2, int vertex3, int vertex4);
 
+  //bool ON_Mesh_SetVertices(ON_Mesh* pMesh, int count, /*ARRAY*/const ON_3fPoint* locations, bool append)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  [return: MarshalAs(UnmanagedType.U1)]
+  internal static extern bool ON_Mesh_SetVertices(IntPtr pMesh, int count, Point3f[] locations, [MarshalAs(UnmanagedType.U1)]bool append);
+
+  //bool ON_Mesh_SetVertices2(ON_Mesh* pMesh, int count, /*ARRAY*/const double* xyz, bool append)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  [return: MarshalAs(UnmanagedType.U1)]
+  internal static extern bool ON_Mesh_SetVertices2(IntPtr pMesh, int count, double[] xyz, [MarshalAs(UnmanagedType.U1)]bool append);
+
   //bool ON_Mesh_SetNormal(ON_Mesh* pMesh, int index, ON_3FVECTOR_STRUCT vector, bool faceNormal)
   [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
   [return: MarshalAs(UnmanagedType.U1)]
@@ -3695,6 +4094,16 @@ internal enum ONXModelTable : int
   [return: MarshalAs(UnmanagedType.U1)]
   internal static extern bool ON_Mesh_SetVertexColors(IntPtr pMesh, int count, int[] argb, [MarshalAs(UnmanagedType.U1)]bool append);
 
+  //bool ON_Mesh_SetFaces(ON_Mesh* pMesh, int faceCount, int verticesPerFace, /*ARRAY*/const int* vertices, bool append)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  [return: MarshalAs(UnmanagedType.U1)]
+  internal static extern bool ON_Mesh_SetFaces(IntPtr pMesh, int faceCount, int verticesPerFace, int[] vertices, [MarshalAs(UnmanagedType.U1)]bool append);
+
+  //bool ON_Mesh_SetFaces2(ON_Mesh* pMesh, int faceCount, /*ARRAY*/const int* faceSizes, /*ARRAY*/const int* vertices, bool append)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  [return: MarshalAs(UnmanagedType.U1)]
+  internal static extern bool ON_Mesh_SetFaces2(IntPtr pMesh, int faceCount, int[] faceSizes, int[] vertices, [MarshalAs(UnmanagedType.U1)]bool append);
+
   //void ON_Mesh_SetInt( ON_Mesh* pMesh, int which, int value )
   [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
   internal static extern void ON_Mesh_SetInt(IntPtr pMesh, int which, int value);
@@ -3784,6 +4193,35 @@ internal enum ONXModelTable : int
   [return: MarshalAs(UnmanagedType.U1)]
   internal static extern bool ON_Mesh_GetTextureCoordinate(IntPtr pConstMesh, int index, ref float s, ref float t);
 
+  //bool ON_Mesh_GetVertices(const ON_Mesh* pConstMesh, int start, int count, /*ARRAY*/ON_3fPoint* vertices)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  [return: MarshalAs(UnmanagedType.U1)]
+  internal static extern bool ON_Mesh_GetVertices(IntPtr pConstMesh, int start, int count, [In,Out] Point3f[] vertices);
+
+  //bool ON_Mesh_GetFaces(const ON_Mesh* pConstMesh, int start, int count, /*ARRAY*/int* faces)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  [return: MarshalAs(UnmanagedType.U1)]
+  internal static extern bool ON_Mesh_GetFaces(IntPtr pConstMesh, int start, int count, [In,Out] int[] faces);
+
+  //bool ON_Mesh_GetNormals(const ON_Mesh* pConstMesh, int start, int count, /*ARRAY*/ON_3fVector* normals, bool faceNormals)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  [return: MarshalAs(UnmanagedType.U1)]
+  internal static extern bool ON_Mesh_GetNormals(IntPtr pConstMesh, int start, int count, [In,Out] Vector3f[] normals, [MarshalAs(UnmanagedType.U1)]bool faceNormals);
+
+  //bool ON_Mesh_GetTextureCoordinates(const ON_Mesh* pConstMesh, int start, int count, /*ARRAY*/float* tcs)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  [return: MarshalAs(UnmanagedType.U1)]
+  internal static extern bool ON_Mesh_GetTextureCoordinates(IntPtr pConstMesh, int start, int count, [In,Out] float[] tcs);
+
+  //bool ON_Mesh_GetVertexColors(const ON_Mesh* pConstMesh, int start, int count, /*ARRAY*/int* argb)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  [return: MarshalAs(UnmanagedType.U1)]
+  internal static extern bool ON_Mesh_GetVertexColors(IntPtr pConstMesh, int start, int count, [In,Out] int[] argb);
+
+  //const void* ON_Mesh_GetListView(const ON_Mesh* pConstMesh, enum MeshListType which, int* count, int* capacity)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern IntPtr ON_Mesh_GetListView(IntPtr pConstMesh, MeshListType which, ref int count, ref int capacity);
+
   //bool ON_Mesh_NakedEdgePoints( const ON_Mesh* pMesh, /*ARRAY*/int* naked_status, int count )
   [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
   [return: MarshalAs(UnmanagedType.U1)]
@@ -3981,6 +4419,18 @@ internal enum ONXModelTable : int
   [return: MarshalAs(UnmanagedType.U1)]
   internal static extern bool ON_Mesh_GetClosestPoint3(IntPtr pConstMesh, Point3d p, ref MeshPointDataStruct meshpoint, double max_dist);
 
+  //int ON_Mesh_GetClosestPoints(const ON_Mesh* pConstMesh,
+  //                                           int count,
+  //                                           /*ARRAY*/const ON_3dPoint* points,
+  //                                           double maxDistance,
+  //                                           /*ARRAY*/int* faceIndices,
+  //                                           /*ARRAY*/double* t,
+  //                                           /*ARRAY*/ON_3dPoint* closestPoints,
+  //                                           /*ARRAY*/ON_3dVector* normals,
+  //                                           int maxThreads)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern int ON_Mesh_GetClosestPoints(IntPtr pConstMesh, int count, Point3d[] points, double maxDistance, [In,Out] int[] faceIndices, [In,Out] double[] t, [In,Out] Point3d[] closestPoints, [In,Out] Vector3d[] normals, int maxThreads);
+
   //bool ON_Mesh_MeshPointAt(const ON_Mesh* pConstMesh, int faceIndex, double t0, double t1, double t2, double t3, ON_3dPoint* p)
   [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
   [return: MarshalAs(UnmanagedType.U1)]
@@ -4105,6 +4555,16 @@ internal enum ONXModelTable : int
   [return: MarshalAs(UnmanagedType.U1)]
   internal static extern bool ON_Mesh_GetMeshPart(IntPtr pConstMesh, int which, ref int vi0, ref int vi1, ref int fi0, ref int fi1, ref int vertex_count, ref int triangle_count);
 
+  internal enum MeshListType : int
+  {
+    Vertices = 0,            // ON_3fPoint
+    Faces = 1,               // ON_MeshFace
+    VertexNormals = 2,       // ON_3fVector
+    FaceNormals = 3,         // ON_3fVector
+    VertexColors = 4,        // ON_Color (ABGR, alpha 0 is opaque)
+    TextureCoordinates = 5   // ON_2fPoint
+  }
+
   internal enum TextureMappingType : int
   {
     NoMapping       = 0,
@@ -4738,6 +5198,11 @@ internal enum TextureMappingGetTransform : int
   [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
   internal static extern void ON_PointCloud_GetColors(IntPtr pConstPointCloud, int count, [In,Out] int[] colors);
 
+  //bool ON_PointCloud_SetColors( ON_PointCloud* pPointCloud, int count, /*ARRAY*/const int* colors)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  [return: MarshalAs(UnmanagedType.U1)]
+  internal static extern bool ON_PointCloud_SetColors(IntPtr pPointCloud, int count, int[] colors);
+
   //int ON_PointCloud_GetClosestPoint(const ON_PointCloud* pConstPointCloud, ON_3DPOINT_STRUCT point)
   [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
   internal static extern int ON_PointCloud_GetClosestPoint(IntPtr pConstPointCloud, Point3d point);
@@ -5194,6 +5659,18 @@ internal enum TextureMappingGetTransform : int
   [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
   internal static extern IntPtr ON_TextLog_New2([MarshalAs(UnmanagedType.LPWStr)]string _filename);
 
+  //ON_TextLog* ON_TextLog_NewFileDescriptor(int fd, int chunkSize)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  internal static extern IntPtr ON_TextLog_NewFileDescriptor(int fd, int chunkSize);
+
+  //ON_TextLog* ON_TextLog_NewCallback(TEXTLOGWRITEPROC callback, int serial_number, int chunkSize)
+  // SKIPPING - Contains a function pointer which needs to be written by hand
+
+  //bool ON_TextLog_Flush(ON_TextLog* pTextLog)
+  [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
+  [return: MarshalAs(UnmanagedType.U1)]
+  internal static extern bool ON_TextLog_Flush(IntPtr pTextLog);
+
   //void ON_TextLog_PushPopIndent(ON_TextLog* pTextLog, bool push)
   [DllImport(Import.lib, CallingConvention=CallingConvention.Cdecl )]
   internal static extern void ON_TextLog_PushPopIndent(IntPtr pTextLog, [MarshalAs(UnmanagedType.U1)]bool push);
@@ -579,6 +579,10 @@ Rhino.Render.UI.UserInterfaceSection.SerialNumberBoolCallback onExpandCallback
     Rhino.DocObjects.Custom.UserData.CreateUserDataCallback create_func,
     Rhino.DocObjects.Custom.UserData.DeleteUserDataCallback delete_func);
 
+  // Keep callback alive until ON_TextLog_Delete is called on the returned log
+  [DllImport(Import.lib, CallingConvention = CallingConvention.Cdecl)]
+  internal static extern IntPtr ON_TextLog_NewCallback(Rhino.FileIO.TextLog.TextLogWriteCallback callback, int serial_number, int chunkSize);
+
   [DllImport(Import.lib, CallingConvention = CallingConvention.Cdecl)]
   [return: MarshalAs(UnmanagedType.U1)]
   internal static extern bool ON_RTree_Search(IntPtr pConstRtree, Point3d pt0, Point3d pt1, int serialNumber, RTree.SearchCallback searchCallback);
@@ -596,6 +600,10 @@ Rhino.Render.UI.UserInterfaceSection.SerialNumberBoolCallback onExpandCallback
   [return: MarshalAs(UnmanagedType.U1)]
   internal static extern bool ON_Arc_Copy(IntPtr pRdnArc, ref Arc pRhCmnArc, [MarshalAs(UnmanagedType.U1)]bool rdn_to_rhc);
 
+  // ONX_Model_ReadFile4 with region passed as a pointer, so IntPtr.Zero reads without a region filter
+  [DllImport(Import.lib, CallingConvention = CallingConvention.Cdecl)]
+  internal static extern IntPtr ONX_Model_ReadFile4([MarshalAs(UnmanagedType.LPWStr)]string path, ReadFileTableTypeFilter tableFilter, ObjectTypeFilter objectTypeFilter, ReadFileOptions options, IntPtr region, IntPtr pConstIndex, IntPtr pStringHolder);
+
   #region rh_menu.cpp
 
   [DllImport(Import.lib, CallingConvention = CallingConvention.Cdecl)]
@@ -143,6 +143,12 @@ public void Print(string format, object arg0, object arg1)
       Print(string.Format(format, arg0, arg1));
     }
 
+    // Matches TEXTLOGWRITEPROC in on_textlog.cpp. utf8 points at length bytes of
+    // UTF-8 text; returning 0 stops the writing. The native log keeps only a
+    // function pointer, so the delegate passed to ON_TextLog_NewCallback has to
+    // be kept alive until ON_TextLog_Delete is called.
+    internal delegate int TextLogWriteCallback(int serial_number, IntPtr utf8, int length);
+
     IntPtr ConstPointer()
     {
       return NonConstPointer(); // all ONX_Models are non-const